@@ -50,8 +50,9 @@ size_t buffer_available(buffer *);
 struct string_buf_s {
     buffer *buf;
     bool fixed;
-    size_t chunk_size;
+    size_t chunk_size; // size of newly allocated chunks
     uint8_t *chunk;
+    uint8_t *chunk_end; // current chunk can be larger than [chunk_size], see string_buf_reserve()
     uint8_t *wp;
 };
 
@@ -61,6 +62,18 @@ void string_buf_init_fixed(string_buf_t *wb, char *outbuf, size_t max);
 
 void string_buf_free(string_buf_t *wb);
 
+/**
+ * Get contiguous writable span of at least [len] bytes at the end of the buffer.
+ * Written bytes become part of the buffer contents after [string_buf_commit()].
+ * @return pointer to the span, or NULL if fixed buffer does not have enough space
+ */
+char *string_buf_reserve(string_buf_t *wb, size_t len);
+
+/**
+ * Add [len] bytes written into span returned by [string_buf_reserve()] to the buffer contents.
+ */
+void string_buf_commit(string_buf_t *wb, size_t len);
+
 #ifdef __cplusplus
 }
 #endif
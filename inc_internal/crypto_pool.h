@@ -0,0 +1,95 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ZITI_SDK_CRYPTO_POOL_H
+#define ZITI_SDK_CRYPTO_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sodium.h>
+#include <uv.h>
+
+#include "mpsc_queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Worker threads for secretstream encrypt/decrypt.
+ *
+ * Work is submitted in batches, operations of a batch run in order on one worker,
+ * so a batch may carry consecutive messages of one stream (shared [state]).
+ * Ordering between batches is up to the submitter: only one batch per stream should be in flight.
+ * Completed batches are handed back to the loop thread through a lock-free queue.
+ */
+typedef struct crypto_pool_s crypto_pool_t;
+
+typedef struct crypto_op_s {
+    bool decrypt;
+    crypto_secretstream_xchacha20poly1305_state *state;
+    const uint8_t *in;
+    size_t in_len;
+    uint8_t *out; // encrypt: in_len + ABYTES, decrypt: in_len - ABYTES
+    unsigned long long out_len;
+    unsigned char tag;
+    int rc;
+    void *ctx;
+} crypto_op_t;
+
+typedef struct crypto_batch_s crypto_batch_t;
+
+// called on the loop thread
+typedef void (*crypto_batch_cb)(crypto_batch_t *b);
+
+struct crypto_batch_s {
+    crypto_batch_cb cb;
+    void *ctx;
+    uint32_t id; // reported with trace events, e.g. connection id
+
+    crypto_batch_t *_next; // worker queue
+    mpsc_node_t _done;     // completion queue
+
+    size_t count;
+    size_t cap;
+    crypto_op_t ops[];
+};
+
+/**
+ * start [threads] crypto workers.
+ * @return pool, or NULL if [threads] is 0 or no worker could be started -- caller does crypto inline
+ */
+crypto_pool_t *crypto_pool_new(uv_loop_t *loop, unsigned int threads);
+
+/**
+ * stop workers and release the pool.
+ * Submitted batches are completed and their callbacks are called before this function returns.
+ */
+void crypto_pool_free(crypto_pool_t *p);
+
+crypto_batch_t *crypto_batch_new(size_t cap, crypto_batch_cb cb, void *ctx);
+
+// @return new operation in batch or NULL if batch is full
+crypto_op_t *crypto_batch_add(crypto_batch_t *b);
+
+void crypto_pool_submit(crypto_pool_t *p, crypto_batch_t *b);
+
+// run single operation of batch [id], used by workers
+void crypto_op_run(crypto_op_t *op, uint32_t id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ZITI_SDK_CRYPTO_POOL_H
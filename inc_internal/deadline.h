@@ -17,24 +17,65 @@
 #ifndef ZITI_SDK_DEADLINE_H
 #define ZITI_SDK_DEADLINE_H
 
-#include <tlsuv/queue.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct deadline_s deadline_t;
-typedef LIST_HEAD(deadline_list, deadline_s) deadline_list_t;
+
+/**
+ * 4-ary min-heap of deadlines ordered by [deadline_s.due].
+ * insert, remove, and moving a deadline earlier are O(log n).
+ */
+typedef struct deadline_heap_s {
+    deadline_t **items;
+    size_t size;
+    size_t cap;
+} deadline_heap_t;
 
 struct deadline_s {
-    LIST_ENTRY(deadline_s) _next;
+    deadline_heap_t *heap; // set while deadline is armed
+    size_t idx;            // position in heap->items
+    uint64_t due;          // heap position key, can be earlier than [expiration] (lazy re-arm)
     uint64_t expiration;
     void (*expire_cb)(void *ctx);
     void *ctx;
 };
 
+/**
+ * arm [d] to expire at [expiration].
+ * If [d] is already armed and only moves later, it stays in place and is re-positioned
+ * when its old due time comes up. This keeps frequently extended deadlines (idle timers) O(1).
+ */
+void deadline_heap_set(deadline_heap_t *h, deadline_t *d, uint64_t expiration);
+
+void deadline_heap_remove(deadline_t *d);
+
+// earliest due time, UINT64_MAX if heap is empty
+uint64_t deadline_heap_next(const deadline_heap_t *h);
+
+/**
+ * remove and return a deadline expired before [now] or NULL if there are none.
+ * Deadlines re-armed with zero timeout from a callback do not fire until the clock moves.
+ * [expire_cb] of the returned deadline is still set.
+ */
+deadline_t *deadline_heap_pop(deadline_heap_t *h, uint64_t now);
+
+// owners of deadlines still in the heap must not clear them after this
+void deadline_heap_free(deadline_heap_t *h);
+
 static inline void clear_deadline(deadline_t *dl) {
     if (dl->expire_cb == NULL) return;
 
     dl->expire_cb = NULL;
-    LIST_REMOVE(dl, _next);
+    deadline_heap_remove(dl);
+}
+
+#ifdef __cplusplus
 }
+#endif
 
 #endif //ZITI_SDK_DEADLINE_H
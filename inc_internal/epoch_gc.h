@@ -0,0 +1,55 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ZITI_SDK_EPOCH_GC_H
+#define ZITI_SDK_EPOCH_GC_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Epoch based reclamation for read-mostly data shared with other threads.
+ *
+ * Readers bracket access with [epoch_gc_enter()]/[epoch_gc_leave()], they never block.
+ * Single writer unpublishes an object and hands it to [epoch_gc_retire()],
+ * it is freed by [epoch_gc_reclaim()] once every reader that could have seen it has left.
+ * Writer never waits for readers: reclaim frees what it can and reports what is still pending.
+ */
+typedef struct epoch_gc_s epoch_gc_t;
+
+epoch_gc_t *epoch_gc_new(void);
+
+// frees all retired objects, there must be no active readers
+void epoch_gc_free(epoch_gc_t *gc);
+
+// reader: returns token for [epoch_gc_leave()]
+unsigned epoch_gc_enter(epoch_gc_t *gc);
+
+void epoch_gc_leave(epoch_gc_t *gc, unsigned token);
+
+// writer: [obj] is no longer reachable by new readers
+void epoch_gc_retire(epoch_gc_t *gc, void *obj, void (*free_fn)(void *));
+
+// writer: advance epoch if possible and free objects past their grace period
+// @return number of retired objects still waiting for readers
+size_t epoch_gc_reclaim(epoch_gc_t *gc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ZITI_SDK_EPOCH_GC_H
@@ -0,0 +1,54 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ZITI_SDK_HOST_TABLE_H
+#define ZITI_SDK_HOST_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "epoch_gc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Append-only hostname -> IPv4 table with a single writer and lock-free readers.
+ *
+ * Adding an entry does not copy the table, it is linked into its bucket.
+ * When the table grows, buckets are rebuilt once per doubling and the old ones
+ * are retired to [gc], so additions are O(1) amortized.
+ */
+typedef struct host_table_s host_table_t;
+
+host_table_t *host_table_new(epoch_gc_t *gc);
+
+// there must be no active readers
+void host_table_free(host_table_t *t);
+
+// writer: [host] must not be in the table yet
+void host_table_add(host_table_t *t, const char *host, uint32_t ip);
+
+// reader: call between epoch_gc_enter()/epoch_gc_leave() of the table's gc
+// @return address assigned to [host] or 0
+uint32_t host_table_get(host_table_t *t, const char *host);
+
+size_t host_table_size(host_table_t *t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ZITI_SDK_HOST_TABLE_H
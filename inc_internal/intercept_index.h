@@ -0,0 +1,59 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ZITI_SDK_INTERCEPT_INDEX_H
+#define ZITI_SDK_INTERCEPT_INDEX_H
+
+#include <ziti/ziti_model.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Compiled intercept addresses of a set of services.
+ *
+ * Hostnames and `*.domain` wildcards are kept in a trie of reversed labels,
+ * CIDRs in a binary trie per address family (longest prefix first), and
+ * port ranges of each service sorted by lower bound.
+ *
+ * Lookup returns the same service as scanning all intercepts with [ziti_intercept_match2()]
+ * and picking the lowest score. Ties go to the most recently added service, same as
+ * the iteration order of `model_map`.
+ */
+typedef struct intercept_index_s intercept_index_t;
+
+intercept_index_t *intercept_index_new(void);
+
+void intercept_index_free(intercept_index_t *idx);
+
+// add or replace intercept addresses of [service]
+void intercept_index_add(intercept_index_t *idx, const char *service, const ziti_intercept_cfg_v1 *intercept);
+
+void intercept_index_remove(intercept_index_t *idx, const char *service);
+
+size_t intercept_index_size(const intercept_index_t *idx);
+
+/**
+ * @param score (optional) match score, see [ziti_intercept_match2()]
+ * @return name of the best matching service or NULL
+ */
+const char *intercept_index_lookup(const intercept_index_t *idx, ziti_protocol proto,
+                                   const ziti_address *addr, int port, int *score);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ZITI_SDK_INTERCEPT_INDEX_H
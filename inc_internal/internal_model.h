@@ -18,6 +18,7 @@
 
 #include "ziti/model_support.h"
 #include "ziti/ziti_model.h"
+#include "ziti/ziti_buffer.h"
 
 // extends ziti_identity
 #define ZITI_IDENTITY_DATA_MODEL(XX, ...) \
@@ -228,6 +229,7 @@ XX(name, model_string, none, name, __VA_ARGS__) \
 XX(apis, ctrl_apis, none, apiAddresses, __VA_ARGS__) \
 XX(is_online, model_bool, none, isOnline, __VA_ARGS__) \
 XX(offline_time, model_number, none, , __VA_ARGS__) \
+XX(rtt, model_number, none, , __VA_ARGS__) \
 XX(cert_pem, model_string, none, certPem, __VA_ARGS__) \
 XX(fingerprint, model_string, none, fingerprint, __VA_ARGS__)
 
@@ -312,6 +314,12 @@ DECLARE_MODEL(ziti_pr_base, ZITI_PR_BASE)
 
 bool ziti_has_capability(const ziti_version *v, ziti_ctrl_cap c);
 
+/**
+ * append JSON representation of [obj] to [buf]
+ * @return 0 on success
+ */
+int model_fmt_to_json(string_buf_t *buf, const void *obj, const type_meta *meta, int flags, int indent);
+
 #ifdef __cplusplus
 }
 #endif
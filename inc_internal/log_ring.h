@@ -0,0 +1,87 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ZITI_SDK_LOG_RING_H
+#define ZITI_SDK_LOG_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+#include <atomic>
+using std::atomic_size_t;
+using std::atomic_uint_fast64_t;
+#else
+#include <stdatomic.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LOG_RECORD_LOC_LEN 128
+#define LOG_RECORD_MSG_LEN 1024
+
+// preformatted log message
+typedef struct log_record_s {
+    int level;
+    uint64_t ts; // milliseconds, captured when message was logged
+    size_t msglen;
+    char loc[LOG_RECORD_LOC_LEN];
+    char msg[LOG_RECORD_MSG_LEN];
+} log_record_t;
+
+/**
+ * Bounded multi-producer/single-consumer queue of log records (Vyukov).
+ *
+ * Producers claim a slot with a single CAS, format directly into it, and publish it.
+ * The consumer reads published records in order without locking.
+ * When the ring is full records are dropped and counted.
+ */
+typedef struct log_ring_s log_ring_t;
+
+/**
+ * @param cap number of records, rounded up to power of 2
+ */
+log_ring_t *log_ring_new(size_t cap);
+
+void log_ring_free(log_ring_t *r);
+
+/**
+ * producer: claim a record slot.
+ * @return record to fill in, or NULL if ring is full
+ */
+log_record_t *log_ring_claim(log_ring_t *r);
+
+// producer: make claimed record visible to consumer
+void log_ring_publish(log_ring_t *r, log_record_t *rec);
+
+/**
+ * consumer: get up to [max] published records in order.
+ * Records stay valid until they are released with [log_ring_release()].
+ * @return number of records
+ */
+size_t log_ring_peek(log_ring_t *r, log_record_t **recs, size_t max);
+
+// consumer: return [count] oldest records to producers
+void log_ring_release(log_ring_t *r, size_t count);
+
+// number of records dropped because ring was full
+uint64_t log_ring_dropped(log_ring_t *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ZITI_SDK_LOG_RING_H
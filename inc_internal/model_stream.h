@@ -0,0 +1,68 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ZITI_SDK_MODEL_STREAM_H
+#define ZITI_SDK_MODEL_STREAM_H
+
+#include <ziti/model_support.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Incremental JSON decoder that fills model objects as input arrives.
+ *
+ * Input can be split at any byte. Values are stored directly into model objects
+ * following the same rules as [model_from_json()], no intermediate JSON DOM is built.
+ * Values of types with custom `from_json` (enums, addresses, `json`, etc) are converted
+ * one value at a time with json-c.
+ */
+typedef struct model_stream_s model_stream;
+
+model_stream *new_model_stream(void);
+
+void delete_model_stream(model_stream *s);
+
+/**
+ * decode value of top level object's [key] into [target].
+ * [target] has the same meaning as model field of type [meta] with modifier [mod]:
+ * `T*` for none_mod, `T**` for ptr_mod, `T***` for array_mod (elements are appended to existing array),
+ * `model_list*` for list_mod, `model_map*` for map_mod.
+ *
+ * Values of keys that are not bound are skipped.
+ * If [key] is NULL the whole document is decoded into [target].
+ *
+ * On failure [target] may be partially filled, and should be freed by the caller.
+ */
+int model_stream_bind(model_stream *s, const char *key, void *target, const type_meta *meta, enum _field_mod mod);
+
+/**
+ * @return MODEL_PARSE_PARTIAL if top level value is not complete yet,
+ *         number of bytes of [data] consumed when top level value is complete,
+ *         MODEL_PARSE_INVALID if input is not valid JSON,
+ *         -1 if input does not match model
+ */
+int model_stream_feed(model_stream *s, const char *data, size_t len);
+
+/**
+ * @return 0 if complete document was decoded, otherwise last error or MODEL_PARSE_PARTIAL
+ */
+int model_stream_status(const model_stream *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ZITI_SDK_MODEL_STREAM_H
@@ -0,0 +1,95 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ZITI_SDK_MPSC_QUEUE_H
+#define ZITI_SDK_MPSC_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+#include <atomic>
+using std::atomic_uintptr_t;
+using std::atomic_bool;
+#else
+#include <stdatomic.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Intrusive multi-producer/single-consumer FIFO (Vyukov).
+ *
+ * Producers on any thread link nodes with a single atomic exchange, the consumer (loop thread)
+ * unlinks them without any locking. Embed [mpsc_node_t] in the queued element and use
+ * [container_of] to get back to it.
+ */
+typedef struct mpsc_node_s {
+    atomic_uintptr_t next;
+} mpsc_node_t;
+
+typedef struct mpsc_queue_s {
+    atomic_uintptr_t head;
+    mpsc_node_t *tail;
+    mpsc_node_t stub;
+
+    // set by producers when queue needs consumer's attention
+    atomic_bool signaled;
+} mpsc_queue_t;
+
+void mpsc_queue_init(mpsc_queue_t *q);
+
+/**
+ * push node to the queue.
+ * @return true if consumer needs to be woken up, i.e. this is the first push since the last [mpsc_queue_rearm()]
+ */
+bool mpsc_queue_push(mpsc_queue_t *q, mpsc_node_t *n);
+
+/**
+ * consumer side only: must be called before draining the queue.
+ * Any push after this call will request another wakeup.
+ */
+void mpsc_queue_rearm(mpsc_queue_t *q);
+
+/**
+ * consumer side only.
+ * @return next node, or NULL if queue is empty (or a producer is in the middle of a push,
+ *         in which case that producer will request a wakeup)
+ */
+mpsc_node_t *mpsc_queue_pop(mpsc_queue_t *q);
+
+/**
+ * Fixed capacity object pool safe to use from multiple threads.
+ * Objects are carved out of a single preallocated slab and recycled through a lock-free stack.
+ * When the slab is exhausted objects are allocated from the heap.
+ */
+typedef struct lf_pool_s lf_pool_t;
+
+lf_pool_t *lf_pool_new(size_t objsize, uint32_t count);
+
+void lf_pool_destroy(lf_pool_t *pool);
+
+// returns zeroed object
+void *lf_pool_alloc(lf_pool_t *pool);
+
+void lf_pool_return(lf_pool_t *pool, void *obj);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ZITI_SDK_MPSC_QUEUE_H
@@ -33,6 +33,7 @@ void pool_destroy(pool_t *pool);
 bool pool_has_available(pool_t *p);
 
 typedef void (*pool_available_cb)(void *ctx);
+// [cb] is called when an object is returned to exhausted pool (pool_alloc_obj() would have failed)
 void pool_set_available_cb(pool_t *p, pool_available_cb, void *ctx);
 
 void *pool_alloc_obj(pool_t *pool);
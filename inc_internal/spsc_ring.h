@@ -0,0 +1,75 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ZITI_SDK_SPSC_RING_H
+#define ZITI_SDK_SPSC_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+#include <atomic>
+using std::atomic_size_t;
+#else
+#include <stdatomic.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Single-producer/single-consumer byte ring.
+ *
+ * Producer and consumer may run on different threads without locking.
+ * Positions grow monotonically and are masked with capacity (power of 2).
+ */
+typedef struct spsc_ring_s {
+    uint8_t *buf;
+    size_t cap;
+    atomic_size_t head; // write position, only modified by producer
+    atomic_size_t tail; // read position, only modified by consumer
+} spsc_ring_t;
+
+/**
+ * @param cap capacity, rounded up to power of 2
+ * @return 0 or UV_ENOMEM
+ */
+int spsc_ring_init(spsc_ring_t *r, size_t cap);
+
+void spsc_ring_free(spsc_ring_t *r);
+
+// number of bytes available for reading
+size_t spsc_ring_size(spsc_ring_t *r);
+
+// producer: copy up to [len] bytes into the ring, returns number of bytes copied
+size_t spsc_ring_write(spsc_ring_t *r, const void *data, size_t len);
+
+// consumer: copy up to [len] bytes out of the ring, returns number of bytes copied
+size_t spsc_ring_read(spsc_ring_t *r, void *out, size_t len);
+
+/**
+ * consumer: get contiguous readable region without copying.
+ * Region stays valid until it is released with [spsc_ring_consume()].
+ * @return size of the region
+ */
+size_t spsc_ring_peek(spsc_ring_t *r, const uint8_t **data);
+
+void spsc_ring_consume(spsc_ring_t *r, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ZITI_SDK_SPSC_RING_H
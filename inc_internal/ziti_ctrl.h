@@ -32,17 +32,44 @@ typedef void (*ctrl_version_cb)(const ziti_version *, const ziti_error *, void *
 
 typedef void(*routers_cb)(ziti_service_routers *srv_routers, const ziti_error *, void *);
 
+// keep-alive connection to controller, requests on a connection are processed one at a time
+typedef struct ctrl_conn_s {
+    tlsuv_http_t *client;
+    unsigned int inflight;
+} ctrl_conn;
+
 typedef struct ziti_controller_s {
     uv_loop_t *loop;
-    tlsuv_http_t *client;
+    // connection pool, connections are opened on demand.
+    // conns[0] is always open, it is a lane reserved for dial path requests: background requests
+    // are not sent on it, but requests are not otherwise ordered by priority
+    ctrl_conn *conns;
+    unsigned int conn_count;
+    // conns[conn_count..conn_slots) are left over from shrinking the pool,
+    // they take no new requests and are closed once their in-flight requests complete
+    unsigned int conn_slots;
+    long keepalive;
 
     char *url;
     model_map endpoints;
+    tls_context *tls;
+
+    // map<header name, value> set on all clients
+    model_map headers;
 
     unsigned int active_reqs;
 
+    // HA endpoint latency probing, see ziti_controller_detail.rtt
+    uv_timer_t *probe_timer;
+    uint64_t probe_interval; // ms
+    model_list probes; // probe clients are kept open between rounds
+    unsigned int probes_pending; // probes of the current round still running
+    bool probe_report; // notify change_cb when current probe round completes
+    uint64_t switch_time;
+
     // tuning options
     unsigned int page_size;
+    unsigned int page_concurrency;
 
     bool is_ha;
     ziti_version version;
@@ -66,6 +93,24 @@ int ziti_ctrl_cancel(ziti_controller *ctrl);
 
 void ziti_ctrl_set_page_size(ziti_controller *ctrl, unsigned int size);
 
+/**
+ * set max number of pages of a list request fetched at the same time.
+ * pages beyond the first are requested in parallel once the total is known
+ */
+void ziti_ctrl_set_page_concurrency(ziti_controller *ctrl, unsigned int count);
+
+/**
+ * set max number of controller connections and time(ms) idle connections are kept open.
+ * 0 keeps current setting, negative [keepalive] closes connection after each request
+ */
+void ziti_ctrl_set_conn_pool(ziti_controller *ctrl, unsigned int size, long keepalive);
+
+/**
+ * check if [url] is the endpoint currently in use.
+ * endpoint URLs received from controller may include API path, configured URL may not.
+ */
+bool ziti_ctrl_is_current(const ziti_controller *ctrl, const char *url);
+
 void ziti_ctrl_set_callbacks(ziti_controller *ctrl, void *ctx,
                              ziti_ctrl_redirect_cb redirect_cb,
                              ziti_ctrl_change_cb change_cb);
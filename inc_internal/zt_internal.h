@@ -29,9 +29,19 @@
 #include "authenticators.h"
 #include "auth_method.h"
 #include "deadline.h"
+#include "mpsc_queue.h"
+#include "crypto_pool.h"
+#include "intercept_index.h"
 
 #include <sodium.h>
 
+#ifdef __cplusplus
+#include <atomic>
+using std::atomic_uint;
+#else
+#include <stdatomic.h>
+#endif
+
 #if !defined(UUID_STR_LEN)
 #define UUID_STR_LEN 37
 #endif
@@ -105,6 +115,10 @@ struct ziti_channel {
     message *in_next;
     size_t in_body_offset;
 
+    // on ztx->dirty_channels: message pool became available, inbound processing should resume
+    bool dirty;
+    LIST_ENTRY(ziti_channel) _dirty;
+
     // map[id->msg_receiver]
     model_map receivers;
 
@@ -144,12 +158,6 @@ struct key_exchange {
     uint8_t *tx;
 };
 
-int init_key_pair(struct key_pair *kp);
-
-int init_crypto(struct key_exchange *key_ex, struct key_pair *kp, const uint8_t *peer_key, bool server);
-
-void free_key_exchange(struct key_exchange *key_ex);
-
 enum ziti_conn_type {
     None,
     Transport,
@@ -171,6 +179,9 @@ struct ziti_conn {
     bool close;
     bool encrypted;
 
+    // on ztx->reap_list after ziti_close() until disposer releases it
+    LIST_ENTRY(ziti_conn) _reap;
+
     union {
         struct {
             char *identity;
@@ -223,6 +234,12 @@ struct ziti_conn {
             crypto_secretstream_xchacha20poly1305_state crypt_o;
             crypto_secretstream_xchacha20poly1305_state crypt_i;
 
+            // batches in flight on ztx->crypto_pool, at most one per direction
+            crypto_batch_t *crypto_out;
+            crypto_batch_t *crypto_in;
+            // result of offloaded decryption for the message being processed
+            crypto_op_t *decrypted;
+
             // stats
             bool bridged;
             uint64_t start;
@@ -249,10 +266,20 @@ typedef void (*ztx_work_f)(ziti_context ztx, void *w_ctx);
 struct ztx_work_s {
     ztx_work_f w;
     void *w_data;
-    STAILQ_ENTRY(ztx_work_s) _next;
+    mpsc_node_t _next;
 };
 
-typedef STAILQ_HEAD(work_q, ztx_work_s) ztx_work_q;
+// ziti_write_mt()/ziti_close_mt() request
+struct conn_mt_req_s {
+    ziti_connection conn;
+    bool close;
+    uint8_t *buf;
+    size_t len;
+    ziti_write_cb write_cb;
+    ziti_close_cb close_cb;
+    void *ctx;
+    mpsc_node_t _next;
+};
 
 struct tls_credentials {
     tlsuv_private_key_t key;
@@ -268,6 +295,8 @@ struct ziti_ctx {
     model_map ctrl_details;
 
     tls_context *tlsCtx;
+    // generation of TLS credentials/CA, shards rebuild their own TLS context when it changes
+    unsigned int tls_gen;
     struct tls_credentials id_creds;
     struct tls_credentials session_creds;
     char *sessionCsr;
@@ -294,11 +323,17 @@ struct ziti_ctx {
     bool services_loaded;
     // map<name,ziti_service>
     model_map services;
+    // intercept addresses of [services]
+    intercept_index_t *intercepts;
+    // map<service name, map<config type, service_cfg_t>> parsed configs of [services]
+    model_map service_cfgs;
     // map<service_id,ziti_session>
     model_map sessions;
 
     // map<service_id,*bool>
     model_map service_forced_updates;
+    // map<service_id,uint64_t*> digest of services as received from controller, see ztx_service_unchanged()
+    model_map service_hashes;
 
     char *last_update;
 
@@ -306,6 +341,10 @@ struct ziti_ctx {
     model_map channels;
     // map<id,ziti_conn>
     model_map connections;
+    // closed connections, checked by grim_reaper() on every loop iteration
+    LIST_HEAD(, ziti_conn) reap_list;
+    // channels that need ziti_channel_prepare() on next loop iteration
+    LIST_HEAD(, ziti_channel) dirty_channels;
 
     // map<conn_id,conn_id> -- connections waiting for a suitable channel
     // map to make removal easier
@@ -325,22 +364,45 @@ struct ziti_ctx {
     struct auth_queries *auth_queries;
 
     deadline_t refresh_deadline;
-    deadline_list_t deadlines;
+    deadline_heap_t deadlines;
 
     uv_loop_t *loop;
     uv_timer_t deadline_timer;
 
     uv_prepare_t prepper;
 
-    ztx_work_q w_queue;
-    uv_mutex_t w_lock;
+    mpsc_queue_t w_queue;
+    lf_pool_t *w_pool;
     uv_async_t w_async;
+
+    // connection requests from other threads, drained together with w_queue
+    mpsc_queue_t mt_queue;
+    lf_pool_t *mt_pool;
+
+    crypto_pool_t *crypto_pool;
+
+    /* sharding, see shard.c */
+    // set on shards: owner of controller, auth and services
+    struct ziti_ctx *primary;
+    // primary only: list of shard contexts
+    model_list shards;
+    // controller requests forwarded to primary
+    unsigned int shard_reqs;
+    enum { shard_attached, shard_detaching, shard_released } shard_detach;
+    // number of connections, used to select shard for new connections
+    atomic_uint conn_count;
 };
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+int init_key_pair(struct key_pair *kp);
+
+int init_crypto(struct key_exchange *key_ex, struct key_pair *kp, const uint8_t *peer_key, bool server);
+
+void free_key_exchange(struct key_exchange *key_ex);
+
 ziti_controller *ztx_get_controller(ziti_context ztx);
 
 void ziti_invalidate_session(ziti_context ztx, const char *service_id, ziti_session_type type);
@@ -390,6 +452,9 @@ int parse_enrollment_jwt(const char *token, ziti_enrollment_jwt_header *zejh, zi
 
 int load_tls(ziti_config *cfg, tls_context **tls, struct tls_credentials *creds);
 
+// reload CA bundle and own certificate of existing TLS context
+int update_tls(ziti_config *cfg, tls_context *tls, struct tls_credentials *creds);
+
 int ziti_bind(ziti_connection conn, const char *service, const ziti_listen_opts *listen_opts,
               ziti_listen_cb listen_cb, ziti_client_cb on_clt_cb);
 
@@ -413,8 +478,23 @@ void ziti_force_service_update(ziti_context ztx, const char *service_id);
 
 void ziti_services_refresh(ziti_context ztx, bool now);
 
+/**
+ * parsed config of [service] of the given type, owned by [ztx].
+ * Only config types used by the SDK are parsed (intercept.v1, ziti-tunneler-client.v1).
+ * If service only has ziti-tunneler-client.v1, intercept.v1 is derived from it.
+ * Result is valid until the service is changed or removed.
+ * @return config object (e.g. ziti_intercept_cfg_v1*) or NULL
+ */
+const void *ztx_service_config(ziti_context ztx, const char *service, const char *cfg_type);
+
 extern void ziti_send_event(ziti_context ztx, const ziti_event_t *e);
 
+// loop thread: run queued ziti_write_mt()/ziti_close_mt() requests
+void ztx_process_mt_requests(ziti_context ztx);
+
+// loop thread, every iteration: dispose connections on reap list, process channels on dirty list
+void ztx_prepare(uv_prepare_t *prep);
+
 void reject_dial_request(uint32_t conn_id, ziti_channel_t *ch, uint32_t req_id, const char *reason);
 
 const ziti_env_info* get_env_info();
@@ -428,6 +508,38 @@ int ztx_init_external_auth(ziti_context ztx, const ziti_jwt_signer *signer);
 void ztx_auth_state_cb(void *, ziti_auth_state , const void *);
 ziti_channel_t * ztx_get_channel(ziti_context ztx, const ziti_edge_router *er);
 
+// adds or replaces service, takes ownership of [s]
+void ztx_set_service(ziti_context ztx, ziti_service *s);
+
+void ztx_drop_service(ziti_context ztx, const char *name);
+
+/**
+ * check refreshed service [s] (as parsed, before any processing) against the digest recorded for it.
+ * @return true if [s] has not changed since it was last received and can be discarded,
+ *         otherwise records its digest and returns false
+ */
+bool ztx_service_unchanged(ziti_context ztx, const ziti_service *s);
+
+// push primary state to shards
+void ztx_shards_sync(ziti_context ztx);
+
+void ztx_shards_update_services(ziti_context ztx, const struct ziti_service_event *ev);
+
+// shard: release if it is shutting down and nothing is pending
+void ztx_shard_check_release(ziti_context ztx);
+
+// controller requests, forwarded to primary context for shards
+void ztx_get_service(ziti_context ztx, const char *name,
+                     void (*cb)(ziti_service *, const ziti_error *, void *), void *ctx);
+
+void ztx_create_session(ziti_context ztx, const char *service_id, ziti_session_type type,
+                        void (*cb)(ziti_session *, const ziti_error *, void *), void *ctx);
+
+void ztx_get_session(ziti_context ztx, const char *session_id,
+                     void (*cb)(ziti_session *, const ziti_error *, void *), void *ctx);
+
+void ztx_list_service_routers(ziti_context ztx, const ziti_service *srv, routers_cb cb, void *ctx);
+
 void ztx_set_deadline(ziti_context ztx, uint64_t timeout, deadline_t *d, void (*cb)(void *), void *ctx);
 
 int ch_send_conn_closed(ziti_channel_t *ch, uint32_t conn_id);
@@ -0,0 +1,50 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ZITI_SDK_ZTRACE_H
+#define ZITI_SDK_ZTRACE_H
+
+#include <ziti/ziti_trace.h>
+
+#ifdef __cplusplus
+#include <atomic>
+using std::atomic_bool;
+using std::memory_order_relaxed;
+#else
+#include <stdbool.h>
+#include <stdatomic.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// rings of exited threads kept for ziti_trace_dump(), older ones are reused by new threads
+#define ZTRACE_EXITED_RINGS 16
+
+extern atomic_bool ztrace_on;
+
+void ztrace_emit(enum ziti_trace_event ev, uint32_t id, uint32_t a, uint32_t b);
+
+// costs a relaxed load when tracing is off
+#define ZTRACE(ev, id, a, b) do { \
+if (atomic_load_explicit(&ztrace_on, memory_order_relaxed)) { \
+ztrace_emit(ZITI_TRACE_##ev, (uint32_t) (id), (uint32_t) (a), (uint32_t) (b)); } \
+} while(0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ZITI_SDK_ZTRACE_H
@@ -116,15 +116,40 @@ static inline int T##_array_from_json(array(T) *a, struct json_object *j) { retu
 .meta = get_##memtype##_meta, \
 },
 
+// generated lookup of field by JSON key, unmapped fields (empty path) never match
+#define gen_field_lookup(n, memtype, modifier, p, partype) \
+if (sizeof(#p) > 1 && len == sizeof(#p) - 1 && memcmp(key, #p, sizeof(#p) - 1) == 0) return fm; \
+fm++;
+
+// generated writer of a single field with pre-formatted key
+#define gen_field_write(n, memtype, modifier, p, partype) \
+if (sizeof(#p) > 1) { \
+    int rc = model_write_field(buf, "\"" #p "\":", sizeof("\"" #p "\":") - 1, &v->n, \
+                               get_##memtype##_meta(), modifier##_mod, &count, indent, flags); \
+    if (rc != 0) return rc; \
+}
+
 #define IMPL_MODEL(type, model) \
 static field_meta type##_FIELDS[] =  {\
     model(gen_field_meta, type) \
     };                          \
+static const field_meta *type##_field_lookup(const char *key, size_t len) { \
+    const field_meta *fm = type##_FIELDS; \
+    model(gen_field_lookup, type) \
+    return NULL; \
+}                               \
+static int type##_write_fields(const type *v, void *buf, int indent, int flags) { \
+    int count = 0; \
+    model(gen_field_write, type) \
+    return 0; \
+}                               \
 static type_meta type##_META = { \
 .name = #type, \
 .size = sizeof(type),\
 .field_count = sizeof(type##_FIELDS) / sizeof(field_meta),\
 .fields = type##_FIELDS,\
+.field_lookup = type##_field_lookup, \
+.fields_writer = (_fields_writer_f) type##_write_fields, \
 };                              \
 IMPL_MODEL_FUNCS(type)
 
@@ -178,6 +203,18 @@ typedef int (*_cmp_f)(const void *lh, const void *rh);
 typedef int (*from_json_func)(void *obj, struct json_object *json, const struct type_meta *meta);
 typedef struct json_object* (*to_json_func)(const void *obj);
 
+// specialized functions generated by IMPL_MODEL, reflective implementation is used if not set
+typedef const field_meta *(*_field_lookup_f)(const char *key, size_t len);
+typedef int (*_fields_writer_f)(const void *obj, void *buf, int indent, int flags);
+
+/**
+ * Model type descriptor.
+ *
+ * Instances are emitted into application code by IMPL_MODEL, so the layout of this struct is part of the SDK ABI.
+ * [field_lookup] and [fields_writer] were added to it: models compiled against an older model_support.h
+ * must be rebuilt before they are used with this version of the library.
+ * Hand-written descriptors may leave both NULL, the reflective implementation is used then.
+ */
 typedef struct type_meta {
     const char *name;
     size_t size;
@@ -188,6 +225,8 @@ typedef struct type_meta {
     _free_f destroyer;
     from_json_func from_json;
     to_json_func to_json;
+    _field_lookup_f field_lookup;
+    _fields_writer_f fields_writer;
 } type_meta;
 
 #define MODEL_PARSE_INVALID (-2)
@@ -214,6 +253,13 @@ ZITI_FUNC char *model_to_json(const void *obj, const type_meta *meta, int flags,
 
 ZITI_FUNC ssize_t model_to_json_r(const void *obj, const type_meta *meta, int flags, char *outbuf, size_t max);
 
+/**
+ * write model field as `"path":value` into string buffer (used by generated model writers).
+ * [key] is quoted path with the colon, [count] is number of fields written so far, incremented if field is not empty
+ */
+ZITI_FUNC int model_write_field(void *buf, const char *key, size_t key_len, const void *field,
+                                const type_meta *meta, enum _field_mod mod, int *count, int indent, int flags);
+
 ZITI_FUNC extern const type_meta *get_model_bool_meta();
 
 ZITI_FUNC extern const type_meta *get_model_number_meta();
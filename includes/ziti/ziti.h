@@ -261,6 +261,25 @@ typedef struct ziti_options_s {
      * To enable certificate extension the value must be greater than 0
      */
     unsigned int cert_extension_window;
+
+    /*
+     * Fields below were appended after cert_extension_window, offsets of earlier fields are unchanged.
+     * ziti_context_set_options() reads the whole struct: applications built against an older header
+     * must be rebuilt (fields left zero keep defaults).
+     */
+
+    /**
+     * \brief number of worker threads used for end-to-end encryption of connection data.
+     *
+     * Large payloads of encrypted connections are encrypted/decrypted off the loop thread.
+     * Message order of each connection is preserved.
+     * Default (0) -- all crypto is done on the loop thread.
+     */
+    unsigned int crypto_threads;
+
+    unsigned int api_page_concurrency; // max number of list pages requested from controller at the same time
+    unsigned int api_conn_pool_size; // max number of connections to controller, one is reserved for dial requests
+    long api_conn_keepalive; // time(ms) idle controller connections are kept open, negative to close after each request
 } ziti_options;
 
 typedef struct ziti_dial_opts_s {
@@ -406,6 +425,37 @@ extern int ziti_context_set_options(ziti_context ztx, const ziti_options *option
 ZITI_FUNC
 extern int ziti_context_run(ziti_context ztx, uv_loop_t *loop);
 
+/**
+ * \brief Add a shard of the context running on another loop.
+ *
+ * A shard shares identity, API session and services of [ztx] (the primary context) and has its own
+ * edge router channels and connections. Controller communication and authentication stay on the primary loop.
+ * Shards do not generate events, and are shut down with the primary context.
+ *
+ * Connections created with the shard (ziti_conn_init()) belong to its loop: all operations on them
+ * must be called on the shard's loop thread, and their callbacks are invoked there.
+ *
+ * Must be called on the primary loop thread after ziti_context_run(),
+ * before [loop] starts running on its thread.
+ *
+ * @param ztx primary context
+ * @param loop shard loop, run by application
+ * @param shard new shard context
+ * @return #ZITI_OK on success, or error code
+ * @see ziti_context_pick_shard()
+ */
+ZITI_FUNC
+extern int ziti_context_add_shard(ziti_context ztx, uv_loop_t *loop, ziti_context *shard);
+
+/**
+ * \brief Select the context with the least active connections among [ztx] and its shards.
+ *
+ * Must be called on the primary loop thread.
+ * @return least loaded context
+ */
+ZITI_FUNC
+extern ziti_context ziti_context_pick_shard(ziti_context ztx);
+
 /**
  * \brief Trigger refresh ahead of normal refresh cycle.
  *
@@ -783,6 +833,46 @@ extern int ziti_close_write(ziti_connection conn);
 ZITI_FUNC
 extern int ziti_write(ziti_connection conn, uint8_t *data, size_t length, ziti_write_cb write_cb, void *write_ctx);
 
+/**
+ * @brief Thread-safe variant of ziti_write().
+ *
+ * May be called from any thread. The request is queued to the context's loop and executed there,
+ * requests queued from all threads are handed over in batches with a single loop wakeup.
+ * Requests from the same thread are executed in order.
+ *
+ * Errors are reported with #ziti_write_cb, which is called on the loop thread.
+ * If the context shuts down before the request is executed, [write_cb] is called with #ZITI_DISABLED
+ * and [conn] passed to it must not be used.
+ * The caller must not use [conn] after ziti_close_mt() or ziti_close() was called on it.
+ *
+ * @param conn the #ziti_connection used to write data to
+ * @param data a buffer of data to write over the provided #ziti_connection
+ * @param length the length of data in the data buffer
+ * @param write_cb a callback invoked on the loop thread after the write completes or fails
+ * @param write_ctx additional context to be passed to the #ziti_write_cb callback
+ *
+ * @return #ZITI_OK if request was queued
+ * @see ziti_write()
+ */
+ZITI_FUNC
+extern int ziti_write_mt(ziti_connection conn, uint8_t *data, size_t length, ziti_write_cb write_cb, void *write_ctx);
+
+/**
+ * @brief Thread-safe variant of ziti_close().
+ *
+ * May be called from any thread. The close is executed on the loop thread after writes
+ * previously queued by the calling thread with ziti_write_mt(). [close_cb] is called on the loop thread,
+ * right away if [conn] was already closed, or if the context shuts down before the request is executed.
+ *
+ * @param conn the #ziti_connection to be closed
+ * @param close_cb callback called after connection is closed
+ *
+ * @return #ZITI_OK if request was queued
+ * @see ziti_close()
+ */
+ZITI_FUNC
+extern int ziti_close_mt(ziti_connection conn, ziti_close_cb close_cb);
+
 /**
  * @brief Bridge [ziti_connection] to a given IO stream
  *
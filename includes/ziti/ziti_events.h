@@ -67,6 +67,7 @@ struct ctrl_detail_s {
     const char *url;
     bool online;
     bool active;
+    int latency; // average response time in milliseconds, -1 if not measured
 };
 
 struct ziti_config_event {
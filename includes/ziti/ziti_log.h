@@ -57,8 +57,10 @@ enum DebugLevel {
 #define ZITI_LOG_MODULE NULL
 #endif
 
+// every call site caches its resolved level, see ziti_log_site_level()
 #define ZITI_LOG(level, fmt, ...) do { \
-if (level <= ziti_log_level(ZITI_LOG_MODULE, __FILENAME__)) { ziti_logger(level, ZITI_LOG_MODULE, __FILENAME__, __LINE__, __func__, fmt, ##__VA_ARGS__); }\
+static unsigned int ziti_log_site_; \
+if (level <= ziti_log_site_level(&ziti_log_site_, ZITI_LOG_MODULE, __FILENAME__)) { ziti_logger(level, ZITI_LOG_MODULE, __FILENAME__, __LINE__, __func__, fmt, ##__VA_ARGS__); }\
 } while(0)
 
 #ifdef __cplusplus
@@ -98,12 +100,61 @@ ZITI_FUNC extern void ziti_log_init(uv_loop_t *loop, int level, log_writer logge
 
 ZITI_FUNC extern void ziti_log_set_logger(log_writer logger);
 
+/**
+ * Deliver log messages from a background thread.
+ *
+ * Messages are formatted by the logging thread into a lock-free queue of [queue_len] records (default 1024 if 0)
+ * with the timestamp taken at log time, and written out by a dedicated thread -- in batches with `writev()`
+ * for the default output, or one by one with the writer set by ziti_log_set_logger().
+ * When the queue is full messages are dropped, and the number of dropped messages is logged.
+ * Messages longer than 1023 bytes are truncated.
+ *
+ * Can also be enabled with `ZITI_LOG_ASYNC=<queue_len>` environment variable.
+ * @return #ZITI_OK, or #ZITI_INVALID_STATE if async logging is already started
+ */
+ZITI_FUNC extern int ziti_log_async_start(size_t queue_len);
+
+// flush queued messages and return to synchronous logging.
+// waits for threads that are in the middle of queueing a message,
+// messages logged after that are written synchronously
+ZITI_FUNC extern void ziti_log_async_stop(void);
+
+// number of messages dropped by async logging
+ZITI_FUNC extern uint64_t ziti_log_async_dropped(void);
+
 // use ZITI_LOG_DEFAULT_LEVEL to reset to default(INFO) or ZITI_LOG env var
 ZITI_FUNC extern void ziti_log_set_level(int level, const char *marker);
 
 // don't use directly
 ZITI_FUNC extern int ziti_log_level(const char *module, const char *file);
 
+// don't use directly: incremented on every log level change
+ZITI_FUNC extern unsigned int ziti_log_generation;
+
+// don't use directly
+ZITI_FUNC extern int ziti_log_site_resolve(unsigned int *site, const char *module, const char *file);
+
+// call site cache is shared by all logging threads
+#if defined(__GNUC__) || defined(__clang__)
+#define ziti_log_load_(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define ziti_log_store_(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#else
+#define ziti_log_load_(p) (*(volatile unsigned int *) (p))
+#define ziti_log_store_(p, v) (*(volatile unsigned int *) (p) = (v))
+#endif
+
+/*
+ * call site cache holds (generation << 4 | level + 1),
+ * so checking a disabled message is a load and a compare until log levels change.
+ */
+static inline int ziti_log_site_level(unsigned int *site, const char *module, const char *file) {
+    unsigned int s = ziti_log_load_(site);
+    if ((s >> 4) == ziti_log_load_(&ziti_log_generation)) {
+        return (int) (s & 0xf) - 1;
+    }
+    return ziti_log_site_resolve(site, module, file);
+}
+
 ZITI_FUNC extern void ziti_log_set_level_by_label(const char *log_level);
 
 ZITI_FUNC extern const char *ziti_log_level_label();
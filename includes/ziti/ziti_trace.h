@@ -0,0 +1,105 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ZITI_SDK_ZITI_TRACE_H
+#define ZITI_SDK_ZITI_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "externs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Data path trace events: XX(name, phase)
+ * phase is a Chrome trace event phase: 'i' instant, 'B' begin, 'E' end
+ */
+#define ZITI_TRACE_EVENTS(XX) \
+    XX(CH_READ, 'i')             /* id: channel, a: bytes */ \
+    XX(CH_WRITE, 'i')            /* id: channel, a: content type, b: message length */ \
+    XX(MSG_DISPATCH, 'i')        /* id: channel, a: content type, b: sequence */ \
+    XX(FLUSH_CLIENT_BEGIN, 'B')  /* id: connection, a: bytes buffered */ \
+    XX(FLUSH_CLIENT_END, 'E')    /* id: connection, a: bytes buffered, b: more to flush */ \
+    XX(FLUSH_SERVICE_BEGIN, 'B') /* id: connection */ \
+    XX(FLUSH_SERVICE_END, 'E')   /* id: connection, b: more to flush */ \
+    XX(ENCRYPT_BEGIN, 'B')       /* id: connection (0 on crypto worker), a: bytes */ \
+    XX(ENCRYPT_END, 'E')         /* id: connection (0 on crypto worker) */ \
+    XX(DECRYPT_BEGIN, 'B')       /* id: connection (0 on crypto worker), a: bytes */ \
+    XX(DECRYPT_END, 'E')         /* id: connection (0 on crypto worker) */
+
+enum ziti_trace_event {
+    ZITI_TRACE_NONE,
+#define trace_ev(n, ph) ZITI_TRACE_##n,
+    ZITI_TRACE_EVENTS(trace_ev)
+#undef trace_ev
+    ZITI_TRACE_EVENT_COUNT,
+};
+
+typedef struct ziti_trace_record_s {
+    uint64_t ts; // nanoseconds, uv_hrtime()
+    uint16_t event;
+    uint16_t reserved;
+    uint32_t id;
+    uint32_t a;
+    uint32_t b;
+} ziti_trace_record;
+
+/*
+ * Trace dump file (host byte order):
+ * ziti_trace_header, then for every thread a ziti_trace_thread followed by [count] records, oldest first.
+ */
+#define ZITI_TRACE_MAGIC "ZTRACE01"
+
+typedef struct ziti_trace_header_s {
+    char magic[8];
+    uint32_t record_size;
+    uint32_t threads;
+} ziti_trace_header;
+
+typedef struct ziti_trace_thread_s {
+    uint32_t thread_id;
+    uint32_t count;
+} ziti_trace_thread;
+
+/**
+ * \brief Start recording data path trace events.
+ *
+ * Every thread records into its own ring buffer of [records_per_thread] (default 65536 if 0) records,
+ * keeping the most recent ones. Ring size is set when a thread records its first event.
+ * @return #ZITI_OK
+ */
+ZITI_FUNC
+extern int ziti_trace_start(size_t records_per_thread);
+
+ZITI_FUNC
+extern void ziti_trace_stop(void);
+
+/**
+ * \brief Write recorded events to a file.
+ *
+ * Records written while dumping may be inconsistent, stop tracing first for an exact snapshot.
+ * Use `ztrace-decode` program to convert the file to a timeline or Chrome trace JSON.
+ * @return #ZITI_OK, or error code
+ */
+ZITI_FUNC
+extern int ziti_trace_dump(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ZITI_SDK_ZITI_TRACE_H
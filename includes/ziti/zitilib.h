@@ -31,10 +31,31 @@ typedef struct ziti_ctx *ziti_context;
 typedef SOCKET ziti_socket_t;
 #else
 #include <netinet/in.h>
+#include <sys/uio.h>
 
 typedef int ziti_socket_t;
 #endif
 
+/** signed size type of [Ziti_read()]/[Ziti_write()] results */
+#if _WIN32
+#include <BaseTsd.h>
+typedef SSIZE_T ziti_ssize_t;
+#else
+#include <sys/types.h>
+typedef ssize_t ziti_ssize_t;
+#endif
+
+/**
+ * @brief socket type flag for [Ziti_socket()]: exchange data via [Ziti_read()]/[Ziti_write()]
+ *
+ * Data is passed between the application and Ziti connection through in-process buffers,
+ * saving the copies and syscalls of the socket bridge. The socket is still a valid handle for
+ * poll/epoll/select: it becomes readable when data (or EOF) is available for [Ziti_read()].
+ * After non-blocking [Ziti_write()] fails with EWOULDBLOCK, it becomes writable once there is room for more data.
+ * Only supported with SOCK_STREAM. Application must not use recv()/send() on such socket once it is connected.
+ */
+#define ZITI_SOCK_DIRECT 0x40000000
+
 /**
  * @brief Initialize Ziti library.
  *
@@ -84,6 +105,41 @@ ziti_context Ziti_load_context(const char *identity);
 ZITI_FUNC
 ziti_socket_t Ziti_socket(int type);
 
+/**
+ * @brief read data from Ziti socket
+ *
+ * For sockets created with [ZITI_SOCK_DIRECT] data is read directly from Ziti connection,
+ * other sockets are read with recv(2).
+ * If no data is available, behavior depends on whether [socket] is marked non-blocking:
+ * non-blocking socket fails with EWOULDBLOCK, otherwise call blocks until data is available.
+ * @param socket connected Ziti socket
+ * @param buf buffer
+ * @param len size of the buffer
+ * @return number of bytes read, 0 on EOF, -1 on error ([Ziti_last_error()] has the error code)
+ */
+ZITI_FUNC
+ziti_ssize_t Ziti_read(ziti_socket_t socket, void *buf, size_t len);
+
+/**
+ * @brief write data to Ziti socket
+ *
+ * See [Ziti_read()]. Blocking socket writes all data, non-blocking socket may write only part of it.
+ * @param socket connected Ziti socket
+ * @param buf data
+ * @param len data length
+ * @return number of bytes written, -1 on error ([Ziti_last_error()] has the error code)
+ */
+ZITI_FUNC
+ziti_ssize_t Ziti_write(ziti_socket_t socket, const void *buf, size_t len);
+
+#if !_WIN32
+/**
+ * @brief scatter read from Ziti socket, see [Ziti_read()]
+ */
+ZITI_FUNC
+ziti_ssize_t Ziti_readv(ziti_socket_t socket, const struct iovec *iov, int iovcnt);
+#endif
+
 /**
  * @brief close the given socket handle/file descriptor.
  * This method facilitates faster cleanup of Ziti socket. Calling standard close()/closesocket() methods still works but may lead to
@@ -159,6 +215,104 @@ int Ziti_listen(ziti_socket_t socket, int backlog);
 ZITI_FUNC
 ziti_socket_t Ziti_accept(ziti_socket_t socket, char *caller, int caller_len);
 
+struct addrinfo;
+
+/**
+ * @brief result of an asynchronous operation, see [Ziti_poll_completions()]
+ */
+typedef struct ziti_completion_s {
+    /** application context passed when operation was submitted */
+    void *ctx;
+    /** 0 on success, error code otherwise */
+    int status;
+    /** socket the operation was performed on */
+    ziti_socket_t fd;
+    /** result of [Ziti_resolve_async()], release with [Ziti_freeaddrinfo()] */
+    struct addrinfo *addrinfo;
+} ziti_completion;
+
+/**
+ * @brief get completion queue handle.
+ *
+ * The returned handle becomes readable when there are completed asynchronous operations, so an application can
+ * wait on it with poll/epoll/select along with its own sockets instead of parking a thread per blocking call.
+ * Application must not read from or close the handle.
+ * @return completion queue handle
+ */
+ZITI_FUNC
+ziti_socket_t Ziti_completion_fd(void);
+
+/**
+ * @brief retrieve completed asynchronous operations, never blocks.
+ * @param completions array to store completions
+ * @param max size of the [completions] array
+ * @return number of completions stored in the array
+ */
+ZITI_FUNC
+int Ziti_poll_completions(ziti_completion *completions, int max);
+
+/**
+ * @brief resolve Ziti intercept hostname without blocking.
+ *
+ * Result is delivered via [Ziti_poll_completions()]. Lookup of hostnames that are not known yet
+ * is held until services of all loaded contexts are available.
+ * @param host hostname
+ * @param port port (optional)
+ * @param hints same as getaddrinfo(3) (optional)
+ * @param ctx application context returned in [ziti_completion]
+ * @return 0 if operation was submitted, error code otherwise
+ */
+ZITI_FUNC
+int Ziti_resolve_async(const char *host, const char *port, const struct addrinfo *hints, void *ctx);
+
+ZITI_FUNC
+void Ziti_freeaddrinfo(struct addrinfo *addrlist);
+
+/**
+ * @brief Connect socket to a Ziti service without blocking
+ *
+ * Works like connect(2) on a non-blocking socket: the call returns immediately and [socket] becomes writable
+ * once Ziti connection is established. If connection fails [socket] is hung up (on Linux `SO_ERROR` is set as well).
+ * Result with the actual Ziti error code is also delivered via [Ziti_poll_completions()].
+ *
+ * Note: on Windows [socket] is only signalled on success, use [Ziti_poll_completions()] to detect failures.
+ * @param socket socket handle created with [Ziti_socket()]
+ * @param ztx Ziti context
+ * @param service service name provided by [ztx]
+ * @param terminator (optional) specific terminator to connect to
+ * @param ctx application context returned in [ziti_completion]
+ * @return 0 if connect was initiated, error code otherwise
+ */
+ZITI_FUNC
+int Ziti_connect_async(ziti_socket_t socket, ziti_context ztx, const char *service, const char *terminator, void *ctx);
+
+/**
+ * @brief Connect socket to a Ziti service with the given intercept address without blocking
+ *
+ * See [Ziti_connect_async()].
+ * @param socket socket handle created with [Ziti_socket()]
+ * @param host target hostname
+ * @param port target port
+ * @param ctx application context returned in [ziti_completion]
+ * @return 0 if connect was initiated, error code otherwise
+ */
+ZITI_FUNC
+int Ziti_connect_addr_async(ziti_socket_t socket, const char *host, unsigned int port, void *ctx);
+
+/**
+ * @brief accept a client Ziti connection without waiting for it to be established
+ *
+ * Never blocks waiting for incoming connections: if none are pending, fails with EWOULDBLOCK.
+ * Returned socket becomes writable once accepted Ziti connection is established, same as [Ziti_connect_async()].
+ * @param socket server socket, see [Ziti_accept()]
+ * @param caller buffer to store caller ID (dialing identity name)
+ * @param caller_len length of the [caller] buffer
+ * @param ctx application context returned in [ziti_completion]
+ * @return socket for the accepted connection. on error -1 is returned, use [Ziti_last_error()] to get actual error code.
+ */
+ZITI_FUNC
+ziti_socket_t Ziti_accept_async(ziti_socket_t socket, char *caller, int caller_len, void *ctx);
+
 /**
  * @brief Shutdown Ziti library.
  *
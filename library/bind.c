@@ -305,14 +305,14 @@ static void get_service_cb(ziti_context ztx, const ziti_service *service, int st
     }
 
     if (!conn->server.srv_routers_api_missing) {
-        ziti_ctrl_list_service_routers(ztx_get_controller(ztx), service, list_routers_cb, conn);
+        ztx_list_service_routers(ztx, service, list_routers_cb, conn);
     }
 
     conn->encrypted = service->encryption;
     if (conn->server.token == NULL) {
-        ziti_ctrl_create_session(ztx_get_controller(ztx), service->id, ziti_session_types.Bind, session_cb, conn);
+        ztx_create_session(ztx, service->id, ziti_session_types.Bind, session_cb, conn);
     } else if (conn->server.srv_routers_api_missing) {
-        ziti_ctrl_get_session(ztx_get_controller(ztx), conn->server.session->id, session_cb, conn);
+        ztx_get_session(ztx, conn->server.session->id, session_cb, conn);
     }
 }
 
@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include "utils.h"
@@ -134,6 +136,7 @@ void string_buf_init(string_buf_t *wb) {
     wb->fixed = false;
     wb->chunk_size = WRITE_BUF_CHUNK_SIZE;
     wb->chunk = malloc(wb->chunk_size);
+    wb->chunk_end = wb->chunk + wb->chunk_size;
     wb->buf = new_buffer();
     wb->wp = wb->chunk;
 }
@@ -141,23 +144,35 @@ void string_buf_init(string_buf_t *wb) {
 void string_buf_init_fixed(string_buf_t *wb, char *outbuf, size_t max) {
     wb->fixed = true;
     wb->chunk = (uint8_t *) outbuf;
+    wb->chunk_end = wb->chunk + max;
     wb->wp = wb->chunk;
     wb->chunk_size = max;
     wb->buf = NULL;
 }
 
+// move current chunk to the buffer and start a new one of at least [size] bytes
+static void string_buf_next_chunk(string_buf_t *wb, size_t size) {
+    if (wb->wp != wb->chunk) {
+        buffer_append(wb->buf, wb->chunk, wb->wp - wb->chunk);
+    } else {
+        free(wb->chunk);
+    }
+    size = MAX(size, wb->chunk_size);
+    wb->chunk = malloc(size);
+    wb->chunk_end = wb->chunk + size;
+    wb->wp = wb->chunk;
+}
+
 size_t string_buf_size(string_buf_t *wb) {
     return buffer_available(wb->buf) + (wb->wp - wb->chunk);
 }
 
 int string_buf_append_byte(string_buf_t *wb, char c) {
-    if (wb->wp - wb->chunk >= wb->chunk_size) {
+    if (wb->wp >= wb->chunk_end) {
 
         if (wb->fixed) { return -1; }
 
-        buffer_append(wb->buf, wb->chunk, wb->wp - wb->chunk);
-        wb->chunk = malloc(wb->chunk_size);
-        wb->wp = wb->chunk;
+        string_buf_next_chunk(wb, 0);
     }
     *wb->wp++ = c;
     return 0;
@@ -169,7 +184,7 @@ int string_buf_appendn(string_buf_t *wb, const char *str, size_t len) {
     size_t chunk_len;
     size_t copy_len;
     copy:
-    chunk_len = wb->chunk + wb->chunk_size - wb->wp;
+    chunk_len = wb->chunk_end - wb->wp;
     copy_len = MIN(chunk_len, len);
     memcpy(wb->wp, s, copy_len);
     len -= copy_len;
@@ -179,15 +194,30 @@ int string_buf_appendn(string_buf_t *wb, const char *str, size_t len) {
     if (len > 0) {
         if (wb->fixed) { return -1; }
 
-        buffer_append(wb->buf, wb->chunk, wb->wp - wb->chunk);
-        wb->chunk = malloc(wb->chunk_size);
-        wb->wp = wb->chunk;
+        string_buf_next_chunk(wb, 0);
         goto copy;
     }
 
     return 0;
 }
 
+char *string_buf_reserve(string_buf_t *wb, size_t len) {
+    if (wb->chunk_end - wb->wp >= (ptrdiff_t) len) {
+        return (char *) wb->wp;
+    }
+
+    if (wb->fixed) { return NULL; }
+
+    // span larger than chunk size gets a chunk of its own size, following chunks are of regular size
+    string_buf_next_chunk(wb, len);
+    return (char *) wb->wp;
+}
+
+void string_buf_commit(string_buf_t *wb, size_t len) {
+    assert(wb->wp + len <= wb->chunk_end);
+    wb->wp += len;
+}
+
 int string_buf_append_urlsafe(string_buf_t *wb, const char *str) {
     static const char unsafe[] = " /:\"<>%{}|\\^`";
 
@@ -215,14 +245,12 @@ int string_buf_append(string_buf_t *wb, const char *str) {
     const char *s = str;
 
     copy:
-    while (*s != '\0' && wb->wp < wb->chunk + wb->chunk_size) { *wb->wp++ = *s++; }
+    while (*s != '\0' && wb->wp < wb->chunk_end) { *wb->wp++ = *s++; }
 
     if (*s != 0) {
         if (wb->fixed) { return -1; }
 
-        buffer_append(wb->buf, wb->chunk, wb->wp - wb->chunk);
-        wb->chunk = malloc(wb->chunk_size);
-        wb->wp = wb->chunk;
+        string_buf_next_chunk(wb, 0);
         goto copy;
     }
 
@@ -256,6 +284,7 @@ void string_buf_free(string_buf_t *wb) {
     wb->wp = NULL;
     if (!wb->fixed) FREE(wb->chunk);
     wb->chunk = NULL;
+    wb->chunk_end = NULL;
     free_buffer(wb->buf);
     wb->buf = NULL;
 }
@@ -281,7 +310,7 @@ int string_buf_fmt(string_buf_t *wb, FORMAT_STRING(const char *fmt), ...) {
     va_list argp;
     va_start(argp, fmt);
 
-    size_t avail_in_chunk = wb->chunk + wb->chunk_size - wb->wp;
+    size_t avail_in_chunk = wb->chunk_end - wb->wp;
     int len = vsnprintf((char *) wb->wp, avail_in_chunk, fmt, argp);
     va_end(argp);
 
@@ -296,15 +325,13 @@ int string_buf_fmt(string_buf_t *wb, FORMAT_STRING(const char *fmt), ...) {
 
     // current chunk is not empty push into buffer
     if (wb->chunk != wb->wp) {
-        buffer_append(wb->buf, wb->chunk, wb->wp - wb->chunk);
-        wb->chunk = malloc(wb->chunk_size);
-        wb->wp = wb->chunk;
+        string_buf_next_chunk(wb, 0);
     }
 
     va_start(argp, fmt);
 
-    if (len < wb->chunk_size) {
-        len = vsnprintf((char*)wb->wp, wb->chunk_size, fmt, argp);
+    if (len < wb->chunk_end - wb->chunk) {
+        len = vsnprintf((char*)wb->wp, wb->chunk_end - wb->chunk, fmt, argp);
         wb->wp += len;
     } else {
         // formatted string won't fit into chunk_size -- add directly to the buffer
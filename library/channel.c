@@ -20,6 +20,7 @@
 #include "zt_internal.h"
 #include "utils.h"
 #include "endian_internal.h"
+#include "ztrace.h"
 
 #if _WIN32
 #include "win32_compat.h"
@@ -130,6 +131,16 @@ static void ch_init_stream(ziti_channel_t *ch) {
     ch->reconnect = false;
 }
 
+// message buffer was returned to exhausted pool:
+// buffered inbound data can be processed and reading resumed on the next loop iteration
+static void ch_pool_available(void *ctx) {
+    ziti_channel_t *ch = ctx;
+    if (!ch->dirty) {
+        ch->dirty = true;
+        LIST_INSERT_HEAD(&ch->ztx->dirty_channels, ch, _dirty);
+    }
+}
+
 int ziti_channel_prepare(ziti_channel_t *ch) {
     process_inbound(ch);
 
@@ -166,6 +177,7 @@ static int ziti_channel_init(struct ziti_ctx *ctx, ziti_channel_t *ch, uint32_t
     ch->in_body_offset = 0;
     ch->incoming = new_buffer();
     ch->in_msg_pool = pool_new(POOLED_MESSAGE_SIZE, INBOUND_POOL_SIZE, (void (*)(void *)) message_free);
+    pool_set_available_cb(ch->in_msg_pool, ch_pool_available, ch);
 
     ch->waiters = (model_map){0};
 
@@ -180,6 +192,10 @@ void ziti_channel_free(ziti_channel_t *ch) {
         ch->connection = NULL;
     }
     clear_deadline(&ch->deadline);
+    if (ch->dirty) {
+        LIST_REMOVE(ch, _dirty);
+        ch->dirty = false;
+    }
     free_buffer(ch->incoming);
     pool_destroy(ch->in_msg_pool);
     ch->in_msg_pool = NULL;
@@ -413,6 +429,7 @@ int ziti_channel_send_message(ziti_channel_t *ch, message *msg, struct ziti_writ
     message_set_seq(msg, &ch->msg_seq);
     CH_LOG(TRACE, "=> ct[%s] seq[%d] len[%d]", content_type_id(msg->header.content),
            msg->header.seq, msg->header.body_len);
+    ZTRACE(CH_WRITE, ch->id, msg->header.content, msg->msgbuflen);
 
     NEWP(req, uv_write_t);
     if (ziti_write == NULL) {
@@ -512,6 +529,7 @@ static void dispatch_message(ziti_channel_t *ch, message *m) {
     bool is_reply = message_get_int32_header(m, ReplyForHeader, (int32_t*)&reply_to);
 
     uint32_t ct = m->header.content;
+    ZTRACE(MSG_DISPATCH, ch->id, ct, m->header.seq);
     if (is_reply) {
         w = model_map_removel(&ch->waiters, (long)reply_to);
 
@@ -918,6 +936,7 @@ static void on_channel_data(uv_stream_t *s, ssize_t len, const uv_buf_t *buf) {
     }
 
     CH_LOG(TRACE, "on_data [len=%zd]", len);
+    ZTRACE(CH_READ, ch->id, len, 0);
     ch->last_read = uv_now(ch->loop);
     buffer_append(ch->incoming, buf->base, (uint32_t) len);
     process_inbound(ch);
@@ -20,6 +20,7 @@
 #include "endian_internal.h"
 #include "win32_compat.h"
 #include "connect.h"
+#include "ztrace.h"
 
 static const char *INVALID_SESSION = "Invalid Session";
 static const int MAX_CONNECT_RETRY = 3;
@@ -27,6 +28,10 @@ static const int MAX_CONNECT_RETRY = 3;
 #define CONN_CAP_MASK (EDGE_MULTIPART | EDGE_TRACE_UUID | EDGE_STREAM)
 #define BOOL_STR(v) ((v) ? "Y" : "N")
 
+// smaller payloads are not worth a trip to crypto pool
+#define CRYPTO_OFFLOAD_MIN (4 * 1024)
+#define CRYPTO_BATCH_MAX 16
+
 #define CONN_LOG(lvl, fmt, ...) ZITI_LOG(lvl, "conn[%u.%u/%.*s/%s](%s) " fmt, \
 conn->ziti_ctx->id, conn->conn_id, (int)sizeof(conn->marker),                 \
 conn->marker, conn_state_str[conn->state], conn->service,                     \
@@ -181,6 +186,11 @@ static int close_conn_internal(struct ziti_conn *conn) {
             return 0;
         }
 
+        if (conn->crypto_in || conn->crypto_out) {
+            CONN_LOG(DEBUG, "waiting for crypto pool");
+            return 0;
+        }
+
         CONN_LOG(DEBUG, "removing");
         if (conn->close_cb) {
             conn->close_cb(conn);
@@ -239,7 +249,8 @@ void on_write_completed(struct ziti_conn *conn, struct ziti_write_req_s *req, in
     }
     CONN_LOG(TRACE, "status %d", status);
 
-    if (status < 0) {
+    // closed connection stays closed to be released by the reaper
+    if (status < 0 && conn->state != Closed) {
         conn_set_state(conn, Disconnected);
         CONN_LOG(DEBUG, "is now Disconnected due to write failure: %d", status);
     }
@@ -530,14 +541,14 @@ void process_connect(struct ziti_conn *conn, ziti_session *session) {
     if (session == NULL) {
         CONN_LOG(DEBUG, "requesting 'Dial' session for service[%s]", conn->service);
         // this will re-enter with session if create succeeds
-        ziti_ctrl_create_session(ztx_get_controller(ztx), req->service_id, ziti_session_types.Dial,
-                                 connect_get_net_session_cb, conn);
+        ztx_create_session(ztx, req->service_id, ziti_session_types.Dial,
+                           connect_get_net_session_cb, conn);
         return;
     }
 
     if (model_list_size(&session->edge_routers) == 0) {
         if (session->refresh) {
-            ziti_ctrl_get_session(ztx_get_controller(ztx), session->id, connect_get_net_session_cb, conn);
+            ztx_get_session(ztx, session->id, connect_get_net_session_cb, conn);
             return;
         } else {
             CONN_LOG(ERROR, "no edge routers available for service[%s] session[%s]", conn->service, session->id);
@@ -559,7 +570,7 @@ void process_connect(struct ziti_conn *conn, ziti_session *session) {
 
     if (session->refresh) {
         CONN_LOG(DEBUG, "refreshing session[%s]", session->id);
-        ziti_ctrl_get_session(ztx_get_controller(ztx), session->id, refresh_session_cb, ztx);
+        ztx_get_session(ztx, session->id, refresh_session_cb, ztx);
         session->refresh = false;
     }
 }
@@ -628,6 +639,62 @@ int ziti_dial_with_options(ziti_connection conn, const char *service, ziti_dial_
     return do_ziti_dial(conn, service, dial_opts, conn_cb, data_cb);
 }
 
+// builds data message for [req]
+// if [encrypt] is false payload of encrypted connection is placed at the ciphertext offset for in-place encryption
+static message *create_data_message(struct ziti_conn *conn, struct ziti_write_req_s *req, bool encrypt) {
+    bool multipart = model_list_size(&req->chain) > 0;
+    bool stream = conn->flags & EDGE_STREAM;
+
+    uint32_t flags = multipart && !stream ? EDGE_MULTIPART_MSG : 0;
+    size_t total_len = conn->encrypted ? crypto_secretstream_xchacha20poly1305_abytes() : 0;
+    total_len += (multipart ? req->chain_len : req->len);
+    message *m = create_message(conn, ContentTypeData, flags, total_len);
+
+    if (multipart) {
+        uint8_t *p = m->body + conn->encrypted;
+        string_buf_t buf;
+        string_buf_init_fixed(&buf, (char*)p, total_len);
+        struct ziti_write_req_s *r = req;
+        model_list_iter it = model_list_iterator(&req->chain);
+        int count = 0;
+        size_t tot = 0;
+        do {
+            if (!stream) {
+                uint16_t part_len = (uint16_t) r->len;
+                part_len = htole16(part_len);
+                string_buf_appendn(&buf, (char *) &part_len, sizeof(part_len));
+            }
+            string_buf_appendn(&buf, (char*)r->buf, r->len);
+            count++;
+            tot += r->len;
+
+            r = model_list_it_element(it);
+            it = model_list_it_next(it);
+        } while(r != NULL);
+        CONN_LOG(DEBUG, "consolidated %d payloads total_len[%zd]", count, tot);
+        conn->sent += tot;
+
+        if (conn->encrypted && encrypt) {
+            ZTRACE(ENCRYPT_BEGIN, conn->conn_id, req->chain_len, 0);
+            crypto_secretstream_xchacha20poly1305_push(&conn->crypt_o, m->body, NULL,
+                                                       p, req->chain_len, NULL, 0, 0);
+            ZTRACE(ENCRYPT_END, conn->conn_id, 0, 0);
+        }
+        string_buf_free(&buf);
+    } else {
+        if (conn->encrypted && encrypt) {
+            ZTRACE(ENCRYPT_BEGIN, conn->conn_id, req->len, 0);
+            crypto_secretstream_xchacha20poly1305_push(&conn->crypt_o, m->body, NULL,
+                                                       req->buf, req->len, NULL, 0, 0);
+            ZTRACE(ENCRYPT_END, conn->conn_id, 0, 0);
+        } else {
+            memcpy(m->body + conn->encrypted, req->buf, req->len);
+        }
+        conn->sent += req->len;
+    }
+    return m;
+}
+
 static void ziti_write_req(struct ziti_write_req_s *req) {
     struct ziti_conn *conn = req->conn;
 
@@ -641,52 +708,7 @@ static void ziti_write_req(struct ziti_write_req_s *req) {
     } else {
         message *m = req->message;
         if (m == NULL) {
-            bool multipart = model_list_size(&req->chain) > 0;
-            bool stream = conn->flags & EDGE_STREAM;
-
-            uint32_t flags = multipart && !stream ? EDGE_MULTIPART_MSG : 0;
-            size_t total_len = conn->encrypted ? crypto_secretstream_xchacha20poly1305_abytes() : 0;
-            total_len += (multipart ? req->chain_len : req->len);
-            m = create_message(conn, ContentTypeData, flags, total_len);
-
-            if (multipart) {
-                uint8_t *p = m->body + conn->encrypted;
-                string_buf_t buf;
-                string_buf_init_fixed(&buf, (char*)p, total_len);
-                struct ziti_write_req_s *r = req;
-                model_list_iter it = model_list_iterator(&req->chain);
-                int count = 0;
-                size_t tot = 0;
-                do {
-                    if (!stream) {
-                        uint16_t part_len = (uint16_t) r->len;
-                        part_len = htole16(part_len);
-                        string_buf_appendn(&buf, (char *) &part_len, sizeof(part_len));
-                    }
-                    string_buf_appendn(&buf, (char*)r->buf, r->len);
-                    count++;
-                    tot += r->len;
-
-                    r = model_list_it_element(it);
-                    it = model_list_it_next(it);
-                } while(r != NULL);
-                CONN_LOG(DEBUG, "consolidated %d payloads total_len[%zd]", count, tot);
-                conn->sent += tot;
-
-                if (conn->encrypted) {
-                    crypto_secretstream_xchacha20poly1305_push(&conn->crypt_o, m->body, NULL,
-                                                               p, req->chain_len, NULL, 0, 0);
-                }
-                string_buf_free(&buf);
-            } else {
-                if (conn->encrypted) {
-                    crypto_secretstream_xchacha20poly1305_push(&conn->crypt_o, m->body, NULL,
-                                                               req->buf, req->len, NULL, 0, 0);
-                } else {
-                    memcpy(m->body, req->buf, req->len);
-                }
-                conn->sent += req->len;
-            }
+            m = create_data_message(conn, req, true);
         }
         send_message(conn, m, req);
     }
@@ -800,8 +822,13 @@ static void on_flush(uv_idle_t *fl) {
         return;
     }
 
+    ZTRACE(FLUSH_CLIENT_BEGIN, conn->conn_id, buffer_available(conn->inbound), 0);
     bool more_to_client = flush_to_client(conn);
+    ZTRACE(FLUSH_CLIENT_END, conn->conn_id, buffer_available(conn->inbound), more_to_client);
+
+    ZTRACE(FLUSH_SERVICE_BEGIN, conn->conn_id, 0, 0);
     bool more_to_service = flush_to_service(conn);
+    ZTRACE(FLUSH_SERVICE_END, conn->conn_id, 0, more_to_service);
 
     if (!more_to_client && !more_to_service) {
         CONN_LOG(TRACE, "stopping flusher");
@@ -847,15 +874,47 @@ void chain_data_requests(ziti_connection conn, struct ziti_write_req_s *req) {
     }
 }
 
+static bool can_offload_write(struct ziti_conn *conn, struct ziti_write_req_s *req) {
+    return conn->ziti_ctx->crypto_pool && conn->encrypted && conn->state == Connected &&
+           req->conn && req->message == NULL && !req->close && !req->eof;
+}
+
+static void on_crypto_out(crypto_batch_t *b) {
+    struct ziti_conn *conn = b->ctx;
+    conn->crypto_out = NULL;
+
+    for (size_t i = 0; i < b->count; i++) {
+        crypto_op_t *op = &b->ops[i];
+        struct ziti_write_req_s *req = op->ctx;
+        if (conn->channel && op->rc == 0) {
+            ziti_write_req(req);
+        } else {
+            pool_return_obj(req->message);
+            req->message = NULL;
+            on_write_completed(conn, req, ZITI_INVALID_STATE);
+        }
+    }
+    free(b);
+    flush_connection(conn);
+}
+
 static bool flush_to_service(ziti_connection conn) {
 
     // still connecting
     if (conn->channel == NULL) { return false; }
     if (conn->state < Connected || conn->state == Accepting) { return false; }
 
+    // encryption of earlier messages is in progress
+    if (conn->crypto_out) { return false; }
+
+    crypto_batch_t *batch = NULL;
     int count = 0;
     while (!TAILQ_EMPTY(&conn->wreqs)) {
         struct ziti_write_req_s *req = TAILQ_FIRST(&conn->wreqs);
+        // messages after the batch have to wait for it
+        if (batch && !can_offload_write(conn, req)) {
+            break;
+        }
         TAILQ_REMOVE(&conn->wreqs, req, _next);
 
         if (conn->state == Connected || req->close) {
@@ -867,6 +926,29 @@ static bool flush_to_service(ziti_connection conn) {
             if (req->conn) {
                 TAILQ_INSERT_TAIL(&conn->pending_wreqs, req, _next);
             }
+
+            size_t len = model_list_size(&req->chain) > 0 ? req->chain_len : req->len;
+            if (can_offload_write(conn, req) && (batch || len >= CRYPTO_OFFLOAD_MIN)) {
+                if (batch == NULL) {
+                    batch = crypto_batch_new(CRYPTO_BATCH_MAX, on_crypto_out, conn);
+                    batch->id = conn->conn_id;
+                }
+                message *m = create_data_message(conn, req, false);
+                req->message = m;
+
+                crypto_op_t *op = crypto_batch_add(batch);
+                op->state = &conn->crypt_o;
+                op->in = m->body + 1;
+                op->in_len = len;
+                op->out = m->body;
+                op->ctx = req;
+                count++;
+                if (batch->count == batch->cap) {
+                    break;
+                }
+                continue;
+            }
+
             ziti_write_req(req);
             count++;
         } else {
@@ -882,12 +964,75 @@ static bool flush_to_service(ziti_connection conn) {
     }
     CONN_LOG(TRACE, "flushed %d messages", count);
 
+    if (batch) {
+        CONN_LOG(TRACE, "encrypting %zd messages on crypto pool", batch->count);
+        conn->crypto_out = batch;
+        crypto_pool_submit(conn->ziti_ctx->crypto_pool, batch);
+        return false;
+    }
+
     return !TAILQ_EMPTY(&conn->wreqs);
 }
 
+static bool can_offload_read(struct ziti_conn *conn, message *m) {
+    return conn->ziti_ctx->crypto_pool && conn->encrypted && conn->key_ex.rx == NULL &&
+           (conn->state == Connected || conn->state == CloseWrite) && !conn->fin_recv &&
+           m->header.content == ContentTypeData &&
+           m->header.body_len > crypto_secretstream_xchacha20poly1305_ABYTES;
+}
+
+static void on_crypto_in(crypto_batch_t *b) {
+    struct ziti_conn *conn = b->ctx;
+    conn->crypto_in = NULL;
+
+    for (size_t i = 0; i < b->count; i++) {
+        crypto_op_t *op = &b->ops[i];
+        message *m = op->ctx;
+
+        conn->decrypted = op;
+        process_edge_message(conn, m);
+        conn->decrypted = NULL;
+
+        FREE(op->out);
+        pool_return_obj(m);
+    }
+    free(b);
+    flush_connection(conn);
+}
+
+// move consecutive data messages from the head of in_q to crypto pool
+static void offload_read(struct ziti_conn *conn) {
+    crypto_batch_t *b = crypto_batch_new(CRYPTO_BATCH_MAX, on_crypto_in, conn);
+    b->id = conn->conn_id;
+    while (b->count < b->cap && !TAILQ_EMPTY(&conn->in_q)) {
+        message *m = TAILQ_FIRST(&conn->in_q);
+        if (!can_offload_read(conn, m)) {
+            break;
+        }
+        TAILQ_REMOVE(&conn->in_q, m, _next);
+
+        crypto_op_t *op = crypto_batch_add(b);
+        op->decrypt = true;
+        op->state = &conn->crypt_i;
+        op->in = m->body;
+        op->in_len = m->header.body_len;
+        op->out = malloc(m->header.body_len - crypto_secretstream_xchacha20poly1305_ABYTES);
+        op->ctx = m;
+    }
+
+    CONN_LOG(TRACE, "decrypting %zd messages on crypto pool", b->count);
+    conn->crypto_in = b;
+    crypto_pool_submit(conn->ziti_ctx->crypto_pool, b);
+}
+
 static bool flush_to_client(ziti_connection conn) {
-    while (!TAILQ_EMPTY(&conn->in_q)) {
+    // messages behind the batch being decrypted have to wait for it
+    while (conn->crypto_in == NULL && !TAILQ_EMPTY(&conn->in_q)) {
         message *m = TAILQ_FIRST(&conn->in_q);
+        if (m->header.body_len >= CRYPTO_OFFLOAD_MIN && can_offload_read(conn, m)) {
+            offload_read(conn);
+            break;
+        }
         TAILQ_REMOVE(&conn->in_q, m, _next);
         process_edge_message(conn, m);
         pool_return_obj(m);
@@ -959,12 +1104,25 @@ void conn_inbound_data_msg(ziti_connection conn, message *msg) {
         } else {
             unsigned char tag;
             if (msg->header.body_len > 0) {
-                plain_text = malloc(msg->header.body_len - crypto_secretstream_xchacha20poly1305_ABYTES);
-                assert(plain_text != NULL);
-                CONN_LOG(VERBOSE, "decrypting %d bytes", msg->header.body_len);
-                int crypto_rc = crypto_secretstream_xchacha20poly1305_pull(&conn->crypt_i,
+                int crypto_rc;
+                if (conn->decrypted) {
+                    // already decrypted by crypto pool
+                    crypto_op_t *op = conn->decrypted;
+                    plain_text = op->out;
+                    plain_len = op->out_len;
+                    tag = op->tag;
+                    crypto_rc = op->rc;
+                    op->out = NULL;
+                } else {
+                    plain_text = malloc(msg->header.body_len - crypto_secretstream_xchacha20poly1305_ABYTES);
+                    assert(plain_text != NULL);
+                    CONN_LOG(VERBOSE, "decrypting %d bytes", msg->header.body_len);
+                    ZTRACE(DECRYPT_BEGIN, conn->conn_id, msg->header.body_len, 0);
+                    crypto_rc = crypto_secretstream_xchacha20poly1305_pull(&conn->crypt_i,
                                                                            plain_text, &plain_len, &tag,
                                                                            msg->body, msg->header.body_len, NULL, 0);
+                    ZTRACE(DECRYPT_END, conn->conn_id, 0, 0);
+                }
                 if (crypto_rc != 0 && (conn->flags & EDGE_TRACE_UUID)) {
                     // try to figure out the cause of crypto error
                     struct msg_uuid *uuid;
@@ -1310,6 +1468,61 @@ int ziti_write(ziti_connection conn, uint8_t *data, size_t length, ziti_write_cb
     return 0;
 }
 
+static int queue_mt_request(ziti_connection conn, struct conn_mt_req_s *req) {
+    ziti_context ztx = conn->ziti_ctx;
+    // only the first request after the queue was drained wakes up the loop
+    if (mpsc_queue_push(&ztx->mt_queue, &req->_next)) {
+        uv_async_send(&ztx->w_async);
+    }
+    return ZITI_OK;
+}
+
+int ziti_write_mt(ziti_connection conn, uint8_t *data, size_t length, ziti_write_cb write_cb, void *write_ctx) {
+    if (conn == NULL) return ZITI_INVALID_STATE;
+
+    struct conn_mt_req_s *req = lf_pool_alloc(conn->ziti_ctx->mt_pool);
+    req->conn = conn;
+    req->buf = data;
+    req->len = length;
+    req->write_cb = write_cb;
+    req->ctx = write_ctx;
+    return queue_mt_request(conn, req);
+}
+
+int ziti_close_mt(ziti_connection conn, ziti_close_cb close_cb) {
+    if (conn == NULL) return ZITI_INVALID_STATE;
+
+    struct conn_mt_req_s *req = lf_pool_alloc(conn->ziti_ctx->mt_pool);
+    req->conn = conn;
+    req->close = true;
+    req->close_cb = close_cb;
+    return queue_mt_request(conn, req);
+}
+
+void ztx_process_mt_requests(ziti_context ztx) {
+    mpsc_node_t *n;
+    while ((n = mpsc_queue_pop(&ztx->mt_queue)) != NULL) {
+        struct conn_mt_req_s req = *container_of(n, struct conn_mt_req_s, _next);
+        lf_pool_return(ztx->mt_pool, container_of(n, struct conn_mt_req_s, _next));
+
+        ziti_connection conn = req.conn;
+        if (req.close) {
+            // connection was already closed, its original close callback is still pending
+            int rc = ziti_close(conn, req.close_cb);
+            if (rc == ZITI_CONN_CLOSED && req.close_cb) {
+                req.close_cb(conn);
+            }
+            continue;
+        }
+
+        // writes are flushed on the next loop iteration, so the whole batch is chained together
+        int rc = ziti_write(conn, req.buf, req.len, req.write_cb, req.ctx);
+        if (rc != ZITI_OK && req.write_cb) {
+            req.write_cb(conn, rc, req.ctx);
+        }
+    }
+}
+
 static int send_fin_message(ziti_connection conn, struct ziti_write_req_s *wr) {
     CONN_LOG(DEBUG, "sending FIN");
     message *m = create_message(conn, ContentTypeData, EDGE_FIN, 0);
@@ -1323,6 +1536,7 @@ int ziti_close(ziti_connection conn, ziti_close_cb close_cb) {
 
     conn->close = true;
     conn->close_cb = close_cb;
+    LIST_INSERT_HEAD(&conn->ziti_ctx->reap_list, conn, _reap);
 
     if (conn->type == Server) {
         return ziti_close_server(conn);
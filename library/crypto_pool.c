@@ -0,0 +1,186 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "crypto_pool.h"
+#include "utils.h"
+#include "ztrace.h"
+
+#include <stdlib.h>
+
+struct crypto_pool_s {
+    uv_thread_t *threads;
+    unsigned int count;
+
+    // pending batches, shared by workers
+    uv_mutex_t lock;
+    uv_cond_t cond;
+    crypto_batch_t *head;
+    crypto_batch_t *tail;
+    bool stop;
+
+    // completed batches, drained on the loop thread
+    mpsc_queue_t done;
+    uv_async_t done_async;
+};
+
+void crypto_op_run(crypto_op_t *op, uint32_t id) {
+    if (op->decrypt) {
+        ZTRACE(DECRYPT_BEGIN, id, op->in_len, 0);
+        op->rc = crypto_secretstream_xchacha20poly1305_pull(op->state, op->out, &op->out_len, &op->tag,
+                                                            op->in, op->in_len, NULL, 0);
+        ZTRACE(DECRYPT_END, id, 0, 0);
+    } else {
+        ZTRACE(ENCRYPT_BEGIN, id, op->in_len, 0);
+        op->rc = crypto_secretstream_xchacha20poly1305_push(op->state, op->out, &op->out_len,
+                                                            op->in, op->in_len, NULL, 0, 0);
+        ZTRACE(ENCRYPT_END, id, 0, 0);
+    }
+}
+
+static void crypto_worker(void *arg) {
+    crypto_pool_t *p = arg;
+
+    uv_mutex_lock(&p->lock);
+    for (;;) {
+        while (p->head == NULL && !p->stop) {
+            uv_cond_wait(&p->cond, &p->lock);
+        }
+        if (p->head == NULL) {
+            break;
+        }
+
+        crypto_batch_t *b = p->head;
+        p->head = b->_next;
+        if (p->head == NULL) {
+            p->tail = NULL;
+        }
+        uv_mutex_unlock(&p->lock);
+
+        for (size_t i = 0; i < b->count; i++) {
+            crypto_op_run(&b->ops[i], b->id);
+        }
+
+        // only the first completion after the loop drained the queue needs a wakeup
+        if (mpsc_queue_push(&p->done, &b->_done)) {
+            uv_async_send(&p->done_async);
+        }
+
+        uv_mutex_lock(&p->lock);
+    }
+    uv_mutex_unlock(&p->lock);
+}
+
+static void on_crypto_done(uv_async_t *a) {
+    crypto_pool_t *p = a->data;
+
+    mpsc_queue_rearm(&p->done);
+
+    mpsc_node_t *n;
+    while ((n = mpsc_queue_pop(&p->done)) != NULL) {
+        crypto_batch_t *b = container_of(n, crypto_batch_t, _done);
+        b->cb(b);
+    }
+}
+
+static void free_pool(uv_handle_t *h);
+
+crypto_pool_t *crypto_pool_new(uv_loop_t *loop, unsigned int threads) {
+    if (threads == 0) {
+        return NULL;
+    }
+
+    NEWP(p, crypto_pool_t);
+    uv_mutex_init(&p->lock);
+    uv_cond_init(&p->cond);
+    mpsc_queue_init(&p->done);
+    uv_async_init(loop, &p->done_async, on_crypto_done);
+    p->done_async.data = p;
+    uv_unref((uv_handle_t *) &p->done_async);
+
+    p->threads = calloc(threads, sizeof(uv_thread_t));
+    for (unsigned int i = 0; i < threads; i++) {
+        if (uv_thread_create(&p->threads[i], crypto_worker, p) != 0) {
+            ZITI_LOG(WARN, "failed to start crypto worker[%u]", i);
+            break;
+        }
+        p->count++;
+    }
+
+    if (p->count == 0) {
+        ZITI_LOG(WARN, "no crypto workers started, crypto runs on the loop thread");
+        FREE(p->threads);
+        uv_close((uv_handle_t *) &p->done_async, free_pool);
+        return NULL;
+    }
+    ZITI_LOG(INFO, "started %u crypto workers", p->count);
+    return p;
+}
+
+static void free_pool(uv_handle_t *h) {
+    crypto_pool_t *p = h->data;
+    uv_cond_destroy(&p->cond);
+    uv_mutex_destroy(&p->lock);
+    free(p);
+}
+
+void crypto_pool_free(crypto_pool_t *p) {
+    if (p == NULL) {
+        return;
+    }
+
+    // workers finish queued batches before exiting
+    uv_mutex_lock(&p->lock);
+    p->stop = true;
+    uv_cond_broadcast(&p->cond);
+    uv_mutex_unlock(&p->lock);
+
+    for (unsigned int i = 0; i < p->count; i++) {
+        uv_thread_join(&p->threads[i]);
+    }
+    FREE(p->threads);
+
+    // all work is done now, hand it back
+    on_crypto_done(&p->done_async);
+
+    uv_close((uv_handle_t *) &p->done_async, free_pool);
+}
+
+crypto_batch_t *crypto_batch_new(size_t cap, crypto_batch_cb cb, void *ctx) {
+    crypto_batch_t *b = calloc(1, sizeof(crypto_batch_t) + cap * sizeof(crypto_op_t));
+    b->cap = cap;
+    b->cb = cb;
+    b->ctx = ctx;
+    return b;
+}
+
+crypto_op_t *crypto_batch_add(crypto_batch_t *b) {
+    if (b->count == b->cap) {
+        return NULL;
+    }
+    return &b->ops[b->count++];
+}
+
+void crypto_pool_submit(crypto_pool_t *p, crypto_batch_t *b) {
+    b->_next = NULL;
+
+    uv_mutex_lock(&p->lock);
+    if (p->tail) {
+        p->tail->_next = b;
+    } else {
+        p->head = b;
+    }
+    p->tail = b;
+    uv_cond_signal(&p->cond);
+    uv_mutex_unlock(&p->lock);
+}
@@ -0,0 +1,150 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "deadline.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#define HEAP_ARITY 4
+#define HEAP_MIN_CAP 16
+
+#define heap_parent(i) (((i) - 1) / HEAP_ARITY)
+#define heap_child(i) ((i) * HEAP_ARITY + 1)
+
+static inline void heap_place(deadline_heap_t *h, deadline_t *d, size_t idx) {
+    h->items[idx] = d;
+    d->idx = idx;
+}
+
+static void sift_up(deadline_heap_t *h, size_t idx) {
+    deadline_t *d = h->items[idx];
+    while (idx > 0) {
+        size_t p = heap_parent(idx);
+        if (h->items[p]->due <= d->due) {
+            break;
+        }
+        heap_place(h, h->items[p], idx);
+        idx = p;
+    }
+    heap_place(h, d, idx);
+}
+
+static void sift_down(deadline_heap_t *h, size_t idx) {
+    deadline_t *d = h->items[idx];
+    for (;;) {
+        size_t c = heap_child(idx);
+        if (c >= h->size) {
+            break;
+        }
+
+        size_t end = c + HEAP_ARITY < h->size ? c + HEAP_ARITY : h->size;
+        size_t min = c;
+        for (size_t i = c + 1; i < end; i++) {
+            if (h->items[i]->due < h->items[min]->due) {
+                min = i;
+            }
+        }
+
+        if (d->due <= h->items[min]->due) {
+            break;
+        }
+        heap_place(h, h->items[min], idx);
+        idx = min;
+    }
+    heap_place(h, d, idx);
+}
+
+void deadline_heap_set(deadline_heap_t *h, deadline_t *d, uint64_t expiration) {
+    d->expiration = expiration;
+
+    if (d->heap == h) {
+        if (expiration < d->due) {
+            d->due = expiration;
+            sift_up(h, d->idx);
+        }
+        return;
+    }
+
+    if (d->heap != NULL) {
+        deadline_heap_remove(d);
+    }
+
+    if (h->size == h->cap) {
+        size_t cap = h->cap ? h->cap * 2 : HEAP_MIN_CAP;
+        deadline_t **items = realloc(h->items, cap * sizeof(deadline_t *));
+        assert(items != NULL);
+        h->items = items;
+        h->cap = cap;
+    }
+
+    d->heap = h;
+    d->due = expiration;
+    heap_place(h, d, h->size++);
+    sift_up(h, d->idx);
+}
+
+void deadline_heap_remove(deadline_t *d) {
+    deadline_heap_t *h = d->heap;
+    if (h == NULL) {
+        return;
+    }
+
+    size_t idx = d->idx;
+    assert(idx < h->size && h->items[idx] == d);
+    d->heap = NULL;
+
+    deadline_t *last = h->items[--h->size];
+    if (last == d) {
+        return;
+    }
+
+    heap_place(h, last, idx);
+    if (idx > 0 && h->items[heap_parent(idx)]->due > last->due) {
+        sift_up(h, idx);
+    } else {
+        sift_down(h, idx);
+    }
+}
+
+uint64_t deadline_heap_next(const deadline_heap_t *h) {
+    return h->size > 0 ? h->items[0]->due : UINT64_MAX;
+}
+
+deadline_t *deadline_heap_pop(deadline_heap_t *h, uint64_t now) {
+    while (h->size > 0) {
+        deadline_t *d = h->items[0];
+        if (d->due >= now) {
+            return NULL;
+        }
+
+        // deadline was extended after it was placed: move it to the actual expiration
+        if (d->expiration >= now) {
+            d->due = d->expiration;
+            sift_down(h, 0);
+            continue;
+        }
+
+        deadline_heap_remove(d);
+        return d;
+    }
+    return NULL;
+}
+
+void deadline_heap_free(deadline_heap_t *h) {
+    free(h->items);
+    h->items = NULL;
+    h->size = 0;
+    h->cap = 0;
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "epoch_gc.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+/*
+ * Readers register in the counter of the current epoch parity.
+ * Writer moves epoch from E to E+1 only when no reader of E-1 is left,
+ * so an object retired during epoch E is unreachable once epoch reaches E+2.
+ */
+struct retired_s {
+    struct retired_s *next;
+    void *obj;
+    void (*free_fn)(void *);
+    unsigned epoch;
+};
+
+struct epoch_gc_s {
+    atomic_uint epoch;
+    atomic_uint readers[2];
+
+    // writer only, oldest first
+    struct retired_s *retired;
+    struct retired_s **retired_tail;
+    size_t retired_count;
+};
+
+epoch_gc_t *epoch_gc_new(void) {
+    epoch_gc_t *gc = calloc(1, sizeof(*gc));
+    if (gc == NULL) return NULL;
+
+    atomic_init(&gc->epoch, 1);
+    atomic_init(&gc->readers[0], 0);
+    atomic_init(&gc->readers[1], 0);
+    gc->retired_tail = &gc->retired;
+    return gc;
+}
+
+void epoch_gc_free(epoch_gc_t *gc) {
+    if (gc == NULL) return;
+
+    while (gc->retired) {
+        struct retired_s *r = gc->retired;
+        gc->retired = r->next;
+        r->free_fn(r->obj);
+        free(r);
+    }
+    free(gc);
+}
+
+unsigned epoch_gc_enter(epoch_gc_t *gc) {
+    for (;;) {
+        unsigned e = atomic_load(&gc->epoch);
+        atomic_fetch_add(&gc->readers[e & 1], 1);
+        if (atomic_load(&gc->epoch) == e) {
+            return e;
+        }
+        // writer moved on, register with the new epoch
+        atomic_fetch_sub(&gc->readers[e & 1], 1);
+    }
+}
+
+void epoch_gc_leave(epoch_gc_t *gc, unsigned token) {
+    atomic_fetch_sub(&gc->readers[token & 1], 1);
+}
+
+void epoch_gc_retire(epoch_gc_t *gc, void *obj, void (*free_fn)(void *)) {
+    if (obj == NULL) return;
+
+    struct retired_s *r = malloc(sizeof(*r));
+    r->next = NULL;
+    r->obj = obj;
+    r->free_fn = free_fn;
+    r->epoch = atomic_load(&gc->epoch);
+    *gc->retired_tail = r;
+    gc->retired_tail = &r->next;
+    gc->retired_count++;
+}
+
+size_t epoch_gc_reclaim(epoch_gc_t *gc) {
+    if (gc->retired == NULL) return 0;
+
+    unsigned e = atomic_load(&gc->epoch);
+    for (int i = 0; i < 2 && e - gc->retired->epoch < 2; i++) {
+        if (atomic_load(&gc->readers[(e - 1) & 1]) != 0) break;
+        e = atomic_fetch_add(&gc->epoch, 1) + 1;
+    }
+
+    while (gc->retired && e - gc->retired->epoch >= 2) {
+        struct retired_s *r = gc->retired;
+        gc->retired = r->next;
+        r->free_fn(r->obj);
+        free(r);
+        gc->retired_count--;
+    }
+    if (gc->retired == NULL) {
+        gc->retired_tail = &gc->retired;
+    }
+    return gc->retired_count;
+}
@@ -0,0 +1,147 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "host_table.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HOST_TABLE_INITIAL_BUCKETS 64
+
+// entries are immutable once linked
+struct host_entry_s {
+    struct host_entry_s *next;
+    uint32_t hash;
+    uint32_t ip;
+    char name[];
+};
+
+struct host_buckets_s {
+    size_t mask;
+    _Atomic(struct host_entry_s *) heads[];
+};
+
+struct host_table_s {
+    epoch_gc_t *gc;
+    _Atomic(struct host_buckets_s *) buckets;
+    size_t count; // writer only
+};
+
+static uint32_t host_hash(const char *host) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *) host; *p; p++) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static struct host_buckets_s *new_buckets(size_t count) {
+    struct host_buckets_s *b = malloc(sizeof(*b) + count * sizeof(b->heads[0]));
+    b->mask = count - 1;
+    for (size_t i = 0; i < count; i++) {
+        atomic_init(&b->heads[i], NULL);
+    }
+    return b;
+}
+
+static void free_buckets(void *p) {
+    struct host_buckets_s *b = p;
+    for (size_t i = 0; i <= b->mask; i++) {
+        struct host_entry_s *e = atomic_load_explicit(&b->heads[i], memory_order_relaxed);
+        while (e) {
+            struct host_entry_s *next = e->next;
+            free(e);
+            e = next;
+        }
+    }
+    free(b);
+}
+
+static void link_entry(struct host_buckets_s *b, struct host_entry_s *e) {
+    _Atomic(struct host_entry_s *) *head = &b->heads[e->hash & b->mask];
+    e->next = atomic_load_explicit(head, memory_order_relaxed);
+    // entry is fully initialized before readers can reach it
+    atomic_store_explicit(head, e, memory_order_release);
+}
+
+static struct host_entry_s *copy_entry(const struct host_entry_s *src) {
+    size_t len = strlen(src->name) + 1;
+    struct host_entry_s *e = malloc(sizeof(*e) + len);
+    e->hash = src->hash;
+    e->ip = src->ip;
+    memcpy(e->name, src->name, len);
+    return e;
+}
+
+host_table_t *host_table_new(epoch_gc_t *gc) {
+    host_table_t *t = calloc(1, sizeof(*t));
+    t->gc = gc;
+    atomic_init(&t->buckets, new_buckets(HOST_TABLE_INITIAL_BUCKETS));
+    return t;
+}
+
+void host_table_free(host_table_t *t) {
+    if (t == NULL) return;
+
+    free_buckets(atomic_load(&t->buckets));
+    free(t);
+}
+
+// readers may still walk old buckets, so entries are copied rather than relinked
+static void grow(host_table_t *t) {
+    struct host_buckets_s *old = atomic_load_explicit(&t->buckets, memory_order_relaxed);
+    struct host_buckets_s *b = new_buckets((old->mask + 1) * 2);
+    for (size_t i = 0; i <= old->mask; i++) {
+        for (struct host_entry_s *e = atomic_load_explicit(&old->heads[i], memory_order_relaxed); e; e = e->next) {
+            link_entry(b, copy_entry(e));
+        }
+    }
+    atomic_store_explicit(&t->buckets, b, memory_order_release);
+    epoch_gc_retire(t->gc, old, free_buckets);
+}
+
+void host_table_add(host_table_t *t, const char *host, uint32_t ip) {
+    struct host_buckets_s *b = atomic_load_explicit(&t->buckets, memory_order_relaxed);
+    if (t->count > b->mask) {
+        grow(t);
+        b = atomic_load_explicit(&t->buckets, memory_order_relaxed);
+    }
+
+    size_t len = strlen(host) + 1;
+    struct host_entry_s *e = malloc(sizeof(*e) + len);
+    e->hash = host_hash(host);
+    e->ip = ip;
+    memcpy(e->name, host, len);
+    link_entry(b, e);
+    t->count++;
+}
+
+uint32_t host_table_get(host_table_t *t, const char *host) {
+    uint32_t h = host_hash(host);
+    struct host_buckets_s *b = atomic_load_explicit(&t->buckets, memory_order_acquire);
+    struct host_entry_s *e = atomic_load_explicit(&b->heads[h & b->mask], memory_order_acquire);
+    for (; e; e = e->next) {
+        if (e->hash == h && strcmp(e->name, host) == 0) {
+            return e->ip;
+        }
+    }
+    return 0;
+}
+
+size_t host_table_size(host_table_t *t) {
+    return t->count;
+}
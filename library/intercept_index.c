@@ -0,0 +1,483 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "intercept_index.h"
+#include "utils.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if _WIN32
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#endif
+
+typedef struct svc_entry_s svc_entry;
+
+typedef struct postings_s {
+    svc_entry **items;
+    size_t len;
+    size_t cap;
+} postings_t;
+
+typedef struct host_node_s {
+    struct host_node_s *parent;
+    char *label; // key in parent's children
+    size_t dlen; // length of the domain name this node represents
+    model_map children;
+    postings_t exact;
+    postings_t wild;
+} host_node;
+
+typedef struct cidr_node_s {
+    struct cidr_node_s *parent;
+    struct cidr_node_s *child[2];
+    postings_t p;
+} cidr_node;
+
+enum posting_kind {
+    HOST_EXACT,
+    HOST_WILD,
+    CIDR,
+};
+
+struct posting_ref {
+    enum posting_kind kind;
+    void *node;
+};
+
+struct port_range {
+    int low;
+    int high;
+};
+
+struct svc_entry_s {
+    char *service;
+    uint64_t seq;
+    uint32_t protocols; // bit per ziti_protocol
+    struct port_range *ports; // sorted by [low]
+    size_t nports;
+    struct posting_ref *refs;
+    size_t nrefs;
+};
+
+struct intercept_index_s {
+    uint64_t seq;
+    // service name -> svc_entry
+    model_map services;
+    host_node hosts;
+    cidr_node v4;
+    cidr_node v6;
+};
+
+#define LOOKUP_MAX_DEPTH 129
+
+static void postings_add(postings_t *p, svc_entry *e) {
+    if (p->len == p->cap) {
+        p->cap = p->cap ? p->cap * 2 : 2;
+        p->items = realloc(p->items, p->cap * sizeof(*p->items));
+    }
+    p->items[p->len++] = e;
+}
+
+static void postings_remove(postings_t *p, svc_entry *e) {
+    for (size_t i = 0; i < p->len; i++) {
+        if (p->items[i] == e) {
+            p->items[i] = p->items[--p->len];
+            return;
+        }
+    }
+}
+
+static void postings_free(postings_t *p) {
+    FREE(p->items);
+    p->len = p->cap = 0;
+}
+
+static size_t lower_host(char *out, const char *host) {
+    size_t len = 0;
+    for (; host[len] != 0; len++) {
+        out[len] = (char) tolower((unsigned char) host[len]);
+    }
+    out[len] = 0;
+    return len;
+}
+
+static host_node *host_node_get(intercept_index_t *idx, const char *name, size_t len) {
+    host_node *n = &idx->hosts;
+    size_t end = len;
+    for (;;) {
+        size_t start = end;
+        while (start > 0 && name[start - 1] != '.') start--;
+
+        const char *label = name + start;
+        size_t label_len = end - start;
+        host_node *child = model_map_get_key(&n->children, label, label_len);
+        if (child == NULL) {
+            NEWP(c, host_node);
+            c->parent = n;
+            c->label = calloc(1, label_len + 1);
+            memcpy(c->label, label, label_len);
+            c->dlen = len - start;
+            model_map_set_key(&n->children, c->label, label_len, c);
+            child = c;
+        }
+        n = child;
+
+        if (start == 0) break;
+        end = start - 1; // skip the dot
+    }
+    return n;
+}
+
+static void host_node_prune(host_node *n) {
+    while (n->parent != NULL && n->exact.len == 0 && n->wild.len == 0 && model_map_size(&n->children) == 0) {
+        host_node *parent = n->parent;
+        model_map_remove_key(&parent->children, n->label, strlen(n->label));
+        postings_free(&n->exact);
+        postings_free(&n->wild);
+        free(n->label);
+        free(n);
+        n = parent;
+    }
+}
+
+static void host_node_free(host_node *n) {
+    host_node *child;
+    const char *label;
+    MODEL_MAP_FOREACH(label, child, &n->children) {
+        host_node_free(child);
+        free(child->label);
+        free(child);
+    }
+    model_map_clear(&n->children, NULL);
+    postings_free(&n->exact);
+    postings_free(&n->wild);
+}
+
+static inline int addr_bit(const uint8_t *ip, unsigned i) {
+    return (ip[i / 8] >> (7 - i % 8)) & 1;
+}
+
+static cidr_node *cidr_node_get(cidr_node *root, const uint8_t *ip, unsigned bits) {
+    cidr_node *n = root;
+    for (unsigned i = 0; i < bits; i++) {
+        int b = addr_bit(ip, i);
+        if (n->child[b] == NULL) {
+            NEWP(c, cidr_node);
+            c->parent = n;
+            n->child[b] = c;
+        }
+        n = n->child[b];
+    }
+    return n;
+}
+
+static void cidr_node_prune(cidr_node *n) {
+    while (n->parent != NULL && n->p.len == 0 && n->child[0] == NULL && n->child[1] == NULL) {
+        cidr_node *parent = n->parent;
+        parent->child[parent->child[0] == n ? 0 : 1] = NULL;
+        postings_free(&n->p);
+        free(n);
+        n = parent;
+    }
+}
+
+static void cidr_node_free(cidr_node *n) {
+    for (int i = 0; i < 2; i++) {
+        if (n->child[i]) {
+            cidr_node_free(n->child[i]);
+            free(n->child[i]);
+            n->child[i] = NULL;
+        }
+    }
+    postings_free(&n->p);
+}
+
+static void entry_add_ref(svc_entry *e, enum posting_kind kind, void *node) {
+    e->refs = realloc(e->refs, (e->nrefs + 1) * sizeof(*e->refs));
+    e->refs[e->nrefs].kind = kind;
+    e->refs[e->nrefs].node = node;
+    e->nrefs++;
+}
+
+static void entry_unlink(svc_entry *e) {
+    for (size_t i = 0; i < e->nrefs; i++) {
+        struct posting_ref *r = &e->refs[i];
+        if (r->kind == CIDR) {
+            cidr_node *n = r->node;
+            postings_remove(&n->p, e);
+        } else {
+            host_node *n = r->node;
+            postings_remove(r->kind == HOST_EXACT ? &n->exact : &n->wild, e);
+        }
+    }
+
+    // prune after all postings are gone, the same node can be referenced more than once
+    for (size_t i = 0; i < e->nrefs; i++) {
+        struct posting_ref *r = &e->refs[i];
+        for (size_t j = i + 1; j < e->nrefs; j++) {
+            if (e->refs[j].node == r->node) {
+                r->node = NULL;
+                break;
+            }
+        }
+        if (r->node == NULL) continue;
+
+        if (r->kind == CIDR) {
+            cidr_node_prune(r->node);
+        } else {
+            host_node_prune(r->node);
+        }
+    }
+    FREE(e->refs);
+    e->nrefs = 0;
+}
+
+static void entry_free(svc_entry *e) {
+    free(e->service);
+    free(e->ports);
+    free(e->refs);
+    free(e);
+}
+
+static int cmp_port_range(const void *a, const void *b) {
+    const struct port_range *l = a;
+    const struct port_range *r = b;
+    return l->low - r->low;
+}
+
+intercept_index_t *intercept_index_new(void) {
+    NEWP(idx, intercept_index_t);
+    return idx;
+}
+
+void intercept_index_free(intercept_index_t *idx) {
+    if (idx == NULL) return;
+
+    model_map_clear(&idx->services, (void (*)(void *)) entry_free);
+    host_node_free(&idx->hosts);
+    cidr_node_free(&idx->v4);
+    cidr_node_free(&idx->v6);
+    free(idx);
+}
+
+size_t intercept_index_size(const intercept_index_t *idx) {
+    return idx ? model_map_size(&idx->services) : 0;
+}
+
+void intercept_index_remove(intercept_index_t *idx, const char *service) {
+    svc_entry *e = model_map_remove(&idx->services, service);
+    if (e) {
+        entry_unlink(e);
+        entry_free(e);
+    }
+}
+
+void intercept_index_add(intercept_index_t *idx, const char *service, const ziti_intercept_cfg_v1 *intercept) {
+    svc_entry *e = model_map_get(&idx->services, service);
+    if (e) {
+        // keep position of the service, like model_map_set() does
+        entry_unlink(e);
+        FREE(e->ports);
+        e->nports = 0;
+        e->protocols = 0;
+    } else {
+        e = calloc(1, sizeof(*e));
+        e->service = strdup(service);
+        e->seq = ++idx->seq;
+        model_map_set(&idx->services, service, e);
+    }
+
+    ziti_protocol *proto;
+    MODEL_LIST_FOREACH(proto, intercept->protocols) {
+        e->protocols |= 1u << *proto;
+    }
+
+    e->ports = calloc(model_list_size(&intercept->port_ranges) + 1, sizeof(*e->ports));
+    ziti_port_range *range;
+    MODEL_LIST_FOREACH(range, intercept->port_ranges) {
+        e->ports[e->nports].low = range->low;
+        e->ports[e->nports].high = range->high;
+        e->nports++;
+    }
+    qsort(e->ports, e->nports, sizeof(*e->ports), cmp_port_range);
+
+    const ziti_address *addr;
+    MODEL_LIST_FOREACH(addr, intercept->addresses) {
+        if (addr->type == ziti_address_hostname) {
+            const char *name = addr->addr.hostname;
+            enum posting_kind kind = HOST_EXACT;
+            if (name[0] == '*') {
+                // "*.domain"
+                if (name[1] == 0) continue;
+                name += 2;
+                kind = HOST_WILD;
+            }
+
+            char lower[sizeof(addr->addr.hostname)];
+            size_t len = lower_host(lower, name);
+            host_node *n = host_node_get(idx, lower, len);
+            postings_add(kind == HOST_EXACT ? &n->exact : &n->wild, e);
+            entry_add_ref(e, kind, n);
+        } else if (addr->type == ziti_address_cidr) {
+            cidr_node *root;
+            unsigned max;
+            if (addr->addr.cidr.af == AF_INET) {
+                root = &idx->v4;
+                max = 32;
+            } else if (addr->addr.cidr.af == AF_INET6) {
+                root = &idx->v6;
+                max = 128;
+            } else {
+                continue;
+            }
+
+            unsigned bits = addr->addr.cidr.bits > max ? max : addr->addr.cidr.bits;
+            cidr_node *n = cidr_node_get(root, (const uint8_t *) &addr->addr.cidr.ip, bits);
+            postings_add(&n->p, e);
+            entry_add_ref(e, CIDR, n);
+        }
+    }
+}
+
+static int port_score(const svc_entry *e, int port) {
+    int score = -1;
+    for (size_t i = 0; i < e->nports && e->ports[i].low <= port; i++) {
+        if (port <= e->ports[i].high) {
+            int width = e->ports[i].high - e->ports[i].low;
+            if (score == -1 || width < score) {
+                score = width;
+                if (score == 0) break;
+            }
+        }
+    }
+    return score;
+}
+
+struct best_match {
+    const svc_entry *entry;
+    int score;
+};
+
+static void match_postings(struct best_match *best, const postings_t *p, ziti_protocol proto, int addr_score, int port) {
+    for (size_t i = 0; i < p->len; i++) {
+        const svc_entry *e = p->items[i];
+        if (proto != 0 && (e->protocols & (1u << proto)) == 0) continue;
+
+        int ps = port_score(e, port);
+        if (ps == -1) continue;
+
+        int score = (addr_score << 16) | (ps & 0xFFFF);
+        if (best->entry == NULL || score < best->score ||
+            (score == best->score && e->seq > best->entry->seq)) {
+            best->entry = e;
+            best->score = score;
+        }
+    }
+}
+
+static void lookup_host(const intercept_index_t *idx, struct best_match *best,
+                        ziti_protocol proto, const char *hostname, int port) {
+    char host[sizeof(((ziti_address *) 0)->addr.hostname)];
+    size_t len = lower_host(host, hostname);
+
+    const host_node *path[LOOKUP_MAX_DEPTH];
+    int depth = 0;
+    const host_node *n = &idx->hosts;
+    bool full = false;
+    size_t end = len;
+    while (depth < LOOKUP_MAX_DEPTH) {
+        size_t start = end;
+        while (start > 0 && host[start - 1] != '.') start--;
+
+        n = model_map_get_key(&n->children, host + start, end - start);
+        if (n == NULL) break;
+        path[depth++] = n;
+
+        if (start == 0) {
+            full = true;
+            break;
+        }
+        end = start - 1;
+    }
+
+    // candidates in order of increasing address score, first level with a match wins
+    if (full) {
+        const host_node *leaf = path[depth - 1];
+        match_postings(best, &leaf->exact, proto, 0, port);
+        match_postings(best, &leaf->wild, proto, 0, port);
+        if (best->entry) return;
+        depth--;
+    }
+
+    for (int i = depth - 1; i >= 0; i--) {
+        match_postings(best, &path[i]->wild, proto, (int) (len - path[i]->dlen), port);
+        if (best->entry) return;
+    }
+}
+
+static void lookup_cidr(const intercept_index_t *idx, struct best_match *best,
+                        ziti_protocol proto, const ziti_address *addr, int port) {
+    const cidr_node *n;
+    unsigned max;
+    if (addr->addr.cidr.af == AF_INET) {
+        n = &idx->v4;
+        max = 32;
+    } else if (addr->addr.cidr.af == AF_INET6) {
+        n = &idx->v6;
+        max = 128;
+    } else {
+        return;
+    }
+
+    unsigned bits = addr->addr.cidr.bits > max ? max : addr->addr.cidr.bits;
+    const uint8_t *ip = (const uint8_t *) &addr->addr.cidr.ip;
+
+    const cidr_node *path[LOOKUP_MAX_DEPTH];
+    path[0] = n;
+    unsigned depth = 0;
+    while (depth < bits) {
+        const cidr_node *c = n->child[addr_bit(ip, depth)];
+        if (c == NULL) break;
+        n = c;
+        path[++depth] = n;
+    }
+
+    // longest prefix first
+    for (int i = (int) depth; i >= 0; i--) {
+        if (path[i]->p.len == 0) continue;
+        match_postings(best, &path[i]->p, proto, (int) addr->addr.cidr.bits - i, port);
+        if (best->entry) return;
+    }
+}
+
+const char *intercept_index_lookup(const intercept_index_t *idx, ziti_protocol proto,
+                                   const ziti_address *addr, int port, int *score) {
+    struct best_match best = {0};
+    if (idx != NULL) {
+        if (addr->type == ziti_address_hostname) {
+            lookup_host(idx, &best, proto, addr->addr.hostname, port);
+        } else if (addr->type == ziti_address_cidr) {
+            lookup_cidr(idx, &best, proto, addr, port);
+        }
+    }
+
+    if (score) {
+        *score = best.entry ? best.score : -1;
+    }
+    return best.entry ? best.entry->service : NULL;
+}
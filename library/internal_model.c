@@ -347,11 +347,11 @@ int ziti_address_match(const ziti_address *addr, const ziti_address *range) {
             unsigned int bits = range->addr.cidr.bits;
             uint8_t mask;
             for (int i = 0; i < 16 && bits > 0; i++) {
-                if (bits > 8) {
+                if (bits >= 8) {
                     bits = bits - 8;
                     mask = 0xff;
                 } else {
-                    mask = 0xff << bits;
+                    mask = (uint8_t) (0xff << (8 - bits));
                     bits = 0;
                 }
 
@@ -0,0 +1,115 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "log_ring.h"
+#include "utils.h"
+
+#include <stdlib.h>
+
+struct log_cell_s {
+    // == position: free for producer at position
+    // == position + 1: published for consumer
+    atomic_size_t seq;
+    log_record_t rec;
+};
+
+struct log_ring_s {
+    size_t mask;
+    atomic_size_t head; // next position to claim
+    size_t tail;        // next position to read, consumer only
+    atomic_uint_fast64_t dropped;
+    struct log_cell_s *cells;
+};
+
+log_ring_t *log_ring_new(size_t cap) {
+    size_t c = 2;
+    while (c < cap) c <<= 1;
+
+    log_ring_t *r = calloc(1, sizeof(*r));
+    if (r == NULL) {
+        return NULL;
+    }
+    r->cells = calloc(c, sizeof(struct log_cell_s));
+    if (r->cells == NULL) {
+        free(r);
+        return NULL;
+    }
+
+    r->mask = c - 1;
+    for (size_t i = 0; i < c; i++) {
+        atomic_init(&r->cells[i].seq, i);
+    }
+    atomic_init(&r->head, 0);
+    atomic_init(&r->dropped, 0);
+    return r;
+}
+
+void log_ring_free(log_ring_t *r) {
+    if (r == NULL) return;
+
+    free(r->cells);
+    free(r);
+}
+
+log_record_t *log_ring_claim(log_ring_t *r) {
+    size_t pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+    for (;;) {
+        struct log_cell_s *cell = &r->cells[pos & r->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&r->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                return &cell->rec;
+            }
+            // pos was reloaded by failed CAS
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+        }
+    }
+}
+
+void log_ring_publish(log_ring_t *r, log_record_t *rec) {
+    struct log_cell_s *cell = container_of(rec, struct log_cell_s, rec);
+    size_t seq = atomic_load_explicit(&cell->seq, memory_order_relaxed);
+    atomic_store_explicit(&cell->seq, seq + 1, memory_order_seq_cst);
+}
+
+size_t log_ring_peek(log_ring_t *r, log_record_t **recs, size_t max) {
+    size_t count = 0;
+    while (count < max) {
+        size_t pos = r->tail + count;
+        struct log_cell_s *cell = &r->cells[pos & r->mask];
+        if (atomic_load_explicit(&cell->seq, memory_order_acquire) != pos + 1) {
+            break;
+        }
+        recs[count++] = &cell->rec;
+    }
+    return count;
+}
+
+void log_ring_release(log_ring_t *r, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        size_t pos = r->tail++;
+        struct log_cell_s *cell = &r->cells[pos & r->mask];
+        atomic_store_explicit(&cell->seq, pos + r->mask + 1, memory_order_release);
+    }
+}
+
+uint64_t log_ring_dropped(log_ring_t *r) {
+    return atomic_load_explicit(&r->dropped, memory_order_relaxed);
+}
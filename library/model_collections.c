@@ -22,134 +22,241 @@
 #include <tlsuv/queue.h>
 #include "utils.h"
 
+/*
+ * model_map is an open addressing hash table (robin hood probing with backward shift deletion).
+ * Slots hold the hash and a pointer to the entry, so probing does not touch entries until hashes match.
+ * Entries are allocated individually (key is stored inline) and linked in insertion order (newest first),
+ * so iterators stay valid when the table is resized, and iteration order does not depend on hashing.
+ */
 struct model_map_entry {
-    void *key;
-    char key_pad[2];
-    size_t key_len;
-    uint32_t key_hash;
-    const void *value;
     LIST_ENTRY(model_map_entry) _next;
-    LIST_ENTRY(model_map_entry) _tnext;
     model_map *_map;
+    const void *value;
+    uint32_t key_hash;
+    size_t key_len;
+    char key[]; // key bytes followed by '\0'
 };
 
-#define ENTRY_KEY(e) ((e)->key_len > sizeof((e)->key) ? (e)->key : &(e)->key)
+struct map_slot {
+    uint32_t hash;
+    struct model_map_entry *entry;
+};
 
 typedef LIST_HEAD(entries_s, model_map_entry) entries_t;
 
 struct model_impl_s {
     entries_t entries;
-    entries_t *table;
-    int buckets;
+    struct map_slot *slots;
+    uint32_t mask;
     size_t size;
 };
 
-static uint32_t key_hash0(const uint8_t *key, size_t key_len) {
-    uint32_t h = 0;
-    for (size_t idx = 0; idx < key_len; idx++) {
-        h = ((h << 5U) + h) + key[idx];
+static const uint32_t DEFAULT_MAP_SLOTS = 16;
+
+// MurmurHash64A
+static uint64_t key_hash(const uint8_t *key, size_t key_len) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    uint64_t h = 0x5bd1e995ULL ^ (key_len * m);
+
+    const uint8_t *end = key + (key_len & ~(size_t)7);
+    for (; key != end; key += 8) {
+        uint64_t k;
+        memcpy(&k, key, sizeof(k));
+        k *= m;
+        k ^= k >> 47;
+        k *= m;
+        h ^= k;
+        h *= m;
     }
+
+    switch (key_len & 7) {
+        case 7: h ^= (uint64_t)key[6] << 48;
+        case 6: h ^= (uint64_t)key[5] << 40;
+        case 5: h ^= (uint64_t)key[4] << 32;
+        case 4: h ^= (uint64_t)key[3] << 24;
+        case 3: h ^= (uint64_t)key[2] << 16;
+        case 2: h ^= (uint64_t)key[1] << 8;
+        case 1: h ^= (uint64_t)key[0];
+            h *= m;
+        default:
+            break;
+    }
+
+    h ^= h >> 47;
+    h *= m;
+    h ^= h >> 47;
     return h;
 }
 
-static const int DEFAULT_MAP_BUCKETS = 16;
+// murmur3 finalizer, integer keys do not need the full byte hash
+static inline uint64_t long_hash(long key) {
+    uint64_t h = (uint64_t)(unsigned long)key;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
 
-static uint32_t (*key_hash)(const uint8_t *key, size_t key_len) = key_hash0;
+// keys set with model_map_setl() and model_map_set_key() must hash the same
+static inline uint32_t map_hash(const void *key, size_t key_len) {
+    if (key_len == sizeof(long)) {
+        long l;
+        memcpy(&l, key, sizeof(l));
+        return (uint32_t)long_hash(l);
+    }
+    return (uint32_t)key_hash(key, key_len);
+}
 
-static void map_resize_table(model_map *m) {
-    if (m->impl == NULL) { return; }
+#define PROBE_DIST(impl, slot_idx, h) (((slot_idx) - (h)) & (impl)->mask)
 
-    int new_buckets = m->impl->buckets * 2;
-    void *new_table = realloc(m->impl->table, new_buckets * sizeof(entries_t));
+static inline struct map_slot *find_slot(const struct model_impl_s *impl, uint32_t h,
+                                         const void *key, size_t key_len) {
+    uint32_t idx = h & impl->mask;
+    for (uint32_t dist = 0;; dist++, idx = (idx + 1) & impl->mask) {
+        struct map_slot *s = impl->slots + idx;
+        if (s->entry == NULL || PROBE_DIST(impl, idx, s->hash) < dist) {
+            return NULL;
+        }
+        if (s->hash == h && s->entry->key_len == key_len && memcmp(s->entry->key, key, key_len) == 0) {
+            return s;
+        }
+    }
+}
 
-    m->impl->buckets *= 2;
-    m->impl->table = new_table;
-    memset(m->impl->table, 0, sizeof(entries_t) * m->impl->buckets);
+static void slot_insert(struct model_impl_s *impl, uint32_t h, struct model_map_entry *e) {
+    struct map_slot cur = {.hash = h, .entry = e};
+    uint32_t idx = h & impl->mask;
+    for (uint32_t dist = 0;; dist++, idx = (idx + 1) & impl->mask) {
+        struct map_slot *s = impl->slots + idx;
+        if (s->entry == NULL) {
+            *s = cur;
+            return;
+        }
 
-    struct model_map_entry *el;
-    LIST_FOREACH(el, &m->impl->entries, _next) {
-        uint32_t idx = el->key_hash % m->impl->buckets;
-        entries_t *bucket = m->impl->table + idx;
-        LIST_INSERT_HEAD(bucket, el, _tnext);
+        uint32_t d = PROBE_DIST(impl, idx, s->hash);
+        if (d < dist) {
+            struct map_slot tmp = *s;
+            *s = cur;
+            cur = tmp;
+            dist = d;
+        }
     }
 }
 
-static struct model_map_entry *find_map_entry(const model_map *m, const uint8_t *key, size_t key_len, uint32_t *hash_out) {
-    uint32_t kh = key_hash(key, key_len);
-    if (hash_out) {
-        *hash_out = kh;
-    }
-    uint32_t idx = kh % m->impl->buckets;
-    entries_t *bucket = m->impl->table + idx;
-    struct model_map_entry *entry;
-    LIST_FOREACH(entry, bucket, _tnext) {
-        if (key_len == entry->key_len && kh == entry->key_hash) {
-            void *ekey = ENTRY_KEY(entry);
-            if (memcmp(key, ekey, key_len) == 0) {
-                return entry;
-            }
+static void slot_delete(struct model_impl_s *impl, struct map_slot *s) {
+    uint32_t idx = (uint32_t)(s - impl->slots);
+    for (;;) {
+        uint32_t next = (idx + 1) & impl->mask;
+        struct map_slot *n = impl->slots + next;
+        if (n->entry == NULL || PROBE_DIST(impl, next, n->hash) == 0) {
+            break;
         }
+        impl->slots[idx] = *n;
+        idx = next;
     }
-    return NULL;
+    impl->slots[idx].entry = NULL;
 }
 
-size_t model_map_size(const model_map *m) {
-    return m->impl ? m->impl->size : 0;
-}
+static void map_resize_table(struct model_impl_s *impl) {
+    uint32_t old_count = impl->mask + 1;
+    struct map_slot *old = impl->slots;
 
-void *model_map_setl(model_map *m, long key, const void *val) {
-    return model_map_set_key(m, &key, sizeof(key), val);
+    impl->slots = calloc((size_t)old_count * 2, sizeof(struct map_slot));
+    impl->mask = old_count * 2 - 1;
+    for (uint32_t i = 0; i < old_count; i++) {
+        if (old[i].entry) {
+            slot_insert(impl, old[i].hash, old[i].entry);
+        }
+    }
+    free(old);
 }
 
-void *model_map_set(model_map *m, const char *key, const void *val) {
-    return model_map_set_key(m, key, strlen(key), val);
+static void map_free_entry(model_map *m, struct model_map_entry *e) {
+    LIST_REMOVE(e, _next);
+    free(e);
+    m->impl->size--;
+
+    if (m->impl->size == 0) {
+        FREE(m->impl->slots);
+        FREE(m->impl);
+    }
 }
 
-void *model_map_set_key(model_map *m, const void *key, size_t key_len, const void *val) {
-    uint32_t kh = 0;
-    struct model_map_entry *el = NULL;
+static void *map_set(model_map *m, uint32_t h, const void *key, size_t key_len, const void *val) {
     if (m->impl == NULL) {
         m->impl = calloc(1, sizeof(struct model_impl_s));
-        m->impl->buckets = DEFAULT_MAP_BUCKETS;
-        m->impl->table = calloc(m->impl->buckets, sizeof(entries_t));
-        kh = key_hash0(key, key_len);
+        m->impl->mask = DEFAULT_MAP_SLOTS - 1;
+        m->impl->slots = calloc(DEFAULT_MAP_SLOTS, sizeof(struct map_slot));
     } else {
-        el = find_map_entry(m, key, key_len, &kh);
+        struct map_slot *s = find_slot(m->impl, h, key, key_len);
+        if (s != NULL) {
+            const void *old_val = s->entry->value;
+            s->entry->value = val;
+            return (void *)old_val;
+        }
     }
 
-    if (el != NULL) {
-        const void *old_val = el->value;
-        el->value = val;
-        return (void*)old_val;
+    // keep load factor under 3/4
+    if ((m->impl->size + 1) * 4 > ((size_t)m->impl->mask + 1) * 3) {
+        map_resize_table(m->impl);
     }
 
-    el = calloc(1, sizeof(*el));
+    struct model_map_entry *el = malloc(offsetof(struct model_map_entry, key) + key_len + 1);
+    el->_map = m;
     el->value = val;
+    el->key_hash = h;
     el->key_len = key_len;
-    if (key_len > sizeof(el->key)) {
-        el->key = calloc(1, key_len + 1);
-        memcpy(el->key, key, key_len);
-    } else {
-        memcpy(&el->key, key, key_len);
-    }
-    el->key_hash = kh;
-    el->_map = m;
-    uint32_t idx = el->key_hash % m->impl->buckets;
+    memcpy(el->key, key, key_len);
+    el->key[key_len] = '\0';
 
-    entries_t *bucket = m->impl->table + idx;
     LIST_INSERT_HEAD(&m->impl->entries, el, _next);
-    LIST_INSERT_HEAD(bucket, el, _tnext);
+    slot_insert(m->impl, h, el);
     m->impl->size++;
+    return NULL;
+}
 
-    if (m->impl->size > m->impl->buckets * 2) {
-        map_resize_table(m);
+static void *map_remove(model_map *m, uint32_t h, const void *key, size_t key_len) {
+    if (m->impl == NULL) {
+        return NULL;
     }
 
-    return NULL;
+    struct map_slot *s = find_slot(m->impl, h, key, key_len);
+    if (s == NULL) {
+        return NULL;
+    }
+
+    struct model_map_entry *el = s->entry;
+    const void *val = el->value;
+    slot_delete(m->impl, s);
+    map_free_entry(m, el);
+    return (void *)val;
+}
+
+size_t model_map_size(const model_map *m) {
+    return m->impl ? m->impl->size : 0;
+}
+
+void *model_map_setl(model_map *m, long key, const void *val) {
+    return map_set(m, (uint32_t)long_hash(key), &key, sizeof(key), val);
+}
+
+void *model_map_set(model_map *m, const char *key, const void *val) {
+    return model_map_set_key(m, key, strlen(key), val);
+}
+
+void *model_map_set_key(model_map *m, const void *key, size_t key_len, const void *val) {
+    return map_set(m, map_hash(key, key_len), key, key_len, val);
 }
 
 void *model_map_getl(const model_map *m, long key) {
-    return model_map_get_key(m, &key, sizeof(key));
+    if (m == NULL || m->impl == NULL) {
+        return NULL;
+    }
+
+    struct map_slot *s = find_slot(m->impl, (uint32_t)long_hash(key), &key, sizeof(key));
+    return s ? (void *)s->entry->value : NULL;
 }
 
 void *model_map_get(const model_map *m, const char *key) {
@@ -161,12 +268,12 @@ void *model_map_get_key(const model_map *m, const void *key, size_t key_len) {
         return NULL;
     }
 
-    struct model_map_entry *el = find_map_entry(m, key, key_len, NULL);
-    return el ? (void*)el->value : NULL;
+    struct map_slot *s = find_slot(m->impl, map_hash(key, key_len), key, key_len);
+    return s ? (void *)s->entry->value : NULL;
 }
 
 void *model_map_removel(model_map *m, long key) {
-    return model_map_remove_key(m, &key, sizeof(key));
+    return map_remove(m, (uint32_t)long_hash(key), &key, sizeof(key));
 }
 
 void *model_map_remove(model_map *m, const char *key) {
@@ -174,28 +281,7 @@ void *model_map_remove(model_map *m, const char *key) {
 }
 
 void *model_map_remove_key(model_map *m, const void *key, size_t key_len) {
-    if (m->impl == NULL) {
-        return NULL;
-    }
-
-    const void *val = NULL;
-    struct model_map_entry *el = find_map_entry(m, key, key_len, NULL);
-    if (el != NULL) {
-        val = el->value;
-        LIST_REMOVE(el, _next);
-        LIST_REMOVE(el, _tnext);
-        if (el->key_len > sizeof(el->key)) {
-            free(el->key);
-        }
-        free(el);
-        m->impl->size--;
-    }
-
-    if (m->impl->size == 0) {
-        FREE(m->impl->table);
-        FREE(m->impl);
-    }
-    return (void*)val;
+    return map_remove(m, map_hash(key, key_len), key, key_len);
 }
 
 void model_map_clear(model_map *map, void (*val_free_func)(void *)) {
@@ -204,15 +290,12 @@ void model_map_clear(model_map *map, void (*val_free_func)(void *)) {
     struct model_map_entry *el;
     while ((el = LIST_FIRST(&map->impl->entries)) != NULL) {
         LIST_REMOVE(el, _next);
-        if (el->key_len > sizeof(el->key)) {
-            FREE(el->key);
-        }
         if (val_free_func) {
             val_free_func((void*)el->value);
         }
         FREE(el);
     }
-    FREE(map->impl->table);
+    FREE(map->impl->slots);
     FREE(map->impl);
 }
 
@@ -233,12 +316,17 @@ const void *model_map_it_key_s(model_map_iter it, size_t *key_len) {
         *key_len = entry->key_len;
     }
 
-    return ENTRY_KEY(entry);
+    return entry->key;
 }
 
 long model_map_it_lkey(model_map_iter it) {
-    const long *keyp = model_map_it_key_s(it, NULL);
-    return keyp ? *keyp : 0;
+    long key = 0;
+    size_t len;
+    const void *keyp = model_map_it_key_s(it, &len);
+    if (keyp) {
+        memcpy(&key, keyp, MIN(len, sizeof(key)));
+    }
+    return key;
 }
 
 void *model_map_it_value(model_map_iter it) {
@@ -254,39 +342,79 @@ model_map_iter model_map_it_remove(model_map_iter it) {
     if (it != NULL) {
         struct model_map_entry *e = (struct model_map_entry *) it;
         model_map *m = e->_map;
-        LIST_REMOVE(e, _next);
-        LIST_REMOVE(e, _tnext);
-        if (e->key_len > sizeof(e->key)) {
-            free(e->key);
-        }
-        free(e);
-
         if (m->impl == NULL) {
             return NULL;
         }
 
-        m->impl->size--;
-        // last element removed
-        if (m->impl->size == 0) {
-            FREE(m->impl->table);
-            FREE(m->impl);
+        struct model_impl_s *impl = m->impl;
+        uint32_t idx = e->key_hash & impl->mask;
+        while (impl->slots[idx].entry != e) {
+            idx = (idx + 1) & impl->mask;
         }
+        slot_delete(impl, impl->slots + idx);
+        map_free_entry(m, e);
     }
     return next;
 }
 
-struct model_list_el {
+/*
+ * model_list is a growable array of slots with free space kept at both ends,
+ * so push/append/pop are amortized O(1) and iteration is sequential.
+ * Iterators are slot pointers. Removing an element leaves a hole in its slot instead of shifting
+ * the following elements, that keeps iterators to other elements valid (e.g. in MODEL_LIST_FOR).
+ * Holes are trimmed from the ends on removal and squeezed out when the array is re-laid out on growth.
+ * Push/append may move the slots and invalidate outstanding iterators.
+ */
+struct list_slot {
     const void *el;
-    model_list *l;
-    LIST_ENTRY(model_list_el) _next;
+    struct model_list_impl_s *impl;
 };
 
 struct model_list_impl_s {
-    size_t size;
-    LIST_HEAD(, model_list_el) elements;
-    struct model_list_el end;
+    model_list *l;
+    size_t size;  // number of elements
+    size_t head;  // first used slot
+    size_t tail;  // one past last used slot
+    size_t cap;
+    struct list_slot *slots;
 };
 
+static const char LIST_HOLE;
+#define IS_HOLE(s) ((s)->el == &LIST_HOLE)
+
+static const size_t DEFAULT_LIST_CAP = 8;
+
+static struct model_list_impl_s *list_impl(model_list *l) {
+    if (l->impl == NULL) {
+        l->impl = calloc(1, sizeof(*l->impl));
+        l->impl->l = l;
+    }
+    return l->impl;
+}
+
+// compact elements into a new slot array with room for at least one more
+// at the front (push) or back (append)
+static void list_layout(struct model_list_impl_s *impl, bool front) {
+    size_t cap = impl->cap ? impl->cap : DEFAULT_LIST_CAP;
+    while (cap < 2 * (impl->size + 1)) {
+        cap *= 2;
+    }
+
+    struct list_slot *slots = malloc(cap * sizeof(struct list_slot));
+    size_t idx = front ? (cap - impl->size) / 2 : 0;
+    size_t new_head = idx;
+    for (size_t i = impl->head; i < impl->tail; i++) {
+        if (!IS_HOLE(&impl->slots[i])) {
+            slots[idx++] = impl->slots[i];
+        }
+    }
+    free(impl->slots);
+    impl->slots = slots;
+    impl->head = new_head;
+    impl->tail = idx;
+    impl->cap = cap;
+}
+
 size_t model_list_size(const model_list *l) {
     return l->impl ? l->impl->size : 0;
 }
@@ -300,81 +428,86 @@ void *model_list_pop(model_list *l) {
 }
 
 void model_list_push(model_list *l, const void *el) {
-    if (l->impl == NULL) {
-        l->impl = calloc(1, sizeof(*l->impl));
-        LIST_INSERT_HEAD(&l->impl->elements, &l->impl->end, _next);
+    struct model_list_impl_s *impl = list_impl(l);
+    if (impl->head == 0) {
+        list_layout(impl, true);
     }
-    l->impl->size++;
-    struct model_list_el *entry = calloc(1, sizeof(struct model_list_el));
-    entry->el = el;
-    entry->l = l;
-    LIST_INSERT_HEAD(&l->impl->elements, entry, _next);
+    impl->head--;
+    impl->slots[impl->head] = (struct list_slot){.el = el, .impl = impl};
+    impl->size++;
 }
 
 void model_list_append(model_list *l, const void *el) {
-    if (l->impl == NULL) {
-        l->impl = calloc(1, sizeof(*l->impl));
-        LIST_INSERT_HEAD(&l->impl->elements, &l->impl->end, _next);
+    struct model_list_impl_s *impl = list_impl(l);
+    if (impl->tail == impl->cap) {
+        list_layout(impl, false);
     }
 
-    l->impl->size++;
-    struct model_list_el *entry = calloc(1, sizeof(struct model_list_el));
-    entry->el = el;
-    entry->l = l;
-    LIST_INSERT_BEFORE(&l->impl->end, entry, _next);
+    impl->slots[impl->tail++] = (struct list_slot){.el = el, .impl = impl};
+    impl->size++;
 }
 
 const void *model_list_head(const model_list *l) {
     if (l->impl == NULL) { return NULL; }
 
-    struct model_list_el *el = LIST_FIRST(&l->impl->elements);
-    if (el == &l->impl->end) { return NULL; }
-
-    return el->el;
+    return l->impl->slots[l->impl->head].el;
 }
 
 void model_list_clear(model_list *list, void (*clear_f)(void *)) {
-    if (list == NULL) { return; }
-    while (model_list_size(list) > 0) {
-        void *el = model_list_pop(list);
-        if (clear_f) {
-            clear_f(el);
+    if (list == NULL || list->impl == NULL) { return; }
+
+    struct model_list_impl_s *impl = list->impl;
+    list->impl = NULL;
+    for (size_t i = impl->head; i < impl->tail; i++) {
+        if (clear_f && !IS_HOLE(&impl->slots[i])) {
+            clear_f((void *)impl->slots[i].el);
         }
     }
+    free(impl->slots);
+    free(impl);
 }
 
 model_list_iter model_list_iterator(model_list *l) {
     if (l == NULL || l->impl == NULL) { return NULL; }
 
-    struct model_list_el *el = LIST_FIRST(&l->impl->elements);
-    if (el == &l->impl->end) { return NULL; }
-
-    return el;
+    return l->impl->slots + l->impl->head;
 }
 
 model_list_iter model_list_it_next(model_list_iter it) {
     if (it == NULL) { return NULL; }
 
-    struct model_list_el *entry = it;
-    struct model_list_el *next = LIST_NEXT(entry, _next);
-    if (next == &entry->l->impl->end) { return NULL; }
-
-    return next;
+    struct list_slot *s = it;
+    struct list_slot *end = s->impl->slots + s->impl->tail;
+    for (s++; s < end; s++) {
+        if (!IS_HOLE(s)) {
+            return s;
+        }
+    }
+    return NULL;
 }
 
 model_list_iter model_list_it_remove(model_list_iter it) {
     if (it == NULL) { return NULL; }
-    struct model_list_el *entry = it;
-    model_list *list = entry->l;
+    struct list_slot *s = it;
+    struct model_list_impl_s *impl = s->impl;
 
     model_list_iter next = model_list_it_next(it);
-    list->impl->size--;
-    LIST_REMOVE(entry, _next);
-    free(entry);
+    s->el = &LIST_HOLE;
+    impl->size--;
 
-    if (list->impl->size == 0) {
-        free(list->impl);
-        list->impl = NULL;
+    if (impl->size == 0) {
+        impl->l->impl = NULL;
+        free(impl->slots);
+        free(impl);
+        return NULL;
+    }
+
+    // trim holes at both ends, so head/tail always point at elements
+    while (IS_HOLE(impl->slots + impl->head)) {
+        impl->head++;
+    }
+    while (IS_HOLE(impl->slots + impl->tail - 1)) {
+        impl->tail--;
     }
     return next;
 }
@@ -382,5 +515,5 @@ model_list_iter model_list_it_remove(model_list_iter it) {
 const void *model_list_it_element(model_list_iter it) {
     if (it == NULL) { return NULL; }
 
-    return ((struct model_list_el *) it)->el;
-}
\ No newline at end of file
+    return ((struct list_slot *) it)->el;
+}
@@ -0,0 +1,784 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "model_stream.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <json-c/json.h>
+
+#include "utils.h"
+
+#define MAX_BINDINGS 8
+
+enum lex_state {
+    lex_value,
+    lex_value_or_end, // after '['
+    lex_key_or_end,   // after '{' or ','
+    lex_colon,
+    lex_next,         // after value: ',' or end of container
+    lex_string,
+    lex_string_esc,
+    lex_string_u,
+    lex_number,
+    lex_literal,
+    lex_done,
+};
+
+enum token {
+    tok_string,
+    tok_number,
+    tok_true,
+    tok_false,
+    tok_null,
+};
+
+enum frame_type {
+    frame_bind,  // top level object with bound keys
+    frame_model,
+    frame_map,
+    frame_list,
+    frame_array,
+};
+
+struct binding {
+    const char *key;
+    void *target;
+    const type_meta *meta;
+    enum _field_mod mod;
+};
+
+struct frame {
+    enum frame_type type;
+    const type_meta *meta; // model type or element type
+    void *target;
+    size_t count;          // frame_array: number of elements
+    size_t cap;
+
+    // destination of the current value
+    const field_meta *field;
+    const struct binding *bind;
+    char *key;
+    bool commit; // element is stored in [tmp] and added to container when complete
+    void *tmp;
+};
+
+struct sbuf {
+    char *b;
+    size_t len;
+    size_t cap;
+};
+
+struct model_stream_s {
+    enum lex_state state;
+    int status;
+
+    struct binding bindings[MAX_BINDINGS];
+    int binding_count;
+
+    // open JSON containers: '{' or '['
+    struct sbuf nest;
+
+    struct frame *frames;
+    size_t frame_count;
+    size_t frame_cap;
+
+    // current scalar token
+    struct sbuf tok;
+    bool str_key;
+    bool num_int;
+    unsigned int u_val;
+    int u_digits;
+    unsigned int u_high;
+    const char *literal;
+    int lit_pos;
+
+    // destination of the current scalar value, NULL if value is skipped
+    const type_meta *leaf_meta;
+    void *leaf_dest;
+
+    // depth of skipped or captured container value
+    size_t passive_depth;
+    bool capturing;
+    const type_meta *cap_meta;
+    void *cap_dest;
+    struct sbuf cap;
+};
+
+static inline void sbuf_add(struct sbuf *b, char c) {
+    if (b->len + 1 >= b->cap) {
+        b->cap = b->cap ? b->cap * 2 : 64;
+        b->b = realloc(b->b, b->cap);
+    }
+    b->b[b->len++] = c;
+}
+
+static inline const char *sbuf_str(struct sbuf *b) {
+    sbuf_add(b, 0);
+    b->len--;
+    return b->b;
+}
+
+static inline bool is_ws(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline bool is_num_char(char c) {
+    return is_digit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+static bool valid_number(const char *p, bool *is_int) {
+    *is_int = true;
+    if (*p == '-') p++;
+    if (!is_digit(*p)) return false;
+    while (is_digit(*p)) p++;
+
+    if (*p == '.') {
+        *is_int = false;
+        p++;
+        if (!is_digit(*p)) return false;
+        while (is_digit(*p)) p++;
+    }
+    if (*p == 'e' || *p == 'E') {
+        *is_int = false;
+        p++;
+        if (*p == '+' || *p == '-') p++;
+        if (!is_digit(*p)) return false;
+        while (is_digit(*p)) p++;
+    }
+    return *p == 0;
+}
+
+static bool is_inline(enum frame_type type, const type_meta *meta) {
+    // same element storage as model_list_from_json/model_array_from_json/parse_map_from_json
+    switch (type) {
+        case frame_list:
+            return meta == get_model_string_meta() || meta == get_json_meta() ||
+                   meta == get_model_number_meta() || meta == get_model_bool_meta();
+        case frame_array:
+            return meta == get_model_string_meta();
+        case frame_map:
+            return meta == get_model_string_meta() || meta == get_json_meta();
+        default:
+            return false;
+    }
+}
+
+static void drop_value(const type_meta *meta, bool inl, void *v) {
+    if (v == NULL) return;
+    if (!inl) {
+        model_free(v, meta);
+    }
+    free(v);
+}
+
+static void add_element(struct frame *f, void *el, bool inl) {
+    switch (f->type) {
+        case frame_list:
+            model_list_append(f->target, el);
+            break;
+        case frame_array: {
+            void ***arr = f->target;
+            if (f->count + 1 > f->cap) {
+                f->cap = f->cap ? f->cap * 2 : 16;
+                *arr = realloc(*arr, (f->cap + 1) * sizeof(void *));
+            }
+            (*arr)[f->count++] = el;
+            (*arr)[f->count] = NULL;
+            break;
+        }
+        case frame_map:
+            drop_value(f->meta, inl, model_map_set(f->target, f->key, el));
+            break;
+        default:
+            break;
+    }
+}
+
+static struct frame *push_frame(model_stream *s, enum frame_type type, const type_meta *meta, void *target) {
+    if (s->frame_count == s->frame_cap) {
+        s->frame_cap = s->frame_cap ? s->frame_cap * 2 : 8;
+        s->frames = realloc(s->frames, s->frame_cap * sizeof(struct frame));
+    }
+    struct frame *f = &s->frames[s->frame_count++];
+    *f = (struct frame) {
+            .type = type,
+            .meta = meta,
+            .target = target,
+    };
+
+    if (type == frame_array) {
+        void ***arr = target;
+        if (*arr == NULL) {
+            *arr = calloc(1, sizeof(void *));
+        }
+        while ((*arr)[f->count] != NULL) f->count++;
+        f->cap = f->count;
+    }
+    return f;
+}
+
+static inline struct frame *top_frame(model_stream *s) {
+    return s->frame_count > 0 ? &s->frames[s->frame_count - 1] : NULL;
+}
+
+static const struct binding *find_binding(model_stream *s, const char *key) {
+    for (int i = 0; i < s->binding_count; i++) {
+        const char *k = s->bindings[i].key;
+        if (k == key || (k && key && strcmp(k, key) == 0)) {
+            return &s->bindings[i];
+        }
+    }
+    return NULL;
+}
+
+static const field_meta *find_field(const type_meta *meta, const char *key, size_t len) {
+    if (meta->field_lookup) {
+        return meta->field_lookup(key, len);
+    }
+
+    for (int i = 0; i < meta->field_count; i++) {
+        const field_meta *fm = &meta->fields[i];
+        if (fm->path && fm->path[0] != 0 && strcmp(fm->path, key) == 0) {
+            return fm;
+        }
+    }
+    return NULL;
+}
+
+static int begin_skip(model_stream *s, char c) {
+    if (c == '{' || c == '[') {
+        s->passive_depth = 1;
+        s->capturing = false;
+    }
+    return 0;
+}
+
+static int begin_typed(model_stream *s, const type_meta *meta, void *dest, char c) {
+    if (meta == get_model_string_meta() || meta == get_model_number_meta() || meta == get_model_bool_meta()) {
+        if (c == '{' || c == '[') return -1;
+        s->leaf_meta = meta;
+        s->leaf_dest = dest;
+        return 0;
+    }
+
+    if (meta->from_json) {
+        if (c == '{' || c == '[') {
+            // collect container text and convert with type's from_json
+            s->passive_depth = 1;
+            s->capturing = true;
+            s->cap_meta = meta;
+            s->cap_dest = dest;
+            s->cap.len = 0;
+            sbuf_add(&s->cap, c);
+        } else {
+            s->leaf_meta = meta;
+            s->leaf_dest = dest;
+        }
+        return 0;
+    }
+
+    if (c != '{') return -1;
+    push_frame(s, frame_model, meta, dest);
+    return 0;
+}
+
+static int begin_slot(model_stream *s, const type_meta *meta, enum _field_mod mod, void *addr, char c) {
+    switch (mod) {
+        case none_mod:
+            return begin_typed(s, meta, addr, c);
+        case ptr_mod: {
+            void **p = addr;
+            if (*p == NULL) {
+                *p = calloc(1, meta->size);
+            }
+            return begin_typed(s, meta, *p, c);
+        }
+        case array_mod:
+            if (c != '[') return -1;
+            push_frame(s, frame_array, meta, addr);
+            return 0;
+        case list_mod:
+            if (c != '[') return -1;
+            push_frame(s, frame_list, meta, addr);
+            return 0;
+        case map_mod:
+            if (c != '{') return -1;
+            push_frame(s, frame_map, meta, addr);
+            return 0;
+    }
+    return -1;
+}
+
+static int begin_element(model_stream *s, struct frame *f, char c) {
+    const type_meta *meta = f->meta;
+    void *dest;
+    if (is_inline(f->type, meta)) {
+        f->commit = true;
+        f->tmp = NULL;
+        dest = &f->tmp;
+    } else {
+        dest = calloc(1, meta->size);
+        add_element(f, dest, false);
+    }
+    return begin_typed(s, meta, dest, c);
+}
+
+static int begin_value(model_stream *s, char c) {
+    if (s->passive_depth > 0) {
+        if (c == '{' || c == '[') s->passive_depth++;
+        return 0;
+    }
+
+    s->leaf_meta = NULL;
+    s->leaf_dest = NULL;
+
+    struct frame *f = top_frame(s);
+    if (f == NULL) {
+        const struct binding *root = find_binding(s, NULL);
+        if (root) {
+            return begin_slot(s, root->meta, root->mod, root->target, c);
+        }
+        if (s->binding_count == 0) {
+            return begin_skip(s, c);
+        }
+        if (c != '{') return -1;
+        push_frame(s, frame_bind, NULL, NULL);
+        return 0;
+    }
+
+    switch (f->type) {
+        case frame_bind:
+            // null values are skipped like in model_from_json
+            if (f->bind == NULL || c == 'n') return begin_skip(s, c);
+            return begin_slot(s, f->bind->meta, f->bind->mod, f->bind->target, c);
+        case frame_model:
+            if (f->field == NULL || c == 'n') return begin_skip(s, c);
+            return begin_slot(s, f->field->meta(), f->field->mod, (char *) f->target + f->field->offset, c);
+        default:
+            return begin_element(s, f, c);
+    }
+}
+
+static int on_key(model_stream *s) {
+    if (s->passive_depth > 0) return 0;
+
+    struct frame *f = top_frame(s);
+    const char *key = sbuf_str(&s->tok);
+    switch (f->type) {
+        case frame_bind:
+            f->bind = find_binding(s, key);
+            break;
+        case frame_model:
+            f->field = find_field(f->meta, key, s->tok.len);
+            break;
+        case frame_map:
+            free(f->key);
+            f->key = calloc(1, s->tok.len + 1);
+            memcpy(f->key, key, s->tok.len);
+            break;
+        default:
+            return MODEL_PARSE_INVALID;
+    }
+    return 0;
+}
+
+static int value_done(model_stream *s) {
+    struct frame *f = top_frame(s);
+    if (f == NULL) return 0;
+
+    if (f->commit) {
+        add_element(f, f->tmp, true);
+        f->commit = false;
+        f->tmp = NULL;
+    }
+    f->field = NULL;
+    f->bind = NULL;
+    FREE(f->key);
+    return 0;
+}
+
+static int store_leaf(model_stream *s, const type_meta *meta, void *dest, enum token t) {
+    if (meta == get_model_string_meta()) {
+        if (t != tok_string) return -1;
+        char *v = malloc(s->tok.len + 1);
+        memcpy(v, s->tok.b, s->tok.len);
+        v[s->tok.len] = 0;
+        *(char **) dest = v;
+    } else if (meta == get_model_number_meta()) {
+        if (t != tok_number || !s->num_int) return -1;
+        *(model_number *) dest = (model_number) strtoll(sbuf_str(&s->tok), NULL, 10);
+    } else if (meta == get_model_bool_meta()) {
+        if (t != tok_true && t != tok_false) return -1;
+        *(bool *) dest = t == tok_true;
+    } else {
+        json_object *j = NULL;
+        switch (t) {
+            case tok_string:
+                j = json_object_new_string_len(s->tok.b, (int) s->tok.len);
+                break;
+            case tok_number:
+                j = json_tokener_parse(sbuf_str(&s->tok));
+                break;
+            case tok_true:
+            case tok_false:
+                j = json_object_new_boolean(t == tok_true);
+                break;
+            case tok_null:
+                break;
+        }
+        int rc = meta->from_json ? meta->from_json(dest, j, meta) : -1;
+        json_object_put(j);
+        if (rc < 0) return -1;
+    }
+    return 0;
+}
+
+static int end_scalar(model_stream *s, enum token t) {
+    // part of skipped or captured container
+    if (s->passive_depth > 0) return 0;
+
+    const type_meta *meta = s->leaf_meta;
+    s->leaf_meta = NULL;
+    if (meta) {
+        int rc = store_leaf(s, meta, s->leaf_dest, t);
+        if (rc != 0) return rc;
+    }
+    return value_done(s);
+}
+
+static int end_container(model_stream *s) {
+    if (s->passive_depth > 0) {
+        if (--s->passive_depth > 0) return 0;
+
+        if (s->capturing) {
+            s->capturing = false;
+            json_object *j = json_tokener_parse(sbuf_str(&s->cap));
+            int rc = s->cap_meta->from_json(s->cap_dest, j, s->cap_meta);
+            json_object_put(j);
+            if (j == NULL || rc < 0) return -1;
+        }
+        return value_done(s);
+    }
+
+    struct frame *f = top_frame(s);
+    free(f->key);
+    s->frame_count--;
+    return value_done(s);
+}
+
+static void after_value(model_stream *s) {
+    s->state = s->nest.len == 0 ? lex_done : lex_next;
+}
+
+static int close_container(model_stream *s, char c) {
+    if (s->nest.len == 0 || s->nest.b[s->nest.len - 1] != (c == '}' ? '{' : '[')) {
+        return MODEL_PARSE_INVALID;
+    }
+    s->nest.len--;
+    int rc = end_container(s);
+    after_value(s);
+    return rc;
+}
+
+static int start_value(model_stream *s, char c) {
+    enum lex_state next;
+    switch (c) {
+        case '{': next = lex_key_or_end; break;
+        case '[': next = lex_value_or_end; break;
+        case '"': next = lex_string; break;
+        case 't': s->literal = "true"; next = lex_literal; break;
+        case 'f': s->literal = "false"; next = lex_literal; break;
+        case 'n': s->literal = "null"; next = lex_literal; break;
+        default:
+            if (c != '-' && !is_digit(c)) return MODEL_PARSE_INVALID;
+            next = lex_number;
+    }
+
+    int rc = begin_value(s, c);
+    if (rc != 0) return rc;
+
+    s->tok.len = 0;
+    s->state = next;
+    switch (next) {
+        case lex_key_or_end:
+        case lex_value_or_end:
+            sbuf_add(&s->nest, c);
+            break;
+        case lex_string:
+            s->str_key = false;
+            break;
+        case lex_literal:
+            s->lit_pos = 1;
+            break;
+        case lex_number:
+            sbuf_add(&s->tok, c);
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+static void str_add(model_stream *s, char c) {
+    if (s->passive_depth == 0) {
+        sbuf_add(&s->tok, c);
+    }
+}
+
+static void str_add_cp(model_stream *s, unsigned int cp) {
+    if (cp < 0x80) {
+        str_add(s, (char) cp);
+    } else if (cp < 0x800) {
+        str_add(s, (char) (0xC0 | (cp >> 6)));
+        str_add(s, (char) (0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        str_add(s, (char) (0xE0 | (cp >> 12)));
+        str_add(s, (char) (0x80 | ((cp >> 6) & 0x3F)));
+        str_add(s, (char) (0x80 | (cp & 0x3F)));
+    } else {
+        str_add(s, (char) (0xF0 | (cp >> 18)));
+        str_add(s, (char) (0x80 | ((cp >> 12) & 0x3F)));
+        str_add(s, (char) (0x80 | ((cp >> 6) & 0x3F)));
+        str_add(s, (char) (0x80 | (cp & 0x3F)));
+    }
+}
+
+// unpaired high surrogate
+static void flush_surrogate(model_stream *s) {
+    if (s->u_high) {
+        s->u_high = 0;
+        str_add_cp(s, 0xFFFD);
+    }
+}
+
+static void add_escaped_cp(model_stream *s) {
+    unsigned int cp = s->u_val;
+    if (cp >= 0xD800 && cp <= 0xDBFF) {
+        flush_surrogate(s);
+        s->u_high = cp;
+        return;
+    }
+
+    if (cp >= 0xDC00 && cp <= 0xDFFF) {
+        if (s->u_high == 0) {
+            cp = 0xFFFD;
+        } else {
+            cp = 0x10000 + ((s->u_high - 0xD800) << 10) + (cp - 0xDC00);
+            s->u_high = 0;
+        }
+    } else {
+        flush_surrogate(s);
+    }
+    str_add_cp(s, cp);
+}
+
+static int hex_value(char c) {
+    if (is_digit(c)) return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static int lex(model_stream *s, const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+        int rc = 0;
+
+        again:
+        // character that terminates a number is processed after the number is complete
+        if (s->capturing && !(s->state == lex_number && !is_num_char(c))) {
+            sbuf_add(&s->cap, c);
+        }
+
+        switch (s->state) {
+            case lex_value_or_end:
+                if (c == ']') {
+                    rc = close_container(s, c);
+                    break;
+                }
+                // fallthrough
+            case lex_value:
+                if (is_ws(c)) break;
+                rc = start_value(s, c);
+                break;
+
+            case lex_key_or_end:
+                if (c == '}') {
+                    rc = close_container(s, c);
+                    break;
+                }
+                if (is_ws(c)) break;
+                if (c != '"') return MODEL_PARSE_INVALID;
+                s->str_key = true;
+                s->tok.len = 0;
+                s->state = lex_string;
+                break;
+
+            case lex_colon:
+                if (is_ws(c)) break;
+                if (c != ':') return MODEL_PARSE_INVALID;
+                s->state = lex_value;
+                break;
+
+            case lex_next:
+                if (is_ws(c)) break;
+                if (c == ',') {
+                    // trailing comma is accepted, same as json-c
+                    s->state = s->nest.b[s->nest.len - 1] == '[' ? lex_value_or_end : lex_key_or_end;
+                } else if (c == '}' || c == ']') {
+                    rc = close_container(s, c);
+                } else {
+                    return MODEL_PARSE_INVALID;
+                }
+                break;
+
+            case lex_string:
+                if (c == '\\') {
+                    s->state = lex_string_esc;
+                    break;
+                }
+                flush_surrogate(s);
+                if (c == '"') {
+                    if (s->str_key) {
+                        rc = on_key(s);
+                        s->state = lex_colon;
+                    } else {
+                        rc = end_scalar(s, tok_string);
+                        after_value(s);
+                    }
+                } else {
+                    str_add(s, c);
+                }
+                break;
+
+            case lex_string_esc:
+                s->state = lex_string;
+                if (c == 'u') {
+                    s->u_val = 0;
+                    s->u_digits = 0;
+                    s->state = lex_string_u;
+                    break;
+                }
+                flush_surrogate(s);
+                switch (c) {
+                    case '"':
+                    case '\\':
+                    case '/': str_add(s, c); break;
+                    case 'b': str_add(s, '\b'); break;
+                    case 'f': str_add(s, '\f'); break;
+                    case 'n': str_add(s, '\n'); break;
+                    case 'r': str_add(s, '\r'); break;
+                    case 't': str_add(s, '\t'); break;
+                    default:
+                        return MODEL_PARSE_INVALID;
+                }
+                break;
+
+            case lex_string_u: {
+                int h = hex_value(c);
+                if (h < 0) return MODEL_PARSE_INVALID;
+                s->u_val = (s->u_val << 4) | (unsigned int) h;
+                if (++s->u_digits == 4) {
+                    add_escaped_cp(s);
+                    s->state = lex_string;
+                }
+                break;
+            }
+
+            case lex_number:
+                if (is_num_char(c)) {
+                    sbuf_add(&s->tok, c);
+                    break;
+                }
+                if (!valid_number(sbuf_str(&s->tok), &s->num_int)) return MODEL_PARSE_INVALID;
+                rc = end_scalar(s, tok_number);
+                if (rc != 0) return rc;
+                after_value(s);
+                if (s->state == lex_done) return (int) i;
+                goto again;
+
+            case lex_literal:
+                if (c != s->literal[s->lit_pos]) return MODEL_PARSE_INVALID;
+                if (s->literal[++s->lit_pos] == 0) {
+                    rc = end_scalar(s, s->literal[0] == 't' ? tok_true : s->literal[0] == 'f' ? tok_false : tok_null);
+                    after_value(s);
+                }
+                break;
+
+            case lex_done:
+                return (int) i;
+        }
+
+        if (rc != 0) return rc;
+        if (s->state == lex_done) return (int) (i + 1);
+    }
+    return MODEL_PARSE_PARTIAL;
+}
+
+model_stream *new_model_stream(void) {
+    model_stream *s = calloc(1, sizeof(*s));
+    s->state = lex_value;
+    s->status = MODEL_PARSE_PARTIAL;
+    return s;
+}
+
+void delete_model_stream(model_stream *s) {
+    if (s == NULL) return;
+
+    for (size_t i = 0; i < s->frame_count; i++) {
+        free(s->frames[i].key);
+    }
+    free(s->frames);
+    free(s->nest.b);
+    free(s->tok.b);
+    free(s->cap.b);
+    free(s);
+}
+
+int model_stream_bind(model_stream *s, const char *key, void *target, const type_meta *meta, enum _field_mod mod) {
+    if (s->binding_count == MAX_BINDINGS || s->state != lex_value || s->frame_count > 0) {
+        return -1;
+    }
+
+    s->bindings[s->binding_count++] = (struct binding) {
+            .key = key,
+            .target = target,
+            .meta = meta,
+            .mod = mod,
+    };
+    return 0;
+}
+
+int model_stream_feed(model_stream *s, const char *data, size_t len) {
+    if (s->status != MODEL_PARSE_PARTIAL) {
+        return s->status;
+    }
+
+    int rc = lex(s, data, len);
+    if (rc >= 0) {
+        s->status = 0;
+    } else if (rc != MODEL_PARSE_PARTIAL) {
+        s->status = rc;
+    }
+    return rc;
+}
+
+int model_stream_status(const model_stream *s) {
+    return s->status;
+}
@@ -19,8 +19,13 @@
 
 #include <ziti/model_support.h>
 #include <buffer.h>
+#include <internal_model.h>
 #include <utils.h>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
 #if _WIN32
 #include <time.h>
 #define timegm(v) _mkgmtime(v)
@@ -234,6 +239,10 @@ char *model_to_json(const void *obj, const type_meta *meta, int flags, size_t *l
     return result;
 }
 
+int model_fmt_to_json(string_buf_t *buf, const void *obj, const type_meta *meta, int flags, int indent) {
+    return write_model_to_buf(obj, meta, buf, indent, flags);
+}
+
 ssize_t model_to_json_r(const void *obj, const type_meta *meta, int flags, char *outbuf, size_t max) {
     if (obj == NULL) {
         return 0;
@@ -251,7 +260,7 @@ ssize_t model_to_json_r(const void *obj, const type_meta *meta, int flags, char
 
 
 #define PRETTY_INDENT(b, ind)  do { \
-for (int j = 0; (flags & MODEL_JSON_COMPACT) == 0 && j <= (ind); j++) BUF_APPEND_B(b, '\t'); \
+if ((flags & MODEL_JSON_COMPACT) == 0) CHECK_APPEND(append_indent(b, (ind) + 1)); \
 } while(0)
 
 #define PRETTY_NL(b) do { \
@@ -264,6 +273,16 @@ if ((flags & MODEL_JSON_COMPACT) == 0) BUF_APPEND_B(b, '\n'); \
 
 #define CHECK_APPEND(op) do { int res = (op); if (res != 0) return res; } while(0)
 
+static int append_indent(string_buf_t *b, int count) {
+    static const char tabs[] = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+    while (count > 0) {
+        int n = MIN(count, (int) sizeof(tabs) - 1);
+        CHECK_APPEND(string_buf_appendn(b, tabs, n));
+        count -= n;
+    }
+    return 0;
+}
+
 int model_list_fmt_to_json(string_buf_t *buf, model_list *l, const type_meta *meta, int flags, int indent) {
     int idx = 0;
     const void *f_ptr;
@@ -293,45 +312,80 @@ int model_list_fmt_to_json(string_buf_t *buf, model_list *l, const type_meta *me
     return 0;
 }
 
-int write_model_to_buf(const void *obj, const type_meta *meta, string_buf_t *buf, int indent, int flags) {
+int model_write_field(void *b, const char *key, size_t key_len, const void *field,
+                      const type_meta *ftm, enum _field_mod mod, int *count, int indent, int flags) {
+    string_buf_t *buf = b;
+    void **f_addr = (void **) field;
+    void *f_ptr = mod == none_mod ? f_addr : (void *) (*f_addr);
 
-    if (meta->jsonifier) {
-        return meta->jsonifier(obj, buf, indent, flags);
+    if (ftm == get_model_string_meta() || ftm == get_json_meta()) {
+        f_ptr = (void *) (*f_addr);
     }
 
-    BUF_APPEND_S(buf, "{");
-    bool comma = false;
-    for (int i = 0; i < meta->field_count; i++) {
-        field_meta *fm = meta->fields + i;
+    if (f_ptr == NULL) {
+        return 0;
+    }
 
-        if (fm->path == NULL || fm->path[0] == 0) {
-            continue;
-        }
-        const type_meta *ftm = fm->meta();
+    if ((*count)++ > 0) {
+        BUF_APPEND_B(buf, ',');
+    }
+    PRETTY_NL(buf);
 
-        void **f_addr = (void **) ((char *) obj + fm->offset);
-        void *f_ptr = fm->mod == none_mod ? f_addr : (void *) (*f_addr);
+    PRETTY_INDENT(buf, indent);
 
-        if (ftm == get_model_string_meta() || ftm == get_json_meta()) {
-            f_ptr = (void *) (*f_addr);
-        }
+    CHECK_APPEND(string_buf_appendn(buf, key, key_len));
 
-        if (f_ptr == NULL) {
-            continue;
+    if (mod == none_mod || mod == ptr_mod) {
+        if (ftm->jsonifier) {
+            CHECK_APPEND(ftm->jsonifier(f_ptr, buf, indent + 1, flags));
         }
+        else {
+            CHECK_APPEND(write_model_to_buf(f_ptr, ftm, buf, indent + 1, flags));
+        }
+    }
+    else if (mod == map_mod) {
+        indent++;
+        model_map *map = (model_map *) f_addr;
+        const char *k;
+        void *v;
+        BUF_APPEND_B(buf, '{');
+        bool need_comma = false;
+        MODEL_MAP_FOREACH(k, v, map) {
+            if (need_comma) {
+                BUF_APPEND_B(buf, ',');
+            }
+            PRETTY_NL(buf);
+            PRETTY_INDENT(buf, indent);
 
-        if (comma) {
-            BUF_APPEND_S(buf, ",");
+            BUF_APPEND_B(buf, '\"');
+            BUF_APPEND_S(buf, k);
+            BUF_APPEND_S(buf, "\":");
+            if (ftm->jsonifier) {
+                CHECK_APPEND(ftm->jsonifier(v, buf, indent + 1, flags));
+            } else {
+                CHECK_APPEND(write_model_to_buf(v, ftm, buf, indent + 1, flags));
+            }
+            need_comma = true;
         }
+        BUF_APPEND_B(buf, '}');
+        indent--;
+    } else if (mod == list_mod) {
+        model_list *list = (model_list *) (f_addr);
+        CHECK_APPEND(model_list_fmt_to_json(buf, list, ftm, flags, indent));
+    } else if (mod == array_mod) {
+        void **arr = (void **) (*f_addr);
+
+        BUF_APPEND_B(buf, '[');
         PRETTY_NL(buf);
+        for (int idx = 0; true; idx++) {
+            f_ptr = arr[idx];
+            if (f_ptr == NULL) { break; }
+            if (idx > 0) {
+                BUF_APPEND_B(buf, ',');
+                PRETTY_NL(buf);
+            }
 
-        PRETTY_INDENT(buf, indent);
-
-        BUF_APPEND_B(buf, '\"');
-        BUF_APPEND_S(buf, fm->path);
-        BUF_APPEND_S(buf, "\":");
-
-        if (fm->mod == none_mod || fm->mod == ptr_mod) {
+            PRETTY_INDENT(buf, indent + 1);
             if (ftm->jsonifier) {
                 CHECK_APPEND(ftm->jsonifier(f_ptr, buf, indent + 1, flags));
             }
@@ -339,64 +393,46 @@ int write_model_to_buf(const void *obj, const type_meta *meta, string_buf_t *buf
                 CHECK_APPEND(write_model_to_buf(f_ptr, ftm, buf, indent + 1, flags));
             }
         }
-        else if (fm->mod == map_mod) {
-            indent++;
-            model_map *map = (model_map *) f_addr;
-            const char *k;
-            void *v;
-            BUF_APPEND_B(buf, '{');
-            bool need_comma = false;
-            MODEL_MAP_FOREACH(k, v, map) {
-                if (need_comma) {
-                    BUF_APPEND_B(buf, ',');
-                }
-                PRETTY_NL(buf);
-                PRETTY_INDENT(buf, indent);
-
-                BUF_APPEND_B(buf, '\"');
-                BUF_APPEND_S(buf, k);
-                BUF_APPEND_S(buf, "\":");
-                if (ftm->jsonifier) {
-                    CHECK_APPEND(ftm->jsonifier(v, buf, indent + 1, flags));
-                } else {
-                    CHECK_APPEND(write_model_to_buf(v, ftm, buf, indent + 1, flags));
-                }
-                need_comma = true;
-            }
-            BUF_APPEND_B(buf, '}');
-            indent--;
-        } else if (fm->mod == list_mod) {
-            model_list *list = (model_list *) (f_addr);
-            CHECK_APPEND(model_list_fmt_to_json(buf, list, ftm, flags, indent));
-        } else if (fm->mod == array_mod) {
-            void **arr = (void **) (*f_addr);
+        PRETTY_NL(buf);
+        PRETTY_INDENT(buf, indent);
+        BUF_APPEND_B(buf, ']');
+    } else {
+        ZITI_LOG(ERROR, "unsupported mod[%d] for field[%.*s]", mod, (int) key_len, key);
+        return -1;
+    }
+    return 0;
+}
 
-            BUF_APPEND_B(buf, '[');
-            PRETTY_NL(buf);
-            for (int idx = 0; true; idx++) {
-                f_ptr = arr[idx];
-                if (f_ptr == NULL) { break; }
-                if (idx > 0) {
-                    BUF_APPEND_B(buf, ',');
-                    PRETTY_NL(buf);
-                }
+int write_model_to_buf(const void *obj, const type_meta *meta, string_buf_t *buf, int indent, int flags) {
 
-                PRETTY_INDENT(buf, indent + 1);
-                if (ftm->jsonifier) {
-                    CHECK_APPEND(ftm->jsonifier(f_ptr, buf, indent + 1, flags));
-                }
-                else {
-                    CHECK_APPEND(write_model_to_buf(f_ptr, ftm, buf, indent + 1, flags));
-                }
+    if (meta->jsonifier) {
+        return meta->jsonifier(obj, buf, indent, flags);
+    }
+
+    BUF_APPEND_S(buf, "{");
+    if (meta->fields_writer) {
+        CHECK_APPEND(meta->fields_writer(obj, buf, indent, flags));
+    } else {
+        int count = 0;
+        char key_buf[128];
+        for (int i = 0; i < meta->field_count; i++) {
+            field_meta *fm = meta->fields + i;
+
+            if (fm->path == NULL || fm->path[0] == 0) {
+                continue;
             }
-            PRETTY_NL(buf);
-            PRETTY_INDENT(buf, indent);
-            BUF_APPEND_B(buf, ']');
-        } else {
-            ZITI_LOG(ERROR, "unsupported mod[%d] for field[%s]", fm->mod, fm->name);
-            return -1;
+
+            // quoted path and colon, long paths go on the heap
+            size_t key_len = strlen(fm->path) + 3;
+            char *key = key_len < sizeof(key_buf) ? key_buf : malloc(key_len + 1);
+            snprintf(key, key_len + 1, "\"%s\":", fm->path);
+            int rc = model_write_field(buf, key, key_len, (char *) obj + fm->offset,
+                                       fm->meta(), fm->mod, &count, indent, flags);
+            if (key != key_buf) {
+                free(key);
+            }
+            CHECK_APPEND(rc);
         }
-        comma = true;
     }
     PRETTY_NL(buf);
     PRETTY_INDENT(buf, indent - 1);
@@ -620,6 +656,35 @@ static int parse_map_from_json(void *mapp, json_object *json, type_meta *el_meta
     return 0;
 }
 
+static int field_from_json(void *obj, const field_meta *fm, json_object *child) {
+    void *field = (char *) obj + fm->offset;
+    void *ch_obj = field;
+    const type_meta *ch_meta = fm->meta();
+    from_json_func parser = ch_meta->from_json;
+    if (parser == NULL) {
+        parser = model_from_json;
+    }
+
+    switch (fm->mod) {
+        case none_mod:
+            break;
+        case ptr_mod:
+            ch_obj = calloc(1, ch_meta->size);
+            *(char**)field = ch_obj;
+            break;
+        case array_mod:
+            parser = (from_json_func) model_array_from_json;
+            break;
+        case map_mod:
+            parser = (from_json_func) parse_map_from_json;
+            break;
+        case list_mod:
+            parser = (from_json_func) model_list_from_json;
+            break;
+    }
+    return parser(ch_obj, child, ch_meta);
+}
+
 int model_from_json(void *obj, json_object *json, const type_meta *meta) {
     int rc = 0;
     memset(obj, 0, meta->size);
@@ -633,6 +698,24 @@ int model_from_json(void *obj, json_object *json, const type_meta *meta) {
         goto done;
     }
 
+    if (meta->field_lookup) {
+        // visit only fields present in JSON
+        json_object_object_foreach(json, key, child) {
+            if (child == NULL || json_object_get_type(child) == json_type_null)
+                continue;
+
+            const field_meta *fm = meta->field_lookup(key, strlen(key));
+            if (fm == NULL)
+                continue;
+
+            rc = field_from_json(obj, fm, child);
+            if (rc != 0) {
+                break;
+            }
+        }
+        goto done;
+    }
+
     for (int fi = 0; fi < meta->field_count; fi++) {
         // field is not mapped to JSON
         const field_meta *fm = &meta->fields[fi];
@@ -643,32 +726,7 @@ int model_from_json(void *obj, json_object *json, const type_meta *meta) {
         if (child == NULL || json_object_get_type(child) == json_type_null)
             continue;
 
-        void *field = (char *) obj + fm->offset;
-        void *ch_obj = field;
-        const type_meta *ch_meta = fm->meta();
-        from_json_func parser = ch_meta->from_json;
-        if (parser == NULL) {
-            parser = model_from_json;
-        }
-        
-        switch (fm->mod) {
-            case none_mod:
-                break;
-            case ptr_mod:
-                ch_obj = calloc(1, ch_meta->size);
-                *(char**)field = ch_obj;
-                break;
-            case array_mod:
-                parser = (from_json_func) model_array_from_json;
-                break;
-            case map_mod:
-                parser = (from_json_func) parse_map_from_json;
-                break;
-            case list_mod:
-                parser = (from_json_func) model_list_from_json;
-                break;
-        }
-        rc = parser(ch_obj, child, ch_meta);
+        rc = field_from_json(obj, fm, child);
         if (rc != 0) {
             break;
         }
@@ -837,52 +895,94 @@ static int m_bool_to_json(const bool *v, string_buf_t *buf, int UNUSED(indent),
 }
 
 static int m_int_to_json(const model_number *v, string_buf_t *buf, int UNUSED(indent), int UNUSED(flags)) {
+    // digits of INT64_MIN and sign
+    char *out = string_buf_reserve(buf, 20);
+    if (out == NULL) return -1;
+
+    char digits[20];
+    int n = 0;
+    uint64_t u = *v < 0 ? (uint64_t) 0 - (uint64_t) *v : (uint64_t) *v;
+    do {
+        digits[n++] = (char) ('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+
+    size_t len = 0;
+    if (*v < 0) out[len++] = '-';
+    while (n > 0) out[len++] = digits[--n];
+    string_buf_commit(buf, len);
+    return 0;
+}
 
-    char b[16];
-    int rc = snprintf(b, sizeof(b), "%" PRId64, *v);
-    if (rc > 0) {
-        return string_buf_append(buf, b);
+#define JSON_ESCAPED(c) ((unsigned char)(c) < ' ' || (c) == '"' || (c) == '\\')
+
+// find first character in [s, end) that needs to be escaped in JSON string
+static const char *json_plain_run(const char *s, const char *end) {
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128i ctl = _mm_set1_epi8(0x1f);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    while (end - s >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) s);
+        // unsigned v <= 0x1f
+        __m128i m = _mm_cmpeq_epi8(_mm_min_epu8(v, ctl), v);
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, quote));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, bslash));
+        if (_mm_movemask_epi8(m) != 0) break;
+        s += 16;
     }
-    return rc;
+#else
+#define SWAR_ONES (~(uint64_t)0 / 0xff)
+#define SWAR_HIGH (SWAR_ONES * 0x80)
+#define SWAR_HAS_LESS(x, n) (((x) - SWAR_ONES * (n)) & ~(x) & SWAR_HIGH)
+    while (end - s >= 8) {
+        uint64_t v;
+        memcpy(&v, s, sizeof(v));
+        if (SWAR_HAS_LESS(v, ' ') ||
+            SWAR_HAS_LESS(v ^ (SWAR_ONES * '"'), 1) ||
+            SWAR_HAS_LESS(v ^ (SWAR_ONES * '\\'), 1)) break;
+        s += 8;
+    }
+#endif
+    while (s < end && !JSON_ESCAPED(*s)) s++;
+    return s;
 }
 
 static int m_string_to_json(const char *str, string_buf_t *buf, int UNUSED(indent), int UNUSED(flags)) {
     static char hex[] = "0123456789abcdef";
 
     BUF_APPEND_B(buf, '\"');
-    const unsigned char *s = (const unsigned char *) str;
-
-    while (*s != '\0') {
-        switch (*s) {
-            case '\n':
-                BUF_APPEND_S(buf, "\\n");
-                break;
-            case '\b':
-                BUF_APPEND_S(buf, "\\b");
-                break;
-            case '\r':
-                BUF_APPEND_S(buf, "\\r");
-                break;
-            case '\t':
-                BUF_APPEND_S(buf, "\\t");
-                break;
-            case '\\':
-                BUF_APPEND_S(buf, "\\\\");
-                break;
-            case '"':
-                BUF_APPEND_S(buf, "\\\"");
-                break;
+    const char *s = str;
+    const char *end = str + strlen(str);
+
+    while (s < end) {
+        const char *run = s;
+        s = json_plain_run(s, end);
+        if (s > run) {
+            CHECK_APPEND(string_buf_appendn(buf, run, s - run));
+        }
+        if (s == end) break;
+
+        char *out = string_buf_reserve(buf, 6);
+        if (out == NULL) return -1;
+
+        unsigned char c = (unsigned char) *s++;
+        out[0] = '\\';
+        size_t len = 2;
+        switch (c) {
+            case '\n': out[1] = 'n'; break;
+            case '\b': out[1] = 'b'; break;
+            case '\r': out[1] = 'r'; break;
+            case '\t': out[1] = 't'; break;
+            case '\\': out[1] = '\\'; break;
+            case '"': out[1] = '"'; break;
             default:
-                if (*s < ' ') {
-                    BUF_APPEND_B(buf, '\\');
-                    BUF_APPEND_S(buf, "u00");
-                    BUF_APPEND_B(buf, hex[*s >> 4]);
-                    BUF_APPEND_B(buf, hex[*s & 0xF]);
-                } else {
-                    BUF_APPEND_B(buf, *s);
-                }
+                memcpy(out + 1, "u00", 3);
+                out[4] = hex[c >> 4];
+                out[5] = hex[c & 0xF];
+                len = 6;
         }
-        s++;
+        string_buf_commit(buf, len);
     }
     BUF_APPEND_B(buf, '"');
     return 0;
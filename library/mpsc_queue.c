@@ -0,0 +1,178 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mpsc_queue.h"
+#include "utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NODE_PTR(p) ((mpsc_node_t*)(p))
+
+void mpsc_queue_init(mpsc_queue_t *q) {
+    atomic_init(&q->stub.next, (uintptr_t)0);
+    atomic_init(&q->head, (uintptr_t)&q->stub);
+    atomic_init(&q->signaled, false);
+    q->tail = &q->stub;
+}
+
+static inline void link_node(mpsc_queue_t *q, mpsc_node_t *n) {
+    atomic_store_explicit(&n->next, (uintptr_t)0, memory_order_relaxed);
+    mpsc_node_t *prev = NODE_PTR(atomic_exchange_explicit(&q->head, (uintptr_t)n, memory_order_acq_rel));
+    // between the exchange and this store the queue is briefly disconnected,
+    // consumer treats it as empty and relies on this producer to signal
+    atomic_store_explicit(&prev->next, (uintptr_t)n, memory_order_release);
+}
+
+bool mpsc_queue_push(mpsc_queue_t *q, mpsc_node_t *n) {
+    link_node(q, n);
+
+    // pairs with the fence in mpsc_queue_rearm(): either consumer sees the node after rearming
+    // or this producer sees the queue rearmed and signals
+    atomic_thread_fence(memory_order_seq_cst);
+
+    // cheap check first to avoid bouncing the cache line on every push
+    if (atomic_load_explicit(&q->signaled, memory_order_acquire)) {
+        return false;
+    }
+    return !atomic_exchange(&q->signaled, true);
+}
+
+void mpsc_queue_rearm(mpsc_queue_t *q) {
+    atomic_store_explicit(&q->signaled, false, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+mpsc_node_t *mpsc_queue_pop(mpsc_queue_t *q) {
+    mpsc_node_t *tail = q->tail;
+    mpsc_node_t *next = NODE_PTR(atomic_load_explicit(&tail->next, memory_order_acquire));
+
+    if (tail == &q->stub) {
+        if (next == NULL) {
+            return NULL;
+        }
+        q->tail = next;
+        tail = next;
+        next = NODE_PTR(atomic_load_explicit(&next->next, memory_order_acquire));
+    }
+
+    if (next) {
+        q->tail = next;
+        return tail;
+    }
+
+    mpsc_node_t *head = NODE_PTR(atomic_load_explicit(&q->head, memory_order_acquire));
+    if (tail != head) {
+        // producer is mid-push
+        return NULL;
+    }
+
+    // tail is the last node, put stub behind it so that it can be handed out
+    link_node(q, &q->stub);
+
+    next = NODE_PTR(atomic_load_explicit(&tail->next, memory_order_acquire));
+    if (next) {
+        q->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+/*
+ * Treiber stack of slab indices. Top of the stack is tagged with a generation counter
+ * to protect against ABA when an object is popped and pushed back while another thread is
+ * in the middle of a pop.
+ */
+#define IDX_NONE UINT32_MAX
+#define TOP(tag, idx) (((uint64_t)(tag) << 32) | (uint32_t)(idx))
+#define TOP_IDX(t) ((uint32_t)((t) & 0xffffffffu))
+#define TOP_TAG(t) ((uint32_t)((t) >> 32))
+
+struct lf_pool_s {
+    size_t objsize;
+    uint32_t count;
+    _Atomic(uint64_t) top;
+    _Atomic(uint32_t) *next;
+    char *slab;
+};
+
+lf_pool_t *lf_pool_new(size_t objsize, uint32_t count) {
+    if (count == 0 || count == IDX_NONE) return NULL;
+
+    NEWP(pool, lf_pool_t);
+    // keep slab objects aligned the same way malloc() would
+    pool->objsize = (objsize + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+    pool->count = count;
+    pool->slab = calloc(count, pool->objsize);
+    pool->next = calloc(count, sizeof(*pool->next));
+    if (pool->slab == NULL || pool->next == NULL) {
+        free(pool->slab);
+        free((void*)pool->next);
+        free(pool);
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        atomic_init(&pool->next[i], i + 1 < count ? i + 1 : IDX_NONE);
+    }
+    atomic_init(&pool->top, TOP(0, 0));
+    return pool;
+}
+
+void lf_pool_destroy(lf_pool_t *pool) {
+    if (pool == NULL) return;
+
+    free(pool->slab);
+    free((void*)pool->next);
+    free(pool);
+}
+
+static inline bool lf_pool_owns(lf_pool_t *pool, void *obj) {
+    char *p = obj;
+    return pool && p >= pool->slab && p < pool->slab + pool->objsize * pool->count;
+}
+
+void *lf_pool_alloc(lf_pool_t *pool) {
+    uint64_t top = atomic_load_explicit(&pool->top, memory_order_acquire);
+    for (;;) {
+        uint32_t idx = TOP_IDX(top);
+        if (idx == IDX_NONE) {
+            return calloc(1, pool->objsize);
+        }
+
+        uint32_t next = atomic_load_explicit(&pool->next[idx], memory_order_relaxed);
+        if (atomic_compare_exchange_weak_explicit(&pool->top, &top, TOP(TOP_TAG(top) + 1, next),
+                                                  memory_order_acq_rel, memory_order_acquire)) {
+            void *obj = pool->slab + (size_t)idx * pool->objsize;
+            memset(obj, 0, pool->objsize);
+            return obj;
+        }
+    }
+}
+
+void lf_pool_return(lf_pool_t *pool, void *obj) {
+    if (obj == NULL) return;
+
+    if (!lf_pool_owns(pool, obj)) {
+        free(obj);
+        return;
+    }
+
+    uint32_t idx = (uint32_t)(((char*)obj - pool->slab) / pool->objsize);
+    uint64_t top = atomic_load_explicit(&pool->top, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&pool->next[idx], TOP_IDX(top), memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->top, &top, TOP(TOP_TAG(top) + 1, idx),
+                                                    memory_order_release, memory_order_relaxed));
+}
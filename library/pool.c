@@ -138,6 +138,8 @@ void pool_return_obj(void *o) {
     }
 
     memset(o, 0, m->size);
+    // nothing could be allocated before this return
+    bool was_exhausted = LIST_EMPTY(&pool->pool) && pool->out == pool->capacity;
     pool->out--;
 
     if (pool->is_closed) {
@@ -146,9 +148,8 @@ void pool_return_obj(void *o) {
             free(pool);
         }
     } else {
-        bool was_empty = LIST_EMPTY(&pool->pool);
         LIST_INSERT_HEAD(&pool->pool, m, _next);
-        if (was_empty && pool->avail_cb) {
+        if (was_exhausted && pool->avail_cb) {
             pool->avail_cb(pool->avail_ctx);
         }
     }
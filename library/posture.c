@@ -181,7 +181,17 @@ static pr_info *get_resp_info(ziti_context ztx, const char *id) {
     return resp;
 }
 
+static void send_posture_from_shard(ziti_context ztx, void *data) {
+    ziti_send_posture_data(ztx);
+}
+
 void ziti_send_posture_data(ziti_context ztx) {
+    // posture checks are run by primary context
+    if (ztx->primary) {
+        ziti_queue_work(ztx->primary, send_posture_from_shard, NULL);
+        return;
+    }
+
     struct posture_checks *checks = ztx->posture_checks;
     if (!checks) {
         ZTX_LOG(DEBUG, "endpoint is disabled");
@@ -566,14 +576,6 @@ static void ziti_pr_send(ziti_context ztx) {
     ziti_pr_send_bulk(ztx);
 }
 
-static char* ziti_pr_to_json(const ziti_pr_base *pr) {
-    const type_meta *meta = get_pr_req_meta(pr->typeId);
-    size_t len;
-    char *json = model_to_json(pr, meta, MODEL_JSON_COMPACT, &len);
-    return json;
-}
-
-int model_list_fmt_to_json(string_buf_t *buf, model_list *l, const type_meta *meta, int flags, int indent);
 static void ziti_pr_send_bulk(ziti_context ztx) {
     struct posture_checks *checks = ztx->posture_checks;
     if (!checks) {
@@ -609,18 +611,37 @@ static void ziti_pr_send_bulk(ziti_context ztx) {
 }
 
 static void send_posture_legacy(ziti_context ztx, model_list *send_prs) {
-    model_list json_list = {};
+    string_buf_t buf;
+    string_buf_init(&buf);
+
+    // responses are written straight into the request body
     pr_info *info;
+    bool comma = false;
+    int rc = string_buf_append_byte(&buf, '[');
     MODEL_LIST_FOREACH(info, *send_prs) {
-        char *json = ziti_pr_to_json(info->obj);
-        model_list_append(&json_list, json);
-        info->should_send = false;
+        if (rc != 0) break;
+        if (comma) {
+            rc = string_buf_append_byte(&buf, ',');
+        }
+        if (rc == 0) {
+            rc = model_fmt_to_json(&buf, info->obj, get_pr_req_meta(info->obj->typeId), MODEL_JSON_COMPACT, 0);
+        }
+        comma = true;
+    }
+    if (rc == 0) {
+        rc = string_buf_append_byte(&buf, ']');
     }
 
-    string_buf_t buf;
-    string_buf_init(&buf);
-    model_list_fmt_to_json(&buf, &json_list, get_json_meta(), 0, 0);
-    model_list_clear(&json_list, free);
+    if (rc != 0) {
+        // responses stay pending and are sent on the next round
+        ZTX_LOG(ERROR, "failed to encode posture responses: %d", rc);
+        string_buf_free(&buf);
+        return;
+    }
+
+    MODEL_LIST_FOREACH(info, *send_prs) {
+        info->should_send = false;
+    }
 
     size_t body_len;
     char *body = string_buf_to_string(&buf, &body_len);
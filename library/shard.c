@@ -0,0 +1,454 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "zt_internal.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Shards are contexts that run on their own loops and share identity of the primary context.
+ * Primary context owns controller, authentication and service state, and pushes copies of it
+ * to shards with ziti_queue_work(). Shards own their edge router channels and connections,
+ * controller requests made by shards are forwarded to the primary loop.
+ */
+
+// snapshot of primary state, applied on shard loop
+struct shard_state {
+    bool enabled;
+    bool update_token;
+    ziti_auth_state auth_state;
+    char *session_token;
+    // TLS credentials as config references, shard builds its own TLS context from them
+    bool tls_update;
+    char *ca;
+    char *key;
+    char *cert;
+    ziti_identity_data *identity_data;
+};
+
+struct shard_services {
+    model_list updated;
+    model_list removed;
+};
+
+enum shard_ctrl_op {
+    shard_get_service,
+    shard_create_session,
+    shard_get_session,
+    shard_list_routers,
+};
+
+typedef void (*shard_ctrl_cb)(void *, const ziti_error *, void *);
+
+struct shard_ctrl_req {
+    ziti_context shard;
+    enum shard_ctrl_op op;
+    char *arg;
+    ziti_session_type type;
+
+    shard_ctrl_cb cb;
+    void *ctx;
+
+    void *resp;
+    ziti_error *err;
+};
+
+static void *model_copy(const void *obj, const type_meta *meta) {
+    if (obj == NULL) {
+        return NULL;
+    }
+
+    size_t len;
+    char *json = model_to_json(obj, meta, 0, &len);
+    void *copy = model_alloc(meta);
+    if (json == NULL || model_parse(copy, json, len, meta) < 0) {
+        model_free(copy, meta);
+        FREE(copy);
+    }
+    free(json);
+    return copy;
+}
+
+static void free_shard_state(struct shard_state *st) {
+    FREE(st->session_token);
+    FREE(st->ca);
+    FREE(st->key);
+    FREE(st->cert);
+    if (st->identity_data) {
+        free_ziti_identity_data_ptr(st->identity_data);
+    }
+    free(st);
+}
+
+static void shard_apply_tls(ziti_context ztx, struct shard_state *st) {
+    bool ca_changed = st->ca && (ztx->config.id.ca == NULL || strcmp(st->ca, ztx->config.id.ca) != 0);
+    if (ca_changed) {
+        FREE(ztx->config.id.ca);
+        ztx->config.id.ca = st->ca;
+        st->ca = NULL;
+    }
+    FREE(ztx->config.id.key);
+    ztx->config.id.key = st->key;
+    st->key = NULL;
+    FREE(ztx->config.id.cert);
+    ztx->config.id.cert = st->cert;
+    st->cert = NULL;
+
+    int rc;
+    if (ztx->tlsCtx == NULL) {
+        rc = load_tls(&ztx->config, &ztx->tlsCtx, &ztx->id_creds);
+    } else {
+        ziti_config upd = {
+                .id = {
+                        .ca = ca_changed ? ztx->config.id.ca : NULL,
+                        .key = ztx->config.id.key,
+                        .cert = ztx->config.id.cert,
+                },
+        };
+        rc = update_tls(&upd, ztx->tlsCtx, &ztx->id_creds);
+    }
+
+    if (rc != ZITI_OK) {
+        ZTX_LOG(ERROR, "failed to update TLS context: %s", ziti_errorstr(rc));
+    }
+}
+
+static void shard_apply_state(ziti_context ztx, void *data) {
+    struct shard_state *st = data;
+
+    if (!ztx->closing) {
+        if (st->tls_update) {
+            shard_apply_tls(ztx, st);
+        }
+
+        if (st->identity_data) {
+            free_ziti_identity_data(ztx->identity_data);
+            FREE(ztx->identity_data);
+            ztx->identity_data = st->identity_data;
+            st->identity_data = NULL;
+        }
+
+        bool token_changed = st->session_token &&
+                             (ztx->session_token == NULL || strcmp(ztx->session_token, st->session_token) != 0);
+        FREE(ztx->session_token);
+        ztx->session_token = st->session_token;
+        st->session_token = NULL;
+
+        if (st->auth_state != ZitiAuthStateFullyAuthenticated) {
+            model_map_clear(&ztx->sessions, (_free_f) free_ziti_session_ptr);
+        }
+        ztx->auth_state = st->auth_state;
+
+        if (token_changed && st->update_token) {
+            const char *url;
+            ziti_channel_t *ch;
+            MODEL_MAP_FOREACH(url, ch, &ztx->channels) {
+                ziti_channel_update_token(ch, ztx->session_token);
+            }
+        }
+
+        if (st->enabled != ztx->enabled) {
+            ziti_set_enabled(ztx, st->enabled);
+        }
+    }
+
+    free_shard_state(st);
+}
+
+static void shard_apply_services(ziti_context ztx, void *data) {
+    struct shard_services *upd = data;
+
+    char *name;
+    while ((name = model_list_pop(&upd->removed)) != NULL) {
+        if (!ztx->closing) {
+            ztx_drop_service(ztx, name);
+        }
+        free(name);
+    }
+
+    ziti_service *s;
+    while ((s = model_list_pop(&upd->updated)) != NULL) {
+        if (ztx->closing) {
+            free_ziti_service_ptr(s);
+        } else {
+            ztx_set_service(ztx, s);
+        }
+    }
+    free(upd);
+}
+
+static char *pem_ref(char *pem) {
+    if (pem == NULL) {
+        return NULL;
+    }
+    size_t len = strlen("pem:") + strlen(pem) + 1;
+    char *ref = malloc(len);
+    snprintf(ref, len, "pem:%s", pem);
+    free(pem);
+    return ref;
+}
+
+// runs on primary loop: TLS context of the primary is never shared with shards,
+// it is mutated when credentials or CA bundle are updated
+static void push_tls(ziti_context ztx, ziti_context shard, struct shard_state *st) {
+    if (ztx->tlsCtx == NULL || shard->tls_gen == ztx->tls_gen) {
+        return;
+    }
+    shard->tls_gen = ztx->tls_gen;
+    st->tls_update = true;
+    st->ca = ztx->config.id.ca ? strdup(ztx->config.id.ca) : NULL;
+
+    tlsuv_private_key_t key = ztx->id_creds.key;
+    tlsuv_certificate_t cert = ztx->id_creds.cert;
+    if (ztx->session_creds.cert) {
+        key = ztx->session_creds.key ? ztx->session_creds.key : ztx->id_creds.key;
+        cert = ztx->session_creds.cert;
+    }
+
+    char *pem = NULL;
+    size_t len;
+    if (key && key->to_pem && key->to_pem(key, &pem, &len) == 0) {
+        st->key = pem_ref(pem);
+    } else if (key == ztx->id_creds.key && ztx->config.id.key) {
+        // key is not exportable(HSM/keychain), shard loads it by reference
+        st->key = strdup(ztx->config.id.key);
+    }
+
+    pem = NULL;
+    if (st->key && cert && cert->to_pem(cert, 1, &pem, &len) == 0) {
+        st->cert = pem_ref(pem);
+    }
+}
+
+static void push_state(ziti_context ztx, ziti_context shard) {
+    NEWP(st, struct shard_state);
+    st->enabled = ztx->enabled;
+    st->update_token = ztx->auth_method && ztx->auth_method->kind == HA;
+    st->auth_state = ztx->auth_state;
+    st->session_token = ztx->session_token ? strdup(ztx->session_token) : NULL;
+    push_tls(ztx, shard, st);
+    st->identity_data = model_copy(ztx->identity_data, get_ziti_identity_data_meta());
+    ziti_queue_work(shard, shard_apply_state, st);
+}
+
+void ztx_shards_sync(ziti_context ztx) {
+    ziti_context shard;
+    MODEL_LIST_FOREACH(shard, ztx->shards) {
+        push_state(ztx, shard);
+    }
+}
+
+static void add_service_copies(model_list *l, ziti_service_array arr) {
+    for (int i = 0; arr && arr[i] != NULL; i++) {
+        ziti_service *copy = model_copy(arr[i], get_ziti_service_meta());
+        if (copy) {
+            model_list_append(l, copy);
+        }
+    }
+}
+
+void ztx_shards_update_services(ziti_context ztx, const struct ziti_service_event *ev) {
+    ziti_context shard;
+    MODEL_LIST_FOREACH(shard, ztx->shards) {
+        NEWP(upd, struct shard_services);
+        add_service_copies(&upd->updated, ev->added);
+        add_service_copies(&upd->updated, ev->changed);
+        for (int i = 0; ev->removed && ev->removed[i] != NULL; i++) {
+            model_list_append(&upd->removed, strdup(ev->removed[i]->name));
+        }
+        ziti_queue_work(shard, shard_apply_services, upd);
+    }
+}
+
+int ziti_context_add_shard(ziti_context ztx, uv_loop_t *loop, ziti_context *shard) {
+    if (ztx == NULL || loop == NULL || shard == NULL) {
+        return ZITI_INVALID_STATE;
+    }
+
+    if (ztx->primary != NULL || ztx->loop == NULL || ztx->loop == loop || ztx->closing) {
+        return ZITI_INVALID_STATE;
+    }
+
+    ziti_context s = calloc(1, sizeof(*s));
+    s->primary = ztx;
+    s->opts = ztx->opts;
+    // events are reported by the primary context
+    s->opts.events = 0;
+    s->opts.event_cb = NULL;
+
+    int rc = ziti_context_run(s, loop);
+    if (rc != ZITI_OK) {
+        free(s);
+        return rc;
+    }
+    model_list_append(&ztx->shards, s);
+
+    push_state(ztx, s);
+
+    NEWP(upd, struct shard_services);
+    const char *name;
+    ziti_service *svc;
+    MODEL_MAP_FOREACH(name, svc, &ztx->services) {
+        ziti_service *copy = model_copy(svc, get_ziti_service_meta());
+        if (copy) {
+            model_list_append(&upd->updated, copy);
+        }
+    }
+    ziti_queue_work(s, shard_apply_services, upd);
+
+    ZTX_LOG(INFO, "added shard ztx[%u]", s->id);
+    *shard = s;
+    return ZITI_OK;
+}
+
+ziti_context ziti_context_pick_shard(ziti_context ztx) {
+    if (ztx == NULL) {
+        return NULL;
+    }
+
+    ziti_context best = ztx;
+    unsigned int load = atomic_load(&ztx->conn_count);
+
+    ziti_context s;
+    MODEL_LIST_FOREACH(s, ztx->shards) {
+        // prefer shards over primary loop, it also runs controller communication
+        unsigned int l = atomic_load(&s->conn_count);
+        if (l <= load && (best == ztx || l < load)) {
+            best = s;
+            load = l;
+        }
+    }
+    return best;
+}
+
+static void shard_ctrl_deliver(ziti_context ztx, void *data) {
+    struct shard_ctrl_req *req = data;
+    ztx->shard_reqs--;
+
+    req->cb(req->resp, req->err, req->ctx);
+
+    if (req->err) {
+        free_ziti_error(req->err);
+        free(req->err);
+    }
+    free(req->arg);
+    free(req);
+
+    if (ztx->shard_reqs == 0) {
+        ztx_shard_check_release(ztx);
+    }
+}
+
+// runs on primary loop
+static void shard_ctrl_done(void *resp, const ziti_error *err, void *ctx) {
+    struct shard_ctrl_req *req = ctx;
+    req->resp = resp;
+    if (err) {
+        // error is owned by the controller request
+        req->err = calloc(1, sizeof(ziti_error));
+        req->err->err = err->err;
+        req->err->http_code = err->http_code;
+        req->err->code = err->code ? strdup(err->code) : NULL;
+        req->err->message = err->message ? strdup(err->message) : NULL;
+    }
+    ziti_queue_work(req->shard, shard_ctrl_deliver, req);
+}
+
+// runs on primary loop
+static void shard_ctrl_start(ziti_context ztx, void *data) {
+    struct shard_ctrl_req *req = data;
+    if (ztx->closing) {
+        ziti_error err = {
+                .err = ZITI_DISABLED,
+                .code = "CONTEXT_DISABLED",
+                .message = (char *) ziti_errorstr(ZITI_DISABLED),
+        };
+        shard_ctrl_done(NULL, &err, req);
+        return;
+    }
+
+    ziti_controller *ctrl = ztx_get_controller(ztx);
+
+    switch (req->op) {
+        case shard_get_service:
+            ziti_ctrl_get_service(ctrl, req->arg,
+                                  (void (*)(ziti_service *, const ziti_error *, void *)) shard_ctrl_done, req);
+            break;
+        case shard_create_session:
+            ziti_ctrl_create_session(ctrl, req->arg, req->type,
+                                     (void (*)(ziti_session *, const ziti_error *, void *)) shard_ctrl_done, req);
+            break;
+        case shard_get_session:
+            ziti_ctrl_get_session(ctrl, req->arg,
+                                  (void (*)(ziti_session *, const ziti_error *, void *)) shard_ctrl_done, req);
+            break;
+        case shard_list_routers: {
+            ziti_service srv = { .id = req->arg };
+            ziti_ctrl_list_service_routers(ctrl, &srv, (routers_cb) shard_ctrl_done, req);
+            break;
+        }
+    }
+}
+
+static void shard_forward(ziti_context ztx, enum shard_ctrl_op op, const char *arg, ziti_session_type type,
+                          shard_ctrl_cb cb, void *ctx) {
+    NEWP(req, struct shard_ctrl_req);
+    req->shard = ztx;
+    req->op = op;
+    req->arg = strdup(arg);
+    req->type = type;
+    req->cb = cb;
+    req->ctx = ctx;
+
+    ztx->shard_reqs++;
+    ziti_queue_work(ztx->primary, shard_ctrl_start, req);
+}
+
+void ztx_get_service(ziti_context ztx, const char *name,
+                     void (*cb)(ziti_service *, const ziti_error *, void *), void *ctx) {
+    if (ztx->primary) {
+        shard_forward(ztx, shard_get_service, name, 0, (shard_ctrl_cb) cb, ctx);
+    } else {
+        ziti_ctrl_get_service(ztx_get_controller(ztx), name, cb, ctx);
+    }
+}
+
+void ztx_create_session(ziti_context ztx, const char *service_id, ziti_session_type type,
+                        void (*cb)(ziti_session *, const ziti_error *, void *), void *ctx) {
+    if (ztx->primary) {
+        shard_forward(ztx, shard_create_session, service_id, type, (shard_ctrl_cb) cb, ctx);
+    } else {
+        ziti_ctrl_create_session(ztx_get_controller(ztx), service_id, type, cb, ctx);
+    }
+}
+
+void ztx_get_session(ziti_context ztx, const char *session_id,
+                     void (*cb)(ziti_session *, const ziti_error *, void *), void *ctx) {
+    if (ztx->primary) {
+        shard_forward(ztx, shard_get_session, session_id, 0, (shard_ctrl_cb) cb, ctx);
+    } else {
+        ziti_ctrl_get_session(ztx_get_controller(ztx), session_id, cb, ctx);
+    }
+}
+
+void ztx_list_service_routers(ziti_context ztx, const ziti_service *srv, routers_cb cb, void *ctx) {
+    if (ztx->primary) {
+        shard_forward(ztx, shard_list_routers, srv->id, 0, (shard_ctrl_cb) cb, ctx);
+    } else {
+        ziti_ctrl_list_service_routers(ztx_get_controller(ztx), srv, cb, ctx);
+    }
+}
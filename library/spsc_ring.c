@@ -0,0 +1,93 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "spsc_ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+
+int spsc_ring_init(spsc_ring_t *r, size_t cap) {
+    size_t c = 1;
+    while (c < cap) c <<= 1;
+
+    r->buf = malloc(c);
+    if (r->buf == NULL) {
+        return UV_ENOMEM;
+    }
+    r->cap = c;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    return 0;
+}
+
+void spsc_ring_free(spsc_ring_t *r) {
+    free(r->buf);
+    r->buf = NULL;
+    r->cap = 0;
+}
+
+size_t spsc_ring_size(spsc_ring_t *r) {
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    return head - tail;
+}
+
+size_t spsc_ring_write(spsc_ring_t *r, const void *data, size_t len) {
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+
+    size_t avail = r->cap - (head - tail);
+    if (len > avail) len = avail;
+    if (len == 0) return 0;
+
+    size_t off = head & (r->cap - 1);
+    size_t first = r->cap - off < len ? r->cap - off : len;
+    memcpy(r->buf + off, data, first);
+    memcpy(r->buf, (const uint8_t *) data + first, len - first);
+
+    atomic_store_explicit(&r->head, head + len, memory_order_release);
+    return len;
+}
+
+size_t spsc_ring_peek(spsc_ring_t *r, const uint8_t **data) {
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+
+    size_t len = head - tail;
+    size_t off = tail & (r->cap - 1);
+    if (len > r->cap - off) len = r->cap - off;
+
+    *data = r->buf + off;
+    return len;
+}
+
+void spsc_ring_consume(spsc_ring_t *r, size_t len) {
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    atomic_store_explicit(&r->tail, tail + len, memory_order_release);
+}
+
+size_t spsc_ring_read(spsc_ring_t *r, void *out, size_t len) {
+    size_t total = 0;
+    const uint8_t *p;
+    size_t n;
+    // at most two contiguous regions
+    while (total < len && (n = spsc_ring_peek(r, &p)) > 0) {
+        if (n > len - total) n = len - total;
+        memcpy((uint8_t *) out + total, p, n);
+        spsc_ring_consume(r, n);
+        total += n;
+    }
+    return total;
+}
@@ -19,18 +19,88 @@
 #include <uv.h>
 
 #include "future.h"
+#include "mpsc_queue.h"
+
+#if defined(__linux__)
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define FUTURE_FUTEX 1
+#endif
+
+// number of preallocated futures, more are allocated on demand
+#define FUTURE_POOL_SIZE 256
+
+enum {
+    FUTURE_PENDING,
+    FUTURE_COMPLETING, // result is being set
+    FUTURE_WAKING,     // result is set, completer is waking up waiter
+    FUTURE_DONE,       // completer no longer touches the future
+};
 
 typedef struct future_s {
-    uv_mutex_t lock;
-    uv_cond_t cond;
-    bool completed;
+    atomic_uint state;
     void *result;
     int err;
+
+    future_done_cb cb;
+    void *cb_data;
+
+#if !defined(FUTURE_FUTEX)
+    uv_mutex_t lock;
+    uv_cond_t cond;
+#endif
 } future_t;
 
+static uv_once_t pool_init = UV_ONCE_INIT;
+static lf_pool_t *future_pool;
 
-future_t *new_future() {
-    future_t *f = calloc(1, sizeof(future_t));
+static void init_future_pool(void) {
+    future_pool = lf_pool_new(sizeof(future_t), FUTURE_POOL_SIZE);
+}
+
+#if defined(FUTURE_FUTEX)
+static void future_wait(future_t *f) {
+    unsigned int s;
+    while ((s = atomic_load(&f->state)) != FUTURE_DONE) {
+        if (s == FUTURE_PENDING) {
+            syscall(SYS_futex, &f->state, FUTEX_WAIT_PRIVATE, FUTURE_PENDING, NULL, NULL, 0);
+        } else {
+            // completer is in the middle of setting result, this is very brief
+            uv_sleep(0);
+        }
+    }
+}
+
+static void future_signal(future_t *f) {
+    atomic_store(&f->state, FUTURE_WAKING);
+    syscall(SYS_futex, &f->state, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+    // last access by the completer, waiter may release the future after this
+    atomic_store(&f->state, FUTURE_DONE);
+}
+#else
+static void future_wait(future_t *f) {
+    uv_mutex_lock(&f->lock);
+    while (atomic_load(&f->state) != FUTURE_DONE) {
+        uv_cond_wait(&f->cond, &f->lock);
+    }
+    uv_mutex_unlock(&f->lock);
+}
+
+static void future_signal(future_t *f) {
+    uv_mutex_lock(&f->lock);
+    atomic_store(&f->state, FUTURE_DONE);
+    uv_cond_broadcast(&f->cond);
+    uv_mutex_unlock(&f->lock);
+}
+#endif
+
+static future_t *alloc_future(void) {
+    uv_once(&pool_init, init_future_pool);
+    future_t *f = lf_pool_alloc(future_pool);
+    atomic_init(&f->state, FUTURE_PENDING);
+#if !defined(FUTURE_FUTEX)
     int rc = uv_mutex_init(&f->lock);
     if (rc != 0) {
         fprintf(stderr, "failed to init lock %d/%s\n", rc, uv_strerror(rc));
@@ -39,13 +109,32 @@ future_t *new_future() {
     if (rc != 0) {
         fprintf(stderr, "failed to init cond %d/%s\n", rc, uv_strerror(rc));
     }
+#endif
     return f;
 }
 
-void destroy_future(future_t *f) {
+static void release_future(future_t *f) {
+#if !defined(FUTURE_FUTEX)
     uv_mutex_destroy(&f->lock);
     uv_cond_destroy(&f->cond);
-    free(f);
+#endif
+    lf_pool_return(future_pool, f);
+}
+
+future_t *new_future() {
+    return alloc_future();
+}
+
+future_t *new_future_cb(future_done_cb cb, void *data) {
+    future_t *f = alloc_future();
+    f->cb = cb;
+    f->cb_data = data;
+    return f;
+}
+
+void destroy_future(future_t *f) {
+    if (f == NULL) return;
+    release_future(f);
 }
 
 int await_future(future_t *f, void **result) {
@@ -53,44 +142,39 @@ int await_future(future_t *f, void **result) {
         return 0;
     }
 
-    uv_mutex_lock(&f->lock);
-    while (!f->completed) {
-        uv_cond_wait(&f->cond, &f->lock);
-    }
+    future_wait(f);
+
     int err = f->err;
-    uv_mutex_unlock(&f->lock);
     if (!err && result != NULL) {
         *result = f->result;
     }
     return err;
 }
 
-int complete_future(future_t *f, void *result) {
-    if (f == NULL) return 0;
+static int finish_future(future_t *f, void *result, int err) {
+    unsigned int pending = FUTURE_PENDING;
+    if (!atomic_compare_exchange_strong(&f->state, &pending, FUTURE_COMPLETING)) {
+        return UV_EINVAL;
+    }
 
-    int rc = UV_EINVAL;
-    uv_mutex_lock(&f->lock);
-    if (!f->completed) {
-        f->completed = true;
-        f->result = result;
-        uv_cond_broadcast(&f->cond);
-        rc = 0;
+    f->result = result;
+    f->err = err;
+
+    if (f->cb) {
+        f->cb(result, err, f->cb_data);
+        release_future(f);
+    } else {
+        future_signal(f);
     }
-    uv_mutex_unlock(&f->lock);
-    return rc;
+    return 0;
 }
 
-int fail_future(future_t *f, int err) {
+int complete_future(future_t *f, void *result) {
     if (f == NULL) return 0;
+    return finish_future(f, result, 0);
+}
 
-    int rc = UV_EINVAL;
-    uv_mutex_lock(&f->lock);
-    if (!f->completed) {
-        f->completed = true;
-        f->err = err;
-        uv_cond_broadcast(&f->cond);
-        rc = 0;
-    }
-    uv_mutex_unlock(&f->lock);
-    return rc;
+int fail_future(future_t *f, int err) {
+    if (f == NULL) return 0;
+    return finish_future(f, NULL, err);
 }
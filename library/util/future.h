@@ -17,10 +17,22 @@
 #ifndef ZITI_SDK_FUTURE_H
 #define ZITI_SDK_FUTURE_H
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct future_s future_t;
 
+typedef void (*future_done_cb)(void *result, int err, void *data);
+
 future_t *new_future(void);
 
+/**
+ * create future that invokes [cb] on the completing thread instead of waking up a waiter.
+ * Future is released after [cb] returns, it must not be awaited or destroyed by the caller.
+ */
+future_t *new_future_cb(future_done_cb cb, void *data);
+
 void destroy_future(future_t *f);
 
 int await_future(future_t *f, void **result);
@@ -29,4 +41,8 @@ int complete_future(future_t *f, void *result);
 
 int fail_future(future_t *f, int err);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif //ZITI_SDK_FUTURE_H
@@ -17,13 +17,18 @@
 #include <ziti/ziti_model.h>
 #include <ziti/ziti_log.h>
 #include <stdarg.h>
+#include <limits.h>
 
 #include "utils.h"
+#include "log_ring.h"
 #include "tlsuv/http.h"
 #include "ziti/errors.h"
 
 #if _WIN32
 #include <time.h>
+#else
+#include <sys/uio.h>
+#include <errno.h>
 #endif
 
 
@@ -115,6 +120,8 @@ static const char *TLSUV_MODULE = "tlsuv";
 
 static model_map log_levels;
 static int ziti_log_lvl = ZITI_LOG_DEFAULT_LEVEL;
+// zero is never a valid generation, so unresolved call sites don't match
+unsigned int ziti_log_generation = 1;
 static FILE *ziti_debug_out;
 static bool log_initialized = false;
 static uv_pid_t log_pid = 0;
@@ -140,6 +147,21 @@ static void init_debug(uv_loop_t *loop);
 
 static void init_uv_mbed_log();
 
+static void log_levels_changed();
+
+// records written by async log thread in one batch
+#define LOG_ASYNC_BATCH 64
+
+static _Atomic(log_ring_t *) async_ring;
+static uv_thread_t async_thread;
+static uv_sem_t async_wake;
+static atomic_bool async_sleeping;
+static atomic_bool async_stop;
+// threads currently writing a record into async_ring
+static atomic_uint async_producers;
+
+static uint64_t log_time_ms();
+
 void ziti_log_init(uv_loop_t *loop, int level, log_writer log_func) {
     init_uv_mbed_log();
 
@@ -191,6 +213,7 @@ void ziti_log_set_level(int level, const char *marker) {
             ziti_log_lvl = level;
         }
     }
+    log_levels_changed();
 
     if (logger) {
         int l = level == ZITI_LOG_DEFAULT_LEVEL ? ziti_log_lvl : level;
@@ -216,6 +239,28 @@ int ziti_log_level(const char *module, const char *file) {
     return ziti_log_lvl;
 }
 
+int ziti_log_site_resolve(unsigned int *site, const char *module, const char *file) {
+    // generation is read first: concurrent level change invalidates what is stored
+    unsigned int gen = ziti_log_load_(&ziti_log_generation);
+    int level = ziti_log_level(module, file);
+    if (level > TRACE) {
+        level = TRACE;
+    } else if (level < 0) {
+        level = -1;
+    }
+    ziti_log_store_(site, (gen << 4) | (unsigned int) (level + 1));
+    return level;
+}
+
+static void log_levels_changed() {
+    unsigned int gen = ziti_log_generation + 1;
+    // generation must fit the call site cache
+    if (gen > (UINT_MAX >> 4)) {
+        gen = 1;
+    }
+    ziti_log_store_(&ziti_log_generation, gen);
+}
+
 const char* ziti_log_level_label() {
     int num_levels = sizeof(level_labels) / sizeof(const char *);
     if (ziti_log_lvl >= 0 && ziti_log_lvl < num_levels) {
@@ -253,6 +298,9 @@ static void init_uv_mbed_log() {
 static void child_init() {
     log_initialized = false;
     log_pid = uv_os_getpid();
+    // async log thread does not survive fork
+    atomic_store(&async_ring, NULL);
+    atomic_store(&async_producers, 0);
 }
 
 static void init_debug(uv_loop_t *loop) {
@@ -295,6 +343,7 @@ static void init_debug(uv_loop_t *loop) {
         }
     }
     model_list_clear(&levels, free);
+    log_levels_changed();
 
     int tlsuv_level = (int) (intptr_t) model_map_get(&log_levels, TLSUV_MODULE);
     if (tlsuv_level > 0) {
@@ -304,6 +353,11 @@ static void init_debug(uv_loop_t *loop) {
     ziti_debug_out = stderr;
 
     starttime = uv_now(loop);
+
+    char *async_len = getenv("ZITI_LOG_ASYNC");
+    if (async_len) {
+        ziti_log_async_start((size_t) strtoul(async_len, NULL, 10));
+    }
 }
 
 #if _WIN32 && defined(_MSC_VER)
@@ -330,13 +384,41 @@ void ziti_logger(int level, const char *module, const char *file, unsigned int l
     log_writer logfunc = logger;
     if (logfunc == NULL) { return; }
 
-    char *logbuf = (char *) uv_key_get(&logbufs);
-    if (!logbuf) {
-        logbuf = malloc(loglinelen);
-        uv_key_set(&logbufs, logbuf);
+    char *logbuf;
+    size_t buflen = loglinelen;
+    char loc_buf[LOG_RECORD_LOC_LEN];
+    char *location = loc_buf;
+
+    // async: format directly into the queued record
+    log_ring_t *ring = NULL;
+    log_record_t *rec = NULL;
+    if (atomic_load(&async_ring) != NULL) {
+        // register before checking again, ziti_log_async_stop() waits for registered producers
+        atomic_fetch_add(&async_producers, 1);
+        ring = atomic_load(&async_ring);
+        if (ring == NULL) {
+            atomic_fetch_sub(&async_producers, 1);
+        }
+    }
+    if (ring) {
+        rec = log_ring_claim(ring);
+        if (rec == NULL) {
+            // dropped, counted by the ring
+            atomic_fetch_sub(&async_producers, 1);
+            return;
+        }
+        rec->ts = log_time_ms();
+        logbuf = rec->msg;
+        buflen = sizeof(rec->msg);
+        location = rec->loc;
+    } else {
+        logbuf = (char *) uv_key_get(&logbufs);
+        if (!logbuf) {
+            logbuf = malloc(loglinelen);
+            uv_key_set(&logbufs, logbuf);
+        }
     }
 
-    char location[128];
     char *last_slash = strrchr(file, DIR_SEP);
 
     int modlen = 16;
@@ -362,19 +444,32 @@ void ziti_logger(int level, const char *module, const char *file, unsigned int l
         file = last_slash + 1;
     }
     if (func && func[0]) {
-        snprintf(location, sizeof(location), "%.*s:%s:%u %s()", modlen, module, file, line, func);
+        snprintf(location, LOG_RECORD_LOC_LEN, "%.*s:%s:%u %s()", modlen, module, file, line, func);
     }
     else {
-        snprintf(location, sizeof(location), "%.*s:%s:%u", modlen, module, file, line);
+        snprintf(location, LOG_RECORD_LOC_LEN, "%.*s:%s:%u", modlen, module, file, line);
     }
 
     va_list argp;
     va_start(argp, fmt);
-    int len = vsnprintf(logbuf, loglinelen, fmt, argp);
+    int len = vsnprintf(logbuf, buflen, fmt, argp);
     va_end(argp);
 
-    if (len > loglinelen) {
-        len = (int) loglinelen;
+    if (len < 0) {
+        len = 0;
+    } else if (len >= buflen) {
+        len = (int) buflen - 1;
+    }
+
+    if (rec) {
+        rec->level = level;
+        rec->msglen = len;
+        log_ring_publish(ring, rec);
+        if (atomic_exchange(&async_sleeping, false)) {
+            uv_sem_post(&async_wake);
+        }
+        atomic_fetch_sub(&async_producers, 1);
+        return;
     }
 
     logfunc(level, location, logbuf, len);
@@ -385,6 +480,203 @@ static void default_log_writer(int level, const char *loc, const char *msg, size
     fprintf(ziti_debug_out, "(%u)[%s] %7s %s %.*s\n", log_pid, elapsed, level_labels[level], loc, (unsigned int) msglen, msg);
 }
 
+// log time in the format of get_elapsed()
+static uint64_t log_time_ms() {
+    if (get_elapsed == get_utc_time) {
+        uv_timeval64_t ts;
+        uv_gettimeofday(&ts);
+        return (uint64_t) ts.tv_sec * 1000 + ts.tv_usec / 1000;
+    }
+
+    uint64_t now = uv_hrtime() / 1000000;
+    return now > starttime ? now - starttime : 0;
+}
+
+// thread-safe gmtime(): log timestamps are formatted on the async log thread too
+static void utc_time(time_t t, struct tm *tm) {
+#if _WIN32
+    gmtime_s(tm, &t);
+#else
+    gmtime_r(&t, tm);
+#endif
+}
+
+static void fmt_log_time(char *buf, size_t len, uint64_t ts) {
+    if (get_elapsed == get_utc_time) {
+        struct tm tm;
+        utc_time((time_t) (ts / 1000), &tm);
+        snprintf(buf, len, "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+                 1900 + tm.tm_year, tm.tm_mon + 1, tm.tm_mday,
+                 tm.tm_hour, tm.tm_min, tm.tm_sec, (int) (ts % 1000));
+    } else {
+        snprintf(buf, len, "%9llu.%03llu", (unsigned long long) (ts / 1000), (unsigned long long) (ts % 1000));
+    }
+}
+
+#if _WIN32
+typedef uv_buf_t log_buf_t;
+
+static void set_log_buf(log_buf_t *b, const char *p, size_t len) {
+    b->base = (char *) p;
+    b->len = (ULONG) len;
+}
+
+static void write_lines(log_buf_t *bufs, int count) {
+    for (int i = 0; i < count; i++) {
+        fwrite(bufs[i].base, 1, bufs[i].len, ziti_debug_out);
+    }
+    fflush(ziti_debug_out);
+}
+#else
+typedef struct iovec log_buf_t;
+
+static void set_log_buf(log_buf_t *b, const char *p, size_t len) {
+    b->iov_base = (void *) p;
+    b->iov_len = len;
+}
+
+static void write_lines(log_buf_t *iov, int count) {
+    int fd = fileno(ziti_debug_out);
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+
+        // partial write: skip what was written
+        while (count > 0 && (size_t) n >= iov->iov_len) {
+            n -= (ssize_t) iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *) iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+}
+#endif
+
+static void write_records(log_record_t **recs, size_t count) {
+    log_writer w = logger;
+    if (w == NULL) return;
+
+    // custom writer gets the same arguments as with synchronous logging
+    if (w != default_log_writer) {
+        for (size_t i = 0; i < count; i++) {
+            w(recs[i]->level, recs[i]->loc, recs[i]->msg, recs[i]->msglen);
+        }
+        return;
+    }
+
+    log_buf_t bufs[LOG_ASYNC_BATCH * 5];
+    char prefix[LOG_ASYNC_BATCH][80];
+    int n = 0;
+    for (size_t i = 0; i < count; i++) {
+        log_record_t *r = recs[i];
+        char ts[32];
+        fmt_log_time(ts, sizeof(ts), r->ts);
+        int plen = snprintf(prefix[i], sizeof(prefix[i]), "(%u)[%s] %7s ", log_pid, ts, level_labels[r->level]);
+        set_log_buf(&bufs[n++], prefix[i], plen);
+        set_log_buf(&bufs[n++], r->loc, strlen(r->loc));
+        set_log_buf(&bufs[n++], " ", 1);
+        set_log_buf(&bufs[n++], r->msg, r->msglen);
+        set_log_buf(&bufs[n++], "\n", 1);
+    }
+    write_lines(bufs, n);
+}
+
+static void report_drops(log_ring_t *ring, uint64_t *reported) {
+    uint64_t dropped = log_ring_dropped(ring);
+    if (dropped == *reported) return;
+
+    log_record_t r = {
+            .level = WARN,
+            .ts = log_time_ms(),
+            .loc = "ziti-sdk:log",
+    };
+    r.msglen = snprintf(r.msg, sizeof(r.msg), "dropped %llu log messages",
+                        (unsigned long long) (dropped - *reported));
+    *reported = dropped;
+
+    log_record_t *recs[] = {&r};
+    write_records(recs, 1);
+}
+
+static void async_log_thread(void *arg) {
+    log_ring_t *ring = arg;
+    log_record_t *recs[LOG_ASYNC_BATCH];
+    uint64_t reported = 0;
+
+    for (;;) {
+        size_t count = log_ring_peek(ring, recs, LOG_ASYNC_BATCH);
+        if (count == 0) {
+            atomic_store(&async_sleeping, true);
+            count = log_ring_peek(ring, recs, LOG_ASYNC_BATCH);
+            if (count == 0) {
+                // only exit when everything is written
+                if (atomic_load(&async_stop)) {
+                    break;
+                }
+                uv_sem_wait(&async_wake);
+                continue;
+            }
+            // a producer may still post, causing an extra wakeup
+            atomic_store(&async_sleeping, false);
+        }
+
+        write_records(recs, count);
+        log_ring_release(ring, count);
+        report_drops(ring, &reported);
+    }
+}
+
+int ziti_log_async_start(size_t queue_len) {
+    if (atomic_load(&async_ring) != NULL) {
+        return ZITI_INVALID_STATE;
+    }
+
+    log_ring_t *ring = log_ring_new(queue_len > 0 ? queue_len : 1024);
+    if (ring == NULL) {
+        return ZITI_ALLOC_FAILED;
+    }
+
+    uv_sem_init(&async_wake, 0);
+    atomic_store(&async_sleeping, false);
+    atomic_store(&async_stop, false);
+    if (uv_thread_create(&async_thread, async_log_thread, ring) != 0) {
+        uv_sem_destroy(&async_wake);
+        log_ring_free(ring);
+        return ZITI_ALLOC_FAILED;
+    }
+
+    atomic_store(&async_ring, ring);
+    return ZITI_OK;
+}
+
+void ziti_log_async_stop(void) {
+    log_ring_t *ring = atomic_exchange(&async_ring, NULL);
+    if (ring == NULL) return;
+
+    // new messages go to the sync path now, wait for the ones being written into the ring
+    while (atomic_load(&async_producers) > 0) {
+        uv_sleep(0);
+    }
+
+    atomic_store(&async_stop, true);
+    uv_sem_post(&async_wake);
+    uv_thread_join(&async_thread);
+
+    uv_sem_destroy(&async_wake);
+    log_ring_free(ring);
+}
+
+uint64_t ziti_log_async_dropped(void) {
+    log_ring_t *ring = atomic_load(&async_ring);
+    return ring ? log_ring_dropped(ring) : 0;
+}
+
 void tlsuv_logger(int level, const char *file, unsigned int line, const char *msg) {
     ziti_logger(level, TLSUV_MODULE, file, line, NULL, "%s", msg);
 }
@@ -406,12 +698,12 @@ static const char *get_utc_time() {
 
         uv_timeval64_t ts;
         uv_gettimeofday(&ts);
-        time_t t = ts.tv_sec;
-        struct tm *tm = gmtime(&t);
+        struct tm tm;
+        utc_time((time_t) ts.tv_sec, &tm);
 
         snprintf(log_timestamp, sizeof(log_timestamp), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
-                 1900 + tm->tm_year, tm->tm_mon + 1, tm->tm_mday,
-                 tm->tm_hour, tm->tm_min, tm->tm_sec, ts.tv_usec / 1000
+                 1900 + tm.tm_year, tm.tm_mon + 1, tm.tm_mday,
+                 tm.tm_hour, tm.tm_min, tm.tm_sec, ts.tv_usec / 1000
         );
     }
     return log_timestamp;
@@ -460,9 +752,9 @@ void ziti_fmt_time(char* time_str, size_t time_str_sz, uv_timeval64_t* tv) {
     if (tv == NULL) {
         strncpy(time_str, "null tv", time_str_sz);
     } else {
-        time_t t = tv->tv_sec;
-        struct tm* start_tm = gmtime(&t);
-        strftime(time_str, time_str_sz, "%Y-%m-%dT%H:%M:%S", start_tm);
+        struct tm start_tm;
+        utc_time((time_t) tv->tv_sec, &start_tm);
+        strftime(time_str, time_str_sz, "%Y-%m-%dT%H:%M:%S", &start_tm);
     }
 }
 
@@ -45,6 +45,12 @@
 
 #define ONE_DAY (60 * 60 * 24)
 
+// preallocated ziti_queue_work() entries per context
+#define ZTX_WORK_PREALLOC 64
+
+// preallocated ziti_write_mt()/ziti_close_mt() requests per context
+#define ZTX_MT_PREALLOC 256
+
 #define ztx_controller(ztx) \
 ((ztx)->ctrl.url ? (ztx)->ctrl.url : (ztx)->config.controller_url)
 
@@ -59,17 +65,20 @@ static void ziti_init_async(ziti_context ztx, void *data);
 
 static void ziti_re_auth(ziti_context ztx);
 
-static void ztx_prepare(uv_prepare_t *prep);
 static void grim_reaper(ziti_context ztx);
 
 static void ztx_work_async(uv_async_t *ar);
 
+static void ztx_run_work(ziti_context ztx);
+
 static void ziti_stop_internal(ziti_context ztx, void *data);
 
 static void ziti_start_internal(ziti_context ztx, void *init_req);
 
 static void set_service_posture_policy_map(ziti_service *service);
 
+static void clear_service_configs(ziti_context ztx);
+
 static void shutdown_and_free(ziti_context ztx);
 
 static void ca_bundle_cb(char *pkcs7, const ziti_error *err, void *ctx);
@@ -83,7 +92,7 @@ static void ztx_config_update(ziti_context ztx);
 
 static void api_session_cb(ziti_api_session *, const ziti_error *, void *);
 
-static uint32_t ztx_seq;
+static atomic_uint ztx_seq;
 
 struct ztx_req_s {
     struct ziti_ctx *ztx;
@@ -98,6 +107,9 @@ static ziti_options default_options = {
         .config_types = all_configs,
         .refresh_interval = 0,
         .api_page_size = 25,
+        .api_page_concurrency = 4,
+        .api_conn_pool_size = 4,
+        .api_conn_keepalive = 30000,
 };
 
 static size_t parse_ref(const char *val, const char **res) {
@@ -186,6 +198,41 @@ int load_tls(ziti_config *cfg, tls_context **ctx, struct tls_credentials *creds)
     return rc;
 }
 
+int update_tls(ziti_config *cfg, tls_context *tls, struct tls_credentials *creds) {
+    if (cfg->id.ca != NULL) {
+        const char *ca;
+        parse_ref(cfg->id.ca, &ca);
+        if (tls->set_ca_bundle(tls, ca, strlen(ca)) != 0) {
+            return ZITI_INVALID_CONFIG;
+        }
+    }
+
+    if (cfg->id.key != NULL) {
+        return init_tls_from_config(tls, cfg, creds);
+    }
+
+    tls->set_own_cert(tls, NULL, NULL);
+    if (creds) {
+        if (creds->key) {
+            creds->key->free(creds->key);
+            creds->key = NULL;
+        }
+        if (creds->cert) {
+            creds->cert->free(creds->cert);
+            creds->cert = NULL;
+        }
+    }
+    return ZITI_OK;
+}
+
+// shards own their TLS contexts, have them rebuilt from primary credentials
+static void ztx_tls_changed(ziti_context ztx) {
+    ztx->tls_gen++;
+    if (!ztx->closing) {
+        ztx_shards_sync(ztx);
+    }
+}
+
 int ziti_set_client_cert(ziti_context ztx, const char *cert_buf, size_t cert_len, const char *key_buf, size_t key_len) {
     tlsuv_private_key_t pk;
     tlsuv_certificate_t c;
@@ -199,9 +246,21 @@ int ziti_set_client_cert(ziti_context ztx, const char *cert_buf, size_t cert_len
     }
 
     if (ztx->tlsCtx->set_own_cert(ztx->tlsCtx, pk, c)) {
+        c->free(c);
+        pk->free(pk);
         return ZITI_INVALID_CERT_KEY_PAIR;
     }
 
+    if (ztx->id_creds.key) {
+        ztx->id_creds.key->free(ztx->id_creds.key);
+    }
+    if (ztx->id_creds.cert) {
+        ztx->id_creds.cert->free(ztx->id_creds.cert);
+    }
+    ztx->id_creds.key = pk;
+    ztx->id_creds.cert = c;
+    ztx_tls_changed(ztx);
+
     return ZITI_OK;
 }
 
@@ -240,6 +299,7 @@ void ziti_set_unauthenticated(ziti_context ztx, const ziti_error *err) {
             ztx->session_creds.key = NULL;
         }
         init_tls_from_config(ztx->tlsCtx, &ztx->config, &ztx->id_creds);
+        ztx_tls_changed(ztx);
     }
 
     model_map_clear(&ztx->sessions, (void (*)(void *)) free_ziti_session_ptr);
@@ -429,7 +489,18 @@ void ziti_set_fully_authenticated(ziti_context ztx, const char *session_token) {
     ziti_posture_init(ztx, 20);
 }
 
+static void force_refresh_from_shard(ziti_context ztx, void *data) {
+    if (!ztx->closing) {
+        ziti_force_api_session_refresh(ztx);
+    }
+}
+
 void ziti_force_api_session_refresh(ziti_context ztx) {
+    if (ztx->primary) {
+        ziti_queue_work(ztx->primary, force_refresh_from_shard, NULL);
+        return;
+    }
+
     ZTX_LOG(DEBUG, "forcing session refresh");
     ztx->auth_method->force_refresh(ztx->auth_method);
 }
@@ -477,6 +548,9 @@ static void ziti_stop_internal(ziti_context ztx, void *data) {
             ev.service.removed[idx++] = model_map_it_value(it);
             it = model_map_it_remove(it);
         }
+        intercept_index_free(ztx->intercepts);
+        ztx->intercepts = NULL;
+        clear_service_configs(ztx);
 
         if (ztx->auth_method) {
             ztx->auth_method->free(ztx->auth_method);
@@ -496,14 +570,33 @@ static void ziti_stop_internal(ziti_context ztx, void *data) {
         ziti_ctrl_clear_api_session(ztx_get_controller(ztx));
         update_ctrl_status(ztx, ZITI_DISABLED, ziti_errorstr(ZITI_DISABLED));
         ztx->enabled = false;
+        ztx_shards_sync(ztx);
+    }
+
+    // context may have no channels to wait for
+    if (ztx->closing && model_map_size(&ztx->channels) == 0) {
+        shutdown_and_free(ztx);
     }
 }
 
 static void ziti_start_internal(ziti_context ztx, void *init_req) {
+    if (ztx->closing) {
+        return;
+    }
+
     if (!ztx->enabled) {
         ZTX_LOG(INFO, "enabling Ziti Context");
         ztx->enabled = true;
 
+        // TLS, controller, and authentication are provided by primary context
+        if (ztx->primary) {
+            metrics_rate_init(&ztx->up_rate, ztx->opts.metrics_type);
+            metrics_rate_init(&ztx->down_rate, ztx->opts.metrics_type);
+            uv_prepare_start(&ztx->prepper, ztx_prepare);
+            ztx->start = uv_now(ztx->loop);
+            return;
+        }
+
         int rc = load_tls(&ztx->config, &ztx->tlsCtx, &ztx->id_creds);
         if (rc != 0) {
             ZITI_LOG(ERROR, "invalid TLS config: %s", ziti_errorstr(rc));
@@ -519,6 +612,7 @@ static void ziti_start_internal(ziti_context ztx, void *init_req) {
 
         ZTX_LOG(INFO, "using tlsuv[%s/%s]", tlsuv_version(),
                 ztx->tlsCtx->version ? ztx->tlsCtx->version() : "unspecified");
+        ztx_tls_changed(ztx);
 
         rc = ztx_init_controller(ztx);
         if (rc != ZITI_OK) {
@@ -549,6 +643,8 @@ static void on_ctrl_list_change(ziti_context ztx, const model_map *endpoints) {
             details[idx].url = url;
             details[idx].id = d->id;
             details[idx].online = d->is_online;
+            details[idx].active = ziti_ctrl_is_current(ztx_get_controller(ztx), url);
+            details[idx].latency = d->rtt > 0 ? (int) (d->rtt / 1000) : -1;
             idx++;
         }
         ziti_send_event(ztx, &(ziti_event_t){
@@ -601,11 +697,15 @@ static int ztx_init_controller(ziti_context ztx) {
     if (ztx->opts.api_page_size != 0) {
         ziti_ctrl_set_page_size(ztx_get_controller(ztx), ztx->opts.api_page_size);
     }
+    if (ztx->opts.api_page_concurrency != 0) {
+        ziti_ctrl_set_page_concurrency(ztx_get_controller(ztx), ztx->opts.api_page_concurrency);
+    }
+    ziti_ctrl_set_conn_pool(ztx_get_controller(ztx), ztx->opts.api_conn_pool_size, ztx->opts.api_conn_keepalive);
     return 0;
 }
 
 static void ziti_init_async(ziti_context ztx, void *data) {
-    ztx->id = ztx_seq++;
+    ztx->id = atomic_fetch_add(&ztx_seq, 1);
     uv_loop_t *loop = ztx->w_async.loop;
     
     uv_prepare_init(loop, &ztx->prepper);
@@ -614,6 +714,13 @@ static void ziti_init_async(ziti_context ztx, void *data) {
 
     metrics_init(5, (time_fn)uv_now, loop);
 
+    ztx->crypto_pool = crypto_pool_new(loop, ztx->opts.crypto_threads);
+
+    // shard is enabled by primary context
+    if (ztx->primary) {
+        return;
+    }
+
     if (!ztx->opts.disabled) {
         ziti_start_internal(ztx, NULL);
     } else {
@@ -728,11 +835,18 @@ int ziti_get_transfer_rates(ziti_context ztx, double *up, double *down) {
 static void free_ztx(uv_handle_t *h) {
     ziti_context ztx = h->data;
 
+    // work submitted after shutdown still owns its data,
+    // run it while context state is intact: work functions check ztx->closing
+    ztx_run_work(ztx);
+
     model_map_clear(&ztx->ext_signers, (_free_f)free_ziti_jwt_signer_ptr);
     model_map_clear(&ztx->ctrl_details, (_free_f) free_ziti_controller_detail_ptr);
     ziti_auth_query_free(ztx->auth_queries);
     ziti_posture_checks_free(ztx->posture_checks);
     model_map_clear(&ztx->services, (_free_f) free_ziti_service_ptr);
+    model_map_clear(&ztx->service_hashes, free);
+    intercept_index_free(ztx->intercepts);
+    clear_service_configs(ztx);
     model_map_clear(&ztx->sessions, (_free_f) free_ziti_session_ptr);
     ziti_set_unauthenticated(ztx, NULL);
     free_ziti_identity_data(ztx->identity_data);
@@ -758,17 +872,85 @@ static void free_ztx(uv_handle_t *h) {
 
     ziti_send_event(ztx, &ev);
 
+    deadline_heap_free(&ztx->deadlines);
+
+    lf_pool_destroy(ztx->w_pool);
+
+    // requests queued after the last loop wakeup, connections are gone by now
+    mpsc_node_t *n;
+    while ((n = mpsc_queue_pop(&ztx->mt_queue)) != NULL) {
+        struct conn_mt_req_s req = *container_of(n, struct conn_mt_req_s, _next);
+        lf_pool_return(ztx->mt_pool, container_of(n, struct conn_mt_req_s, _next));
+
+        if (req.close) {
+            if (req.close_cb) req.close_cb(req.conn);
+        } else if (req.write_cb) {
+            req.write_cb(req.conn, ZITI_DISABLED, req.ctx);
+        }
+    }
+    lf_pool_destroy(ztx->mt_pool);
 
     ZTX_LOG(INFO, "shutdown is complete\n");
     free(ztx);
 }
 
+static void shard_released_cb(ziti_context ztx, void *data) {
+    ztx->shard_detach = shard_released;
+    shutdown_and_free(ztx);
+}
+
+// runs on primary loop: stop sending work to the shard
+static void detach_shard(ziti_context ztx, void *data) {
+    ziti_context shard = data;
+    model_list_iter it = model_list_iterator(&ztx->shards);
+    while (it != NULL) {
+        if (model_list_it_element(it) == shard) {
+            it = model_list_it_remove(it);
+        } else {
+            it = model_list_it_next(it);
+        }
+    }
+
+    ziti_queue_work(shard, shard_released_cb, NULL);
+    if (ztx->closing) {
+        shutdown_and_free(ztx);
+    }
+}
+
+void ztx_shard_check_release(ziti_context ztx) {
+    if (ztx->closing) {
+        shutdown_and_free(ztx);
+    }
+}
+
 static void shutdown_and_free(ziti_context ztx) {
+    if (uv_is_closing((const uv_handle_t *) &ztx->w_async)) {
+        return;
+    }
+
     if (model_map_size(&ztx->channels) > 0) {
         ZTX_LOG(INFO, "waiting for %zd channels to disconnect", model_map_size(&ztx->channels));
         return;
     }
 
+    if (model_list_size(&ztx->shards) > 0) {
+        ZTX_LOG(INFO, "waiting for %zd shards to stop", model_list_size(&ztx->shards));
+        return;
+    }
+
+    // primary may still have work queued for this shard
+    if (ztx->primary && ztx->shard_detach != shard_released) {
+        if (ztx->shard_detach == shard_attached && ztx->shard_reqs == 0) {
+            ztx->shard_detach = shard_detaching;
+            ziti_queue_work(ztx->primary, detach_shard, ztx);
+        }
+        return;
+    }
+
+    // deliver completed crypto work before connections are reaped
+    crypto_pool_free(ztx->crypto_pool);
+    ztx->crypto_pool = NULL;
+
     grim_reaper(ztx);
 
     if (ztx->tlsCtx) {
@@ -783,10 +965,19 @@ static void shutdown_and_free(ziti_context ztx) {
     uv_close((uv_handle_t *)&ztx->prepper, NULL);
 }
 
+static void shard_shutdown(ziti_context ztx, void *data) {
+    ziti_shutdown(ztx);
+}
+
 int ziti_shutdown(ziti_context ztx) {
     ZTX_LOG(INFO, "Ziti is shutting down");
     ztx->closing = true;
 
+    ziti_context shard;
+    MODEL_LIST_FOREACH(shard, ztx->shards) {
+        ziti_queue_work(shard, shard_shutdown, NULL);
+    }
+
     ziti_queue_work(ztx, ziti_stop_internal, NULL);
 
     return ZITI_OK;
@@ -984,6 +1175,7 @@ int ziti_conn_init(ziti_context ztx, ziti_connection *conn, void *data) {
 
     *conn = c;
     model_map_setl(&ctx->connections, (long) c->conn_id, c);
+    atomic_store(&ctx->conn_count, (unsigned int) model_map_size(&ctx->connections));
     return ZITI_OK;
 }
 
@@ -1017,6 +1209,112 @@ void ztx_config_update(ziti_context ztx) {
     });
 }
 
+typedef struct service_cfg_s {
+    const type_meta *meta;
+    void *cfg;
+} service_cfg_t;
+
+// config types parsed when service is loaded
+static const struct {
+    const char *type;
+    const type_meta *(*meta)();
+} parsed_cfg_types[] = {
+        {ZITI_INTERCEPT_CFG_V1, get_ziti_intercept_cfg_v1_meta},
+        {ZITI_CLIENT_CFG_V1,    get_ziti_client_cfg_v1_meta},
+};
+
+static void free_service_cfg(service_cfg_t *c) {
+    model_free(c->cfg, c->meta);
+    free(c->cfg);
+    free(c);
+}
+
+static void free_service_cfgs(model_map *cfgs) {
+    if (cfgs == NULL) return;
+
+    model_map_clear(cfgs, (_free_f) free_service_cfg);
+    free(cfgs);
+}
+
+static void clear_service_configs(ziti_context ztx) {
+    model_map_clear(&ztx->service_cfgs, (_free_f) free_service_cfgs);
+}
+
+static void drop_service_configs(ziti_context ztx, const char *service) {
+    free_service_cfgs(model_map_remove(&ztx->service_cfgs, service));
+}
+
+static void cache_service_configs(ziti_context ztx, ziti_service *s) {
+    model_map *cfgs = NULL;
+    for (int i = 0; i < sizeof(parsed_cfg_types) / sizeof(parsed_cfg_types[0]); i++) {
+        const char *json = ziti_service_get_raw_config(s, parsed_cfg_types[i].type);
+        if (json == NULL) continue;
+
+        const type_meta *meta = parsed_cfg_types[i].meta();
+        void *cfg = model_alloc(meta);
+        if (model_parse(cfg, json, strlen(json), meta) < 0) {
+            ZTX_LOG(WARN, "service[%s] has invalid %s config", s->name, parsed_cfg_types[i].type);
+            model_free(cfg, meta);
+            free(cfg);
+            continue;
+        }
+
+        if (cfgs == NULL) {
+            cfgs = calloc(1, sizeof(*cfgs));
+        }
+        NEWP(c, service_cfg_t);
+        c->meta = meta;
+        c->cfg = cfg;
+        model_map_set(cfgs, parsed_cfg_types[i].type, c);
+    }
+
+    // older services only have client config, derive intercept from it once
+    service_cfg_t *clt = cfgs ? model_map_get(cfgs, ZITI_CLIENT_CFG_V1) : NULL;
+    if (clt && model_map_get(cfgs, ZITI_INTERCEPT_CFG_V1) == NULL) {
+        NEWP(c, service_cfg_t);
+        c->meta = get_ziti_intercept_cfg_v1_meta();
+        c->cfg = alloc_ziti_intercept_cfg_v1();
+        ziti_intercept_from_client_cfg(c->cfg, clt->cfg);
+        model_map_set(cfgs, ZITI_INTERCEPT_CFG_V1, c);
+    }
+
+    free_service_cfgs(model_map_remove(&ztx->service_cfgs, s->name));
+    if (cfgs) {
+        model_map_set(&ztx->service_cfgs, s->name, cfgs);
+    }
+}
+
+const void *ztx_service_config(ziti_context ztx, const char *service, const char *cfg_type) {
+    model_map *cfgs = model_map_get(&ztx->service_cfgs, service);
+    if (cfgs == NULL) return NULL;
+
+    service_cfg_t *c = model_map_get(cfgs, cfg_type);
+    return c ? c->cfg : NULL;
+}
+
+static void index_service_intercept(ziti_context ztx, ziti_service *s) {
+    const ziti_intercept_cfg_v1 *intercept = ztx_service_config(ztx, s->name, ZITI_INTERCEPT_CFG_V1);
+
+    if (intercept == NULL) {
+        if (ztx->intercepts) {
+            intercept_index_remove(ztx->intercepts, s->name);
+        }
+        return;
+    }
+
+    if (ztx->intercepts == NULL) {
+        ztx->intercepts = intercept_index_new();
+    }
+
+    intercept_index_add(ztx->intercepts, s->name, intercept);
+}
+
+// service was added or changed
+static void service_loaded(ziti_context ztx, ziti_service *s) {
+    cache_service_configs(ztx, s);
+    index_service_intercept(ztx, s);
+}
+
 static void set_service_flags(ziti_service *s) {
     for (int i = 0; s->permissions[i] != NULL; i++) {
         if (*s->permissions[i] == ziti_session_types.Dial) {
@@ -1028,6 +1326,29 @@ static void set_service_flags(ziti_service *s) {
     }
 }
 
+void ztx_set_service(ziti_context ztx, ziti_service *s) {
+    set_service_flags(s);
+    ziti_service *old = model_map_set(&ztx->services, s->name, s);
+    free_ziti_service_ptr(old);
+    service_loaded(ztx, s);
+}
+
+void ztx_drop_service(ziti_context ztx, const char *name) {
+    ziti_service *s = model_map_remove(&ztx->services, name);
+    if (s == NULL) {
+        return;
+    }
+
+    ziti_session *session = model_map_remove(&ztx->sessions, s->id);
+    free_ziti_session_ptr(session);
+    free(model_map_remove(&ztx->service_hashes, s->id));
+    if (ztx->intercepts) {
+        intercept_index_remove(ztx->intercepts, s->name);
+    }
+    drop_service_configs(ztx, s->name);
+    free_ziti_service_ptr(s);
+}
+
 static void service_cb(ziti_service *s, const ziti_error *err, void *ctx) {
     struct ztx_req_s *req = ctx;
     int rc = ZITI_SERVICE_UNAVAILABLE;
@@ -1036,6 +1357,7 @@ static void service_cb(ziti_service *s, const ziti_error *err, void *ctx) {
         set_service_flags(s);
         ziti_service *old = model_map_set(&req->ztx->services, s->name, s);
         free_ziti_service_ptr(old);
+        service_loaded(req->ztx, s);
         rc = ZITI_OK;
     } else {
         if (err) {
@@ -1061,7 +1383,7 @@ int ziti_service_available(ziti_context ztx, const char *service, ziti_service_c
     req->cb = cb;
     req->cb_ctx = ctx;
 
-    ziti_ctrl_get_service(ztx_get_controller(ztx), service, service_cb, req);
+    ztx_get_service(ztx, service, service_cb, req);
     return ZITI_OK;
 }
 
@@ -1075,35 +1397,8 @@ const ziti_service *ziti_service_for_addr_str(ziti_context ztx, ziti_protocol pr
 }
 
 const ziti_service *ziti_service_for_addr(ziti_context ztx, ziti_protocol proto, const ziti_address *addr, int port) {
-    int best_score = -1;
-    ziti_service *best = NULL;
-
-    ziti_service *srv;
-    const char *name;
-    MODEL_MAP_FOREACH(name, srv, &ztx->services) {
-        ziti_intercept_cfg_v1 intercept = {0};
-        ziti_client_cfg_v1 clt_cfg = {0};
-        if (ziti_service_get_config(srv, ZITI_INTERCEPT_CFG_V1, &intercept, (parse_service_cfg_f) parse_ziti_intercept_cfg_v1) == ZITI_OK ||
-                (ziti_service_get_config(srv, ZITI_CLIENT_CFG_V1, &clt_cfg, (parse_service_cfg_f) parse_ziti_client_cfg_v1) == ZITI_OK &&
-                 ziti_intercept_from_client_cfg(&intercept, &clt_cfg) == ZITI_OK
-                )
-        ) {
-            int match = ziti_intercept_match2(&intercept, proto, addr, port);
-
-            if (match == -1) { continue; }
-
-            // best possible match
-            if (match == 0) { return srv; }
-
-            if (best_score == -1 || best_score > match) {
-                best_score = match;
-                best = srv;
-            }
-        }
-        free_ziti_intercept_cfg_v1(&intercept);
-        free_ziti_client_cfg_v1(&clt_cfg);
-    }
-    return best;
+    const char *name = intercept_index_lookup(ztx->intercepts, proto, addr, port, NULL);
+    return name ? model_map_get(&ztx->services, name) : NULL;
 }
 
 
@@ -1174,18 +1469,97 @@ void ziti_force_service_update(ziti_context ztx, const char* service_id) {
     model_map_set(&ztx->service_forced_updates, service_id, (void *) (uintptr_t) true);
 }
 
+// FNV-1a
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t len) {
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ p[i]) * FNV_PRIME;
+    }
+    return h;
+}
+
+static uint64_t hash_str(uint64_t h, const char *s) {
+    // include terminator so that ("ab", "c") and ("a", "bc") differ
+    return s ? hash_bytes(h, s, strlen(s) + 1) : hash_bytes(h, "", 1);
+}
+
+static uint64_t hash_num(uint64_t h, int64_t n) {
+    return hash_bytes(h, &n, sizeof(n));
+}
+
+static uint64_t posture_set_hash(const char *policy_id, const ziti_posture_query_set *set) {
+    uint64_t h = hash_str(FNV_OFFSET, policy_id);
+    h = hash_num(h, set->is_passing);
+    uint64_t queries = 0;
+    for (int i = 0; set->posture_queries && set->posture_queries[i]; i++) {
+        const ziti_posture_query *q = set->posture_queries[i];
+        uint64_t qh = hash_str(FNV_OFFSET, q->id);
+        qh = hash_num(qh, q->timeout);
+        queries += hash_str(qh, q->updated_at);
+    }
+    return hash_num(h, (int64_t) queries);
+}
+
+// compact digest of service as received from controller, covers everything is_service_updated() looks at:
+// id, name, updated_at, configs, and posture policies/queries (array or map form, before conversion).
+// map entries are combined with addition so the result does not depend on their order
+static uint64_t service_content_hash(const ziti_service *s) {
+    uint64_t h = hash_str(FNV_OFFSET, s->id);
+    h = hash_str(h, s->name);
+    h = hash_str(h, s->updated_at);
+
+    uint64_t cfg = 0;
+    const char *k;
+    const char *v;
+    MODEL_MAP_FOREACH(k, v, &s->config) {
+        cfg += hash_str(hash_str(FNV_OFFSET, k), v);
+    }
+    h = hash_num(h, (int64_t) cfg);
+
+    uint64_t posture = 0;
+    const char *policy_id;
+    const ziti_posture_query_set *set;
+    MODEL_MAP_FOREACH(policy_id, set, &s->posture_query_map) {
+        posture += posture_set_hash(policy_id, set);
+    }
+    for (int i = 0; s->posture_query_set && s->posture_query_set[i]; i++) {
+        posture += posture_set_hash(s->posture_query_set[i]->policy_id, s->posture_query_set[i]);
+    }
+    return hash_num(h, (int64_t) posture);
+}
+
+bool ztx_service_unchanged(ziti_context ztx, const ziti_service *s) {
+    uint64_t h = service_content_hash(s);
+    const ziti_service *curr = model_map_get(&ztx->services, s->name);
+    uint64_t *known = model_map_get(&ztx->service_hashes, s->id);
+    if (curr != NULL && known != NULL && *known == h && strcmp(curr->id, s->id) == 0 &&
+        model_map_get(&ztx->service_forced_updates, s->id) == NULL) {
+        return true;
+    }
+
+    if (known == NULL) {
+        known = malloc(sizeof(*known));
+        model_map_set(&ztx->service_hashes, s->id, known);
+    }
+    *known = h;
+    return false;
+}
+
 // is_service_updated returns 0 if the direct service properties
 // and configurations have not been altered. Will return non-0
 // values if they have. This ignores posture query alterations.
 static int is_service_updated(ziti_context ztx, ziti_service *new, ziti_service *old) {
-    //compare updated at, if changed, signal update
-    if (strcmp(old->updated_at, new->updated_at) != 0) {
-        ZTX_LOG(VERBOSE, "service [%s] is updated, update_at property changes", new->name);
+    //check for forced updates
+    if (model_map_remove(&ztx->service_forced_updates, new->id) != NULL) {
         return 1;
     }
 
-    //check for forced updates
-    if (model_map_remove(&ztx->service_forced_updates, new->id) != NULL) {
+    //compare updated at, if changed, signal update
+    if (strcmp(old->updated_at, new->updated_at) != 0) {
+        ZTX_LOG(VERBOSE, "service [%s] is updated, update_at property changes", new->name);
         return 1;
     }
 
@@ -1261,9 +1635,16 @@ static void update_services(ziti_service_array services, const ziti_error *error
     ZTX_LOG(VERBOSE, "processing service updates");
 
     model_map updates = {0};
+    // names of services that did not change since last refresh
+    model_map unchanged = {0};
 
     int idx;
     for (idx = 0; services[idx] != NULL; idx++) {
+        if (ztx_service_unchanged(ztx, services[idx])) {
+            model_map_set(&unchanged, services[idx]->name, (void *) (uintptr_t) true);
+            free_ziti_service_ptr(services[idx]);
+            continue;
+        }
         set_service_flags(services[idx]);
         set_posture_query_defaults(services[idx]);
         set_service_posture_policy_map(services[idx]);
@@ -1296,6 +1677,8 @@ static void update_services(ziti_service_array services, const ziti_error *error
                 free(updt);
             }
 
+            it = model_map_it_next(it);
+        } else if (model_map_get(&unchanged, model_map_it_key(it)) != NULL) {
             it = model_map_it_next(it);
         } else {
             // service was removed
@@ -1308,6 +1691,11 @@ static void update_services(ziti_service_array services, const ziti_error *error
                 free_ziti_session(session);
                 free(session);
             }
+            free(model_map_remove(&ztx->service_hashes, s->id));
+            if (ztx->intercepts) {
+                intercept_index_remove(ztx->intercepts, s->name);
+            }
+            drop_service_configs(ztx, s->name);
             it = model_map_it_remove(it);
         }
     }
@@ -1326,12 +1714,14 @@ static void update_services(ziti_service_array services, const ziti_error *error
         ziti_service *old = model_map_set(&ztx->services, s->name, s);
         free_ziti_service(old);
         FREE(old);
+        service_loaded(ztx, s);
     }
 
     // process additions
     for (idx = 0; ev.service.added[idx] != NULL; idx++) {
         s = ev.service.added[idx];
         model_map_set(&ztx->services, s->name, s);
+        service_loaded(ztx, s);
     }
 
     if (!ztx->services_loaded || (addIdx + remIdx + chIdx) > 0) {
@@ -1339,6 +1729,7 @@ static void update_services(ziti_service_array services, const ziti_error *error
                 ztx->services_loaded ? "false" : "true", addIdx, remIdx, chIdx);
         ziti_send_event(ztx, &ev);
         ztx->services_loaded = true;
+        ztx_shards_update_services(ztx, &ev.service);
     } else {
         ZTX_LOG(VERBOSE, "no services added, changed, or removed");
     }
@@ -1355,6 +1746,7 @@ static void update_services(ziti_service_array services, const ziti_error *error
     free(ev.service.changed);
 
     model_map_clear(&updates, NULL);
+    model_map_clear(&unchanged, NULL);
     model_map_clear(&ztx->service_forced_updates, NULL);
 }
 
@@ -1513,6 +1905,7 @@ static void update_identity_data(ziti_identity_data *data, const ziti_error *err
         free_ziti_identity_data(ztx->identity_data);
         FREE(ztx->identity_data);
         ztx->identity_data = data;
+        ztx_shards_sync(ztx);
     }
 
     update_ctrl_status(ztx,
@@ -1541,6 +1934,8 @@ static void on_create_cert(ziti_create_api_cert_resp *resp, const ziti_error *e,
         int rc = ztx->tlsCtx->set_own_cert(ztx->tlsCtx, pk, ztx->session_creds.cert);
         if (rc != 0) {
             ZTX_LOG(ERROR, "failed to set session cert: %d", rc);
+        } else {
+            ztx_tls_changed(ztx);
         }
 
         free_ziti_create_api_cert_resp_ptr(resp);
@@ -1573,6 +1968,7 @@ static void ca_bundle_cb(char *pkcs7, const ziti_error *err, void *ctx) {
             new_pem = NULL;
 
             ztx_config_update(ztx);
+            ztx_tls_changed(ztx);
         }
     } else {
         ZITI_LOG(ERROR, "failed to get CA bundle from controller: %s", err->message);
@@ -1618,67 +2014,50 @@ const ziti_version *ziti_get_version() {
 }
 
 static void grim_reaper(ziti_context ztx) {
+    if (LIST_EMPTY(&ztx->reap_list)) {
+        return;
+    }
 
     size_t total = model_map_size(&ztx->connections);
     size_t count = 0;
 
-    if (total == 0 && !ztx->enabled) {
-        // context disabled and no connections
-        return;
-    }
+    // take the whole list: close callbacks may close more connections,
+    // those are checked on the next iteration
+    LIST_HEAD(, ziti_conn) reap = { LIST_FIRST(&ztx->reap_list) };
+    LIST_FIRST(&reap)->_reap.le_prev = &LIST_FIRST(&reap);
+    LIST_INIT(&ztx->reap_list);
 
-    model_map_iter it = model_map_iterator(&ztx->connections);
-    while (it != NULL) {
-        ziti_connection conn = model_map_it_value(it);
-        int closed = conn->close ? conn->disposer(conn) : 0;
-        it = closed ? model_map_it_remove(it) : model_map_it_next(it);
-        count += closed;
+    ziti_connection conn;
+    while ((conn = LIST_FIRST(&reap)) != NULL) {
+        LIST_REMOVE(conn, _reap);
+        uint32_t conn_id = conn->conn_id;
+        if (conn->disposer(conn)) {
+            model_map_removel(&ztx->connections, (long) conn_id);
+            count++;
+        } else {
+            LIST_INSERT_HEAD(&ztx->reap_list, conn, _reap);
+        }
     }
     if (count > 0) {
+        atomic_store(&ztx->conn_count, (unsigned int) model_map_size(&ztx->connections));
         ZTX_LOG(DEBUG, "reaped %zd closed (out of %zd total) connections", count, total);
     }
 }
 
 void ztx_set_deadline(ziti_context ztx, uint64_t timeout, deadline_t *d, void (*cb)(void *), void *ctx) {
     assert(cb != NULL);
-    clear_deadline(d);
 
     uint64_t now = uv_now(ztx->loop);
-    d->expiration = now + timeout;
     d->ctx = ctx;
     d->expire_cb = cb;
-
-    if (LIST_EMPTY(&ztx->deadlines)) {
-        LIST_INSERT_HEAD(&ztx->deadlines, d, _next);
-        return;
-    }
-
-    deadline_t *dp = LIST_FIRST(&ztx->deadlines);
-    deadline_t *dn = LIST_NEXT(dp, _next);
-    while(1) {
-        if (d->expiration < dp->expiration) {
-            LIST_INSERT_BEFORE(dp, d, _next);
-            break;
-        }
-
-        if (dn == NULL) {
-            LIST_INSERT_AFTER(dp, d, _next);
-            break;
-        }
-
-        dp = dn;
-        dn = LIST_NEXT(dp, _next);
-    }
+    deadline_heap_set(&ztx->deadlines, d, now + timeout);
 }
 
 static void ztx_process_deadlines(uv_timer_t *t) {
     ziti_context ztx = t->data;
     uint64_t now = uv_now(ztx->loop);
-    deadline_t *d ;
-    while ((d = LIST_FIRST(&ztx->deadlines)) && now > d->expiration) {
-        LIST_REMOVE(d, _next);
-
-        void *ctx = d->ctx;
+    deadline_t *d;
+    while ((d = deadline_heap_pop(&ztx->deadlines, now)) != NULL) {
         void (*cb)(void *) = d->expire_cb;
         d->expire_cb = NULL;
         cb(d->ctx);
@@ -1686,14 +2065,15 @@ static void ztx_process_deadlines(uv_timer_t *t) {
 }
 
 static void ztx_prep_deadlines(ziti_context ztx) {
-    if (LIST_EMPTY(&ztx->deadlines)) {
+    uint64_t next = deadline_heap_next(&ztx->deadlines);
+    if (next == UINT64_MAX) {
         uv_timer_stop(&ztx->deadline_timer);
         return;
     }
 
-    deadline_t *next = LIST_FIRST(&ztx->deadlines);
     uint64_t now = uv_now(ztx->loop);
-    uint64_t wait_time = next->expiration > now ? next->expiration - now : 0;
+    // deadlines fire once the clock is past expiration
+    uint64_t wait_time = next >= now ? next - now + 1 : 0;
     uv_timer_start(&ztx->deadline_timer, ztx_process_deadlines, wait_time, 0);
 }
 
@@ -1707,10 +2087,19 @@ void ztx_prepare(uv_prepare_t *prep) {
     // NOTE: stalled ziti connections are flushed with idle handlers,
     // which run before prepare, which means that message
     // buffers could be returned to their corresponding channels
-    // therefore enabling channel read if it was blocked
-    const char *id;
+    // therefore enabling channel read if it was blocked.
+    // Only channels that got buffers back are on the dirty list,
+    // channels marked again while processing are picked up on the next iteration
+    LIST_HEAD(, ziti_channel) dirty = { LIST_FIRST(&ztx->dirty_channels) };
+    if (!LIST_EMPTY(&dirty)) {
+        LIST_FIRST(&dirty)->_dirty.le_prev = &LIST_FIRST(&dirty);
+    }
+    LIST_INIT(&ztx->dirty_channels);
+
     ziti_channel_t *ch;
-    MODEL_MAP_FOREACH(id, ch, &ztx->channels) {
+    while ((ch = LIST_FIRST(&dirty)) != NULL) {
+        LIST_REMOVE(ch, _dirty);
+        ch->dirty = false;
         ziti_channel_prepare(ch);
     }
 
@@ -1769,37 +2158,37 @@ void ziti_on_channel_event(ziti_channel_t *ch, ziti_router_status status, ziti_c
     }
 }
 
-static void ztx_work_async(uv_async_t *ar) {
-    ziti_context ztx = ar->data;
-    ztx_work_q work;
-    STAILQ_INIT(&work);
+static void ztx_run_work(ziti_context ztx) {
+    mpsc_node_t *n;
+    while ((n = mpsc_queue_pop(&ztx->w_queue)) != NULL) {
+        struct ztx_work_s *wrk = container_of(n, struct ztx_work_s, _next);
+        ztx_work_f w = wrk->w;
+        void *w_data = wrk->w_data;
+        lf_pool_return(ztx->w_pool, wrk);
 
-    struct ztx_work_s *w;
-    uv_mutex_lock(&ztx->w_lock);
-    work = ztx->w_queue;
-    STAILQ_INIT(&ztx->w_queue);
-    uv_mutex_unlock(&ztx->w_lock);
+        w(ztx, w_data);
+    }
+}
 
-    while (!STAILQ_EMPTY(&work)) {
-        w = STAILQ_FIRST(&work);
-        STAILQ_REMOVE_HEAD(&work, _next);
+static void ztx_work_async(uv_async_t *ar) {
+    ziti_context ztx = ar->data;
 
-        w->w(ztx, w->w_data);
+    mpsc_queue_rearm(&ztx->w_queue);
+    mpsc_queue_rearm(&ztx->mt_queue);
 
-        free(w);
-    }
+    ztx_process_mt_requests(ztx);
+    ztx_run_work(ztx);
 }
 
 void ziti_queue_work(ziti_context ztx, ztx_work_f w, void *data) {
-    NEWP(wrk, struct ztx_work_s);
+    struct ztx_work_s *wrk = lf_pool_alloc(ztx->w_pool);
     wrk->w = w;
     wrk->w_data = data;
 
-    uv_mutex_trylock(&ztx->w_lock);
-    STAILQ_INSERT_TAIL(&ztx->w_queue, wrk, _next);
-    uv_mutex_unlock(&ztx->w_lock);
-
-    uv_async_send(&ztx->w_async);
+    // only the first submitter after the queue was drained needs to wake up the loop
+    if (mpsc_queue_push(&ztx->w_queue, &wrk->_next)) {
+        uv_async_send(&ztx->w_async);
+    }
 }
 
 static void copy_oidc(ziti_context ztx, const ziti_jwt_signer *oidc) {
@@ -1898,6 +2287,9 @@ int ziti_context_set_options(ziti_context ztx, const ziti_options *options) {
         copy_opt(refresh_interval);
         copy_opt(metrics_type);
         copy_opt(api_page_size);
+        copy_opt(api_page_concurrency);
+        copy_opt(api_conn_pool_size);
+        copy_opt(api_conn_keepalive);
         copy_opt(event_cb);
         copy_opt(events);
         copy_opt(app_ctx);
@@ -1906,6 +2298,7 @@ int ziti_context_set_options(ziti_context ztx, const ziti_options *options) {
         copy_opt(pq_os_cb);
         copy_opt(pq_process_cb);
         copy_opt(cert_extension_window);
+        copy_opt(crypto_threads);
 
 #undef copy_opt
     }
@@ -1923,10 +2316,12 @@ int ziti_context_run(ziti_context ztx, uv_loop_t *loop) {
     uv_timer_init(loop, &ztx->deadline_timer);
     ztx->deadline_timer.data = ztx;
 
-    STAILQ_INIT(&ztx->w_queue);
+    mpsc_queue_init(&ztx->w_queue);
+    ztx->w_pool = lf_pool_new(sizeof(struct ztx_work_s), ZTX_WORK_PREALLOC);
+    mpsc_queue_init(&ztx->mt_queue);
+    ztx->mt_pool = lf_pool_new(sizeof(struct conn_mt_req_s), ZTX_MT_PREALLOC);
     uv_async_init(loop, &ztx->w_async, ztx_work_async);
     ztx->w_async.data = ztx;
-    uv_mutex_init(&ztx->w_lock);
 
     ziti_queue_work(ztx, ziti_init_async, NULL);
 
@@ -2028,6 +2423,7 @@ void ztx_auth_state_cb(void *ctx, ziti_auth_state state, const void *data) {
             break;
     }
     ztx->auth_state = state;
+    ztx_shards_sync(ztx);
 }
 
 ziti_channel_t * ztx_get_channel(ziti_context ztx, const ziti_edge_router *er) {
@@ -2081,6 +2477,7 @@ static void cert_verify_cb(void *r, const ziti_error *err, void *ctx) {
     req->cert_resp->client_cert_pem = NULL;
 
     ztx_config_update(ztx);
+    ztx_tls_changed(ztx);
 
     done:
     if (req->new_cert) req->new_cert->free(req->new_cert);
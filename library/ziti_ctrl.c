@@ -17,17 +17,28 @@
 
 #include "utils.h"
 #include "zt_internal.h"
+#include "model_stream.h"
 #include <ziti_ctrl.h>
 #include <tlsuv/http.h>
 #include <assert.h>
 
 
 #define DEFAULT_PAGE_SIZE 25
-#define ZITI_CTRL_KEEPALIVE 0
+#define DEFAULT_PAGE_CONCURRENCY 4
+#define DEFAULT_CONN_POOL_SIZE 4
+#define DEFAULT_CTRL_KEEPALIVE 30000
 #define ZITI_CTRL_TIMEOUT 15000
 // one minute in millis
 #define ONE_MINUTE (1 * 60 * 1000)
 
+// HA endpoint selection: endpoints are probed every PROBE_INTERVAL, only probe latency is compared,
+// switch to a faster endpoint only if it is at least SWITCH_MIN_GAIN faster (and by SWITCH_RATIO)
+// and the current endpoint was used for at least SWITCH_HOLD_TIME
+#define PROBE_INTERVAL ONE_MINUTE
+#define SWITCH_HOLD_TIME (5 * ONE_MINUTE)
+#define SWITCH_MIN_GAIN 20000 // usec
+#define SWITCH_RATIO 70 // percent
+
 const char *const ERROR_CODE_UNAUTHORIZED = "UNAUTHORIZED";
 const char *const ERROR_MSG_NO_API_SESSION_TOKEN = "no api session token set for ziti_controller";
 
@@ -88,14 +99,24 @@ ctrl->url ? ctrl->url : "<unset>", ##__VA_ARGS__)
 
 #define MAKE_RESP(ctrl, cb, parser, ctx) prepare_resp(ctrl, (ctrl_resp_cb_t)(cb), (body_parse_fn)(parser), ctx)
 
+// response data is decoded directly into model type while body is received
+#define MAKE_MODEL_RESP(ctrl, cb, type, mod, ctx) \
+prepare_model_resp(ctrl, (ctrl_resp_cb_t)(cb), get_##type##_meta(), mod, ctx)
+
 typedef struct ctrl_resp ctrl_resp_t;
 typedef void (*ctrl_cb_t)(void *, const ziti_error *, ctrl_resp_t *);
 typedef void (*ctrl_resp_cb_t)(void *, const ziti_error *, void *);
 typedef int (*body_parse_fn)(void *, json_object *);
 
+enum ctrl_req_prio {
+    ctrl_prio_high, // dial path and authentication
+    ctrl_prio_low,  // background refresh, not sent on the primary connection
+};
+
 enum ctrl_content_type {
     ctrl_content_text,
     ctrl_content_json,
+    ctrl_content_model,
 };
 
 struct ctrl_resp {
@@ -105,14 +126,30 @@ struct ctrl_resp {
     void *content;
     json_object *resp_json;
 
+    // streaming decode of ctrl_content_model
+    const type_meta *data_meta;
+    enum _field_mod data_mod;
+    void *data;
+    resp_meta meta;
+    ziti_error error;
+
     uv_timeval64_t start;
     uv_timeval64_t all_start;
 
+    int conn; // index of connection in ctrl->conns, -1 when no request is active
+    // tlsuv advertises its available encodings and inflates the body before it gets to ctrl_body_cb
+    bool compressed;
+
     bool paging;
     const char *base_path;
     unsigned int limit;
     unsigned int total;
     unsigned int recd;
+    struct ctrl_pages *pages;
+
+    // set on requests for a single page of a parallel paging request
+    struct ctrl_resp *parent;
+    unsigned int page_idx;
 
     body_parse_fn body_parse_func;
     ctrl_resp_cb_t resp_cb;
@@ -125,25 +162,120 @@ struct ctrl_resp {
     ctrl_cb_t ctrl_cb;
 };
 
+// state of parallel paging request, pages after the first one
+struct ctrl_pages {
+    unsigned int count;
+    unsigned int offset;   // offset of the first page
+    unsigned int next;     // next page to request
+    unsigned int inflight;
+    void **data;           // received pages (JSON or model arrays), in offset order
+    ziti_error err;        // first error
+};
+
 static void internal_get_version(ziti_controller *ctrl);
 
 static struct ctrl_resp *prepare_resp(ziti_controller *ctrl, ctrl_resp_cb_t cb, body_parse_fn parser, void *ctx);
 
+static struct ctrl_resp *prepare_model_resp(ziti_controller *ctrl, ctrl_resp_cb_t cb,
+                                            const type_meta *meta, enum _field_mod mod, void *ctx);
+
+static void free_resp_data(const type_meta *meta, enum _field_mod mod, void *data);
+
+static void free_content_proc(struct ctrl_resp *resp);
+
 static void ctrl_paging_req(struct ctrl_resp *resp);
 
+static void ctrl_pages_start(struct ctrl_resp *resp, const resp_meta *meta);
+
+static void ctrl_pages_next(struct ctrl_resp *resp);
+
 static void ctrl_default_cb(void *s, const ziti_error *e, struct ctrl_resp *resp);
 
 static void ctrl_body_cb(tlsuv_http_req_t *req, char *b, ssize_t len);
 
 static const char* ctrl_next_ep(ziti_controller *ctrl, const char *current);
 
+static void ctrl_start_probes(ziti_controller *ctrl);
+
+static void ctrl_stop_probes(ziti_controller *ctrl);
+
+static tlsuv_http_t *ctrl_new_client(ziti_controller *ctrl);
+
+static long ctrl_keepalive(const ziti_controller *ctrl);
+
+static void ctrl_set_url(ziti_controller *ctrl, const char *url);
+
+static void ctrl_set_header(ziti_controller *ctrl, const char *name, const char *value);
+
+// idle connection wins, then new connection if pool is not full, then least loaded.
+// high priority only means conns[0] is not shared with background requests
+static int ctrl_pick_conn(ziti_controller *ctrl, enum ctrl_req_prio prio) {
+    unsigned int first = prio == ctrl_prio_low && ctrl->conn_count > 1 ? 1 : 0;
+    int best = -1;
+    int empty = -1;
+    for (unsigned int i = first; i < ctrl->conn_count; i++) {
+        ctrl_conn *c = &ctrl->conns[i];
+        if (c->client == NULL) {
+            if (empty == -1) {
+                empty = (int) i;
+            }
+            continue;
+        }
+        if (c->inflight == 0) {
+            return (int) i;
+        }
+        if (best == -1 || c->inflight < ctrl->conns[best].inflight) {
+            best = (int) i;
+        }
+    }
+
+    if (empty != -1 && (ctrl->conns[empty].client = ctrl_new_client(ctrl)) != NULL) {
+        CTRL_LOG(DEBUG, "opened connection[%d]", empty);
+        return empty;
+    }
+    return best != -1 ? best : 0;
+}
+
 static tlsuv_http_req_t *
-start_request(tlsuv_http_t *http, const char *method, const char *path, tlsuv_http_resp_cb cb, struct ctrl_resp *resp) {
+start_request(enum ctrl_req_prio prio, const char *method, const char *path, tlsuv_http_resp_cb cb,
+              struct ctrl_resp *resp) {
     ziti_controller *ctrl = resp->ctrl;
     ctrl->active_reqs++;
+    resp->conn = ctrl_pick_conn(ctrl, prio);
+    ctrl->conns[resp->conn].inflight++;
     uv_gettimeofday(&resp->start);
-    CTRL_LOG(VERBOSE, "starting %s[%s]", method, path);
-    return tlsuv_http_req(http, method, path, cb, resp);
+    CTRL_LOG(VERBOSE, "starting %s[%s] on connection[%d]", method, path, resp->conn);
+    return tlsuv_http_req(ctrl->conns[resp->conn].client, method, path, cb, resp);
+}
+
+static void on_http_close(tlsuv_http_t *clt);
+
+// close idle connections past the pool size, and forget trailing closed slots
+static void ctrl_drain_conns(ziti_controller *ctrl) {
+    for (unsigned int i = ctrl->conn_count; i < ctrl->conn_slots; i++) {
+        ctrl_conn *c = &ctrl->conns[i];
+        if (c->client && c->inflight == 0) {
+            CTRL_LOG(DEBUG, "closing drained connection[%u]", i);
+            tlsuv_http_close(c->client, on_http_close);
+            c->client = NULL;
+        }
+    }
+    while (ctrl->conn_slots > ctrl->conn_count && ctrl->conns[ctrl->conn_slots - 1].client == NULL) {
+        ctrl->conn_slots--;
+    }
+}
+
+// request is complete (or failed), its connection is available for the next one
+static void ctrl_req_done(struct ctrl_resp *resp) {
+    ziti_controller *ctrl = resp->ctrl;
+    if (resp->conn >= 0 && (unsigned int) resp->conn < ctrl->conn_slots &&
+        ctrl->conns[resp->conn].inflight > 0) {
+        ctrl->conns[resp->conn].inflight--;
+        if ((unsigned int) resp->conn >= ctrl->conn_count) {
+            ctrl_drain_conns(ctrl);
+        }
+    }
+    resp->conn = -1;
 }
 
 static const char *find_header(tlsuv_http_resp_t *r, const char *name) {
@@ -165,6 +297,7 @@ static void ctrl_resp_cb(tlsuv_http_resp_t *r, void *data) {
 
     resp->status = r->code;
     if (r->code < 0) {
+        ctrl_req_done(resp);
         int e = ZITI_CONTROLLER_UNAVAILABLE;
         const char *code = "CONTROLLER_UNAVAILABLE";
 
@@ -183,7 +316,7 @@ static void ctrl_resp_cb(tlsuv_http_resp_t *r, void *data) {
                     FREE(ctrl->url);
                     ctrl->url = strdup(next_ep);
                     CTRL_LOG(INFO, "switching to endpoint[%s]", ctrl->url);
-                    tlsuv_http_set_url(ctrl->client, next_ep);
+                    ctrl_set_url(ctrl, next_ep);
                     internal_get_version(ctrl);
                 }
             }
@@ -199,16 +332,26 @@ static void ctrl_resp_cb(tlsuv_http_resp_t *r, void *data) {
     } else {
         CTRL_LOG(VERBOSE, "received headers %s[%s]", r->req->method, r->req->path);
         r->body_cb = ctrl_body_cb;
+        resp->compressed = find_header(r, "content-encoding") != NULL;
 
         const char *hv;
         if ((hv = find_header(r, "content-type")) != NULL &&
             strncmp(hv, "application/json", strlen("application/json")) == 0) {
-            resp->resp_content = ctrl_content_json;
-            resp->content_proc = json_tokener_new();
+            if (resp->data_meta) {
+                model_stream *ms = new_model_stream();
+                model_stream_bind(ms, "meta", &resp->meta, get_resp_meta_meta(), none_mod);
+                model_stream_bind(ms, "error", &resp->error, get_ziti_error_meta(), none_mod);
+                model_stream_bind(ms, "data", &resp->data, resp->data_meta, resp->data_mod);
+                resp->resp_content = ctrl_content_model;
+                resp->content_proc = ms;
+            } else {
+                resp->resp_content = ctrl_content_json;
+                resp->content_proc = json_tokener_new();
+            }
         } else {
             resp->resp_content = ctrl_content_text;
             resp->content_proc = new_string_buf();
-            if (resp->body_parse_func) {
+            if (resp->body_parse_func || resp->data_meta) {
                 CTRL_LOG(ERROR, "received unexpected content: %s", hv);
             }
         }
@@ -252,7 +395,7 @@ static void ctrl_default_cb(void *s, const ziti_error *e, struct ctrl_resp *resp
         detail->name = strdup(ctrl->url);
         model_map_set(&ctrl->endpoints, detail->name, detail);
 
-        tlsuv_http_set_url(ctrl->client, ctrl->url);
+        ctrl_set_url(ctrl, ctrl->url);
 
         if (resp->ctrl->redirect_cb) {
             ctrl->redirect_cb(ctrl->url, ctrl->cb_ctx);
@@ -267,15 +410,42 @@ static void ctrl_default_cb(void *s, const ziti_error *e, struct ctrl_resp *resp
     if (resp->resp_json != NULL) {
         json_object_put(resp->resp_json);
     }
-    if (resp->content_proc != NULL) {
-        if (resp->resp_content == ctrl_content_json)
+    free_resp_data(resp->data_meta, resp->data_mod, resp->data);
+    free_ziti_error(&resp->error);
+    free_content_proc(resp);
+    free(resp);
+}
+
+static void free_resp_data(const type_meta *meta, enum _field_mod mod, void *data) {
+    if (data == NULL) {
+        return;
+    }
+
+    if (mod == array_mod) {
+        model_free_array((void ***) &data, meta);
+    } else {
+        model_free(data, meta);
+        free(data);
+    }
+}
+
+static void free_content_proc(struct ctrl_resp *resp) {
+    if (resp->content_proc == NULL) {
+        return;
+    }
+
+    switch (resp->resp_content) {
+        case ctrl_content_json:
             json_tokener_free(resp->content_proc);
-        else {
+            break;
+        case ctrl_content_model:
+            delete_model_stream(resp->content_proc);
+            break;
+        default:
             string_buf_free(resp->content_proc);
-            FREE(resp->content_proc);
-        }
+            free(resp->content_proc);
     }
-    free(resp);
+    resp->content_proc = NULL;
 }
 
 static void internal_ctrl_list_cb(ziti_controller_detail_array arr, const ziti_error *err, void *ctx) {
@@ -307,6 +477,7 @@ static void internal_ctrl_list_cb(ziti_controller_detail_array arr, const ziti_e
                 change = true;
             } else {
                 change = change || (old_detail->is_online != d->is_online);
+                d->rtt = old_detail->rtt;
             }
         } else {
             CTRL_LOG(DEBUG, "ctrl[%s] has no edge/v1 endpoint", d->name);
@@ -328,6 +499,10 @@ static void internal_ctrl_list_cb(ziti_controller_detail_array arr, const ziti_e
         model_map_clear(&new_eps, (void (*)(void *)) free_ziti_controller_detail_ptr);
     }
     free(arr);
+
+    if (ctrl->is_ha && model_map_size(&ctrl->endpoints) > 1) {
+        ctrl_start_probes(ctrl);
+    }
 }
 
 static void internal_version_cb(ziti_version *v, ziti_error *e, struct ctrl_resp *resp) {
@@ -351,7 +526,11 @@ static void internal_version_cb(ziti_version *v, ziti_error *e, struct ctrl_resp
         }
 
         if (path) {
-            tlsuv_http_set_path_prefix(resp->ctrl->client, path->path);
+            for (unsigned int i = 0; i < ctrl->conn_slots; i++) {
+                if (ctrl->conns[i].client) {
+                    tlsuv_http_set_path_prefix(ctrl->conns[i].client, path->path);
+                }
+            }
         } else {
             CTRL_LOG(WARN, "controller did not provide expected(v1) API version path");
         }
@@ -376,9 +555,9 @@ static void internal_version_cb(ziti_version *v, ziti_error *e, struct ctrl_resp
 
 void ziti_ctrl_clear_api_session(ziti_controller *ctrl) {
     ctrl->has_token = false;
-    if (ctrl->client) {
+    if (ctrl->conns) {
         CTRL_LOG(DEBUG, "clearing api session token for ziti_controller");
-        tlsuv_http_header(ctrl->client, "zt-session", NULL);
+        ctrl_set_header(ctrl, "zt-session", NULL);
         ziti_ctrl_set_token(ctrl, NULL);
     }
 }
@@ -394,7 +573,7 @@ static void ctrl_login_cb(ziti_api_session *s, ziti_error *e, struct ctrl_resp *
         CTRL_LOG(DEBUG, "authenticated successfully session[%s]", s->id);
         ctrl->has_token = true;
         if (!ctrl->is_ha) {
-            tlsuv_http_header(ctrl->client, "zt-session", s->token);
+            ctrl_set_header(ctrl, "zt-session", s->token);
         }
     }
     ctrl_default_cb(s, e, resp);
@@ -405,7 +584,7 @@ static void ctrl_logout_cb(void *s, ziti_error *e, struct ctrl_resp *resp) {
     CTRL_LOG(DEBUG, "logged out");
 
     ctrl->has_token = false;
-    tlsuv_http_header(ctrl->client, "zt-session", NULL);
+    ctrl_set_header(ctrl, "zt-session", NULL);
     ctrl_default_cb(s, e, resp);
 }
 
@@ -419,12 +598,53 @@ static void free_body_cb(tlsuv_http_req_t * UNUSED(req), char *body, ssize_t UNU
     free(body);
 }
 
+static void ctrl_resp_complete(struct ctrl_resp *resp, void *resp_obj, ziti_error *error,
+                               const char *path, int http_code) {
+    ziti_controller *ctrl = resp->ctrl;
+    if (resp->body_parse_func && resp->resp_json != NULL) {
+        if (resp->body_parse_func(&resp_obj, resp->resp_json) < 0) {
+            CTRL_LOG(ERROR, "error parsing response data for req[%s]", path);
+            error->code = strdup("INVALID_CONTROLLER_RESPONSE");
+            error->message = strdup("unexpected response JSON");
+        }
+        json_object_put(resp->resp_json);
+        resp->resp_json = NULL;
+        free_content_proc(resp);
+    }
+
+    if (error->code) {
+        error->err = code_to_error(error->code);
+        error->http_code = http_code;
+
+        CTRL_LOG(ERROR, "API request[%s] failed code[%s] message[%s]",
+                 path, error->code, error->message);
+    }
+    if (error->err != ZITI_OK) {
+        resp->ctrl_cb(NULL, error, resp);
+    } else {
+        resp->ctrl_cb(resp_obj, NULL, resp);
+    }
+    free_ziti_error(error);
+}
+
 static void ctrl_body_cb(tlsuv_http_req_t *req, char *b, ssize_t len) {
     struct ctrl_resp *resp = req->data;
     ziti_controller *ctrl = resp->ctrl;
 
     if (len > 0) {
-        if (resp->resp_content == ctrl_content_json) {
+        if (resp->resp_content == ctrl_content_model) {
+            int rc = model_stream_status(resp->content_proc);
+            if (rc == MODEL_PARSE_PARTIAL) {
+                CTRL_LOG(VERBOSE, "HTTP RESPONSE: %.*s", (int)len, b);
+                rc = model_stream_feed(resp->content_proc, b, len);
+                if (rc < 0 && rc != MODEL_PARSE_PARTIAL) {
+                    CTRL_LOG(WARN, "parsing error: %d", rc);
+                }
+            } else if (rc == 0) {
+                CTRL_LOG(WARN, "dropping unexpected extra data after JSON payload: %.*s",
+                         (int)len, b);
+            }
+        } else if (resp->resp_content == ctrl_content_json) {
             if (resp->content == NULL) {
                 CTRL_LOG(VERBOSE, "HTTP RESPONSE: %.*s", (int)len, b);
                 resp->content = json_tokener_parse_ex(resp->content_proc, b, (int) len);
@@ -440,39 +660,62 @@ static void ctrl_body_cb(tlsuv_http_req_t *req, char *b, ssize_t len) {
             string_buf_appendn(resp->content_proc, b, len);
         }
     } else if (len == UV_EOF) {
+        ctrl_req_done(resp);
         void *resp_obj = NULL;
         uv_timeval64_t now;
         uv_gettimeofday(&now);
 
         ziti_error error = {};
         if (resp->resp_content == ctrl_content_text) {
-            if (resp->body_parse_func) {
+            if (resp->body_parse_func || resp->data_meta) {
                 error.code = strdup("INVALID_CONTROLLER_RESPONSE");
                 error.message = strdup("received non-JSON response");
             } else {
                 resp_obj = string_buf_to_string(resp->content_proc, NULL);
             }
-            string_buf_free(resp->content_proc);
-            FREE(resp->content_proc);
+            free_content_proc(resp);
         } else {
-            json_object *err_json = json_object_object_get(resp->content, "error");
-            if (err_json) {
-                if (ziti_error_from_json(&error, err_json) != 0) {
+            resp_meta meta = {0};
+            json_object *data = NULL;
+            if (resp->resp_content == ctrl_content_model) {
+                int rc = model_stream_status(resp->content_proc);
+                free_content_proc(resp);
+
+                error = resp->error;
+                resp->error = (ziti_error){0};
+                meta = resp->meta;
+                if (rc != 0 && error.code == NULL) {
+                    CTRL_LOG(ERROR, "error parsing response data for req[%s]: %d", req->path, rc);
                     error.code = strdup("INVALID_CONTROLLER_RESPONSE");
-                    error.message = strdup(json_object_get_string(err_json));
+                    error.message = strdup("unexpected response JSON");
+                }
+            } else {
+                json_object *err_json = json_object_object_get(resp->content, "error");
+                if (err_json) {
+                    if (ziti_error_from_json(&error, err_json) != 0) {
+                        error.code = strdup("INVALID_CONTROLLER_RESPONSE");
+                        error.message = strdup(json_object_get_string(err_json));
+                    }
                 }
+                resp_meta_from_json(&meta, json_object_object_get(resp->content, "meta"));
+                data = json_object_object_get(resp->content, "data");
+                data = json_object_get(data);
+                json_object_put(resp->content);
+                resp->content = NULL;
             }
-            resp_meta meta = {0};
-            resp_meta_from_json(&meta, json_object_object_get(resp->content, "meta"));
-            json_object *data = json_object_object_get(resp->content, "data");
-            data = json_object_get(data);
-            json_object_put(resp->content);
-            resp->content = NULL;
 
             if (resp->paging) {
                 bool last_page = meta.pagination.total <=
                                  meta.pagination.offset + meta.pagination.limit;
-                if (json_object_get_type(data) == json_type_array) {
+                if (resp->resp_content == ctrl_content_model) {
+                    // pages are appended to the same array
+                    void **arr = resp->data;
+                    while (arr && arr[resp->recd]) {
+                        resp->recd++;
+                    }
+                    CTRL_LOG(DEBUG, "received %d/%d for paging request GET[%s]",
+                             resp->recd, (int)meta.pagination.total, resp->base_path);
+                } else if (json_object_get_type(data) == json_type_array) {
                     resp->recd += json_object_array_length(data);
                     if (resp->resp_json == NULL) {
                         resp->resp_json = data;
@@ -487,10 +730,13 @@ static void ctrl_body_cb(tlsuv_http_req_t *req, char *b, ssize_t len) {
                     CTRL_LOG(DEBUG, "received %d/%d for paging request GET[%s]",
                              resp->recd, (int)meta.pagination.total, resp->base_path);
                 }
-                if (!last_page) {
-                    json_tokener_free(resp->content_proc);
-                    resp->content_proc = NULL;
-                    ctrl_paging_req(resp);
+                if (!last_page && error.code == NULL) {
+                    free_content_proc(resp);
+                    if (resp->pages == NULL && ctrl->page_concurrency > 1) {
+                        ctrl_pages_start(resp, &meta);
+                    } else {
+                        ctrl_paging_req(resp);
+                    }
                     return;
                 }
                 uint64_t elapsed = (now.tv_sec * 1000000 + now.tv_usec) - (resp->all_start.tv_sec * 1000000 + resp->all_start.tv_usec);
@@ -499,48 +745,26 @@ static void ctrl_body_cb(tlsuv_http_req_t *req, char *b, ssize_t len) {
 
             } else {
                 uint64_t elapsed = (now.tv_sec * 1000000 + now.tv_usec) - (resp->start.tv_sec * 1000000 + resp->start.tv_usec);
-                CTRL_LOG(DEBUG, "completed %s[%s] in %" PRIu64 ".%03" PRIu64 " s",
-                         req->method, req->path, elapsed / 1000000, (elapsed / 1000) % 1000);
+                CTRL_LOG(DEBUG, "completed %s[%s]%s in %" PRIu64 ".%03" PRIu64 " s",
+                         req->method, req->path, resp->compressed ? "(compressed)" : "",
+                         elapsed / 1000000, (elapsed / 1000) % 1000);
                 resp->resp_json = data;
             }
-            
-            if (resp->body_parse_func && resp->resp_json != NULL) {
-                if (resp->body_parse_func(&resp_obj, resp->resp_json) < 0) {
-                    CTRL_LOG(ERROR, "error parsing response data for req[%s]", req->path);
-                    error.code = strdup("INVALID_CONTROLLER_RESPONSE");
-                    error.message = strdup("unexpected response JSON");
-                }
-                json_object_put(resp->resp_json);
-                resp->resp_json = NULL;
-                json_tokener_free(resp->content_proc);
-                resp->content_proc = NULL;
+
+            // partially decoded data is released with the response
+            if (resp->resp_content == ctrl_content_model && error.code == NULL) {
+                resp_obj = resp->data;
+                resp->data = NULL;
             }
         }
 
-        if (error.code) {
-            error.err = code_to_error(error.code);
-            error.http_code = req->resp.code;
-
-            CTRL_LOG(ERROR, "API request[%s] failed code[%s] message[%s]",
-                     req->path, error.code, error.message);
-        }
-        if (error.err != ZITI_OK) {
-            resp->ctrl_cb(NULL, &error, resp);
-        } else {
-            resp->ctrl_cb(resp_obj, NULL, resp);
-        }
-        free_ziti_error(&error);
+        ctrl_resp_complete(resp, resp_obj, &error, req->path, req->resp.code);
     } else {
+        ctrl_req_done(resp);
         CTRL_LOG(WARN, "failed to read response body: %zd[%s]", len, uv_strerror(len));
-        if (resp->resp_content == ctrl_content_json) {
-            json_tokener_free(resp->content_proc);
-            json_object_put(resp->resp_json);
-            resp->resp_json = NULL;
-        } else {
-            string_buf_free(resp->content_proc);
-            FREE(resp->content_proc);
-        }
-        resp->content_proc = NULL;
+        free_content_proc(resp);
+        json_object_put(resp->resp_json);
+        resp->resp_json = NULL;
         ziti_error err = {
                 .err = ZITI_CONTROLLER_UNAVAILABLE,
                 .code = "CONTROLLER_UNAVAILABLE",
@@ -551,11 +775,11 @@ static void ctrl_body_cb(tlsuv_http_req_t *req, char *b, ssize_t len) {
             err.err = ZITI_DISABLED;
             err.code = "CONTEXT_DISABLED";
         }
-        resp->resp_cb(NULL, &err, resp);
+        resp->ctrl_cb(NULL, &err, resp);
     }
 }
 
-// pick next random endpoint
+// pick fastest measured online endpoint, or random one if latencies are not known yet
 static const char* ctrl_next_ep(ziti_controller *ctrl, const char *current) {
     if(model_map_size(&ctrl->endpoints) == 0) {
         CTRL_LOG(WARN, "empty endpoints map");
@@ -582,7 +806,19 @@ static const char* ctrl_next_ep(ziti_controller *ctrl, const char *current) {
         }
     }
     const char *next = NULL;
-    if (model_list_size(&online) > 0) {
+    int64_t best_rtt = 0;
+    MODEL_LIST_FOREACH(url, online) {
+        d = model_map_get(&ctrl->endpoints, url);
+        if (d && d->rtt > 0 && (next == NULL || d->rtt < best_rtt)) {
+            next = url;
+            best_rtt = d->rtt;
+        }
+    }
+
+    if (next != NULL) {
+        CTRL_LOG(DEBUG, "fastest online endpoint[%s] rtt[%" PRId64 ".%03" PRId64 " ms]",
+                 next, best_rtt / 1000, best_rtt % 1000);
+    } else if (model_list_size(&online) > 0) {
         int rand = (int) (uv_now(ctrl->loop) % model_list_size(&online));
         model_list_iter it = model_list_iterator(&online);
         for (int i = 0; i < rand; i++) {
@@ -606,6 +842,284 @@ static const char* ctrl_next_ep(ziti_controller *ctrl, const char *current) {
     return next;
 }
 
+bool ziti_ctrl_is_current(const ziti_controller *ctrl, const char *url) {
+    if (ctrl->url == NULL || url == NULL) {
+        return false;
+    }
+    size_t len = strlen(ctrl->url);
+    while (len > 0 && ctrl->url[len - 1] == '/') {
+        len--;
+    }
+    return strncmp(url, ctrl->url, len) == 0 && (url[len] == '\0' || url[len] == '/');
+}
+
+static ziti_controller_detail *ctrl_find_ep(ziti_controller *ctrl, const char *url) {
+    if (url == NULL) {
+        return NULL;
+    }
+    ziti_controller_detail *d = model_map_get(&ctrl->endpoints, url);
+    if (d == NULL && url == ctrl->url) {
+        const char *ep;
+        MODEL_MAP_FOREACH(ep, d, &ctrl->endpoints) {
+            if (ziti_ctrl_is_current(ctrl, ep)) {
+                return d;
+            }
+        }
+        d = NULL;
+    }
+    return d;
+}
+
+// exponentially weighted moving average of request latency, 1/8 weight of the new sample
+static void ctrl_update_rtt(ziti_controller_detail *d, int64_t sample) {
+    if (sample <= 0) {
+        sample = 1;
+    }
+    d->rtt = d->rtt > 0 ? (d->rtt * 7 + sample) / 8 : sample;
+}
+
+// probe measurement: time to response headers.
+// regular requests are not sampled, they queue behind each other and could be sent before an endpoint switch
+static void ctrl_rtt_sample(ziti_controller *ctrl, const char *url, const uv_timeval64_t *start) {
+    ziti_controller_detail *d = ctrl_find_ep(ctrl, url);
+    if (d == NULL) {
+        return;
+    }
+
+    uv_timeval64_t now;
+    uv_gettimeofday(&now);
+    ctrl_update_rtt(d, (now.tv_sec - start->tv_sec) * 1000000 + (now.tv_usec - start->tv_usec));
+}
+
+// switch to the fastest online endpoint if it is significantly faster than the current one
+static void ctrl_check_switch(ziti_controller *ctrl) {
+    if (!ctrl->is_ha || ctrl->active_reqs > 0 || ctrl->url == NULL) {
+        return;
+    }
+
+    uint64_t now = uv_now(ctrl->loop);
+    if (ctrl->switch_time != 0 && now - ctrl->switch_time < SWITCH_HOLD_TIME) {
+        return;
+    }
+
+    ziti_controller_detail *curr = ctrl_find_ep(ctrl, ctrl->url);
+    if (curr == NULL || curr->rtt <= 0) {
+        return;
+    }
+
+    const char *best = NULL;
+    int64_t best_rtt = curr->rtt;
+    const char *url;
+    ziti_controller_detail *d;
+    MODEL_MAP_FOREACH(url, d, &ctrl->endpoints) {
+        if (d && d != curr && d->is_online && d->rtt > 0 && d->rtt < best_rtt) {
+            best = url;
+            best_rtt = d->rtt;
+        }
+    }
+
+    if (best == NULL ||
+        best_rtt * 100 > curr->rtt * SWITCH_RATIO ||
+        curr->rtt - best_rtt < SWITCH_MIN_GAIN) {
+        return;
+    }
+
+    CTRL_LOG(INFO, "switching to faster endpoint[%s] rtt[%" PRId64 " ms] current rtt[%" PRId64 " ms]",
+             best, best_rtt / 1000, curr->rtt / 1000);
+    FREE(ctrl->url);
+    ctrl->url = strdup(best);
+    ctrl_set_url(ctrl, ctrl->url);
+    ctrl->switch_time = now;
+    ctrl->probe_report = true;
+    internal_get_version(ctrl);
+}
+
+// active measurement: two GET /version on a dedicated connection, kept open between rounds,
+// only the second one is timed so that connect and TLS handshake are not counted
+struct ctrl_probe {
+    ziti_controller *ctrl; // NULL once probe is stopped
+    char *url;
+    tlsuv_http_t client;
+    bool busy; // probe is part of the current round
+    unsigned int round;
+    uv_timeval64_t start;
+};
+
+static void probe_resp_cb(tlsuv_http_resp_t *r, void *data);
+
+static void probe_close_cb(tlsuv_http_t *clt) {
+    struct ctrl_probe *p = container_of(clt, struct ctrl_probe, client);
+    free(p->url);
+    free(p);
+}
+
+static void probe_close(struct ctrl_probe *p) {
+    p->ctrl = NULL;
+    tlsuv_http_close(&p->client, probe_close_cb);
+}
+
+static void probe_send(struct ctrl_probe *p) {
+    uv_gettimeofday(&p->start);
+    tlsuv_http_req(&p->client, "GET", "/version", probe_resp_cb, p);
+}
+
+static void probe_done(struct ctrl_probe *p, int err) {
+    ziti_controller *ctrl = p->ctrl;
+    p->busy = false;
+
+    ziti_controller_detail *d = model_map_get(&ctrl->endpoints, p->url);
+    if (d != NULL) {
+        if (err == 0) {
+            ctrl_rtt_sample(ctrl, p->url, &p->start);
+            if (!d->is_online) {
+                CTRL_LOG(INFO, "endpoint[%s] is back online", p->url);
+                d->is_online = true;
+                ctrl->probe_report = true;
+            }
+        } else if (d->is_online) {
+            CTRL_LOG(WARN, "endpoint[%s] probe failed: %d(%s)", p->url, err, uv_strerror(err));
+            d->is_online = false;
+            d->offline_time = (model_number) uv_now(ctrl->loop);
+            d->rtt = 0;
+            ctrl->probe_report = true;
+        }
+    }
+
+    assert(ctrl->probes_pending > 0);
+    if (--ctrl->probes_pending > 0) {
+        return;
+    }
+
+    // probe round is complete
+    const char *url;
+    MODEL_MAP_FOREACH(url, d, &ctrl->endpoints) {
+        if (d == NULL) continue;
+        CTRL_LOG(DEBUG, "endpoint[%s] online[%s] rtt[%" PRId64 ".%03" PRId64 " ms]%s",
+                 url, d->is_online ? "Y" : "N", d->rtt / 1000, d->rtt % 1000,
+                 ziti_ctrl_is_current(ctrl, url) ? " (current)" : "");
+    }
+    ctrl_check_switch(ctrl);
+    if (ctrl->probe_report && ctrl->change_cb) {
+        ctrl->probe_report = false;
+        ctrl->change_cb(ctrl->cb_ctx, &ctrl->endpoints);
+    }
+}
+
+static void probe_body_cb(tlsuv_http_req_t *req, char *UNUSED(b), ssize_t len) {
+    struct ctrl_probe *p = req->data;
+    if (len >= 0 || p->ctrl == NULL || !p->busy) {
+        return;
+    }
+
+    if (len != UV_EOF) {
+        probe_done(p, (int) len);
+    } else if (p->round++ == 0) {
+        probe_send(p);
+    } else {
+        probe_done(p, 0);
+    }
+}
+
+static void probe_resp_cb(tlsuv_http_resp_t *r, void *data) {
+    struct ctrl_probe *p = data;
+    if (p->ctrl == NULL || !p->busy) {
+        return;
+    }
+
+    if (r->code < 0) {
+        probe_done(p, r->code);
+    } else {
+        r->body_cb = probe_body_cb;
+    }
+}
+
+static struct ctrl_probe *probe_new(ziti_controller *ctrl, const char *url) {
+    struct ctrl_probe *p = calloc(1, sizeof(*p));
+    if (tlsuv_http_init(ctrl->loop, &p->client, url) != 0) {
+        CTRL_LOG(WARN, "failed to probe endpoint[%s]", url);
+        free(p);
+        return NULL;
+    }
+    p->ctrl = ctrl;
+    p->url = strdup(url);
+    tlsuv_http_set_ssl(&p->client, ctrl->tls);
+    tlsuv_http_connect_timeout(&p->client, ZITI_CTRL_TIMEOUT);
+    // keep connection between rounds, only the first round pays for the handshake
+    tlsuv_http_idle_keepalive(&p->client, -1);
+    return p;
+}
+
+static struct ctrl_probe *probe_find(ziti_controller *ctrl, const char *url) {
+    struct ctrl_probe *p;
+    MODEL_LIST_FOREACH(p, ctrl->probes) {
+        if (strcmp(p->url, url) == 0) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static void ctrl_probe_timer_cb(uv_timer_t *t) {
+    ziti_controller *ctrl = t->data;
+    if (ctrl->probes_pending > 0) {
+        CTRL_LOG(DEBUG, "previous probe round is still in progress");
+        return;
+    }
+
+    // drop probes of endpoints that are no longer listed
+    struct ctrl_probe *p;
+    model_list_iter it = model_list_iterator(&ctrl->probes);
+    while (it != NULL) {
+        p = (struct ctrl_probe *) model_list_it_element(it);
+        if (model_map_get(&ctrl->endpoints, p->url) == NULL) {
+            it = model_list_it_remove(it);
+            probe_close(p);
+        } else {
+            it = model_list_it_next(it);
+        }
+    }
+
+    const char *url;
+    ziti_controller_detail *d;
+    MODEL_MAP_FOREACH(url, d, &ctrl->endpoints) {
+        if ((p = probe_find(ctrl, url)) == NULL) {
+            if ((p = probe_new(ctrl, url)) == NULL) {
+                continue;
+            }
+            model_list_append(&ctrl->probes, p);
+        }
+        p->busy = true;
+        p->round = 0;
+        ctrl->probes_pending++;
+        probe_send(p);
+    }
+}
+
+static void ctrl_start_probes(ziti_controller *ctrl) {
+    if (ctrl->probe_timer != NULL) {
+        return;
+    }
+
+    CTRL_LOG(DEBUG, "starting endpoint latency probes");
+    ctrl->probe_timer = calloc(1, sizeof(uv_timer_t));
+    uv_timer_init(ctrl->loop, ctrl->probe_timer);
+    uv_unref((uv_handle_t *) ctrl->probe_timer);
+    ctrl->probe_timer->data = ctrl;
+    ctrl->probe_report = true; // report first measurements
+    uv_timer_start(ctrl->probe_timer, ctrl_probe_timer_cb, 0, ctrl->probe_interval);
+}
+
+static void ctrl_stop_probes(ziti_controller *ctrl) {
+    if (ctrl->probe_timer) {
+        uv_close((uv_handle_t *) ctrl->probe_timer, (uv_close_cb) free);
+        ctrl->probe_timer = NULL;
+    }
+
+    // requests are cancelled by close, callbacks are ignored since probe->ctrl is cleared
+    model_list_clear(&ctrl->probes, (void (*)(void *)) probe_close);
+    ctrl->probes_pending = 0;
+}
+
 int ziti_ctrl_init(uv_loop_t *loop, ziti_controller *ctrl, model_list *urls, tls_context *tls) {
     *ctrl = (ziti_controller){0};
     if (model_list_size(urls) == 0) {
@@ -613,7 +1127,11 @@ int ziti_ctrl_init(uv_loop_t *loop, ziti_controller *ctrl, model_list *urls, tls
         return ZITI_INVALID_CONFIG;
     }
     ctrl->page_size = DEFAULT_PAGE_SIZE;
+    ctrl->page_concurrency = DEFAULT_PAGE_CONCURRENCY;
+    ctrl->keepalive = DEFAULT_CTRL_KEEPALIVE;
+    ctrl->probe_interval = PROBE_INTERVAL;
     ctrl->loop = loop;
+    ctrl->tls = tls;
     memset(&ctrl->version, 0, sizeof(ctrl->version));
 
     const char *ep;
@@ -626,22 +1144,17 @@ int ziti_ctrl_init(uv_loop_t *loop, ziti_controller *ctrl, model_list *urls, tls
     const char *initial_ep = ctrl_next_ep(ctrl, NULL);
     ctrl->url = strdup(initial_ep);
 
-    ctrl->client = calloc(1, sizeof(tlsuv_http_t));
-    if (tlsuv_http_init(loop, ctrl->client, ctrl->url) != 0) {
-        if (tlsuv_http_close(ctrl->client, (tlsuv_http_close_cb) free) != 0) {
-            free(ctrl->client);
-        }
-        ctrl->client = NULL;
+    ctrl_set_header(ctrl, "Accept", "application/json");
+    tlsuv_http_t *clt = ctrl_new_client(ctrl);
+    if (clt == NULL) {
         return ZITI_INVALID_CONFIG;
     }
+    ctrl->conns = calloc(DEFAULT_CONN_POOL_SIZE, sizeof(ctrl_conn));
+    ctrl->conn_count = DEFAULT_CONN_POOL_SIZE;
+    ctrl->conn_slots = DEFAULT_CONN_POOL_SIZE;
+    ctrl->conns[0].client = clt;
     CTRL_LOG(INFO, "controller initialized");
 
-    tlsuv_http_set_path_prefix(ctrl->client, "");
-    ctrl->client->data = ctrl;
-    tlsuv_http_set_ssl(ctrl->client, tls);
-    tlsuv_http_idle_keepalive(ctrl->client, ZITI_CTRL_KEEPALIVE);
-    tlsuv_http_connect_timeout(ctrl->client, ZITI_CTRL_TIMEOUT);
-    tlsuv_http_header(ctrl->client, "Accept", "application/json");
     ctrl->has_token = false;
     ctrl->instance_id = NULL;
 
@@ -652,7 +1165,7 @@ int ziti_ctrl_init(uv_loop_t *loop, ziti_controller *ctrl, model_list *urls, tls
 
 int ziti_ctrl_set_token(ziti_controller *ctrl, const char *token) {
     if (token == NULL) {
-        tlsuv_http_header(ctrl->client, "Authorization", NULL);
+        ctrl_set_header(ctrl, "Authorization", NULL);
         ctrl->has_token = false;
         return 0;
     }
@@ -662,7 +1175,7 @@ int ziti_ctrl_set_token(ziti_controller *ctrl, const char *token) {
     char *header = string_buf_to_string(b, NULL);
 
     ctrl->has_token = true;
-    tlsuv_http_header(ctrl->client, "Authorization", header);
+    ctrl_set_header(ctrl, "Authorization", header);
 
     free(header);
     delete_string_buf(b);
@@ -674,10 +1187,96 @@ int ziti_ctrl_set_token(ziti_controller *ctrl, const char *token) {
     return ZITI_OK;
 }
 
+static tlsuv_http_t *ctrl_new_client(ziti_controller *ctrl) {
+    tlsuv_http_t *clt = calloc(1, sizeof(tlsuv_http_t));
+    if (tlsuv_http_init(ctrl->loop, clt, ctrl->url) != 0) {
+        if (tlsuv_http_close(clt, (tlsuv_http_close_cb) free) != 0) {
+            free(clt);
+        }
+        return NULL;
+    }
+
+    const char *prefix = "";
+    if (ctrl->version.api_versions) {
+        api_path *path = model_map_get(&ctrl->version.api_versions->edge, "v1");
+        if (path) {
+            prefix = path->path;
+        }
+    }
+    tlsuv_http_set_path_prefix(clt, prefix);
+    clt->data = ctrl;
+    tlsuv_http_set_ssl(clt, ctrl->tls);
+    tlsuv_http_idle_keepalive(clt, ctrl_keepalive(ctrl));
+    tlsuv_http_connect_timeout(clt, ZITI_CTRL_TIMEOUT);
+
+    const char *name;
+    const char *value;
+    MODEL_MAP_FOREACH(name, value, &ctrl->headers) {
+        tlsuv_http_header(clt, name, value);
+    }
+    return clt;
+}
+
+// tlsuv: 0 - close after request, negative - never close
+static long ctrl_keepalive(const ziti_controller *ctrl) {
+    return ctrl->keepalive < 0 ? 0 : ctrl->keepalive;
+}
+
+static void ctrl_set_url(ziti_controller *ctrl, const char *url) {
+    for (unsigned int i = 0; i < ctrl->conn_slots; i++) {
+        if (ctrl->conns[i].client) {
+            tlsuv_http_set_url(ctrl->conns[i].client, url);
+        }
+    }
+}
+
+// header is kept for clients created later
+static void ctrl_set_header(ziti_controller *ctrl, const char *name, const char *value) {
+    char *old = value ? model_map_set(&ctrl->headers, name, strdup(value)) : model_map_remove(&ctrl->headers, name);
+    free(old);
+
+    for (unsigned int i = 0; i < ctrl->conn_slots; i++) {
+        if (ctrl->conns[i].client) {
+            tlsuv_http_header(ctrl->conns[i].client, name, value);
+        }
+    }
+}
+
 void ziti_ctrl_set_page_size(ziti_controller *ctrl, unsigned int size) {
     ctrl->page_size = size;
 }
 
+void ziti_ctrl_set_page_concurrency(ziti_controller *ctrl, unsigned int count) {
+    ctrl->page_concurrency = count > 0 ? count : 1;
+}
+
+void ziti_ctrl_set_conn_pool(ziti_controller *ctrl, unsigned int size, long keepalive) {
+    if (keepalive != 0) {
+        ctrl->keepalive = keepalive;
+    }
+    if (size == 0 || ctrl->conns == NULL) {
+        size = ctrl->conn_count;
+    }
+
+    // growing reuses draining slots first, shrinking lets in-flight requests complete
+    if (size > ctrl->conn_slots) {
+        ctrl->conns = realloc(ctrl->conns, size * sizeof(ctrl_conn));
+        for (unsigned int i = ctrl->conn_slots; i < size; i++) {
+            ctrl->conns[i] = (ctrl_conn){0};
+        }
+        ctrl->conn_slots = size;
+    }
+    ctrl->conn_count = size;
+    ctrl_drain_conns(ctrl);
+
+    for (unsigned int i = 0; i < ctrl->conn_slots; i++) {
+        if (ctrl->conns[i].client) {
+            tlsuv_http_idle_keepalive(ctrl->conns[i].client, ctrl_keepalive(ctrl));
+        }
+    }
+    CTRL_LOG(DEBUG, "using up to %u connections, keepalive[%ld]", ctrl->conn_count, ctrl->keepalive);
+}
+
 void ziti_ctrl_set_callbacks(ziti_controller *ctrl, void *ctx,
                              ziti_ctrl_redirect_cb redirect_cb,
                              ziti_ctrl_change_cb change_cb) {
@@ -691,21 +1290,31 @@ static void on_http_close(tlsuv_http_t *clt) {
 }
 
 int ziti_ctrl_cancel(ziti_controller *ctrl) {
-    if (ctrl->client == NULL) {
-        return ZITI_OK;
+    int rc = ZITI_OK;
+    for (unsigned int i = 0; ctrl->conns && i < ctrl->conn_slots; i++) {
+        if (ctrl->conns[i].client) {
+            int r = tlsuv_http_cancel_all(ctrl->conns[i].client);
+            rc = rc ? rc : r;
+        }
     }
-    return tlsuv_http_cancel_all(ctrl->client);
+    return rc;
 }
 
 int ziti_ctrl_close(ziti_controller *ctrl) {
+    ctrl_stop_probes(ctrl);
     free_ziti_version(&ctrl->version);
     model_map_clear(&ctrl->endpoints, (void (*)(void *)) free_ziti_controller_detail_ptr);
     FREE(ctrl->url);
     FREE(ctrl->instance_id);
-    if (ctrl->client) {
-        tlsuv_http_close(ctrl->client, on_http_close);
+    model_map_clear(&ctrl->headers, free);
+    for (unsigned int i = 0; ctrl->conns && i < ctrl->conn_slots; i++) {
+        if (ctrl->conns[i].client) {
+            tlsuv_http_close(ctrl->conns[i].client, on_http_close);
+        }
     }
-    ctrl->client = NULL;
+    FREE(ctrl->conns);
+    ctrl->conn_count = 0;
+    ctrl->conn_slots = 0;
     return ZITI_OK;
 }
 
@@ -713,7 +1322,7 @@ static void internal_get_version(ziti_controller *ctrl) {
     struct ctrl_resp *resp = MAKE_RESP(ctrl, NULL, ziti_version_ptr_from_json, NULL);
     resp->ctrl_cb = (ctrl_cb_t) internal_version_cb;
 
-    ctrl->version_req = start_request(ctrl->client, "GET", "/version", ctrl_resp_cb, resp);
+    ctrl->version_req = start_request(ctrl_prio_high, "GET", "/version", ctrl_resp_cb, resp);
 }
 
 void ziti_ctrl_get_version(ziti_controller *ctrl, ctrl_version_cb cb, void *ctx) {
@@ -761,7 +1370,7 @@ void ziti_ctrl_login(
     struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, ziti_api_session_ptr_from_json, ctx);
     resp->ctrl_cb = (ctrl_cb_t)ctrl_login_cb;
 
-    tlsuv_http_req_t *req = start_request(ctrl->client, "POST", "/authenticate?method=cert", ctrl_resp_cb, resp);
+    tlsuv_http_req_t *req = start_request(ctrl_prio_high, "POST", "/authenticate?method=cert", ctrl_resp_cb, resp);
     tlsuv_http_req_header(req, "Content-Type", "application/json");
     tlsuv_http_req_data(req, body, body_len, free_body_cb);
 
@@ -798,7 +1407,7 @@ void ziti_ctrl_login_ext_jwt(ziti_controller *ctrl, const char *jwt,
     string_buf_append(auth, jwt);
     char *auth_hdr = string_buf_to_string(auth, NULL);
 
-    tlsuv_http_req_t *req = start_request(ctrl->client, "POST", "/authenticate", ctrl_resp_cb, resp);
+    tlsuv_http_req_t *req = start_request(ctrl_prio_high, "POST", "/authenticate", ctrl_resp_cb, resp);
     tlsuv_http_req_header(req, "authorization", auth_hdr);
     tlsuv_http_req_header(req, "Content-Type", "application/json");
     tlsuv_http_req_query(req, 1, &(tlsuv_http_pair){"method", "ext-jwt"});
@@ -829,7 +1438,7 @@ void ziti_ctrl_current_identity(ziti_controller *ctrl, void(*cb)(ziti_identity_d
     if(!verify_api_session(ctrl, (void (*)(void *, const ziti_error *, void *)) cb, ctx)) return;
 
     struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, ziti_identity_data_ptr_from_json, ctx);
-    start_request(ctrl->client, "GET", "/current-identity", ctrl_resp_cb, resp);
+    start_request(ctrl_prio_high, "GET", "/current-identity", ctrl_resp_cb, resp);
 }
 
 void ziti_ctrl_current_api_session(ziti_controller *ctrl, void(*cb)(ziti_api_session *, const ziti_error *, void *), void *ctx) {
@@ -838,7 +1447,7 @@ void ziti_ctrl_current_api_session(ziti_controller *ctrl, void(*cb)(ziti_api_ses
     struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, ziti_api_session_ptr_from_json, ctx);
     resp->ctrl_cb = (ctrl_cb_t) ctrl_login_cb;
 
-    start_request(ctrl->client, "GET", "/current-api-session", ctrl_resp_cb, resp);
+    start_request(ctrl_prio_high, "GET", "/current-api-session", ctrl_resp_cb, resp);
 }
 
 void ziti_ctrl_mfa_jwt(ziti_controller *ctrl, const char *token, void(*cb)(ziti_api_session *, const ziti_error *, void *), void *ctx) {
@@ -852,7 +1461,7 @@ void ziti_ctrl_mfa_jwt(ziti_controller *ctrl, const char *token, void(*cb)(ziti_
     char *header = string_buf_to_string(b, NULL);
 
 
-    tlsuv_http_req_t *req = start_request(ctrl->client, "GET", "/current-api-session", ctrl_resp_cb, resp);
+    tlsuv_http_req_t *req = start_request(ctrl_prio_high, "GET", "/current-api-session", ctrl_resp_cb, resp);
     tlsuv_http_req_header(req, "Authorization", header);
 }
 
@@ -889,20 +1498,20 @@ void ziti_ctrl_logout(ziti_controller *ctrl, void(*cb)(void *, const ziti_error
     struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, NULL, ctx);
     resp->ctrl_cb = (ctrl_cb_t) ctrl_logout_cb;
 
-    start_request(ctrl->client, "DELETE", "/current-api-session", ctrl_resp_cb, resp);
+    start_request(ctrl_prio_high, "DELETE", "/current-api-session", ctrl_resp_cb, resp);
 }
 
 void ziti_ctrl_get_services_update(ziti_controller *ctrl, void (*cb)(ziti_service_update *, const ziti_error *, void *), void *ctx) {
     if(!verify_api_session(ctrl, (void (*)(void *, const ziti_error *, void *)) cb, ctx)) return;
 
     struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, ziti_service_update_ptr_from_json, ctx);
-    start_request(ctrl->client, "GET", "/current-api-session/service-updates", ctrl_resp_cb, resp);
+    start_request(ctrl_prio_low, "GET", "/current-api-session/service-updates", ctrl_resp_cb, resp);
 }
 
 void ziti_ctrl_get_services(ziti_controller *ctrl, void (*cb)(ziti_service_array, const ziti_error *, void *), void *ctx) {
     if(!verify_api_session(ctrl, (void (*)(void *, const ziti_error *, void *)) cb, ctx)) return;
 
-    struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, ziti_service_array_from_json, ctx);
+    struct ctrl_resp *resp = MAKE_MODEL_RESP(ctrl, cb, ziti_service, array_mod, ctx);
 
     resp->paging = true;
     resp->base_path = "/services?configTypes=all";
@@ -913,7 +1522,7 @@ void ziti_ctrl_current_edge_routers(ziti_controller *ctrl, void (*cb)(ziti_edge_
                                     void *ctx) {
     if(!verify_api_session(ctrl, (void (*)(void *, const ziti_error *, void *)) cb, ctx)) return;
 
-    struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, ziti_edge_router_array_from_json, ctx);
+    struct ctrl_resp *resp = MAKE_MODEL_RESP(ctrl, cb, ziti_edge_router, array_mod, ctx);
     resp->paging = true;
     resp->base_path = "/current-identity/edge-routers";
     ctrl_paging_req(resp);
@@ -932,10 +1541,10 @@ ziti_ctrl_get_service(ziti_controller *ctrl, const char *service_name, void (*cb
     char name_clause[1024];
     snprintf(name_clause, sizeof(name_clause), "name=\"%s\"", service_name);
 
-    struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, ziti_service_array_from_json, ctx);
+    struct ctrl_resp *resp = MAKE_MODEL_RESP(ctrl, cb, ziti_service, array_mod, ctx);
     resp->ctrl_cb = (ctrl_cb_t) ctrl_service_cb;
 
-    tlsuv_http_req_t *req = start_request(ctrl->client, "GET", "/services", ctrl_resp_cb, resp);
+    tlsuv_http_req_t *req = start_request(ctrl_prio_high, "GET", "/services", ctrl_resp_cb, resp);
     tlsuv_http_req_query(req, 1, &(tlsuv_http_pair){
         "filter", name_clause
     });
@@ -949,7 +1558,7 @@ void ziti_ctrl_list_service_routers(ziti_controller *ctrl, const ziti_service *s
 
     char path[512];
     snprintf(path, sizeof(path), "/services/%s/edge-routers", srv->id);
-    tlsuv_http_req_t *req = start_request(ctrl->client, "GET", path, ctrl_resp_cb, resp);
+    tlsuv_http_req_t *req = start_request(ctrl_prio_high, "GET", path, ctrl_resp_cb, resp);
     tlsuv_http_req_query(req, 2, (tlsuv_http_pair[]){
             { "offset", "0" },
             { "limit", "100" }
@@ -965,8 +1574,8 @@ void ziti_ctrl_get_session(
     char req_path[128];
     snprintf(req_path, sizeof(req_path), "/sessions/%s", session_id);
 
-    struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, ziti_session_ptr_from_json, ctx);
-    tlsuv_http_req_t *req = start_request(ctrl->client, "GET", req_path, ctrl_resp_cb, resp);
+    struct ctrl_resp *resp = MAKE_MODEL_RESP(ctrl, cb, ziti_session, ptr_mod, ctx);
+    tlsuv_http_req_t *req = start_request(ctrl_prio_high, "GET", req_path, ctrl_resp_cb, resp);
     tlsuv_http_req_header(req, "Content-Type", "application/json");
 }
 
@@ -981,9 +1590,9 @@ void ziti_ctrl_create_session(
                           "{\"serviceId\": \"%s\", \"type\": \"%s\"}",
                           service_id, ziti_session_types.name(type));
 
-    struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, ziti_session_ptr_from_json, ctx);
+    struct ctrl_resp *resp = MAKE_MODEL_RESP(ctrl, cb, ziti_session, ptr_mod, ctx);
     resp->ctrl = ctrl;
-    tlsuv_http_req_t *req = start_request(ctrl->client, "POST", "/sessions", ctrl_resp_cb, resp);
+    tlsuv_http_req_t *req = start_request(ctrl_prio_high, "POST", "/sessions", ctrl_resp_cb, resp);
     tlsuv_http_req_header(req, "Content-Type", "application/json");
     tlsuv_http_req_data(req, content, len, free_body_cb);
 }
@@ -992,7 +1601,7 @@ void ziti_ctrl_get_sessions(
         ziti_controller *ctrl, void (*cb)(ziti_session **, const ziti_error *, void *), void *ctx) {
     if(!verify_api_session(ctrl, (ctrl_resp_cb_t)cb, ctx)) return;
 
-    struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, ziti_session_array_from_json, ctx);
+    struct ctrl_resp *resp = MAKE_MODEL_RESP(ctrl, cb, ziti_session, array_mod, ctx);
     resp->paging = true;
     resp->base_path = "/sessions";
     ctrl_paging_req(resp);
@@ -1030,7 +1639,7 @@ ziti_ctrl_enroll(ziti_controller *ctrl, ziti_enrollment_method method, const cha
 
     struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, ziti_enrollment_resp_ptr_from_json, ctx);
 
-    tlsuv_http_req_t *req = start_request(ctrl->client, "POST", "/enroll", ctrl_enroll_http_cb, resp);
+    tlsuv_http_req_t *req = start_request(ctrl_prio_high, "POST", "/enroll", ctrl_enroll_http_cb, resp);
     size_t q_count = method == ziti_enrollment_method_ca ? 1 : 2;
     const tlsuv_http_pair q_params[] = {
         { "method", ziti_enrollment_methods.name(method)},
@@ -1056,7 +1665,7 @@ void
 ziti_ctrl_get_well_known_certs(ziti_controller *ctrl, void (*cb)(char *, const ziti_error *, void *), void *ctx) {
     struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, NULL, ctx);
     resp->resp_content = ctrl_content_text;   // Make no attempt in ctrl_resp_cb to parse response as JSON
-    tlsuv_http_req_t *req = start_request(ctrl->client, "GET", "/.well-known/est/cacerts", ctrl_resp_cb, resp);
+    tlsuv_http_req_t *req = start_request(ctrl_prio_high, "GET", "/.well-known/est/cacerts", ctrl_resp_cb, resp);
     tlsuv_http_req_header(req, "Accept", "application/pkcs7-mime");
 }
 
@@ -1066,7 +1675,7 @@ void ziti_pr_post(ziti_controller *ctrl, char *body, size_t body_len,
 
     struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, ziti_pr_response_ptr_from_json, ctx);
 
-    tlsuv_http_req_t *req = start_request(ctrl->client, "POST", "/posture-response", ctrl_resp_cb, resp);
+    tlsuv_http_req_t *req = start_request(ctrl_prio_low, "POST", "/posture-response", ctrl_resp_cb, resp);
     tlsuv_http_req_header(req, "Content-Type", "application/json");
     char *copy = strdup(body);
     tlsuv_http_req_data(req, copy, body_len, free_body_cb);
@@ -1078,12 +1687,22 @@ void ziti_pr_post_bulk(ziti_controller *ctrl, char *body, size_t body_len,
 
     struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, ziti_pr_response_ptr_from_json, ctx);
 
-    tlsuv_http_req_t *req = start_request(ctrl->client, "POST", "/posture-response-bulk", ctrl_resp_cb, resp);
+    tlsuv_http_req_t *req = start_request(ctrl_prio_low, "POST", "/posture-response-bulk", ctrl_resp_cb, resp);
     tlsuv_http_req_header(req, "Content-Type", "application/json");
     char *copy = strdup(body);
     tlsuv_http_req_data(req, copy, body_len, free_body_cb);
 }
 
+// base path may carry an arbitrary query, so page path is not limited in size
+static char *ctrl_page_path(const struct ctrl_resp *resp, unsigned int offset) {
+    string_buf_t *b = new_string_buf();
+    string_buf_fmt(b, "%s%climit=%u&offset=%u", resp->base_path,
+                   strchr(resp->base_path, '?') ? '&' : '?', resp->limit, offset);
+    char *path = string_buf_to_string(b, NULL);
+    delete_string_buf(b);
+    return path;
+}
+
 static void ctrl_paging_req(struct ctrl_resp *resp) {
     ziti_controller *ctrl = resp->ctrl;
     if (resp->limit == 0) {
@@ -1093,19 +1712,161 @@ static void ctrl_paging_req(struct ctrl_resp *resp) {
         uv_gettimeofday(&resp->all_start);
         CTRL_LOG(DEBUG, "starting paging request GET[%s]", resp->base_path);
     }
-    char query = strchr(resp->base_path, '?') ? '&' : '?';
-    char path[128];
-    snprintf(path, sizeof(path), "%s%climit=%d&offset=%d", resp->base_path, query, resp->limit, resp->recd);
+    char *path = ctrl_page_path(resp, resp->recd);
     CTRL_LOG(VERBOSE, "requesting %s", path);
-    start_request(resp->ctrl->client, "GET", path, ctrl_resp_cb, resp);
+    start_request(ctrl_prio_low, "GET", path, ctrl_resp_cb, resp);
+    free(path);
 }
 
+static void ctrl_page_cb(void *data, const ziti_error *err, struct ctrl_resp *page) {
+    struct ctrl_resp *resp = page->parent;
+    struct ctrl_pages *pages = resp->pages;
+
+    pages->inflight--;
+    if (pages->err.code == NULL) {
+        if (err) {
+            pages->err.err = err->err;
+            pages->err.http_code = err->http_code;
+            pages->err.code = strdup(err->code ? err->code : "CONTROLLER_UNAVAILABLE");
+            pages->err.message = err->message ? strdup(err->message) : NULL;
+        } else if (page->data_meta) {
+            pages->data[page->page_idx] = data;
+            data = NULL;
+        } else if (json_object_get_type(page->resp_json) != json_type_array) {
+            pages->err.err = ZITI_INVALID_STATE;
+            pages->err.code = strdup("INVALID_CONTROLLER_RESPONSE");
+            pages->err.message = strdup("unexpected response JSON");
+        } else {
+            pages->data[page->page_idx] = page->resp_json;
+            page->resp_json = NULL;
+        }
+    }
+    if (page->data_meta) {
+        free_resp_data(page->data_meta, page->data_mod, data);
+    } else {
+        free(data); // non-JSON response
+    }
+    ctrl_default_cb(NULL, NULL, page);
+
+    ctrl_pages_next(resp);
+}
+
+// first page is received: request the rest, up to page_concurrency at a time
+static void ctrl_pages_start(struct ctrl_resp *resp, const resp_meta *meta) {
+    ziti_controller *ctrl = resp->ctrl;
+    if (meta->pagination.limit > 0) {
+        resp->limit = (unsigned int) meta->pagination.limit;
+    }
+    resp->total = (unsigned int) meta->pagination.total;
+
+    unsigned int offset = (unsigned int) meta->pagination.offset + resp->limit;
+    NEWP(pages, struct ctrl_pages);
+    pages->offset = offset;
+    pages->count = (resp->total - offset + resp->limit - 1) / resp->limit;
+    pages->data = calloc(pages->count, sizeof(void *));
+    resp->pages = pages;
+
+    CTRL_LOG(DEBUG, "requesting %u more pages for GET[%s], up to %u at a time",
+             pages->count, resp->base_path, ctrl->page_concurrency);
+    ctrl_pages_next(resp);
+}
+
+// append decoded pages to the first page array with a single allocation
+static void ctrl_pages_join(struct ctrl_resp *resp, bool keep) {
+    struct ctrl_pages *pages = resp->pages;
+    size_t total = resp->recd;
+    for (unsigned int i = 0; keep && i < pages->count; i++) {
+        for (void **d = pages->data[i]; d && *d; d++) {
+            total++;
+        }
+    }
+
+    void **arr = keep ? realloc(resp->data, (total + 1) * sizeof(void *)) : NULL;
+    for (unsigned int i = 0; i < pages->count; i++) {
+        void **data = pages->data[i];
+        if (arr == NULL) {
+            free_resp_data(resp->data_meta, resp->data_mod, data);
+            continue;
+        }
+        for (void **d = data; d && *d; d++) {
+            arr[resp->recd++] = *d;
+        }
+        free(data);
+    }
+    if (arr) {
+        arr[resp->recd] = NULL;
+        resp->data = arr;
+    }
+}
+
+static void ctrl_pages_next(struct ctrl_resp *resp) {
+    ziti_controller *ctrl = resp->ctrl;
+    struct ctrl_pages *pages = resp->pages;
+
+    while (pages->err.code == NULL && pages->next < pages->count && pages->inflight < ctrl->page_concurrency) {
+        unsigned int idx = pages->next++;
+        struct ctrl_resp *page = prepare_resp(ctrl, NULL, NULL, NULL);
+        page->ctrl_cb = (ctrl_cb_t) ctrl_page_cb;
+        page->parent = resp;
+        page->page_idx = idx;
+        page->data_meta = resp->data_meta;
+        page->data_mod = resp->data_mod;
+
+        char *path = ctrl_page_path(resp, pages->offset + idx * resp->limit);
+        CTRL_LOG(VERBOSE, "requesting %s", path);
+        pages->inflight++;
+        // picks an idle connection if there is one
+        start_request(ctrl_prio_low, "GET", path, ctrl_resp_cb, page);
+        free(path);
+    }
+
+    if (pages->inflight > 0) {
+        return;
+    }
+
+    ziti_error err = pages->err;
+    if (resp->data_meta) {
+        ctrl_pages_join(resp, err.code == NULL);
+    } else {
+        for (unsigned int i = 0; i < pages->count; i++) {
+            json_object *data = pages->data[i];
+            if (data && err.code == NULL) {
+                resp->recd += json_object_array_length(data);
+                for (int idx = 0; idx < json_object_array_length(data); idx++) {
+                    json_object_array_add(resp->resp_json, json_object_get(json_object_array_get_idx(data, idx)));
+                }
+            }
+            json_object_put(data);
+        }
+    }
+    free(pages->data);
+    FREE(resp->pages);
+
+    if (err.code) {
+        json_object_put(resp->resp_json);
+        resp->resp_json = NULL;
+        CTRL_LOG(ERROR, "paging request GET[%s] failed code[%s] message[%s]",
+                 resp->base_path, err.code, err.message);
+        resp->ctrl_cb(NULL, &err, resp);
+        free_ziti_error(&err);
+        return;
+    }
+
+    uv_timeval64_t now;
+    uv_gettimeofday(&now);
+    uint64_t elapsed = (now.tv_sec * 1000000 + now.tv_usec) - (resp->all_start.tv_sec * 1000000 + resp->all_start.tv_usec);
+    CTRL_LOG(DEBUG, "completed paging request GET[%s] %u/%u in %" PRIu64 ".%03" PRIu64 " s",
+             resp->base_path, resp->recd, resp->total, elapsed / 1000000, (elapsed / 1000) % 1000);
+    void *resp_obj = resp->data;
+    resp->data = NULL;
+    ctrl_resp_complete(resp, resp_obj, &err, resp->base_path, 200);
+}
 
 void ziti_ctrl_login_mfa(ziti_controller *ctrl, char *body, size_t body_len, void(*cb)(void *, const ziti_error *, void *), void *ctx) {
     if (!verify_api_session(ctrl, cb, ctx)) { return; }
 
     struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, NULL, ctx);
-    tlsuv_http_req_t *req = start_request(ctrl->client, "POST", "/authenticate/mfa", ctrl_resp_cb, resp);
+    tlsuv_http_req_t *req = start_request(ctrl_prio_high, "POST", "/authenticate/mfa", ctrl_resp_cb, resp);
     tlsuv_http_req_header(req, "Content-Type", "application/json");
     tlsuv_http_req_data(req, body, body_len, free_body_cb);
 }
@@ -1114,7 +1875,7 @@ void ziti_ctrl_post_mfa(ziti_controller *ctrl, void(*cb)(void *, const ziti_erro
     if (!verify_api_session(ctrl, cb, ctx)) { return; }
 
     struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, NULL, ctx);
-    tlsuv_http_req_t *req = start_request(ctrl->client, "POST", "/current-identity/mfa", ctrl_resp_cb, resp);
+    tlsuv_http_req_t *req = start_request(ctrl_prio_high, "POST", "/current-identity/mfa", ctrl_resp_cb, resp);
     tlsuv_http_req_header(req, "Content-Type", "application/json");
     tlsuv_http_req_data(req, NULL, 0, free_body_cb);
 }
@@ -1124,7 +1885,7 @@ void ziti_ctrl_get_mfa(ziti_controller *ctrl, void(*cb)(ziti_mfa_enrollment *, c
 
     struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, ziti_mfa_enrollment_ptr_from_json, ctx);
 
-    tlsuv_http_req_t *req = start_request(ctrl->client, "GET", "/current-identity/mfa", ctrl_resp_cb, resp);
+    tlsuv_http_req_t *req = start_request(ctrl_prio_high, "GET", "/current-identity/mfa", ctrl_resp_cb, resp);
     tlsuv_http_req_header(req, "Content-Type", "application/json");
 }
 
@@ -1132,7 +1893,7 @@ void ziti_ctrl_delete_mfa(ziti_controller *ctrl, char *code, void(*cb)(void *, c
     if (!verify_api_session(ctrl, cb, ctx)) { return; }
 
     struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, NULL, ctx);
-    tlsuv_http_req_t *req = start_request(ctrl->client, "DELETE", "/current-identity/mfa", ctrl_resp_cb, resp);
+    tlsuv_http_req_t *req = start_request(ctrl_prio_high, "DELETE", "/current-identity/mfa", ctrl_resp_cb, resp);
     tlsuv_http_req_header(req, "Content-Type", "application/json");
     tlsuv_http_req_header(req, "mfa-validation-code", code);
 }
@@ -1141,7 +1902,7 @@ void ziti_ctrl_post_mfa_verify(ziti_controller *ctrl, char *body, size_t body_le
     if (!verify_api_session(ctrl, cb, ctx)) { return; }
 
     struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, NULL, ctx);
-    tlsuv_http_req_t *req = start_request(ctrl->client, "POST", "/current-identity/mfa/verify", ctrl_resp_cb, resp);
+    tlsuv_http_req_t *req = start_request(ctrl_prio_high, "POST", "/current-identity/mfa/verify", ctrl_resp_cb, resp);
     tlsuv_http_req_header(req, "Content-Type", "application/json");
     tlsuv_http_req_data(req, body, body_len, free_body_cb);
 }
@@ -1151,7 +1912,7 @@ void ziti_ctrl_get_mfa_recovery_codes(ziti_controller *ctrl, char *code, void(*c
 
     struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, ziti_mfa_recovery_codes_ptr_from_json, ctx);
 
-    tlsuv_http_req_t *req = start_request(ctrl->client, "GET", "/current-identity/mfa/recovery-codes", ctrl_resp_cb,
+    tlsuv_http_req_t *req = start_request(ctrl_prio_high, "GET", "/current-identity/mfa/recovery-codes", ctrl_resp_cb,
                                           resp);
     tlsuv_http_req_header(req, "mfa-validation-code", code);
     tlsuv_http_req_header(req, "Content-Type", "application/json");
@@ -1162,7 +1923,7 @@ void ziti_ctrl_post_mfa_recovery_codes(ziti_controller *ctrl, char *body, size_t
 
     struct ctrl_resp *resp = MAKE_RESP(ctrl, cb, NULL, ctx);
 
-    tlsuv_http_req_t *req = start_request(ctrl->client, "POST", "/current-identity/mfa/recovery-codes", ctrl_resp_cb,
+    tlsuv_http_req_t *req = start_request(ctrl_prio_high, "POST", "/current-identity/mfa/recovery-codes", ctrl_resp_cb,
                                           resp);
     tlsuv_http_req_header(req, "Content-Type", "application/json");
     tlsuv_http_req_data(req, body, body_len, free_body_cb);
@@ -1182,7 +1943,7 @@ void ziti_ctrl_extend_cert_authenticator(ziti_controller *ctrl, const char *auth
     size_t body_len;
     char *body = ziti_extend_cert_authenticator_req_to_json(&extend_req, 0, &body_len);
 
-    tlsuv_http_req_t *req = start_request(ctrl->client, "POST", path, ctrl_resp_cb, resp);
+    tlsuv_http_req_t *req = start_request(ctrl_prio_high, "POST", path, ctrl_resp_cb, resp);
     tlsuv_http_req_header(req, "Content-Type", "application/json");
     tlsuv_http_req_data(req, body, body_len, free_body_cb);
 }
@@ -1201,7 +1962,7 @@ void ziti_ctrl_verify_extend_cert_authenticator(ziti_controller *ctrl, const cha
     size_t body_len;
     char *body = ziti_verify_extend_cert_authenticator_req_to_json(&verify_req, 0, &body_len);
 
-    tlsuv_http_req_t *req = start_request(ctrl->client, "POST", path, ctrl_resp_cb, resp);
+    tlsuv_http_req_t *req = start_request(ctrl_prio_high, "POST", path, ctrl_resp_cb, resp);
     tlsuv_http_req_header(req, "Content-Type", "application/json");
     tlsuv_http_req_data(req, body, body_len, free_body_cb);
 }
@@ -1222,7 +1983,7 @@ void ziti_ctrl_create_api_certificate(ziti_controller *ctrl, const char *csr_pem
     size_t body_len;
     char *body = ziti_create_api_cert_req_to_json(&cert_req, 0, &body_len);
 
-    tlsuv_http_req_t *req = start_request(ctrl->client, "POST", path, ctrl_resp_cb, resp);
+    tlsuv_http_req_t *req = start_request(ctrl_prio_high, "POST", path, ctrl_resp_cb, resp);
     tlsuv_http_req_header(req, "Content-Type", "application/json");
     tlsuv_http_req_data(req, body, body_len, free_body_cb);
 }
@@ -1234,5 +1995,14 @@ static struct ctrl_resp *prepare_resp(ziti_controller *ctrl, ctrl_resp_cb_t cb,
     resp->ctx = ctx;
     resp->ctrl = ctrl;
     resp->ctrl_cb = ctrl_default_cb;
+    resp->conn = -1;
+    return resp;
+}
+
+static struct ctrl_resp *prepare_model_resp(ziti_controller *ctrl, ctrl_resp_cb_t cb,
+                                            const type_meta *meta, enum _field_mod mod, void *ctx) {
+    struct ctrl_resp *resp = prepare_resp(ctrl, cb, NULL, ctx);
+    resp->data_meta = meta;
+    resp->data_mod = mod;
     return resp;
 }
\ No newline at end of file
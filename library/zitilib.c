@@ -28,13 +28,25 @@ typedef uint16_t in_port_t;
 #endif
 #else
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
 #define SOCKET_ERROR (-1)
 #endif
 
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+
 #include <ziti/zitilib.h>
 #include <ziti/ziti.h>
 #include <ziti/ziti_log.h>
 #include "zt_internal.h"
+#include "mpsc_queue.h"
+#include "spsc_ring.h"
+#include "epoch_gc.h"
+#include "host_table.h"
 #include "util/future.h"
 
 static bool is_blocking(ziti_socket_t s);
@@ -55,25 +67,66 @@ typedef struct queue_elem_s {
     loop_work_cb cb;
     void *arg;
     future_t *f;
-    LIST_ENTRY(queue_elem_s) _next;
+    mpsc_node_t _next;
 } queue_elem_t;
 
+// number of preallocated queue elements, more are allocated on demand
+#define LOOP_QUEUE_PREALLOC 256
+
 static void internal_init();
 
 static future_t *schedule_on_loop(loop_work_cb cb, void *arg, bool wait);
 
+static void submit_on_loop(loop_work_cb cb, void *arg, future_t *f);
+
+static void post_completion(void *ctx, int status, ziti_socket_t fd, struct addrinfo *ai);
+
 static void do_shutdown(void *args, future_t *f, uv_loop_t *l);
 
+struct direct_sock_s;
+
+static void direct_unregister(struct direct_sock_s *ds);
+
+static void direct_fail(struct direct_sock_s *ds, int err);
+static void direct_unplug(struct direct_sock_s *ds);
+
+static void resolve_snapshot_update(void);
+
+static void resolve_init(uv_loop_t *l);
+
+static void resolve_close(void);
+
+static void resolve_snapshot_reset(void);
+
 static uv_once_t init;
 static uv_loop_t *lib_loop;
 static uv_thread_t lib_thread;
 static uv_key_t err_key;
-static uv_mutex_t q_mut;
 static uv_async_t q_async;
-static LIST_HEAD(loop_queue, queue_elem_s) loop_q;
+static mpsc_queue_t loop_q;
+static lf_pool_t *loop_q_pool;
 
 static future_t *child_init_future;
 
+// ZITI_SOCK_DIRECT sockets that are not connected yet, loop thread only
+static model_map direct_fds;
+
+struct completion_s {
+    ziti_completion c;
+    mpsc_node_t _next;
+};
+
+// number of preallocated completion entries, more are allocated on demand
+#define COMPLETION_PREALLOC 256
+
+static struct {
+    mpsc_queue_t q;
+    lf_pool_t *pool;
+    uv_mutex_t lock; // serializes Ziti_poll_completions() callers
+    ziti_socket_t fd; // readable side given to the application
+    ziti_socket_t notify;
+} completions;
+
 
 #if _WIN32
 
@@ -94,7 +147,9 @@ typedef struct ztx_wrap {
     model_list futures;
 
     future_t *services_loaded;
-    model_map intercepts;
+    // services are loaded or context failed to load, loop thread only
+    bool services_ready;
+    intercept_index_t *intercept_idx;
 } ztx_wrap_t;
 
 struct backlog_entry_s {
@@ -102,12 +157,26 @@ struct backlog_entry_s {
     ziti_connection conn;
     char *caller_id;
     future_t *accept_f;
+
+    // Ziti_accept_async(): client socket is handed out before ziti_accept() completes
+    bool async;
+    void *ctx;
+    ziti_socket_t clt_fd;
+    ziti_socket_t plug;
+    size_t plug_len;
     TAILQ_ENTRY(backlog_entry_s) _next;
 };
 
 typedef struct ziti_sock_s {
     ziti_socket_t fd;
     ziti_socket_t ziti_fd;
+    // ziti_fd is a plug, see plug_socket()
+    bool plugged;
+    size_t plug_len;
+
+    // data is exchanged via Ziti_read()/Ziti_write(), see ZITI_SOCK_DIRECT
+    bool direct;
+    struct direct_sock_s *dsock;
     future_t *f;
     ziti_context ztx;
     ziti_connection conn;
@@ -122,8 +191,37 @@ typedef struct ziti_sock_s {
 
 static model_map ziti_contexts;
 
+// ziti_sockets is only modified on the loop thread, under the lock:
+// Ziti_check_socket() reads it from application threads
+static uv_mutex_t sockets_lock;
 static model_map ziti_sockets;
 
+static void sockets_set(ziti_sock_t *zs) {
+    uv_mutex_lock(&sockets_lock);
+    sockets_set(zs);
+    uv_mutex_unlock(&sockets_lock);
+}
+
+static ziti_sock_t *sockets_remove(ziti_socket_t fd) {
+    uv_mutex_lock(&sockets_lock);
+    ziti_sock_t *zs = model_map_remove_key(&ziti_sockets, &fd, sizeof(fd));
+    uv_mutex_unlock(&sockets_lock);
+    return zs;
+}
+
+// listening sockets: Ziti_accept_async() takes pending connections on application thread
+// backlog of listening sockets is only accessed under the lock
+static uv_mutex_t backlog_lock;
+static model_map listen_socks;
+
+static void unlisten(ziti_socket_t fd, ziti_sock_t *zs) {
+    uv_mutex_lock(&backlog_lock);
+    if (model_map_get_key(&listen_socks, &fd, sizeof(fd)) == zs) {
+        model_map_remove_key(&listen_socks, &fd, sizeof(fd));
+    }
+    uv_mutex_unlock(&backlog_lock);
+}
+
 void Ziti_lib_init(void) {
     uv_once(&init, internal_init);
 }
@@ -142,6 +240,51 @@ static void set_error(int err) {
     uv_key_set(&err_key, (void *) (intptr_t) err);
 }
 
+struct services_waiter_s {
+    loop_work_cb cb;
+    void *arg;
+    future_t *f;
+};
+
+// requests that need services of all contexts, loop thread only
+static model_list services_waiters;
+
+static bool all_services_ready(void) {
+    MODEL_MAP_FOR(it, ziti_contexts) {
+        ztx_wrap_t *wrap = model_map_it_value(it);
+        if (!wrap->services_ready) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// runs [cb] on the loop once every context has loaded its services
+static void run_when_services_ready(loop_work_cb cb, void *arg, future_t *f, uv_loop_t *l) {
+    if (all_services_ready()) {
+        cb(arg, f, l);
+        return;
+    }
+
+    NEWP(w, struct services_waiter_s);
+    w->cb = cb;
+    w->arg = arg;
+    w->f = f;
+    model_list_append(&services_waiters, w);
+}
+
+static void run_services_waiters(uv_loop_t *l) {
+    if (!all_services_ready()) {
+        return;
+    }
+
+    struct services_waiter_s *w;
+    while ((w = model_list_pop(&services_waiters)) != NULL) {
+        w->cb(w->arg, w->f, l);
+        free(w);
+    }
+}
+
 static void on_ctx_event(ziti_context ztx, const ziti_event_t *ev) {
     ztx_wrap_t *wrap = ziti_app_ctx(ztx);
     future_t *f;
@@ -166,47 +309,43 @@ static void on_ctx_event(ziti_context ztx, const ziti_event_t *ev) {
             }
             if (err == ZITI_DISABLED) {
                 destroy_future(wrap->services_loaded);
+                intercept_index_free(wrap->intercept_idx);
                 free(wrap);
+            } else if (!wrap->services_ready) {
+                // don't hold up requests waiting for services on a context that failed to load
+                wrap->services_ready = true;
+                run_services_waiters(lib_loop);
             }
         }
+        // controller address could have changed
+        resolve_snapshot_update();
+    } else if (ev->type == ZitiRouterEvent) {
+        if (ev->router.status == EdgeRouterAdded || ev->router.status == EdgeRouterRemoved) {
+            resolve_snapshot_update();
+        }
     } else if (ev->type == ZitiServiceEvent) {
 
         for (int i = 0; ev->service.removed && ev->service.removed[i] != NULL; i++) {
-            ziti_intercept_cfg_v1 *intercept = model_map_remove(&wrap->intercepts, ev->service.removed[i]->name);
-            free_ziti_intercept_cfg_v1(intercept);
-            FREE(intercept);
-        }
-
-        for (int i = 0; ev->service.changed && ev->service.changed[i] != NULL; i++) {
-            ziti_service *s = ev->service.changed[i];
-            ziti_intercept_cfg_v1 *intercept = alloc_ziti_intercept_cfg_v1();
-
-            if (ziti_service_get_config(s, ZITI_INTERCEPT_CFG_V1, intercept, (parse_service_cfg_f) parse_ziti_intercept_cfg_v1) == ZITI_OK) {
-                intercept = model_map_set(&wrap->intercepts, s->name, intercept);
-            }
-
-            free_ziti_intercept_cfg_v1(intercept);
-            FREE(intercept);
+            intercept_index_remove(wrap->intercept_idx, ev->service.removed[i]->name);
         }
 
-        for (int i = 0; ev->service.added && ev->service.added[i] != NULL; i++) {
-            ziti_service *s = ev->service.added[i];
-            ziti_intercept_cfg_v1 *intercept = alloc_ziti_intercept_cfg_v1();
-            ziti_client_cfg_v1 clt_cfg = {0};
-
-            if (ziti_service_get_config(s, ZITI_INTERCEPT_CFG_V1, intercept, (parse_service_cfg_f) parse_ziti_intercept_cfg_v1) == ZITI_OK) {
-                intercept = model_map_set(&wrap->intercepts, s->name, intercept);
-            } else if (ziti_service_get_config(s, ZITI_CLIENT_CFG_V1, &clt_cfg, (parse_service_cfg_f) parse_ziti_client_cfg_v1) == ZITI_OK) {
-                ziti_intercept_from_client_cfg(intercept, &clt_cfg);
-                intercept = model_map_set(&wrap->intercepts, s->name, intercept);
-                free_ziti_client_cfg_v1(&clt_cfg);
+        // configs were parsed by the context when services were loaded
+        ziti_service **updates[] = { ev->service.changed, ev->service.added };
+        for (int u = 0; u < 2; u++) {
+            for (int i = 0; updates[u] && updates[u][i] != NULL; i++) {
+                ziti_service *s = updates[u][i];
+                const ziti_intercept_cfg_v1 *intercept = ztx_service_config(ztx, s->name, ZITI_INTERCEPT_CFG_V1);
+                if (intercept) {
+                    intercept_index_add(wrap->intercept_idx, s->name, intercept);
+                } else {
+                    intercept_index_remove(wrap->intercept_idx, s->name);
+                }
             }
-
-            free_ziti_intercept_cfg_v1(intercept);
-            FREE(intercept);
         }
 
         complete_future(wrap->services_loaded, NULL);
+        wrap->services_ready = true;
+        run_services_waiters(lib_loop);
     }
 }
 
@@ -239,10 +378,11 @@ static void load_ziti_ctx(void *arg, future_t *f, uv_loop_t *l) {
 
     wrap = calloc(1, sizeof(struct ztx_wrap));
     wrap->ztx = ztx;
+    wrap->intercept_idx = intercept_index_new();
     rc = ziti_context_set_options(ztx, &(ziti_options){
             .app_ctx = wrap,
             .event_cb = on_ctx_event,
-            .events = ZitiContextEvent | ZitiServiceEvent,
+            .events = ZitiContextEvent | ZitiServiceEvent | ZitiRouterEvent,
             .refresh_interval = 60,
             .config_types = configs,
     });
@@ -256,6 +396,7 @@ static void load_ziti_ctx(void *arg, future_t *f, uv_loop_t *l) {
     if (rc != ZITI_OK) goto error;
 
     model_map_set(&ziti_contexts, arg, wrap);
+    resolve_snapshot_update();
 
 error:
 
@@ -444,24 +585,122 @@ static int connect_socket(ziti_socket_t clt_sock, ziti_socket_t *ziti_sock) {
     return 0;
 }
 
+#if !_WIN32 && !defined(SOCKET_PAIR_ALT)
+#define SOCKET_PLUG 1
+#endif
+
+/**
+ * Async connect support: replace [clt_sock] with one end of a socket pair and fill its send buffer,
+ * so that it does not become writable until [unplug_socket()] is called, just like a socket
+ * with a pending non-blocking connect(). The socket keeps its file description from here on,
+ * so it can be registered with epoll right away.
+ * @param clt_sock client socket
+ * @param plug[out] other end of the socket pair, becomes bridge socket after [unplug_socket()]
+ * @param plug_len[out] number of filler bytes
+ * @return 0 on success or if not supported on this platform ([plug] is set to SOCKET_ERROR)
+ */
+static int plug_socket(ziti_socket_t clt_sock, ziti_socket_t *plug, size_t *plug_len) {
+    *plug = SOCKET_ERROR;
+    *plug_len = 0;
+#if defined(SOCKET_PLUG)
+    int flags = fcntl(clt_sock, F_GETFL, 0);
+    int fds[2] = {-1, -1};
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+        ZITI_LOG(WARN, "socketpair failed[%d/%s]", errno, strerror(errno));
+        return errno;
+    }
+
+    // kernel clamps it to the minimum
+    int sndbuf = 1;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+    char filler[512] = {0};
+    ssize_t n;
+    while ((n = write(fds[0], filler, sizeof(filler))) > 0) {
+        *plug_len += (size_t) n;
+    }
+
+    if (dup2(fds[0], clt_sock) == -1) {
+        ZITI_LOG(WARN, "dup2 failed[%d/%s]", errno, strerror(errno));
+        close(fds[0]);
+        close(fds[1]);
+        return errno;
+    }
+    close(fds[0]);
+    // preserve blocking mode set by the application
+    fcntl(clt_sock, F_SETFL, flags);
+#if defined(SO_NOSIGPIPE)
+    int nosig = 1;
+    setsockopt(fds[1], SOL_SOCKET, SO_NOSIGPIPE, (void *)&nosig, sizeof(int));
+#endif
+
+    *plug = fds[1];
+    ZITI_LOG(VERBOSE, "plugged client socket[%d] <-> plug[%d] filler[%zd]", clt_sock, *plug, *plug_len);
+#endif
+    return 0;
+}
+
+/**
+ * consume filler bytes and restore send buffer, [clt_sock] becomes writable
+ */
+static int unplug_socket(ziti_socket_t clt_sock, ziti_socket_t plug, size_t plug_len) {
+#if defined(SOCKET_PLUG)
+    int sndbuf;
+    socklen_t optlen = sizeof(sndbuf);
+    // plug end has default send buffer, kernel doubles the value on set
+    if (getsockopt(plug, SOL_SOCKET, SO_SNDBUF, &sndbuf, &optlen) == 0) {
+        sndbuf /= 2;
+        setsockopt(clt_sock, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    }
+
+    // read exactly the filler, application may already be blocked in write()
+    char buf[512];
+    while (plug_len > 0) {
+        ssize_t n = read(plug, buf, plug_len < sizeof(buf) ? plug_len : sizeof(buf));
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            return n == 0 ? ECONNRESET : errno;
+        }
+        plug_len -= (size_t) n;
+    }
+#endif
+    return 0;
+}
+
 // make sure old ziti_sock_t instance does not interfere with
 // the new/reused socket fd
 static void check_socket(void *arg, future_t *f, uv_loop_t *l) {
     ziti_socket_t fd = (ziti_socket_t) (uintptr_t) arg;
     ZITI_LOG(VERBOSE, "checking client fd[%d]", fd);
-    ziti_sock_t *s = model_map_remove_key(&ziti_sockets, &fd, sizeof(fd));
+    ziti_sock_t *s = sockets_remove(fd);
     if (s) {
         ZITI_LOG(VERBOSE, "stale ziti_sock_t[fd=%d]", fd);
+        unlisten(fd, s);
         s->fd = SOCKET_ERROR;
+        if (s->dsock) {
+            direct_unregister(s->dsock);
+        }
     }
+    model_map_remove_key(&direct_fds, &fd, sizeof(fd));
+    complete_future(f, NULL);
+}
+
+static void check_direct_socket(void *arg, future_t *f, uv_loop_t *l) {
+    ziti_socket_t fd = (ziti_socket_t) (uintptr_t) arg;
+    check_socket(arg, NULL, l);
+    model_map_set_key(&direct_fds, &fd, sizeof(fd), (void *) (uintptr_t) 1);
     complete_future(f, NULL);
 }
 
 ziti_socket_t Ziti_socket(int type) {
+    bool direct = (type & ZITI_SOCK_DIRECT) != 0;
+    type &= ~ZITI_SOCK_DIRECT;
+
     ziti_socket_t fd = socket(AF_INET, type, 0);
     set_error(fd < 0 ? errno : 0);
     if (fd > 0) {
-        future_t *f = schedule_on_loop(check_socket, (void *) (uintptr_t) fd, true);
+        future_t *f = schedule_on_loop(direct ? check_direct_socket : check_socket, (void *) (uintptr_t) fd, true);
         await_future(f, NULL);
         destroy_future(f);
     }
@@ -471,7 +710,15 @@ ziti_socket_t Ziti_socket(int type) {
 static void close_work(void *arg, future_t *f, uv_loop_t *l) {
     ziti_socket_t fd = (ziti_socket_t) (uintptr_t) arg;
     ZITI_LOG(DEBUG, "closing client fd[%d]", fd);
-    ziti_sock_t *s = model_map_remove_key(&ziti_sockets, &fd, sizeof(fd));
+    ziti_sock_t *s = sockets_remove(fd);
+    model_map_remove_key(&direct_fds, &fd, sizeof(fd));
+    if (s) {
+        unlisten(fd, s);
+    }
+    if (s && s->dsock) {
+        direct_unregister(s->dsock);
+        direct_fail(s->dsock, ZITI_CONN_CLOSED);
+    }
 #if _WIN32
     closesocket(fd);
 #else
@@ -481,8 +728,7 @@ static void close_work(void *arg, future_t *f, uv_loop_t *l) {
 }
 
 int Ziti_close(ziti_socket_t fd) {
-    ziti_sock_t *s = model_map_get_key(&ziti_sockets, &fd, sizeof(fd));
-    if (s) {
+    if (Ziti_check_socket(fd) != 0) {
         ZITI_LOG(DEBUG, "closing ziti socket[%d]", fd);
         future_t *f = schedule_on_loop(close_work, (void *) (uintptr_t) fd, true);
         await_future(f, NULL);
@@ -501,34 +747,367 @@ struct conn_req_s {
 
     const char *host;
     uint16_t port;
+
+    ziti_socket_t plug;
+    size_t plug_len;
 };
 
 static void on_bridge_close(void *ctx) {
     ziti_sock_t *zs = ctx;
     ZITI_LOG(DEBUG, "closed conn for socket(%d)", zs->fd);
-    model_map_remove_key(&ziti_sockets, &zs->fd, sizeof(zs->fd));
+    sockets_remove(zs->fd);
+    unlisten(zs->fd, zs);
+    if (zs->ziti_fd != SOCKET_ERROR) {
 #if _WIN32
-    closesocket(zs->ziti_fd);
+        closesocket(zs->ziti_fd);
 #else
-    close(zs->ziti_fd);
+        close(zs->ziti_fd);
 #endif
+    }
     free(zs->service);
     free(zs);
 }
 
+/*
+ * Direct data path (ZITI_SOCK_DIRECT): application exchanges data with the Ziti connection
+ * through a pair of SPSC rings via Ziti_read()/Ziti_write(), socket fd is only used for readiness signalling
+ */
+#define DIRECT_RING_SIZE (64 * 1024)
+
+typedef struct direct_sock_s {
+    ziti_socket_t fd;
+    ziti_socket_t sig; // other end of [fd], loop writes a byte to it when [in] becomes non-empty
+    ziti_connection conn;
+    ziti_sock_t *zs;
+
+    spsc_ring_t in;  // loop -> app
+    spsc_ring_t out; // app -> loop
+    size_t out_inflight; // loop only
+
+    atomic_bool rd_signaled;
+    atomic_bool out_plugged; // [out] was full: send buffer of [fd] is filled, so it does not poll writable
+    atomic_bool in_paused; // loop stopped accepting data, [in] is full
+    atomic_bool in_kick;
+    atomic_bool out_kick;
+    atomic_int in_err;  // ZITI_EOF or error
+    atomic_int out_err;
+    atomic_int refs;
+
+    // blocking writers wait for room in [out]
+    uv_mutex_t wlock;
+    uv_cond_t wcond;
+    atomic_int wwaiters;
+} direct_sock_t;
+
+// connected direct sockets, looked up from application threads
+static uv_rwlock_t direct_lock;
+static model_map direct_socks;
+
+static void direct_release(direct_sock_t *ds) {
+    if (atomic_fetch_sub(&ds->refs, 1) != 1) return;
+
+    spsc_ring_free(&ds->in);
+    spsc_ring_free(&ds->out);
+    uv_mutex_destroy(&ds->wlock);
+    uv_cond_destroy(&ds->wcond);
+    free(ds);
+}
+
+static direct_sock_t *direct_get(ziti_socket_t fd) {
+    uv_rwlock_rdlock(&direct_lock);
+    direct_sock_t *ds = model_map_get_key(&direct_socks, &fd, sizeof(fd));
+    if (ds) {
+        atomic_fetch_add(&ds->refs, 1);
+    }
+    uv_rwlock_rdunlock(&direct_lock);
+    return ds;
+}
+
+static void direct_unregister(direct_sock_t *ds) {
+    uv_rwlock_wrlock(&direct_lock);
+    if (model_map_get_key(&direct_socks, &ds->fd, sizeof(ds->fd)) == ds) {
+        model_map_remove_key(&direct_socks, &ds->fd, sizeof(ds->fd));
+    }
+    uv_rwlock_wrunlock(&direct_lock);
+}
+
+static void direct_signal_read(direct_sock_t *ds) {
+    if (!atomic_exchange(&ds->rd_signaled, true)) {
+        char b = 1;
+        send(ds->sig, &b, sizeof(b), 0);
+    }
+}
+
+// read whatever is buffered on socket without blocking
+static void drain_socket(ziti_socket_t s) {
+    char buf[512];
+#if _WIN32
+    u_long avail = 0;
+    ioctlsocket(s, FIONREAD, &avail);
+#else
+    int avail = 0;
+    ioctl(s, FIONREAD, &avail);
+#endif
+    while (avail > 0) {
+        int n = recv(s, buf, avail < (int) sizeof(buf) ? (int) avail : (int) sizeof(buf), 0);
+        if (n <= 0) break;
+        avail -= n;
+    }
+}
+
+// application thread: [in] was found empty, consume readiness signal
+static void direct_clear_read(direct_sock_t *ds) {
+    drain_socket(ds->fd);
+
+    atomic_exchange(&ds->rd_signaled, false);
+    // data could have arrived before the flag was cleared
+    if (spsc_ring_size(&ds->in) > 0) {
+        direct_signal_read(ds);
+    }
+}
+
+static void direct_wake_writers(direct_sock_t *ds) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&ds->wwaiters) > 0) {
+        uv_mutex_lock(&ds->wlock);
+        uv_cond_broadcast(&ds->wcond);
+        uv_mutex_unlock(&ds->wlock);
+    }
+}
+
+static void on_direct_conn_close(ziti_connection conn) {
+    direct_sock_t *ds = ziti_conn_data(conn);
+    ZITI_LOG(DEBUG, "direct socket fd[%d] closed", ds->fd);
+    direct_unregister(ds);
+    on_bridge_close(ds->zs);
+    direct_release(ds);
+}
+
+static void direct_fail(direct_sock_t *ds, int err) {
+    int none = 0;
+    atomic_compare_exchange_strong(&ds->in_err, &none, err);
+    none = 0;
+    atomic_compare_exchange_strong(&ds->out_err, &none, err);
+
+    direct_wake_writers(ds);
+    if (atomic_load(&ds->out_plugged)) {
+        // let writers polling for POLLOUT find out_err
+        direct_unplug(ds);
+    }
+    if (ds->conn) {
+        // wake up readers
+        shutdown(ds->sig,
+#if _WIN32
+                 SD_SEND
+#else
+                 SHUT_WR
+#endif
+        );
+        ziti_connection conn = ds->conn;
+        ds->conn = NULL;
+        ziti_close(conn, on_direct_conn_close);
+    }
+}
+
+static void direct_kick_resume(direct_sock_t *ds);
+
+static ssize_t on_direct_data(ziti_connection conn, const uint8_t *data, ssize_t len) {
+    direct_sock_t *ds = ziti_conn_data(conn);
+
+    if (len > 0) {
+        size_t n = spsc_ring_write(&ds->in, data, (size_t) len);
+        if (n > 0) {
+            direct_signal_read(ds);
+        }
+
+        if (n < (size_t) len) {
+            // stop delivery until application makes room
+            ziti_conn_set_data_cb(conn, NULL);
+            atomic_store(&ds->in_paused, true);
+            // application could have drained the ring before it saw the pause
+            if (spsc_ring_size(&ds->in) < ds->in.cap) {
+                direct_kick_resume(ds);
+            }
+        }
+        return (ssize_t) n;
+    }
+
+    if (len == ZITI_EOF) {
+        ZITI_LOG(VERBOSE, "direct socket fd[%d] received EOF", ds->fd);
+        atomic_store(&ds->in_err, ZITI_EOF);
+        shutdown(ds->sig,
+#if _WIN32
+                 SD_SEND
+#else
+                 SHUT_WR
+#endif
+        );
+    } else {
+        direct_fail(ds, (int) len);
+    }
+    return 0;
+}
+
+static void direct_resume(void *arg, future_t *f, uv_loop_t *l) {
+    direct_sock_t *ds = arg;
+    atomic_exchange(&ds->in_kick, false);
+    if (ds->conn && atomic_exchange(&ds->in_paused, false)) {
+        ziti_conn_set_data_cb(ds->conn, on_direct_data);
+    }
+    direct_release(ds);
+}
+
+static void direct_kick_resume(direct_sock_t *ds) {
+    if (!atomic_exchange(&ds->in_kick, true)) {
+        atomic_fetch_add(&ds->refs, 1);
+        submit_on_loop(direct_resume, ds, NULL);
+    }
+}
+
+static void direct_write_next(direct_sock_t *ds);
+
+// loop thread: drop filler written by direct_plug_write(), [fd] polls writable again
+static void direct_unplug(direct_sock_t *ds) {
+    atomic_store(&ds->out_plugged, false);
+    drain_socket(ds->sig);
+}
+
+static void direct_unplug_work(void *arg, future_t *f, uv_loop_t *l) {
+    direct_sock_t *ds = arg;
+    direct_unplug(ds);
+    direct_release(ds);
+}
+
+// application thread: [out] is full, stop [fd] from polling writable until loop makes room
+static void direct_plug_write(direct_sock_t *ds) {
+#if !_WIN32
+    atomic_store(&ds->out_plugged, true);
+
+    // keep the filler small, application never sends data on [fd]
+    int sndbuf = 1;
+    setsockopt(ds->fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    char filler[512] = {0};
+    int flags = 0;
+#if defined(MSG_NOSIGNAL)
+    flags = MSG_NOSIGNAL;
+#endif
+    while (send(ds->fd, filler, sizeof(filler), flags) > 0) {}
+
+    // loop could have released space before it saw the flag
+    atomic_thread_fence(memory_order_seq_cst);
+    if (spsc_ring_size(&ds->out) < ds->out.cap) {
+        atomic_fetch_add(&ds->refs, 1);
+        submit_on_loop(direct_unplug_work, ds, NULL);
+    }
+#endif
+}
+
+static void on_direct_write(ziti_connection conn, ssize_t status, void *ctx) {
+    direct_sock_t *ds = ctx;
+    spsc_ring_consume(&ds->out, ds->out_inflight);
+    ds->out_inflight = 0;
+    direct_wake_writers(ds);
+    // direct_wake_writers() fenced: either this sees the flag or the writer sees the released space
+    if (atomic_load(&ds->out_plugged)) {
+        direct_unplug(ds);
+    }
+
+    if (status < 0) {
+        direct_fail(ds, (int) status);
+    } else {
+        direct_write_next(ds);
+    }
+    direct_release(ds);
+}
+
+static void direct_write_next(direct_sock_t *ds) {
+    if (ds->out_inflight > 0 || ds->conn == NULL) return;
+
+    const uint8_t *p;
+    size_t len = spsc_ring_peek(&ds->out, &p);
+    if (len == 0) return;
+
+    // ring region is handed to ziti_write() as is and released in on_direct_write()
+    ds->out_inflight = len;
+    atomic_fetch_add(&ds->refs, 1);
+    int rc = ziti_write(ds->conn, (uint8_t *) p, len, on_direct_write, ds);
+    if (rc != ZITI_OK) {
+        ds->out_inflight = 0;
+        direct_release(ds);
+        direct_fail(ds, rc);
+    }
+}
+
+static void direct_flush(void *arg, future_t *f, uv_loop_t *l) {
+    direct_sock_t *ds = arg;
+    atomic_exchange(&ds->out_kick, false);
+    direct_write_next(ds);
+    direct_release(ds);
+}
+
+static int direct_attach(ziti_connection conn, ziti_sock_t *zs) {
+    NEWP(ds, direct_sock_t);
+    if (spsc_ring_init(&ds->in, DIRECT_RING_SIZE) != 0 ||
+        spsc_ring_init(&ds->out, DIRECT_RING_SIZE) != 0) {
+        spsc_ring_free(&ds->in);
+        free(ds);
+        return ENOMEM;
+    }
+    ds->fd = zs->fd;
+    ds->sig = zs->ziti_fd;
+    ds->conn = conn;
+    ds->zs = zs;
+    atomic_init(&ds->refs, 1); // released when connection is closed
+    uv_mutex_init(&ds->wlock);
+    uv_cond_init(&ds->wcond);
+
+    zs->dsock = ds;
+    ziti_conn_set_data(conn, ds);
+
+    uv_rwlock_wrlock(&direct_lock);
+    model_map_set_key(&direct_socks, &ds->fd, sizeof(ds->fd), ds);
+    uv_rwlock_wrunlock(&direct_lock);
+
+    ziti_conn_set_data_cb(conn, on_direct_data);
+    ZITI_LOG(DEBUG, "direct data path for fd[%d]", ds->fd);
+    return 0;
+}
+
+static void bridge_socket(ziti_connection conn, ziti_sock_t *zs) {
+    if (zs->direct) {
+        int rc = direct_attach(conn, zs);
+        if (rc == 0) return;
+        ZITI_LOG(WARN, "failed to setup direct data path for fd[%d], using bridge", zs->fd);
+    }
+    ziti_conn_bridge_fds(conn, (uv_os_fd_t) zs->ziti_fd, (uv_os_fd_t) zs->ziti_fd, on_bridge_close, zs);
+}
+
 static void on_ziti_connect(ziti_connection conn, int status) {
     ziti_sock_t *zs = ziti_conn_data(conn);
     if (status == ZITI_OK) {
-        int rc = connect_socket(zs->fd, &zs->ziti_fd);
+        // plugged socket becomes writable on unplug, direct path has to be ready by then
+        if (zs->direct && zs->plugged && direct_attach(conn, zs) != 0) {
+            zs->direct = false;
+        }
+
+        int rc = zs->plugged ?
+                 unplug_socket(zs->fd, zs->ziti_fd, zs->plug_len) :
+                 connect_socket(zs->fd, &zs->ziti_fd);
         if (rc != 0) {
             ZITI_LOG(ERROR, "failed to connect client socket: %d/%s", rc, strerror(rc));
             fail_future(zs->f, rc);
+            if (zs->dsock) {
+                direct_fail(zs->dsock, rc);
+            }
             return;
         }
 
         ZITI_LOG(DEBUG, "bridge connected to ziti fd[%d]->ziti_fd[%d]->conn[%d]->service[%s]",
                  zs->fd, zs->ziti_fd, zs->conn->conn_id, zs->service);
-        ziti_conn_bridge_fds(conn, (uv_os_fd_t) zs->ziti_fd, (uv_os_fd_t) zs->ziti_fd, on_bridge_close, zs);
+        if (zs->dsock == NULL) {
+            bridge_socket(conn, zs);
+        }
         complete_future(zs->f, conn);
     } else {
         ZITI_LOG(WARN, "failed to establish ziti connection: %d(%s)", status, ziti_errorstr(status));
@@ -541,7 +1120,6 @@ static void on_ziti_connect(ziti_connection conn, int status) {
 static const char* find_service(ztx_wrap_t *wrap, int type, const char *host, uint16_t port) {
     ZITI_LOG(DEBUG, "looking up %d:%s:%d", type, host, port);
     const char *service;
-    ziti_intercept_cfg_v1 *intercept;
 
     // check for service matching host
     ziti_service *s = model_map_get(&wrap->ztx->services, host);
@@ -572,20 +1150,11 @@ static const char* find_service(ztx_wrap_t *wrap, int type, const char *host, ui
             return NULL;
     }
 
-    int score = -1;
-    const char *best = NULL;
-    MODEL_MAP_FOREACH(service, intercept, &wrap->intercepts) {
-        int match = ziti_intercept_match(intercept, proto, host, port);
-        if (match == -1) { continue; }
-
-        if (match == 0) { return service; }
-
-        if (score == -1 || score > match) {
-            best = service;
-            score = match;
-        }
+    ziti_address addr;
+    if (parse_ziti_address_str(&addr, host) < 0) {
+        return NULL;
     }
-    return best;
+    return intercept_index_lookup(wrap->intercept_idx, proto, &addr, port, NULL);
 }
 
 const char *fmt_identity(const ziti_intercept_cfg_v1 *intercept, const char* proto, const char *host, int port) {
@@ -648,7 +1217,7 @@ static void do_ziti_connect(struct conn_req_s *req, future_t *f, uv_loop_t *l) {
         host = req->host;
     }
 
-    ziti_intercept_cfg_v1 *intercept = NULL;
+    const ziti_intercept_cfg_v1 *intercept = NULL;
     if (req->ztx == NULL) {
         MODEL_MAP_FOR(it, ziti_contexts) {
             ztx_wrap_t *wrap = model_map_it_value(it);
@@ -657,7 +1226,7 @@ static void do_ziti_connect(struct conn_req_s *req, future_t *f, uv_loop_t *l) {
             if (service_name != NULL) {
                 req->ztx = wrap->ztx;
                 req->service = service_name;
-                intercept = model_map_get(&wrap->intercepts, service_name);
+                intercept = ztx_service_config(wrap->ztx, service_name, ZITI_INTERCEPT_CFG_V1);
                 break;
             }
         }
@@ -669,8 +1238,14 @@ static void do_ziti_connect(struct conn_req_s *req, future_t *f, uv_loop_t *l) {
         zs->fd = req->fd;
         zs->f = f;
         zs->service = strdup(req->service);
+        zs->ziti_fd = req->plug;
+        zs->direct = model_map_get_key(&direct_fds, &zs->fd, sizeof(zs->fd)) != NULL;
+        zs->plugged = req->plug != SOCKET_ERROR;
+        zs->plug_len = req->plug_len;
+        // plug is owned by the ziti socket now
+        req->plug = SOCKET_ERROR;
 
-        model_map_set_key(&ziti_sockets, &zs->fd, sizeof(zs->fd), zs);
+        sockets_set(zs);
 
         ziti_conn_init(req->ztx, &zs->conn, zs);
         char app_data[1024];
@@ -713,6 +1288,7 @@ int Ziti_connect_addr(ziti_socket_t socket, const char *host, unsigned int port)
             .fd = socket,
             .host = host,
             .port = port,
+            .plug = SOCKET_ERROR,
     };
 
 
@@ -737,6 +1313,7 @@ int Ziti_connect(ziti_socket_t socket, ziti_context ztx, const char *service, co
             .ztx = ztx,
             .service = service,
             .terminator = terminator ? strdup(terminator) : NULL,
+            .plug = SOCKET_ERROR,
     };
 
     future_t *f = schedule_on_loop((loop_work_cb) do_ziti_connect, &req, true);
@@ -746,6 +1323,85 @@ int Ziti_connect(ziti_socket_t socket, ziti_context ztx, const char *service, co
     return err ? -1 : 0;
 }
 
+// address lookup needs services of all contexts
+static void do_ziti_connect_addr(void *arg, future_t *f, uv_loop_t *l) {
+    run_when_services_ready((loop_work_cb) do_ziti_connect, arg, f, l);
+}
+
+struct conn_async_s {
+    struct conn_req_s req;
+    char *service;
+    char *terminator;
+    char *host;
+    void *ctx;
+};
+
+static void on_connect_async(void *result, int err, void *data) {
+    struct conn_async_s *a = data;
+#if defined(SOCKET_PLUG)
+    if (a->req.plug != SOCKET_ERROR) {
+        // connect failed before ziti connection took over the plug:
+        // closing it signals the error on client socket
+        close(a->req.plug);
+    }
+#endif
+    ZITI_LOG(DEBUG, "async connect fd[%d] completed: %d", a->req.fd, err);
+    post_completion(a->ctx, err, a->req.fd, NULL);
+
+    free(a->service);
+    free(a->terminator);
+    free(a->host);
+    free(a);
+}
+
+static int connect_async(ziti_socket_t socket, ziti_context ztx, const char *service, const char *terminator,
+                         const char *host, unsigned int port, void *ctx) {
+    if (Ziti_check_socket(socket) != 0) {
+        return EALREADY;
+    }
+
+    NEWP(a, struct conn_async_s);
+    a->service = service ? strdup(service) : NULL;
+    a->terminator = terminator ? strdup(terminator) : NULL;
+    a->host = host ? strdup(host) : NULL;
+    a->ctx = ctx;
+    a->req = (struct conn_req_s) {
+            .fd = socket,
+            .ztx = ztx,
+            .service = a->service,
+            .terminator = a->terminator,
+            .host = a->host,
+            .port = (uint16_t) port,
+    };
+
+    int rc = plug_socket(socket, &a->req.plug, &a->req.plug_len);
+    if (rc != 0) {
+        free(a->service);
+        free(a->terminator);
+        free(a->host);
+        free(a);
+        return rc;
+    }
+
+    submit_on_loop(ztx ? (loop_work_cb) do_ziti_connect : do_ziti_connect_addr, &a->req,
+                   new_future_cb(on_connect_async, a));
+    return 0;
+}
+
+int Ziti_connect_async(ziti_socket_t socket, ziti_context ztx, const char *service, const char *terminator, void *ctx) {
+    if (ztx == NULL) return EINVAL;
+    if (service == NULL) return EINVAL;
+
+    return connect_async(socket, ztx, service, terminator, NULL, 0, ctx);
+}
+
+int Ziti_connect_addr_async(ziti_socket_t socket, const char *host, unsigned int port, void *ctx) {
+    if (host == NULL) { return EINVAL; }
+    if (port == 0 || port > UINT16_MAX) { return EINVAL; }
+
+    return connect_async(socket, NULL, NULL, NULL, host, port, ctx);
+}
+
 static bool is_blocking(ziti_socket_t s) {
 #if _WIN32
     /*
@@ -779,12 +1435,26 @@ struct sock_info_s {
     char *peer;
 };
 
+static void on_accept_async_failed(struct backlog_entry_s *pending, int err) {
+#if defined(SOCKET_PLUG)
+    if (pending->plug != SOCKET_ERROR) {
+        close(pending->plug);
+    }
+#endif
+    post_completion(pending->ctx, err, pending->clt_fd, NULL);
+}
+
 static void on_ziti_accept(ziti_connection client, int status) {
     struct backlog_entry_s *pending = ziti_conn_data(client);
     if (status != ZITI_OK) {
         ZITI_LOG(WARN, "ziti_accept failed!");
-        // ziti accept failed, so just put the accept future back into accept_q
-        model_list_push(&pending->parent->accept_q, pending->accept_f);
+        if (pending->async) {
+            // client socket was already handed out, signal error on it
+            on_accept_async_failed(pending, status);
+        } else {
+            // ziti accept failed, so just put the accept future back into accept_q
+            model_list_push(&pending->parent->accept_q, pending->accept_f);
+        }
 
         ziti_close(client, NULL);
         free(pending->caller_id);
@@ -793,11 +1463,22 @@ static void on_ziti_accept(ziti_connection client, int status) {
     }
 
     ziti_socket_t fd, ziti_fd;
-    fd = socket(AF_INET, SOCK_STREAM, 0);
-    int rc = connect_socket(fd, &ziti_fd);
+    int rc = 0;
+    bool plugged = pending->async && pending->plug != SOCKET_ERROR;
+    if (plugged) {
+        fd = pending->clt_fd;
+        ziti_fd = pending->plug;
+    } else {
+        fd = pending->async ? pending->clt_fd : socket(AF_INET, SOCK_STREAM, 0);
+        rc = connect_socket(fd, &ziti_fd);
+    }
     if (rc != 0) {
         ZITI_LOG(WARN, "failed to connect client socket[%d]: %d", fd, rc);
-        fail_future(pending->accept_f, rc);
+        if (pending->async) {
+            on_accept_async_failed(pending, rc);
+        } else {
+            fail_future(pending->accept_f, rc);
+        }
         ziti_close(client, NULL);
         free(pending->caller_id);
         free(pending);
@@ -809,11 +1490,47 @@ static void on_ziti_accept(ziti_connection client, int status) {
     NEWP(zs, ziti_sock_t);
     zs->fd = fd;
     zs->ziti_fd = ziti_fd;
+    zs->direct = pending->parent->direct;
     ziti_conn_set_data(client, zs);
-    model_map_set_key(&ziti_sockets, &zs->fd, sizeof(zs->fd), zs);
-    ziti_conn_bridge_fds(client, (uv_os_fd_t) zs->ziti_fd, (uv_os_fd_t) zs->ziti_fd, on_bridge_close, zs);
-    NEWP(si, struct sock_info_s);
-    si->fd = zs->fd;
+    sockets_set(zs);
+
+    if (plugged) {
+        // see on_ziti_connect()
+        if (zs->direct && direct_attach(client, zs) != 0) {
+            zs->direct = false;
+        }
+
+        rc = unplug_socket(fd, ziti_fd, pending->plug_len);
+        if (rc != 0) {
+            ZITI_LOG(WARN, "failed to connect client socket[%d]: %d", fd, rc);
+            // plug is closed with zs
+            post_completion(pending->ctx, rc, fd, NULL);
+            if (zs->dsock) {
+                direct_fail(zs->dsock, rc);
+            } else {
+                ziti_close(client, NULL);
+                on_bridge_close(zs);
+            }
+            free(pending->caller_id);
+            free(pending);
+            return;
+        }
+    }
+
+    if (zs->dsock == NULL) {
+        bridge_socket(client, zs);
+    }
+
+    if (pending->async) {
+        ZITI_LOG(DEBUG, "async accept completed with fd[%d]", fd);
+        post_completion(pending->ctx, 0, fd, NULL);
+        free(pending->caller_id);
+        free(pending);
+        return;
+    }
+
+    NEWP(si, struct sock_info_s);
+    si->fd = zs->fd;
     si->peer = pending->caller_id;
 
     ZITI_LOG(DEBUG, "completing accept future[%p] with fd[%d]", pending->accept_f, fd);
@@ -858,13 +1575,21 @@ static void on_ziti_client(ziti_connection server, ziti_connection client, int s
         return;
     }
 
-    if (model_list_size(&server_sock->backlog) < server_sock->max_pending) {
+    uv_mutex_lock(&backlog_lock);
+    bool queued = model_list_size(&server_sock->backlog) < server_sock->max_pending;
+    if (queued) {
         ZITI_LOG(DEBUG, "server[%d] no active accept: putting connection in backlog and sending notify", server_sock->fd);
         model_list_append(&server_sock->backlog, pending);
+        // notify is sent under the lock: whoever takes the entry finds its byte on server socket
         send(server_sock->ziti_fd, &notify, sizeof(notify), 0);
-    } else {
+    }
+    uv_mutex_unlock(&backlog_lock);
+
+    if (!queued) {
         ZITI_LOG(DEBUG, "accept backlog is full, client[%s] rejected", clt_ctx->caller_id);
         ziti_close(client, NULL);
+        free(pending->caller_id);
+        free(pending);
     }
 }
 
@@ -878,7 +1603,7 @@ static void on_ziti_bind(ziti_connection server, int status) {
         free(zs);
     } else {
         connect_socket(zs->fd, &zs->ziti_fd);
-        model_map_set_key(&ziti_sockets, &zs->fd, sizeof(zs->fd), zs);
+        sockets_set(zs);
 
         ZITI_LOG(DEBUG, "successfully bound fd[%d] to service[%s]", zs->fd, zs->service);
         complete_future(zs->f, server);
@@ -897,6 +1622,8 @@ static void do_ziti_bind(struct conn_req_s *req, future_t *f, uv_loop_t *l) {
         zs->fd = req->fd;
         zs->service = strdup(req->service);
         zs->f = f;
+        // accepted client sockets inherit direct mode
+        zs->direct = model_map_get_key(&direct_fds, &zs->fd, sizeof(zs->fd)) != NULL;
 
         ZITI_LOG(DEBUG, "requesting bind fd[%d] to service[%s@%s]", zs->fd, req->terminator ? req->terminator : "", req->service);
         ziti_listen_opts opts = {
@@ -941,9 +1668,14 @@ static void do_ziti_listen(void *arg, future_t *f, uv_loop_t *l) {
         fail_future(f, EBADF);
     } else {
         if (!zs->server) {
+            uv_mutex_lock(&sockets_lock);
             zs->server = true;
+            uv_mutex_unlock(&sockets_lock);
         }
+        uv_mutex_lock(&backlog_lock);
         zs->max_pending = req->backlog;
+        model_map_set_key(&listen_socks, &zs->fd, sizeof(zs->fd), zs);
+        uv_mutex_unlock(&backlog_lock);
         complete_future(f, NULL);
     }
 }
@@ -962,6 +1694,13 @@ int Ziti_listen(ziti_socket_t socket, int backlog) {
     return err ? -1 : 0;
 }
 
+static struct backlog_entry_s *pop_backlog(ziti_sock_t *zs) {
+    uv_mutex_lock(&backlog_lock);
+    struct backlog_entry_s *pending = model_list_pop(&zs->backlog);
+    uv_mutex_unlock(&backlog_lock);
+    return pending;
+}
+
 static void do_ziti_accept(void *r, future_t *f, uv_loop_t *l) {
     ziti_socket_t server_fd = (ziti_socket_t) (uintptr_t) r;
     ziti_sock_t *zs = model_map_get_key(&ziti_sockets, &server_fd, sizeof(server_fd));
@@ -977,8 +1716,8 @@ static void do_ziti_accept(void *r, future_t *f, uv_loop_t *l) {
         return;
     }
 
-    while (model_list_size(&zs->backlog) > 0) {
-        struct backlog_entry_s *pending = model_list_pop(&zs->backlog);
+    struct backlog_entry_s *pending;
+    while ((pending = pop_backlog(zs)) != NULL) {
         ZITI_LOG(DEBUG, "server[%d]: pending connection[%s] for service[%s]", zs->fd, pending->caller_id, zs->service);
 
         ziti_connection conn = pending->conn;
@@ -997,19 +1736,15 @@ static void do_ziti_accept(void *r, future_t *f, uv_loop_t *l) {
     }
 
     // no pending connections
-    if (model_list_size(&zs->backlog) == 0) {
-        bool blocking = is_blocking(server_fd);
-        ZITI_LOG(DEBUG, "fd[%d] is_blocking[%d]", server_fd, blocking);
+    bool blocking = is_blocking(server_fd);
+    ZITI_LOG(DEBUG, "fd[%d] is_blocking[%d]", server_fd, blocking);
 
-        ZITI_LOG(DEBUG, "no pending connections for server fd[%d]", server_fd);
-        if (blocking) {
-            model_list_append(&zs->accept_q, f);
-        } else {
-            fail_future(f, EWOULDBLOCK);
-        }
-        return;
+    ZITI_LOG(DEBUG, "no pending connections for server fd[%d]", server_fd);
+    if (blocking) {
+        model_list_append(&zs->accept_q, f);
+    } else {
+        fail_future(f, EWOULDBLOCK);
     }
-
 }
 
 ziti_socket_t Ziti_accept(ziti_socket_t server, char *caller, int caller_len) {
@@ -1040,6 +1775,87 @@ ziti_socket_t Ziti_accept(ziti_socket_t server, char *caller, int caller_len) {
     return clt;
 }
 
+// loop thread: accept connection taken from backlog by Ziti_accept_async()
+static void do_ziti_accept_async(void *arg, future_t *f, uv_loop_t *l) {
+    struct backlog_entry_s *pending = arg;
+    ziti_connection conn = pending->conn;
+
+    ziti_conn_set_data(conn, pending);
+    int rc = ziti_accept(conn, on_ziti_accept, NULL);
+    if (rc != ZITI_OK) {
+        ZITI_LOG(DEBUG, "failed to accept: client conn[%d] gone? [%d/%s]", conn->conn_id, rc, ziti_errorstr(rc));
+        on_accept_async_failed(pending, rc);
+        ziti_close(conn, NULL);
+        free(pending->caller_id);
+        free(pending);
+    }
+}
+
+static void reject_pending(void *arg, future_t *f, uv_loop_t *l) {
+    struct backlog_entry_s *pending = arg;
+    ziti_close(pending->conn, NULL);
+    free(pending->caller_id);
+    free(pending);
+}
+
+ziti_socket_t Ziti_accept_async(ziti_socket_t server, char *caller, int caller_len, void *ctx) {
+    int err = 0;
+    struct backlog_entry_s *pending = NULL;
+
+    uv_mutex_lock(&backlog_lock);
+    ziti_sock_t *zs = model_map_get_key(&listen_socks, &server, sizeof(server));
+    if (zs == NULL) {
+        ZITI_LOG(WARN, "fd[%d] is not a listening ziti socket", server);
+        err = EINVAL;
+    } else if ((pending = model_list_pop(&zs->backlog)) == NULL) {
+        err = EWOULDBLOCK;
+    }
+    uv_mutex_unlock(&backlog_lock);
+
+    if (pending == NULL) {
+        set_error(err);
+        return SOCKET_ERROR;
+    }
+
+    // consume notification sent for this connection, see on_ziti_client()
+    char b;
+    recv(server, &b, 1, 0);
+
+    pending->async = true;
+    pending->ctx = ctx;
+    pending->plug = SOCKET_ERROR;
+    pending->clt_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (pending->clt_fd == SOCKET_ERROR) {
+        err = errno;
+    } else {
+        err = plug_socket(pending->clt_fd, &pending->plug, &pending->plug_len);
+    }
+
+    if (err != 0) {
+        ZITI_LOG(WARN, "failed to create client socket for server fd[%d]: %d", server, err);
+        if (pending->clt_fd != SOCKET_ERROR) {
+#if _WIN32
+            closesocket(pending->clt_fd);
+#else
+            close(pending->clt_fd);
+#endif
+        }
+        submit_on_loop(reject_pending, pending, NULL);
+        set_error(err);
+        return SOCKET_ERROR;
+    }
+
+    ziti_socket_t clt = pending->clt_fd;
+    if (caller != NULL) {
+        strncpy(caller, pending->caller_id, caller_len);
+    }
+    submit_on_loop(do_ziti_accept_async, pending, NULL);
+
+    set_error(0);
+    ZITI_LOG(DEBUG, "fd[%d] returning clt[%d]", server, clt);
+    return clt;
+}
+
 
 void Ziti_lib_shutdown(void) {
     future_t *f = schedule_on_loop(do_shutdown, NULL, true);
@@ -1048,6 +1864,10 @@ void Ziti_lib_shutdown(void) {
     uv_once_t child_once = UV_ONCE_INIT;
     memcpy(&init, &child_once, sizeof(child_once));
     uv_key_delete(&err_key);
+    uv_rwlock_destroy(&direct_lock);
+    uv_mutex_destroy(&backlog_lock);
+    uv_mutex_destroy(&sockets_lock);
+    resolve_snapshot_reset();
     destroy_future(f);
 }
 
@@ -1058,39 +1878,127 @@ static void looper(void *arg) {
     ZITI_LOG(DEBUG, "loop is done");
 }
 
-future_t *schedule_on_loop(loop_work_cb cb, void *arg, bool wait) {
-    queue_elem_t *el = calloc(1, sizeof(queue_elem_t));
+static void submit_on_loop(loop_work_cb cb, void *arg, future_t *f) {
+    queue_elem_t *el = lf_pool_alloc(loop_q_pool);
     el->cb = cb;
     el->arg = arg;
-    if (wait) {
-        el->f = new_future();
+    el->f = f;
+
+    // only wake up the loop if it is not already scheduled to process the queue
+    if (mpsc_queue_push(&loop_q, &el->_next)) {
+        uv_async_send(&q_async);
     }
+}
 
-    uv_mutex_lock(&q_mut);
-    LIST_INSERT_HEAD(&loop_q, el, _next);
-    uv_mutex_unlock(&q_mut);
-    uv_async_send(&q_async);
+future_t *schedule_on_loop(loop_work_cb cb, void *arg, bool wait) {
+    future_t *f = wait ? new_future() : NULL;
+    submit_on_loop(cb, arg, f);
+    return f;
+}
 
-    return el->f;
+static void init_completions(void) {
+    mpsc_queue_init(&completions.q);
+    completions.pool = lf_pool_new(sizeof(struct completion_s), COMPLETION_PREALLOC);
+    uv_mutex_init(&completions.lock);
+
+#if defined(__linux__)
+    completions.fd = completions.notify = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (completions.fd == -1) {
+        ZITI_LOG(ERROR, "failed to create completion eventfd: %d/%s", errno, strerror(errno));
+    }
+#else
+    completions.fd = socket(AF_INET, SOCK_STREAM, 0);
+    int rc = connect_socket(completions.fd, &completions.notify);
+    if (rc != 0) {
+        ZITI_LOG(ERROR, "failed to create completion socket: %d", rc);
+    }
+#if _WIN32
+    u_long nonblocking = 1;
+    ioctlsocket(completions.fd, FIONBIO, &nonblocking);
+#else
+    fcntl(completions.fd, F_SETFL, fcntl(completions.fd, F_GETFL, 0) | O_NONBLOCK);
+#endif
+#endif
 }
 
-void process_on_loop(uv_async_t *async) {
-    LIST_HEAD(loop_queue, queue_elem_s) q = {0};
+static void signal_completions(void) {
+#if defined(__linux__)
+    uint64_t one = 1;
+    if (write(completions.notify, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+        ZITI_LOG(WARN, "failed to signal completions: %d/%s", errno, strerror(errno));
+    }
+#else
+    char b = 1;
+    send(completions.notify, &b, sizeof(b), 0);
+#endif
+}
 
-    // drain q
-    uv_mutex_lock(&q_mut);
-    while (!LIST_EMPTY(&loop_q)) {
-        queue_elem_t *el = LIST_FIRST(&loop_q);
-        LIST_REMOVE(el, _next);
-        LIST_INSERT_HEAD(&q, el, _next);
+static void clear_completions_signal(void) {
+#if defined(__linux__)
+    uint64_t count;
+    (void)read(completions.fd, &count, sizeof(count));
+#else
+    char buf[64];
+    while (recv(completions.fd, buf, sizeof(buf), 0) > 0) {}
+#endif
+}
+
+// can be called from any thread
+static void post_completion(void *ctx, int status, ziti_socket_t fd, struct addrinfo *ai) {
+    struct completion_s *c = lf_pool_alloc(completions.pool);
+    c->c.ctx = ctx;
+    c->c.status = status;
+    c->c.fd = fd;
+    c->c.addrinfo = ai;
+
+    if (mpsc_queue_push(&completions.q, &c->_next)) {
+        signal_completions();
     }
-    uv_mutex_unlock(&q_mut);
+}
+
+ziti_socket_t Ziti_completion_fd(void) {
+    Ziti_lib_init();
+    return completions.fd;
+}
+
+int Ziti_poll_completions(ziti_completion *results, int max) {
+    if (results == NULL || max <= 0) return 0;
+
+    Ziti_lib_init();
+    int count = 0;
+
+    uv_mutex_lock(&completions.lock);
+    clear_completions_signal();
+    mpsc_queue_rearm(&completions.q);
+
+    mpsc_node_t *n;
+    while (count < max && (n = mpsc_queue_pop(&completions.q)) != NULL) {
+        struct completion_s *c = container_of(n, struct completion_s, _next);
+        results[count++] = c->c;
+        lf_pool_return(completions.pool, c);
+    }
+
+    // there may be more, keep completion handle readable
+    if (count == max) {
+        signal_completions();
+    }
+    uv_mutex_unlock(&completions.lock);
+
+    return count;
+}
 
-    while (!LIST_EMPTY(&q)) {
-        queue_elem_t *el = LIST_FIRST(&q);
-        LIST_REMOVE(el, _next);
-        el->cb(el->arg, el->f, async->loop);
-        free(el);
+void process_on_loop(uv_async_t *async) {
+    mpsc_queue_rearm(&loop_q);
+
+    mpsc_node_t *n;
+    while ((n = mpsc_queue_pop(&loop_q)) != NULL) {
+        queue_elem_t *el = container_of(n, queue_elem_t, _next);
+        loop_work_cb cb = el->cb;
+        void *arg = el->arg;
+        future_t *f = el->f;
+        lf_pool_return(loop_q_pool, el);
+
+        cb(arg, f, async->loop);
     }
 }
 
@@ -1108,9 +2016,10 @@ static void child_load_contexts(void *load_list, future_t *f, uv_loop_t *l) {
 
 static void child_init() {
     lib_loop = uv_loop_new();
-    memset(&loop_q, 0, sizeof(loop_q));
+    mpsc_queue_init(&loop_q);
     ziti_log_init(lib_loop, -1, NULL);
     uv_async_init(lib_loop, &q_async, process_on_loop);
+    resolve_init(lib_loop);
 
     model_map_iter it = model_map_iterator(&ziti_contexts);
     model_list *idents = calloc(1, sizeof(*idents));
@@ -1131,10 +2040,16 @@ static void internal_init() {
 #endif
     init_in4addr_loopback();
     uv_key_create(&err_key);
-    uv_mutex_init(&q_mut);
+    uv_rwlock_init(&direct_lock);
+    uv_mutex_init(&backlog_lock);
+    uv_mutex_init(&sockets_lock);
+    init_completions();
+    mpsc_queue_init(&loop_q);
+    loop_q_pool = lf_pool_new(sizeof(queue_elem_t), LOOP_QUEUE_PREALLOC);
     lib_loop = uv_loop_new();
     ziti_log_init(lib_loop, -1, NULL);
     uv_async_init(lib_loop, &q_async, process_on_loop);
+    resolve_init(lib_loop);
     uv_thread_create(&lib_thread, looper, lib_loop);
 }
 
@@ -1146,10 +2061,15 @@ void do_shutdown(void *args, future_t *f, uv_loop_t *l) {
         if (w->ztx) {
             ziti_shutdown(w->ztx);
         }
-        model_map_clear(&w->intercepts, (void (*)(void *)) free_ziti_intercept_cfg_v1_ptr);
+        intercept_index_free(w->intercept_idx);
+        w->intercept_idx = NULL;
     }
+    // no contexts left, pending requests fail to find a service
+    run_services_waiters(l);
+    resolve_snapshot_update();
     complete_future(f, NULL);
     uv_close((uv_handle_t *) &q_async, NULL);
+    resolve_close();
 
 #if _WIN32
     uv_stop(q_async.loop);
@@ -1187,17 +2107,153 @@ int Ziti_enroll_identity(const char *jwt, const char *key, const char *cert, cha
     return rc;
 }
 
-static model_map host_to_ip;
 static model_map ip_to_host;
 
+/*
+ * Read-mostly copy of resolver state, so that Ziti_resolve() can answer without a round trip to the loop thread.
+ * Readers enter [resolve_gc] for the duration of a lookup.
+ * Assigned addresses go into [resolve_hosts], an append-only table readers can walk while the loop adds to it.
+ * Controller/router addresses change rarely: loop rebuilds them at most once per iteration
+ * and retires the old snapshot, it is freed after readers are gone. Loop never waits for readers.
+ */
+struct internal_host_s {
+    char *name;
+    size_t len;
+    bool prefix;
+};
+
+typedef struct resolve_snapshot_s {
+    // controller/router addresses
+    struct internal_host_s *internal;
+    size_t internal_count;
+} resolve_snapshot_t;
+
+static epoch_gc_t *resolve_gc;
+static host_table_t *resolve_hosts;
+static _Atomic(resolve_snapshot_t *) resolve_snap;
+static bool resolve_snap_dirty;
+static uv_check_t resolve_check;
+static uv_timer_t resolve_gc_timer;
+
+static void snapshot_free(void *p) {
+    resolve_snapshot_t *snap = p;
+    if (snap == NULL) return;
+
+    for (size_t i = 0; i < snap->internal_count; i++) {
+        free(snap->internal[i].name);
+    }
+    free(snap->internal);
+    free(snap);
+}
+
+static bool snapshot_is_internal(const resolve_snapshot_t *snap, const char *host) {
+    for (size_t i = 0; i < snap->internal_count; i++) {
+        const struct internal_host_s *h = &snap->internal[i];
+        if (h->prefix ? strncmp(host, h->name, h->len) == 0 : strcmp(host, h->name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void snapshot_add_internal(resolve_snapshot_t *snap, size_t *cap, const char *name, size_t len, bool prefix) {
+    if (snap->internal_count == *cap) {
+        *cap = *cap ? *cap * 2 : 8;
+        snap->internal = realloc(snap->internal, *cap * sizeof(*snap->internal));
+    }
+    struct internal_host_s *h = &snap->internal[snap->internal_count++];
+    h->name = calloc(1, len + 1);
+    memcpy(h->name, name, len);
+    h->len = len;
+    h->prefix = prefix;
+}
+
+static void snapshot_publish(void) {
+    NEWP(snap, resolve_snapshot_t);
+
+    // refuse resolving controller/router addresses
+    // this way Ziti context can operate even if resolve was high-jacked (e.g. zitify)
+    size_t cap = 0;
+    MODEL_MAP_FOR(it, ziti_contexts) {
+        ztx_wrap_t *wrap = model_map_it_value(it);
+        if (wrap->ztx == NULL) continue;
+
+        const char *ctrl = ziti_get_controller(wrap->ztx);
+        struct tlsuv_url_s url;
+        if (ctrl && tlsuv_parse_url(&url, ctrl) == 0 && url.hostname) {
+            snapshot_add_internal(snap, &cap, url.hostname, url.hostname_len, true);
+        }
+
+        MODEL_MAP_FOR(chit, wrap->ztx->channels) {
+            ziti_channel_t *ch = model_map_it_value(chit);
+            if (ch->host) {
+                snapshot_add_internal(snap, &cap, ch->host, strlen(ch->host), false);
+            }
+        }
+    }
+
+    epoch_gc_retire(resolve_gc, atomic_exchange(&resolve_snap, snap), snapshot_free);
+}
+
+static void resolve_gc_cb(uv_timer_t *t) {
+    if (epoch_gc_reclaim(resolve_gc) > 0) {
+        // some reader is still in the middle of a lookup, check back shortly
+        uv_timer_start(t, resolve_gc_cb, 1, 0);
+    }
+}
+
+// runs once per loop iteration
+static void resolve_check_cb(uv_check_t *c) {
+    if (resolve_snap_dirty) {
+        resolve_snap_dirty = false;
+        snapshot_publish();
+    }
+    if (!uv_is_active((uv_handle_t *) &resolve_gc_timer)) {
+        resolve_gc_cb(&resolve_gc_timer);
+    }
+}
+
+static void resolve_init(uv_loop_t *l) {
+    if (resolve_gc == NULL) {
+        resolve_gc = epoch_gc_new();
+        resolve_hosts = host_table_new(resolve_gc);
+    }
+    uv_check_init(l, &resolve_check);
+    uv_check_start(&resolve_check, resolve_check_cb);
+    uv_unref((uv_handle_t *) &resolve_check);
+    uv_timer_init(l, &resolve_gc_timer);
+    uv_unref((uv_handle_t *) &resolve_gc_timer);
+}
+
+static void resolve_close(void) {
+    uv_close((uv_handle_t *) &resolve_check, NULL);
+    uv_close((uv_handle_t *) &resolve_gc_timer, NULL);
+}
+
+// loop thread only: snapshot is rebuilt before the loop goes back to polling
+static void resolve_snapshot_update(void) {
+    resolve_snap_dirty = true;
+}
+
+// loop is stopped, no readers are expected
+static void resolve_snapshot_reset(void) {
+    snapshot_free(atomic_exchange(&resolve_snap, NULL));
+    host_table_free(resolve_hosts);
+    resolve_hosts = NULL;
+    epoch_gc_free(resolve_gc);
+    resolve_gc = NULL;
+    resolve_snap_dirty = false;
+}
+
 static in_addr_t addr_counter = 0x64400000; // 100.64.0.0
-static void resolve_cb(void *r, future_t *f) {
+static void resolve_cb(void *r, future_t *f, uv_loop_t *l) {
     struct conn_req_s *req = r;
 
     ZITI_LOG(DEBUG, "resolving %s", req->host);
-    in_addr_t ip = (in_addr_t)(intptr_t)model_map_get(&host_to_ip, req->host);
+    // loop is the only writer, no need to enter resolve_gc
+    in_addr_t ip = host_table_get(resolve_hosts, req->host);
     if (ip == 0) {
-        const char *service_name;
+        const char *service_name = NULL;
         MODEL_MAP_FOR(it, ziti_contexts) {
             ztx_wrap_t *wrap = model_map_it_value(it);
             service_name = find_service(wrap, 0, req->host, req->port);
@@ -1214,47 +2270,48 @@ static void resolve_cb(void *r, future_t *f) {
 
         ip = htonl(++addr_counter);
         ZITI_LOG(DEBUG, "assigned %s => %x", req->host, ip);
-        model_map_set(&host_to_ip, req->host, (void *) (uintptr_t) ip);
+        host_table_add(resolve_hosts, req->host, ip);
         model_map_set_key(&ip_to_host, &ip, sizeof(ip), strdup(req->host));
     }
 
     complete_future(f, (void *) (uintptr_t) ip);
 }
 
+// host lookup needs services of all contexts
+static void do_resolve(void *arg, future_t *f, uv_loop_t *l) {
+    run_when_services_ready(resolve_cb, arg, f, l);
+}
+
 ZITI_FUNC
 void Ziti_freeaddrinfo(struct addrinfo *addrlist) {
     uv_freeaddrinfo(addrlist);
 }
 
-static bool is_internal(const char *host) {
-    // refuse resolving controller/router addresses here
-    // this way Ziti context can operate even if resolve was high-jacked (e.g. zitify)
-    MODEL_MAP_FOR(it, ziti_contexts) {
-        ztx_wrap_t *wrap = model_map_it_value(it);
-        if (wrap->ztx == NULL) continue;
-
-        const char *ctrl = ziti_get_controller(wrap->ztx);
-        struct tlsuv_url_s url;
-        tlsuv_parse_url(&url, ctrl);
+// single allocation, so that the result can be released with freeaddrinfo()
+static struct addrinfo *new_addrinfo(int socktype, int proto) {
+    struct addrinfo *res = calloc(1, sizeof(struct addrinfo) + sizeof(struct sockaddr_in6));
+    res->ai_socktype = socktype;
+    res->ai_protocol = proto;
+    res->ai_addr = (struct sockaddr *) (res + 1);
+    return res;
+}
 
-        if (strncmp(host, url.hostname, url.hostname_len) == 0) {
-            return true;
-        }
+static void set_ziti_addr(struct addrinfo *res, in_port_t portnum, in_addr_t ip) {
+    struct sockaddr_in *addr4 = (struct sockaddr_in *) res->ai_addr;
+    addr4->sin_family = AF_INET;
+    addr4->sin_port = htons(portnum);
+    addr4->sin_addr.s_addr = ip;
 
-        if (wrap->ztx) {
-            MODEL_MAP_FOR(chit, wrap->ztx->channels) {
-                ziti_channel_t *ch = model_map_it_value(chit);
-                if (strcmp(ch->host, host) == 0) {
-                    return true;
-                }
-            }
-        }
-    }
-    return false;
+    res->ai_family = AF_INET;
+    res->ai_addrlen = sizeof(*addr4);
 }
 
-ZITI_FUNC
-int Ziti_resolve(const char *host, const char *port, const struct addrinfo *hints, struct addrinfo **addrlist) {
+/**
+ * resolves numeric addresses immediately, or prepares [res] for Ziti lookup
+ * @return 0 - resolved, 1 - Ziti lookup is needed, EAI_* error code otherwise
+ */
+static int resolve_prepare(const char *host, const char *port, const struct addrinfo *hints,
+                           struct addrinfo **res, in_port_t *portnum) {
     if (host == NULL) {
         return EAI_NONAME;
     }
@@ -1268,46 +2325,66 @@ int Ziti_resolve(const char *host, const char *port, const struct addrinfo *hint
             case SOCK_DGRAM:proto = IPPROTO_UDP;break;
             case 0:proto = 0;break;// any type
             default: // no other protocols are supported
-                return -1;
+                return EAI_SOCKTYPE;
         }
     }
 
-    // refuse resolving controller/router addresses here
-    // this way Ziti context can operate even if resolve was high-jacked (e.g. zitify)
-    if (is_internal(host)) {
-        return -1;
+    *portnum = port ? (in_port_t) strtol(port, NULL, 10) : 0;
+    ZITI_LOG(DEBUG, "host[%s] port[%s]", host, port);
+    *res = new_addrinfo(socktype, proto);
+
+    if (uv_ip4_addr(host, *portnum, (struct sockaddr_in *) (*res)->ai_addr) == 0) {
+        ZITI_LOG(DEBUG, "host[%s] port[%s] is IPv4 address", host, port);
+        (*res)->ai_family = AF_INET;
+        (*res)->ai_addrlen = sizeof(struct sockaddr_in);
+        return 0;
     }
 
-    in_port_t portnum = port ? (in_port_t) strtol(port, NULL, 10) : 0;
-    ZITI_LOG(DEBUG, "host[%s] port[%s]", host, port);
-    struct addrinfo *res = calloc(1, sizeof(struct addrinfo));
-    res->ai_socktype = socktype;
-    res->ai_protocol = proto;
+    if (uv_ip6_addr(host, *portnum, (struct sockaddr_in6 *) (*res)->ai_addr) == 0) {
+        ZITI_LOG(INFO, "host[%s] port[%s] is IPv6 address", host, port);
+        (*res)->ai_family = AF_INET6;
+        (*res)->ai_addrlen = sizeof(struct sockaddr_in6);
+        return 0;
+    }
 
-    struct sockaddr_in *addr4 = calloc(1, sizeof(struct sockaddr_in6));
-    int rc = 0;
-    if ((rc = uv_ip4_addr(host, portnum, addr4)) == 0) {
-        ZITI_LOG(DEBUG, "host[%s] port[%s] rc = %d", host, port, rc);
+    // no snapshot before Ziti_lib_init() or after Ziti_lib_shutdown()
+    if (resolve_gc == NULL) {
+        return 1;
+    }
 
-        res->ai_family = AF_INET;
-        res->ai_addr = (struct sockaddr *) addr4;
-        res->ai_addrlen = sizeof(struct sockaddr_in);
+    unsigned epoch = epoch_gc_enter(resolve_gc);
+    resolve_snapshot_t *snap = atomic_load(&resolve_snap);
+    bool internal = snap && snapshot_is_internal(snap, host);
+    in_addr_t ip = host_table_get(resolve_hosts, host);
+    epoch_gc_leave(resolve_gc, epoch);
 
-        *addrlist = res;
+    // refuse resolving controller/router addresses here
+    // this way Ziti context can operate even if resolve was high-jacked (e.g. zitify)
+    if (internal) {
+        FREE(*res);
+        return EAI_FAIL;
+    }
+
+    if (ip != 0) {
+        ZITI_LOG(DEBUG, "host[%s] is already assigned %x", host, ip);
+        set_ziti_addr(*res, *portnum, ip);
         return 0;
-    } else if (uv_ip6_addr(host, portnum, (struct sockaddr_in6 *) addr4) == 0) {
-        ZITI_LOG(INFO, "host[%s] port[%s] rc = %d", host, port, rc);
+    }
 
-        res->ai_family = AF_INET6;
-        res->ai_addr = (struct sockaddr *) addr4;
-        res->ai_addrlen = sizeof(struct sockaddr_in6);
+    return 1;
+}
+
+ZITI_FUNC
+int Ziti_resolve(const char *host, const char *port, const struct addrinfo *hints, struct addrinfo **addrlist) {
+    struct addrinfo *res = NULL;
+    in_port_t portnum = 0;
+    int rc = resolve_prepare(host, port, hints, &res, &portnum);
+    if (rc == 0) {
         *addrlist = res;
         return 0;
     }
-
-    MODEL_MAP_FOR(it, ziti_contexts) {
-        ztx_wrap_t *ztx = model_map_it_value(it);
-        await_future(ztx->services_loaded, NULL);
+    if (rc != 1) {
+        return rc == EAI_NONAME ? rc : -1;
     }
 
     struct conn_req_s req = {
@@ -1315,38 +2392,223 @@ int Ziti_resolve(const char *host, const char *port, const struct addrinfo *hint
             .port = portnum,
     };
 
-    future_t *f = schedule_on_loop((loop_work_cb) resolve_cb, &req, true);
+    future_t *f = schedule_on_loop(do_resolve, &req, true);
     uintptr_t result;
     int err = await_future(f, (void **) &result);
     set_error(err);
 
     if (err == 0) {
-        addr4->sin_family = AF_INET;
-        addr4->sin_port = htons(portnum);
-        addr4->sin_addr.s_addr = (in_addr_t)result;
-
-        res->ai_family = AF_INET;
-        res->ai_addr = (struct sockaddr *) addr4;
-        res->ai_socktype = hints->ai_socktype;
-
-        res->ai_addrlen = sizeof(*addr4);
+        set_ziti_addr(res, portnum, (in_addr_t) result);
         *addrlist = res;
     } else {
         free(res);
-        free(addr4);
     }
     destroy_future(f);
 
     return err == 0 ? 0 : -1;
 }
 
+struct resolve_async_s {
+    struct conn_req_s req;
+    struct addrinfo *res;
+    void *ctx;
+};
+
+static void on_resolve_async(void *result, int err, void *data) {
+    struct resolve_async_s *r = data;
+    if (err == 0) {
+        set_ziti_addr(r->res, r->req.port, (in_addr_t) (uintptr_t) result);
+    } else {
+        FREE(r->res);
+    }
+
+    post_completion(r->ctx, err, SOCKET_ERROR, r->res);
+    free((char *) r->req.host);
+    free(r);
+}
+
+
+ZITI_FUNC
+int Ziti_resolve_async(const char *host, const char *port, const struct addrinfo *hints, void *ctx) {
+    struct addrinfo *res = NULL;
+    in_port_t portnum = 0;
+    int rc = resolve_prepare(host, port, hints, &res, &portnum);
+    if (rc == 0) {
+        post_completion(ctx, 0, SOCKET_ERROR, res);
+        return 0;
+    }
+    if (rc != 1) {
+        return rc;
+    }
+
+    NEWP(r, struct resolve_async_s);
+    r->req.host = strdup(host);
+    r->req.port = portnum;
+    r->res = res;
+    r->ctx = ctx;
+
+    submit_on_loop(do_resolve, r, new_future_cb(on_resolve_async, r));
+    return 0;
+}
+
 int Ziti_check_socket(ziti_socket_t fd) {
+    int rc = 0;
+    uv_mutex_lock(&sockets_lock);
     ziti_sock_t *sock = model_map_get_key(&ziti_sockets, &fd, sizeof(fd));
-    if (sock == NULL) return 0;
-    if (sock->server) return 2;
-    return 1;
+    if (sock != NULL) {
+        rc = sock->server ? 2 : 1;
+    }
+    uv_mutex_unlock(&sockets_lock);
+    return rc;
+}
+
+static bool sock_nonblocking(ziti_socket_t fd) {
+#if _WIN32
+    // there is no way to query FIONBIO
+    return false;
+#else
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags != -1 && (flags & O_NONBLOCK);
+#endif
+}
+
+static void wait_readable(ziti_socket_t fd) {
+#if _WIN32
+    WSAPOLLFD pfd = { .fd = fd, .events = POLLIN, };
+    WSAPoll(&pfd, 1, -1);
+#else
+    struct pollfd pfd = { .fd = fd, .events = POLLIN, };
+    poll(&pfd, 1, -1);
+#endif
+}
+
+// returns number of bytes read, 0 on EOF, or negative error
+static ssize_t direct_read(direct_sock_t *ds, const uv_buf_t *bufs, int nbufs) {
+    for (;;) {
+        size_t total = 0;
+        for (int i = 0; i < nbufs; i++) {
+            size_t n = spsc_ring_read(&ds->in, bufs[i].base, bufs[i].len);
+            total += n;
+            if (n < bufs[i].len) break;
+        }
+
+        if (total > 0) {
+            atomic_thread_fence(memory_order_seq_cst);
+            if (atomic_load(&ds->in_paused)) {
+                direct_kick_resume(ds);
+            }
+            return (ssize_t) total;
+        }
+
+        direct_clear_read(ds);
+        if (spsc_ring_size(&ds->in) > 0) continue;
+
+        int err = atomic_load(&ds->in_err);
+        if (err == ZITI_EOF) return 0;
+        if (err != 0) return err;
+
+        if (sock_nonblocking(ds->fd)) return UV_EAGAIN;
+        wait_readable(ds->fd);
+    }
+}
+
+static ssize_t direct_write(direct_sock_t *ds, const uint8_t *data, size_t len) {
+    bool nonblock = sock_nonblocking(ds->fd);
+    size_t total = 0;
+    while (total < len) {
+        int err = atomic_load(&ds->out_err);
+        if (err != 0) {
+            return total > 0 ? (ssize_t) total : err;
+        }
+
+        size_t n = spsc_ring_write(&ds->out, data + total, len - total);
+        if (n > 0) {
+            total += n;
+            if (!atomic_exchange(&ds->out_kick, true)) {
+                atomic_fetch_add(&ds->refs, 1);
+                submit_on_loop(direct_flush, ds, NULL);
+            }
+            continue;
+        }
+
+        if (nonblock) {
+            // application is going to poll for POLLOUT
+            direct_plug_write(ds);
+            return total > 0 ? (ssize_t) total : UV_EAGAIN;
+        }
+
+        // wait for loop to release space in the ring
+        uv_mutex_lock(&ds->wlock);
+        atomic_fetch_add(&ds->wwaiters, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        while (spsc_ring_size(&ds->out) == ds->out.cap && atomic_load(&ds->out_err) == 0) {
+            uv_cond_wait(&ds->wcond, &ds->wlock);
+        }
+        atomic_fetch_sub(&ds->wwaiters, 1);
+        uv_mutex_unlock(&ds->wlock);
+    }
+    return (ssize_t) total;
 }
 
+static ssize_t direct_result(ssize_t rc) {
+    if (rc >= 0) {
+        set_error(0);
+        return rc;
+    }
+
+    if (rc == UV_EAGAIN) {
+        set_error(EWOULDBLOCK);
+        errno = EWOULDBLOCK;
+    } else {
+        set_error((int) rc);
+        errno = rc == ZITI_CONN_CLOSED ? EPIPE : ECONNRESET;
+    }
+    return -1;
+}
+
+ziti_ssize_t Ziti_read(ziti_socket_t fd, void *buf, size_t len) {
+    direct_sock_t *ds = direct_get(fd);
+    if (ds == NULL) {
+        ssize_t rc = recv(fd, buf, len, 0);
+        set_error(rc < 0 ? errno : 0);
+        return rc;
+    }
+
+    uv_buf_t b = uv_buf_init(buf, (unsigned int) len);
+    ssize_t rc = direct_read(ds, &b, 1);
+    direct_release(ds);
+    return direct_result(rc);
+}
+
+ziti_ssize_t Ziti_write(ziti_socket_t fd, const void *buf, size_t len) {
+    direct_sock_t *ds = direct_get(fd);
+    if (ds == NULL) {
+        ssize_t rc = send(fd, buf, len, 0);
+        set_error(rc < 0 ? errno : 0);
+        return rc;
+    }
+
+    ssize_t rc = direct_write(ds, buf, len);
+    direct_release(ds);
+    return direct_result(rc);
+}
+
+#if !_WIN32
+ziti_ssize_t Ziti_readv(ziti_socket_t fd, const struct iovec *iov, int iovcnt) {
+    direct_sock_t *ds = direct_get(fd);
+    if (ds == NULL) {
+        ssize_t rc = readv(fd, iov, iovcnt);
+        set_error(rc < 0 ? errno : 0);
+        return rc;
+    }
+
+    // uv_buf_t has the same layout as struct iovec on unix
+    ssize_t rc = direct_read(ds, (const uv_buf_t *) iov, iovcnt);
+    direct_release(ds);
+    return direct_result(rc);
+}
+#endif
+
 ZITI_FUNC
 const char *Ziti_lookup(in_addr_t addr) {
     const char *hostname = model_map_get_key(&ip_to_host, &addr, sizeof(addr));
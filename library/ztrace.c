@@ -0,0 +1,220 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ztrace.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ziti/errors.h>
+
+#if !_WIN32
+#include <pthread.h>
+#endif
+
+#define ZTRACE_DEFAULT_RECORDS (64 * 1024)
+
+// per-thread ring, only written by its thread
+struct trace_ring {
+    uint32_t thread_id;
+    // owner thread exited, order of exit. guarded by rings_lock
+    uint64_t exited;
+    size_t cap;
+    atomic_size_t pos;
+    ziti_trace_record *records;
+    struct trace_ring *next;
+};
+
+atomic_bool ztrace_on;
+
+static uv_once_t trace_once = UV_ONCE_INIT;
+static uv_mutex_t rings_lock;
+static struct trace_ring *rings;
+static uint32_t ring_count;
+static uint32_t thread_seq;
+static uint64_t exit_seq;
+static atomic_size_t ring_size;
+
+// thread exit: ring stays in the dump until it is taken over by a new thread
+static void release_ring(void *arg) {
+    struct trace_ring *r = arg;
+    uv_mutex_lock(&rings_lock);
+    r->exited = ++exit_seq;
+    uv_mutex_unlock(&rings_lock);
+}
+
+// uv_key_t has no destructor, rings of exited threads are released with native thread-local keys
+#if _WIN32
+static DWORD trace_key;
+
+static void NTAPI trace_key_dtor(void *r) {
+    if (r) release_ring(r);
+}
+
+#define trace_key_get() ((struct trace_ring *) FlsGetValue(trace_key))
+#define trace_key_set(r) FlsSetValue(trace_key, r)
+#else
+static pthread_key_t trace_key;
+
+#define trace_key_get() ((struct trace_ring *) pthread_getspecific(trace_key))
+#define trace_key_set(r) pthread_setspecific(trace_key, r)
+#endif
+
+static void trace_init(void) {
+#if _WIN32
+    trace_key = FlsAlloc(trace_key_dtor);
+#else
+    pthread_key_create(&trace_key, release_ring);
+#endif
+    uv_mutex_init(&rings_lock);
+}
+
+// runs under rings_lock: oldest exited ring, if enough exited rings are kept
+static struct trace_ring *take_exited_ring(void) {
+    struct trace_ring **oldest = NULL;
+    uint32_t exited = 0;
+    for (struct trace_ring **rp = &rings; *rp != NULL; rp = &(*rp)->next) {
+        if ((*rp)->exited) {
+            exited++;
+            if (oldest == NULL || (*rp)->exited < (*oldest)->exited) {
+                oldest = rp;
+            }
+        }
+    }
+    if (exited < ZTRACE_EXITED_RINGS) {
+        return NULL;
+    }
+
+    struct trace_ring *r = *oldest;
+    *oldest = r->next;
+    ring_count--;
+    return r;
+}
+
+static struct trace_ring *new_ring(void) {
+    size_t cap = 1;
+    while (cap < atomic_load(&ring_size)) cap <<= 1;
+
+    uv_mutex_lock(&rings_lock);
+    struct trace_ring *r = take_exited_ring();
+    uv_mutex_unlock(&rings_lock);
+
+    if (r && r->cap != cap) {
+        free(r->records);
+        FREE(r);
+    }
+
+    if (r == NULL) {
+        r = calloc(1, sizeof(*r));
+        if (r == NULL) return NULL;
+        r->records = calloc(cap, sizeof(ziti_trace_record));
+        if (r->records == NULL) {
+            free(r);
+            return NULL;
+        }
+        r->cap = cap;
+    }
+    r->exited = 0;
+    atomic_store(&r->pos, 0);
+
+    uv_mutex_lock(&rings_lock);
+    r->thread_id = ++thread_seq;
+    r->next = rings;
+    rings = r;
+    ring_count++;
+    uv_mutex_unlock(&rings_lock);
+
+    trace_key_set(r);
+    return r;
+}
+
+void ztrace_emit(enum ziti_trace_event ev, uint32_t id, uint32_t a, uint32_t b) {
+    uv_once(&trace_once, trace_init);
+    struct trace_ring *r = trace_key_get();
+    if (r == NULL && (r = new_ring()) == NULL) {
+        return;
+    }
+
+    size_t pos = atomic_load_explicit(&r->pos, memory_order_relaxed);
+    ziti_trace_record *rec = &r->records[pos & (r->cap - 1)];
+    rec->ts = uv_hrtime();
+    rec->event = (uint16_t) ev;
+    rec->id = id;
+    rec->a = a;
+    rec->b = b;
+    atomic_store_explicit(&r->pos, pos + 1, memory_order_release);
+}
+
+int ziti_trace_start(size_t records_per_thread) {
+    uv_once(&trace_once, trace_init);
+    atomic_store(&ring_size, records_per_thread > 0 ? records_per_thread : ZTRACE_DEFAULT_RECORDS);
+    atomic_store(&ztrace_on, true);
+    return ZITI_OK;
+}
+
+void ziti_trace_stop(void) {
+    atomic_store(&ztrace_on, false);
+}
+
+static int write_ring(FILE *f, struct trace_ring *r) {
+    size_t pos = atomic_load_explicit(&r->pos, memory_order_acquire);
+    size_t count = pos < r->cap ? pos : r->cap;
+    size_t start = (pos - count) & (r->cap - 1);
+
+    ziti_trace_thread th = {
+            .thread_id = r->thread_id,
+            .count = (uint32_t) count,
+    };
+    if (fwrite(&th, sizeof(th), 1, f) != 1) {
+        return -1;
+    }
+
+    // oldest records first: from start to the end of the buffer, then wrap
+    size_t first = r->cap - start < count ? r->cap - start : count;
+    if (fwrite(r->records + start, sizeof(ziti_trace_record), first, f) != first ||
+        fwrite(r->records, sizeof(ziti_trace_record), count - first, f) != count - first) {
+        return -1;
+    }
+    return 0;
+}
+
+int ziti_trace_dump(const char *path) {
+    uv_once(&trace_once, trace_init);
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        ZITI_LOG(ERROR, "failed to open trace file[%s]: %s", path, strerror(errno));
+        return ZITI_INVALID_CONFIG;
+    }
+
+    uv_mutex_lock(&rings_lock);
+    ziti_trace_header hdr = {
+            .record_size = sizeof(ziti_trace_record),
+            .threads = ring_count,
+    };
+    memcpy(hdr.magic, ZITI_TRACE_MAGIC, sizeof(hdr.magic));
+
+    int rc = fwrite(&hdr, sizeof(hdr), 1, f) == 1 ? 0 : -1;
+    for (struct trace_ring *r = rings; r != NULL && rc == 0; r = r->next) {
+        rc = write_ring(f, r);
+    }
+    uv_mutex_unlock(&rings_lock);
+
+    if (fclose(f) != 0 || rc != 0) {
+        ZITI_LOG(ERROR, "failed to write trace file[%s]", path);
+        return ZITI_WTF;
+    }
+    return ZITI_OK;
+}
@@ -0,0 +1,177 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// converts trace file written by ziti_trace_dump() to text timeline or Chrome trace JSON
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ziti/ziti_trace.h>
+
+struct event_info {
+    const char *name;
+    char phase;
+};
+
+static const struct event_info events[] = {
+        [ZITI_TRACE_NONE] = {"NONE", 'i'},
+#define ev_info(n, ph) [ZITI_TRACE_##n] = {#n, ph},
+        ZITI_TRACE_EVENTS(ev_info)
+#undef ev_info
+};
+
+struct entry {
+    uint32_t thread_id;
+    ziti_trace_record rec;
+};
+
+static int by_time(const void *l, const void *r) {
+    const struct entry *a = l;
+    const struct entry *b = r;
+    if (a->rec.ts != b->rec.ts) return a->rec.ts < b->rec.ts ? -1 : 1;
+    return (a->thread_id > b->thread_id) - (a->thread_id < b->thread_id);
+}
+
+static const struct event_info *event_info(uint16_t ev) {
+    static const struct event_info unknown = {"UNKNOWN", 'i'};
+    return ev < ZITI_TRACE_EVENT_COUNT ? &events[ev] : &unknown;
+}
+
+static int read_trace(FILE *f, struct entry **out, size_t *count) {
+    ziti_trace_header hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+        memcmp(hdr.magic, ZITI_TRACE_MAGIC, sizeof(hdr.magic)) != 0) {
+        fprintf(stderr, "not a ziti trace file\n");
+        return -1;
+    }
+    if (hdr.record_size != sizeof(ziti_trace_record)) {
+        fprintf(stderr, "unsupported record size[%u]\n", hdr.record_size);
+        return -1;
+    }
+
+    struct entry *entries = NULL;
+    size_t n = 0;
+    for (uint32_t t = 0; t < hdr.threads; t++) {
+        ziti_trace_thread th;
+        if (fread(&th, sizeof(th), 1, f) != 1) {
+            fprintf(stderr, "truncated trace file\n");
+            free(entries);
+            return -1;
+        }
+
+        if (th.count == 0) {
+            continue;
+        }
+
+        struct entry *e = realloc(entries, (n + th.count) * sizeof(struct entry));
+        if (e == NULL) {
+            fprintf(stderr, "out of memory\n");
+            free(entries);
+            return -1;
+        }
+        entries = e;
+        for (uint32_t i = 0; i < th.count; i++, n++) {
+            entries[n].thread_id = th.thread_id;
+            if (fread(&entries[n].rec, sizeof(ziti_trace_record), 1, f) != 1) {
+                fprintf(stderr, "truncated trace file\n");
+                free(entries);
+                return -1;
+            }
+        }
+    }
+
+    if (n > 0) {
+        qsort(entries, n, sizeof(struct entry), by_time);
+    }
+    *out = entries;
+    *count = n;
+    return 0;
+}
+
+static void print_timeline(const struct entry *entries, size_t count) {
+    uint64_t start = count > 0 ? entries[0].rec.ts : 0;
+    printf("%14s %6s %-20s %10s %10s %10s\n", "usec", "thread", "event", "id", "a", "b");
+    for (size_t i = 0; i < count; i++) {
+        const ziti_trace_record *r = &entries[i].rec;
+        uint64_t ns = r->ts - start;
+        printf("%7" PRIu64 ".%03u %6u %-20s %10u %10u %10u\n",
+               ns / 1000, (unsigned) (ns % 1000), entries[i].thread_id,
+               event_info(r->event)->name, r->id, r->a, r->b);
+    }
+}
+
+// https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+static void print_chrome(const struct entry *entries, size_t count) {
+    printf("{\"traceEvents\":[");
+    for (size_t i = 0; i < count; i++) {
+        const ziti_trace_record *r = &entries[i].rec;
+        const struct event_info *info = event_info(r->event);
+
+        // begin/end pairs must have the same name to be matched
+        size_t name_len = strlen(info->name);
+        if (info->phase == 'B') name_len -= strlen("_BEGIN");
+        if (info->phase == 'E') name_len -= strlen("_END");
+
+        printf("%s\n{\"name\":\"%.*s\",\"ph\":\"%c\",%s\"ts\":%" PRIu64 ".%03u,\"pid\":1,\"tid\":%u,"
+               "\"args\":{\"id\":%u,\"a\":%u,\"b\":%u}}",
+               i > 0 ? "," : "", (int) name_len, info->name, info->phase,
+               info->phase == 'i' ? "\"s\":\"t\"," : "",
+               r->ts / 1000, (unsigned) (r->ts % 1000), entries[i].thread_id,
+               r->id, r->a, r->b);
+    }
+    printf("\n]}\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = NULL;
+    int chrome = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--chrome") == 0) {
+            chrome = 1;
+        } else if (path == NULL) {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+
+    if (path == NULL) {
+        fprintf(stderr, "usage: %s [--chrome] <trace file>\n", argv[0]);
+        return 1;
+    }
+
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    struct entry *entries = NULL;
+    size_t count = 0;
+    int rc = read_trace(f, &entries, &count);
+    fclose(f);
+    if (rc != 0) {
+        return 1;
+    }
+
+    if (chrome) {
+        print_chrome(entries, count);
+    } else {
+        print_timeline(entries, count);
+    }
+    free(entries);
+    return 0;
+}
@@ -17,6 +17,7 @@ limitations under the License.
 #include "catch2_includes.hpp"
 
 #include <buffer.h>
+#include <cstring>
 #include <iostream>
 
 TEST_CASE("fixed buffer overflow", "[util]") {
@@ -103,3 +104,61 @@ TEST_CASE("buffer fmt", "[util]") {
 
 
 
+
+TEST_CASE("buffer reserve", "[util]") {
+    auto buf = new_string_buf();
+    std::string expected;
+
+    // spans of all sizes, including larger than a chunk
+    for (size_t n = 1; n < 3000; n += 97) {
+        char *span = string_buf_reserve(buf, n);
+        REQUIRE(span != nullptr);
+        memset(span, 'a' + (int)(n % 26), n);
+        // only part of the reserved span is used
+        string_buf_commit(buf, n / 2);
+        expected.append(n / 2, (char)('a' + n % 26));
+        string_buf_append(buf, "|");
+        expected += "|";
+    }
+    CHECK(string_buf_size(buf) == expected.size());
+
+    size_t len;
+    char *result = string_buf_to_string(buf, &len);
+    CHECK_THAT(result, Catch::Matchers::Equals(expected));
+    CHECK(len == expected.size());
+    free(result);
+    delete_string_buf(buf);
+
+    char b[10];
+    auto fixed = new_fixed_string_buf(b, sizeof(b));
+    REQUIRE(string_buf_reserve(fixed, 8) == b);
+    string_buf_commit(fixed, 8);
+    CHECK(string_buf_reserve(fixed, 3) == nullptr);
+    CHECK(string_buf_reserve(fixed, 2) == b + 8);
+    CHECK(string_buf_size(fixed) == 8);
+    delete_string_buf(fixed);
+}
+
+TEST_CASE("buffer reserve keeps chunk size", "[util]") {
+    auto buf = new_string_buf();
+    size_t chunk_size = buf->chunk_size;
+
+    char *span = string_buf_reserve(buf, chunk_size * 4);
+    REQUIRE(span != nullptr);
+    memset(span, 'x', chunk_size * 4);
+    string_buf_commit(buf, chunk_size * 4);
+    CHECK(buf->chunk_size == chunk_size);
+
+    // oversized chunk is full, next one is of regular size
+    string_buf_append(buf, "y");
+    CHECK(buf->chunk_size == chunk_size);
+    CHECK((size_t) (buf->chunk_end - buf->chunk) == chunk_size);
+    CHECK(string_buf_size(buf) == chunk_size * 4 + 1);
+
+    size_t len;
+    char *result = string_buf_to_string(buf, &len);
+    CHECK(len == chunk_size * 4 + 1);
+    CHECK(std::string(result) == std::string(chunk_size * 4, 'x') + "y");
+    free(result);
+    delete_string_buf(buf);
+}
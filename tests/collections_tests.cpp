@@ -15,7 +15,14 @@
 #include "catch2_includes.hpp"
 
 #include <ziti/model_collections.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
 #include <cstring>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 
 TEST_CASE("model bench", "[model]") {
@@ -217,6 +224,225 @@ TEST_CASE("map remove it inside foreach", "[model]") {
     REQUIRE(m.impl == nullptr);
 }
 
+TEST_CASE("map iteration order", "[model]") {
+    model_map m = {nullptr};
+    model_map_set(&m, "a", (void *) 1);
+    model_map_set(&m, "b", (void *) 2);
+    model_map_setl(&m, 42, (void *) 3);
+    model_map_set(&m, "a-long-key-stored-in-entry", (void *) 4);
+    // replacing value keeps position
+    CHECK(model_map_set(&m, "b", (void *) 5) == (void *) 2);
+
+    // newest first
+    std::vector<intptr_t> values;
+    for (auto it = model_map_iterator(&m); it != nullptr; it = model_map_it_next(it)) {
+        values.push_back((intptr_t) model_map_it_value(it));
+    }
+    CHECK(values == std::vector<intptr_t>{4, 3, 5, 1});
+
+    long k = 42;
+    CHECK(model_map_get_key(&m, &k, sizeof(k)) == (void *) 3);
+    CHECK(model_map_getl(&m, 43) == nullptr);
+    model_map_clear(&m, nullptr);
+}
+
+TEST_CASE("map random operations", "[model]") {
+    std::mt19937 rnd(7);
+    std::unordered_map<std::string, intptr_t> expected;
+    model_map m = {nullptr};
+
+    for (int i = 0; i < 100000; i++) {
+        auto key = "k" + std::to_string(rnd() % 5000);
+        switch (rnd() % 3) {
+            case 0: {
+                auto old = (intptr_t) model_map_set(&m, key.c_str(), (void *) (intptr_t) (i + 1));
+                CHECK(old == expected[key]);
+                expected[key] = i + 1;
+                break;
+            }
+            case 1: {
+                auto old = (intptr_t) model_map_remove(&m, key.c_str());
+                CHECK(old == expected[key]);
+                expected.erase(key);
+                break;
+            }
+            default:
+                CHECK((intptr_t) model_map_get(&m, key.c_str()) == expected[key]);
+        }
+    }
+
+    size_t count = 0;
+    for (auto &e: expected) count += e.second != 0;
+    CHECK(model_map_size(&m) == count);
+
+    const char *k;
+    void *v;
+    MODEL_MAP_FOREACH(k, v, &m) {
+        CHECK((intptr_t) v == expected[k]);
+    }
+    model_map_clear(&m, nullptr);
+}
+
+// minimal copy of the chained model_map the open addressing table replaced, kept for the comparison below
+// entry per allocation, djb2 hash, table doubles when there are more than two entries per bucket
+namespace chained {
+    struct entry {
+        entry *next;
+        uint32_t hash;
+        size_t key_len;
+        void *key;
+        const void *value;
+    };
+
+    struct map {
+        entry **table = nullptr;
+        size_t buckets = 0;
+        size_t size = 0;
+    };
+
+    static uint32_t hash(const void *key, size_t len) {
+        auto p = (const uint8_t *) key;
+        uint32_t h = 0;
+        for (size_t i = 0; i < len; i++) h = ((h << 5U) + h) + p[i];
+        return h;
+    }
+
+    static entry **find(const map *m, const void *key, size_t len, uint32_t h) {
+        entry **e = &m->table[h % m->buckets];
+        for (; *e != nullptr; e = &(*e)->next) {
+            if ((*e)->hash == h && (*e)->key_len == len && memcmp((*e)->key, key, len) == 0) break;
+        }
+        return e;
+    }
+
+    static void resize(map *m) {
+        size_t buckets = m->buckets * 2;
+        auto table = (entry **) calloc(buckets, sizeof(entry *));
+        for (size_t i = 0; i < m->buckets; i++) {
+            for (entry *e = m->table[i], *next; e != nullptr; e = next) {
+                next = e->next;
+                e->next = table[e->hash % buckets];
+                table[e->hash % buckets] = e;
+            }
+        }
+        free(m->table);
+        m->table = table;
+        m->buckets = buckets;
+    }
+
+    static void set(map *m, const void *key, size_t len, const void *val) {
+        if (m->table == nullptr) {
+            m->buckets = 16;
+            m->table = (entry **) calloc(m->buckets, sizeof(entry *));
+        }
+        uint32_t h = hash(key, len);
+        entry **e = find(m, key, len, h);
+        if (*e != nullptr) {
+            (*e)->value = val;
+            return;
+        }
+        auto el = (entry *) calloc(1, sizeof(entry));
+        el->hash = h;
+        el->key_len = len;
+        el->key = malloc(len);
+        memcpy(el->key, key, len);
+        el->value = val;
+        el->next = m->table[h % m->buckets];
+        m->table[h % m->buckets] = el;
+        if (++m->size > m->buckets * 2) resize(m);
+    }
+
+    static void *get(const map *m, const void *key, size_t len) {
+        if (m->table == nullptr) return nullptr;
+        entry *e = *find(m, key, len, hash(key, len));
+        return e ? (void *) e->value : nullptr;
+    }
+
+    static void remove(map *m, const void *key, size_t len) {
+        if (m->table == nullptr) return;
+        entry **e = find(m, key, len, hash(key, len));
+        if (*e == nullptr) return;
+        entry *el = *e;
+        *e = el->next;
+        free(el->key);
+        free(el);
+        if (--m->size == 0) {
+            free(m->table);
+            *m = map{};
+        }
+    }
+}
+
+struct model_map_ops {
+    model_map m = {nullptr};
+    void set(const void *k, size_t len, const void *v) { model_map_set_key(&m, k, len, v); }
+    void *get(const void *k, size_t len) { return model_map_get_key(&m, k, len); }
+    void remove(const void *k, size_t len) { model_map_remove_key(&m, k, len); }
+    bool empty() const { return m.impl == nullptr; }
+};
+
+struct chained_map_ops {
+    chained::map m;
+    void set(const void *k, size_t len, const void *v) { chained::set(&m, k, len, v); }
+    void *get(const void *k, size_t len) { return chained::get(&m, k, len); }
+    void remove(const void *k, size_t len) { chained::remove(&m, k, len); }
+    bool empty() const { return m.table == nullptr; }
+};
+
+template<class M>
+static void bench_map(const char *name, std::vector<std::string> keys, std::vector<long> lkeys) {
+    using clock = std::chrono::steady_clock;
+    M m;
+    auto start = clock::now();
+    for (auto &k: keys) m.set(k.c_str(), k.size(), k.c_str());
+    auto set_time = clock::now() - start;
+
+    // lookup in random order, sequential keys make hash locality look better than it is
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(1));
+    start = clock::now();
+    size_t found = 0;
+    for (int i = 0; i < 10; i++) {
+        for (auto &k: keys) found += m.get(k.c_str(), k.size()) != nullptr;
+    }
+    auto get_time = clock::now() - start;
+    CHECK(found == 10 * keys.size());
+
+    start = clock::now();
+    for (auto &k: keys) m.remove(k.c_str(), k.size());
+    auto remove_time = clock::now() - start;
+    CHECK(m.empty());
+
+    start = clock::now();
+    for (auto k: lkeys) m.set(&k, sizeof(k), (void *) 1);
+    for (int j = 0; j < 10; j++) {
+        for (auto k: lkeys) found += m.get(&k, sizeof(k)) != nullptr;
+    }
+    for (auto k: lkeys) m.remove(&k, sizeof(k));
+    auto long_time = clock::now() - start;
+    CHECK(m.empty());
+
+    using ms = std::chrono::duration<double, std::milli>;
+    printf("%-8s %zu string keys: set %.1f ms, 10x get %.1f ms, remove %.1f ms; long keys set/10x get/remove %.1f ms\n",
+           name, keys.size(), ms(set_time).count(), ms(get_time).count(), ms(remove_time).count(),
+           ms(long_time).count());
+}
+
+// run with `all_tests "[bench]"`
+TEST_CASE("map operations", "[.][bench]") {
+    const int count = 200000;
+    std::vector<std::string> keys;
+    for (int i = 0; i < count; i++) {
+        keys.push_back("service-name-" + std::to_string(i));
+    }
+
+    std::vector<long> lkeys;
+    for (long i = 0; i < count; i++) lkeys.push_back(i * 4096);
+    std::shuffle(lkeys.begin(), lkeys.end(), std::mt19937(1));
+
+    bench_map<chained_map_ops>("chained", keys, lkeys);
+    bench_map<model_map_ops>("model", keys, lkeys);
+}
+
 TEST_CASE("list remove inside foreach", "[model]") {
     model_list l{};
     char key[128];
@@ -232,4 +458,78 @@ TEST_CASE("list remove inside foreach", "[model]") {
     }
 
     REQUIRE(l.impl == nullptr);
-}
\ No newline at end of file
+}
+
+TEST_CASE("list push/append/remove", "[model]") {
+    std::mt19937 rnd(3);
+    std::deque<intptr_t> expected;
+    model_list l{};
+
+    for (intptr_t i = 1; i < 20000; i++) {
+        switch (rnd() % 4) {
+            case 0:
+                model_list_push(&l, (void *) i);
+                expected.push_front(i);
+                break;
+            case 1:
+                CHECK((intptr_t) model_list_pop(&l) == (expected.empty() ? 0 : expected.front()));
+                if (!expected.empty()) expected.pop_front();
+                break;
+            default:
+                model_list_append(&l, (void *) i);
+                expected.push_back(i);
+        }
+
+        // drop multiples of 7 once in a while
+        if (i % 1000 == 0) {
+            MODEL_LIST_FOR(it, l) {
+                if ((intptr_t) model_list_it_element(it) % 7 == 0) {
+                    model_list_it_remove(it);
+                }
+            }
+            expected.erase(std::remove_if(expected.begin(), expected.end(), [](intptr_t v) { return v % 7 == 0; }),
+                           expected.end());
+        }
+    }
+
+    REQUIRE(model_list_size(&l) == expected.size());
+    CHECK((intptr_t) model_list_head(&l) == expected.front());
+    std::vector<intptr_t> actual;
+    const void *el;
+    MODEL_LIST_FOREACH(el, l) {
+        actual.push_back((intptr_t) el);
+    }
+    CHECK(actual == std::vector<intptr_t>(expected.begin(), expected.end()));
+
+    model_list_clear(&l, nullptr);
+    CHECK(l.impl == nullptr);
+}
+
+// run with `all_tests "[bench]"`
+TEST_CASE("list operations", "[.][bench]") {
+    const int count = 1000000;
+    model_list l{};
+
+    auto start = std::chrono::steady_clock::now();
+    for (intptr_t i = 0; i < count; i++) model_list_append(&l, (void *) i);
+    auto append_time = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    intptr_t sum = 0;
+    for (int j = 0; j < 10; j++) {
+        const void *el;
+        MODEL_LIST_FOREACH(el, l) {
+            sum += (intptr_t) el;
+        }
+    }
+    auto iter_time = std::chrono::steady_clock::now() - start;
+    CHECK(sum == 10 * ((intptr_t) count * (count - 1) / 2));
+
+    start = std::chrono::steady_clock::now();
+    model_list_clear(&l, nullptr);
+    auto clear_time = std::chrono::steady_clock::now() - start;
+
+    using ms = std::chrono::duration<double, std::milli>;
+    printf("%d elements: append %.1f ms, 10x iterate %.1f ms, clear %.1f ms\n",
+           count, ms(append_time).count(), ms(iter_time).count(), ms(clear_time).count());
+}
@@ -0,0 +1,539 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2_includes.hpp"
+#include "tls_fixture.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "zt_internal.h"
+#include "endian_internal.h"
+#include "edge_protocol.h"
+#include "message.h"
+
+// connect.h enum clashes with conn_state typedef in C++
+#define conn_state conn_state_enum
+#include "connect.h"
+#undef conn_state
+
+#define ABYTES crypto_secretstream_xchacha20poly1305_ABYTES
+#define HEADERBYTES crypto_secretstream_xchacha20poly1305_HEADERBYTES
+
+// dialing side of the connection, on the other side of the edge router
+struct edge_peer {
+    uint8_t pk[crypto_kx_PUBLICKEYBYTES];
+    uint8_t sk[crypto_kx_SECRETKEYBYTES];
+    uint8_t rx[crypto_kx_SESSIONKEYBYTES];
+    uint8_t tx[crypto_kx_SESSIONKEYBYTES];
+    crypto_secretstream_xchacha20poly1305_state push;
+    crypto_secretstream_xchacha20poly1305_state pull;
+    bool pull_ready = false;
+    uint32_t msg_seq = 0;
+    int32_t edge_seq = 0;
+};
+
+// edge message sent by the connection, as received by the peer
+struct sent_msg {
+    uint32_t content;
+    int32_t edge_seq;
+    uint32_t flags;
+    std::string data; // decrypted
+};
+
+// accepted connection on a channel to TLS test server, context with crypto workers
+struct crypto_conn_test {
+    uv_loop_t *loop;
+    tls_fixture srv;
+    tls_context *tls = nullptr;
+    ziti_context ztx = nullptr;
+    ziti_channel_t *ch = nullptr;
+    ziti_connection parent = nullptr;
+    ziti_connection conn = nullptr;
+    edge_peer peer;
+
+    std::vector<sent_msg> sent;
+    size_t sent_offset = 0;
+
+    int accepted = -1;
+    std::string received;
+    bool eof = false;
+    std::list<std::string> outbound;
+    std::vector<ssize_t> writes;
+    std::vector<std::string> events;
+    int closes = 0;
+
+    uv_timer_t timer{};
+    bool timed_out = false;
+
+    // runs on the loop after connection flush (uv_idle) and before completed crypto work
+    // is picked up (uv_poll), repeatedly until it returns true
+    uv_prepare_t hook{};
+    std::function<bool()> hook_fn;
+
+    crypto_conn_test() : loop(uv_loop_new()), srv(loop) {
+        uv_timer_init(loop, &timer);
+        timer.data = this;
+        uv_prepare_init(loop, &hook);
+        hook.data = this;
+        uv_prepare_start(&hook, [](uv_prepare_t *p) {
+            auto t = (crypto_conn_test *) p->data;
+            if (t->hook_fn && t->hook_fn()) {
+                t->hook_fn = nullptr;
+            }
+        });
+        uv_unref((uv_handle_t *) &hook);
+
+        ziti_config cfg{};
+        cfg.controller_url = (char *) "https://127.0.0.1:1280";
+        REQUIRE(ziti_context_init(&ztx, &cfg) == ZITI_OK);
+        ziti_options opts{};
+        opts.disabled = true;
+        opts.crypto_threads = 2;
+        ziti_context_set_options(ztx, &opts);
+        REQUIRE(ziti_context_run(ztx, loop) == ZITI_OK);
+        // crypto workers are started on the loop
+        REQUIRE(run_until([this] { return ztx->crypto_pool != nullptr; }));
+
+        connect_channel();
+        accept_conn();
+    }
+
+    ~crypto_conn_test() {
+        if (conn && !conn->close) {
+            ziti_close(conn, nullptr);
+            // let StateClosed go out before channel is gone
+            run_until([this] { return conn->state == Closed; });
+        }
+        if (ch) {
+            ziti_channel_close(ch, ZITI_DISABLED);
+        }
+        if (ztx) {
+            ziti_shutdown(ztx);
+        }
+        srv.close();
+        uv_close((uv_handle_t *) &timer, nullptr);
+        uv_close((uv_handle_t *) &hook, nullptr);
+        uv_run(loop, UV_RUN_DEFAULT);
+        // reaped connection leaves parent's children
+        free(parent);
+        tls->free_ctx(tls);
+        uv_loop_close(loop);
+        free(loop);
+    }
+
+    bool run_until(const std::function<bool()> &done, uint64_t timeout = 5000) {
+        timed_out = false;
+        uv_timer_start(&timer, [](uv_timer_t *t) {
+            ((crypto_conn_test *) t->data)->timed_out = true;
+        }, timeout, 0);
+        while (!done() && !timed_out) {
+            uv_run(loop, UV_RUN_ONCE);
+        }
+        uv_timer_stop(&timer);
+        return done();
+    }
+
+    void connect_channel() {
+        tls = default_tls_context(srv.ca_pem.c_str(), srv.ca_pem.size() + 1);
+
+        ch = (ziti_channel_t *) calloc(1, sizeof(ziti_channel_t));
+        ch->ztx = ztx;
+        ch->loop = loop;
+        ch->id = 1;
+        ch->name = strdup("test-router");
+        ch->url = strdup("tls://127.0.0.1");
+        ch->incoming = new_buffer();
+        ch->in_msg_pool = pool_new(32 * 1024, 16, (void (*)(void *)) message_free);
+
+        ch->connection = (tlsuv_stream_t *) calloc(1, sizeof(tlsuv_stream_t));
+        tlsuv_stream_init(loop, ch->connection, tls);
+        ch->connection->data = ch;
+
+        int status = 1;
+        uv_connect_t req{};
+        req.data = &status;
+        REQUIRE(tlsuv_stream_connect(&req, ch->connection, "127.0.0.1", srv.port, [](uv_connect_t *r, int st) {
+            *(int *) r->data = st;
+        }) == 0);
+        REQUIRE(run_until([&] { return status != 1; }));
+        REQUIRE(status == 0);
+    }
+
+    // what binding does with a Dial request for encrypted service
+    void accept_conn() {
+        crypto_kx_keypair(peer.pk, peer.sk);
+
+        parent = (ziti_connection) calloc(1, sizeof(struct ziti_conn));
+        parent->ziti_ctx = ztx;
+        parent->conn_id = 1000;
+
+        ziti_conn_init(ztx, &conn, this);
+        init_transport_conn(conn);
+        snprintf(conn->marker, sizeof(conn->marker), "-");
+        conn->encrypted = true;
+        init_key_pair(&conn->key_pair);
+        REQUIRE(init_crypto(&conn->key_ex, &conn->key_pair, peer.pk, true) == 0);
+        REQUIRE(crypto_kx_client_session_keys(peer.rx, peer.tx, peer.pk, peer.sk, conn->key_pair.pk) == 0);
+        conn->state = Accepting;
+        conn->channel = ch;
+        conn->parent = parent;
+        conn->dial_req_seq = 1;
+
+        REQUIRE(ziti_accept(conn, on_accept, on_data) == ZITI_OK);
+        REQUIRE(run_until([this] { return accepted != -1; }));
+        REQUIRE(accepted == ZITI_OK);
+
+        // DialSuccess and crypto header
+        REQUIRE(run_until([this] {
+            parse_sent();
+            return peer.pull_ready && TAILQ_EMPTY(&conn->pending_wreqs);
+        }));
+        REQUIRE(sent.size() == 1);
+        CHECK(sent[0].content == ContentTypeDialSuccess);
+        sent.clear();
+    }
+
+    static void on_accept(ziti_connection c, int status) {
+        ((crypto_conn_test *) ziti_conn_data(c))->accepted = status;
+    }
+
+    static ssize_t on_data(ziti_connection c, const uint8_t *data, ssize_t len) {
+        auto t = (crypto_conn_test *) ziti_conn_data(c);
+        if (len == ZITI_EOF) {
+            t->eof = true;
+        } else if (len > 0) {
+            t->received.append((const char *) data, len);
+        }
+        return len;
+    }
+
+    static void on_write(ziti_connection c, ssize_t status, void *) {
+        auto t = (crypto_conn_test *) ziti_conn_data(c);
+        t->writes.push_back(status);
+        t->events.emplace_back("write");
+    }
+
+    static void on_close(ziti_connection c) {
+        auto t = (crypto_conn_test *) ziti_conn_data(c);
+        t->closes++;
+        t->events.emplace_back("close");
+        t->conn = nullptr;
+    }
+
+    // write buffer must stay valid until write_cb
+    void write(const std::string &data) {
+        outbound.push_back(data);
+        auto buf = (uint8_t *) outbound.back().data();
+        REQUIRE(ziti_write(conn, buf, data.size(), on_write, nullptr) == ZITI_OK);
+    }
+
+    // decode messages that made it to the TLS server
+    void parse_sent() {
+        const std::string &wire = srv.received;
+        while (wire.size() - sent_offset >= HEADER_SIZE) {
+            auto p = (uint8_t *) &wire[sent_offset];
+            header_t h;
+            header_from_buffer(&h, p);
+            size_t total = HEADER_SIZE + h.headers_len + h.body_len;
+            if (wire.size() - sent_offset < total) {
+                break;
+            }
+            sent_offset += total;
+
+            message *m;
+            REQUIRE(message_new_from_header(nullptr, p, &m) == ZITI_OK);
+            memcpy(m->msgbufp, p, total);
+            m->nhdrs = parse_hdrs(m->headers, m->header.headers_len, &m->hdrs);
+            REQUIRE(m->nhdrs >= 0);
+
+            sent_msg s{m->header.content, -1, 0};
+            message_get_int32_header(m, SeqHeader, &s.edge_seq);
+            message_get_int32_header(m, FlagsHeader, (int32_t *) &s.flags);
+
+            if (m->header.content == ContentTypeData && !peer.pull_ready) {
+                REQUIRE(m->header.body_len == HEADERBYTES);
+                REQUIRE(crypto_secretstream_xchacha20poly1305_init_pull(&peer.pull, m->body, peer.rx) == 0);
+                peer.pull_ready = true;
+            } else {
+                if (m->header.content == ContentTypeData && m->header.body_len > 0) {
+                    std::string plain(m->header.body_len - ABYTES, '\0');
+                    unsigned long long plain_len;
+                    REQUIRE(crypto_secretstream_xchacha20poly1305_pull(
+                            &peer.pull, (uint8_t *) &plain[0], &plain_len, nullptr,
+                            m->body, m->header.body_len, nullptr, 0) == 0);
+                    s.data = plain;
+                }
+                sent.push_back(s);
+            }
+            pool_return_obj(m);
+        }
+    }
+
+    // message from peer, arriving on the channel
+    void peer_send(const uint8_t *body, size_t len, uint32_t flags) {
+        int32_t conn_id = htole32(conn->rt_conn_id);
+        int32_t edge_seq = htole32(peer.edge_seq++);
+        uint32_t msg_flags = htole32(flags);
+        hdr_t headers[] = {
+                {
+                        .header_id = ConnIdHeader,
+                        .length = sizeof(conn_id),
+                        .value = (uint8_t *) &conn_id,
+                },
+                {
+                        .header_id = SeqHeader,
+                        .length = sizeof(edge_seq),
+                        .value = (uint8_t *) &edge_seq,
+                },
+                {
+                        .header_id = FlagsHeader,
+                        .length = sizeof(msg_flags),
+                        .value = (uint8_t *) &msg_flags,
+                },
+        };
+        message *m = message_new(nullptr, ContentTypeData, headers, flags ? 3 : 2, len);
+        if (len > 0) {
+            memcpy(m->body, body, len);
+        }
+        message_set_seq(m, &peer.msg_seq);
+        buffer_append_copy(ch->incoming, m->msgbufp, m->msgbuflen);
+        pool_return_obj(m);
+    }
+
+    void peer_send_header() {
+        uint8_t header[HEADERBYTES];
+        crypto_secretstream_xchacha20poly1305_init_push(&peer.push, header, peer.tx);
+        peer_send(header, sizeof(header), 0);
+    }
+
+    void peer_send_data(const std::string &data) {
+        std::vector<uint8_t> cipher(data.size() + ABYTES);
+        crypto_secretstream_xchacha20poly1305_push(&peer.push, cipher.data(), nullptr,
+                                                   (const uint8_t *) data.data(), data.size(), nullptr, 0, 0);
+        peer_send(cipher.data(), cipher.size(), 0);
+    }
+
+    void peer_send_fin() {
+        peer_send(nullptr, 0, EDGE_FIN);
+    }
+
+    // what channel does when it reads from the router
+    void deliver() {
+        ziti_channel_prepare(ch);
+    }
+
+    // what context shutdown does to its channels
+    void close_channel() {
+        ziti_channel_close(ch, ZITI_DISABLED);
+        ch = nullptr;
+    }
+};
+
+static std::string payload(char c, size_t len) {
+    std::string s(len, c);
+    s[0] = '<';
+    s[len - 1] = '>';
+    return s;
+}
+
+TEST_CASE("writes behind crypto batch are sent in order", "[conn][crypto]") {
+    crypto_conn_test t;
+    auto conn = t.conn;
+
+    std::vector<std::string> data = {
+            payload('a', 8 * 1024),
+            payload('b', 16 * 1024),
+            payload('c', 4 * 1024),
+    };
+    std::string tail = "tail";
+
+    for (auto &d: data) {
+        t.write(d);
+    }
+
+    bool in_flight = false;
+    t.hook_fn = [&] {
+        if (conn->crypto_out == nullptr) return false;
+
+        in_flight = true;
+        CHECK(conn->crypto_out->count == data.size());
+        CHECK(TAILQ_EMPTY(&conn->wreqs));
+
+        // small write and EOF have to wait for the batch
+        t.write(tail);
+        CHECK(ziti_close_write(conn) == ZITI_OK);
+        return true;
+    };
+
+    REQUIRE(t.run_until([&] {
+        t.parse_sent();
+        return !t.sent.empty() && (t.sent.back().flags & EDGE_FIN) && TAILQ_EMPTY(&conn->pending_wreqs);
+    }));
+    CHECK(in_flight);
+
+    REQUIRE(t.sent.size() == data.size() + 2);
+    for (size_t i = 0; i < data.size(); i++) {
+        CHECK(t.sent[i].content == ContentTypeData);
+        CHECK(t.sent[i].data == data[i]);
+    }
+    CHECK(t.sent[data.size()].data == tail);
+    CHECK(t.sent[data.size() + 1].data.empty());
+    CHECK(t.sent[data.size() + 1].flags & EDGE_FIN);
+
+    // crypto header was edge_seq 0
+    for (size_t i = 0; i < t.sent.size(); i++) {
+        CHECK(t.sent[i].edge_seq == (int32_t) i + 1);
+    }
+
+    REQUIRE(t.writes.size() == 4);
+    CHECK(t.writes[0] == (ssize_t) data[0].size());
+    CHECK(t.writes[1] == (ssize_t) data[1].size());
+    CHECK(t.writes[2] == (ssize_t) data[2].size());
+    CHECK(t.writes[3] == (ssize_t) tail.size());
+}
+
+TEST_CASE("inbound data is decrypted on crypto pool", "[conn][crypto]") {
+    crypto_conn_test t;
+    auto conn = t.conn;
+
+    std::vector<std::string> data = {
+            payload('x', 8 * 1024),
+            payload('y', 32 * 1024),
+            payload('z', 5 * 1024),
+            "small",
+    };
+
+    t.peer_send_header();
+    for (auto &d: data) {
+        t.peer_send_data(d);
+    }
+    t.peer_send_fin();
+
+    bool in_flight = false;
+    t.hook_fn = [&] {
+        if (conn->crypto_in == nullptr) return false;
+
+        in_flight = true;
+        // consecutive data messages are decrypted together, FIN waits behind the batch
+        CHECK(conn->crypto_in->count == data.size());
+        CHECK(TAILQ_FIRST(&conn->in_q) != nullptr);
+        CHECK(t.received.empty());
+        CHECK_FALSE(t.eof);
+        return true;
+    };
+
+    t.deliver();
+    REQUIRE(t.run_until([&] { return t.eof; }));
+    CHECK(in_flight);
+
+    std::string expected;
+    for (auto &d: data) {
+        expected += d;
+    }
+    CHECK(t.received == expected);
+}
+
+TEST_CASE("close waits for crypto pool", "[conn][crypto]") {
+    crypto_conn_test t;
+    auto conn = t.conn;
+    auto conn_id = conn->conn_id;
+    auto ztx = t.ztx;
+
+    SECTION("decrypt in flight") {
+        t.peer_send_header();
+        t.peer_send_data(payload('x', 8 * 1024));
+        t.peer_send_data(payload('y', 8 * 1024));
+
+        bool in_flight = false;
+        t.hook_fn = [&] {
+            if (conn->crypto_in == nullptr) return false;
+
+            in_flight = true;
+            CHECK(ziti_close(conn, crypto_conn_test::on_close) == ZITI_OK);
+            t.close_channel();
+            CHECK(conn->state == Closed);
+
+            // reaper: connection stays until decrypted messages are returned
+            ztx_prepare(&ztx->prepper);
+            CHECK(t.closes == 0);
+            CHECK(LIST_FIRST(&ztx->reap_list) == conn);
+            return true;
+        };
+        t.deliver();
+
+        REQUIRE(t.run_until([&] { return in_flight && conn->crypto_in == nullptr; }));
+        CHECK(t.closes == 0);
+        ztx_prepare(&ztx->prepper);
+        CHECK(t.closes == 1);
+        CHECK(model_map_getl(&ztx->connections, (long) conn_id) == nullptr);
+        // data_cb is cleared by ziti_close()
+        CHECK(t.received.empty());
+    }
+
+    SECTION("encrypt in flight") {
+        t.write(payload('a', 8 * 1024));
+        t.write(payload('b', 8 * 1024));
+
+        t.hook_fn = [&] {
+            if (conn->crypto_out == nullptr) return false;
+
+            CHECK(ziti_close(conn, crypto_conn_test::on_close) == ZITI_OK);
+            t.close_channel();
+            CHECK(conn->state == Closed);
+
+            ztx_prepare(&ztx->prepper);
+            CHECK(t.closes == 0);
+            CHECK(t.writes.empty());
+            return true;
+        };
+
+        REQUIRE(t.run_until([&] { return t.writes.size() == 2; }));
+        // channel is gone: messages are encrypted but not sent
+        CHECK(t.writes[0] == ZITI_INVALID_STATE);
+        CHECK(t.writes[1] == ZITI_INVALID_STATE);
+        CHECK(t.closes == 0);
+
+        ztx_prepare(&ztx->prepper);
+        CHECK(t.closes == 1);
+        CHECK(t.events == std::vector<std::string>{"write", "write", "close"});
+    }
+}
+
+TEST_CASE("shutdown completes crypto batches before reaping connections", "[conn][crypto]") {
+    crypto_conn_test t;
+    auto conn = t.conn;
+
+    t.write(payload('a', 8 * 1024));
+    t.write(payload('b', 8 * 1024));
+    t.write(payload('c', 8 * 1024));
+
+    t.hook_fn = [&] {
+        if (conn->crypto_out == nullptr) return false;
+
+        CHECK(ziti_close(conn, crypto_conn_test::on_close) == ZITI_OK);
+        t.close_channel();
+        ziti_shutdown(t.ztx);
+        t.ztx = nullptr;
+        return true;
+    };
+
+    REQUIRE(t.run_until([&] { return t.closes == 1; }));
+    CHECK(t.writes == std::vector<ssize_t>{ZITI_INVALID_STATE, ZITI_INVALID_STATE, ZITI_INVALID_STATE});
+    CHECK(t.events == std::vector<std::string>{"write", "write", "write", "close"});
+}
@@ -0,0 +1,130 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2_includes.hpp"
+
+#include <map>
+#include <thread>
+
+#include "zt_internal.h"
+
+struct mt_result {
+    std::thread::id loop_thread;
+    std::thread::id write_thread;
+    std::thread::id close_thread;
+    ssize_t write_status = 0;
+    int writes = 0;
+    int closes = 0;
+};
+
+static mt_result mt_res;
+
+static ziti_context new_test_ztx(uv_loop_t *loop) {
+    ziti_config cfg{};
+    cfg.controller_url = (char *) "https://127.0.0.1:1280";
+    ziti_context ztx;
+    REQUIRE(ziti_context_init(&ztx, &cfg) == ZITI_OK);
+    ziti_options opts{};
+    opts.disabled = true;
+    ziti_context_set_options(ztx, &opts);
+    REQUIRE(ziti_context_run(ztx, loop) == ZITI_OK);
+    return ztx;
+}
+
+static int test_disposer(ziti_connection conn) {
+    free(conn);
+    return 1;
+}
+
+static void mt_write_cb(ziti_connection, ssize_t status, void *) {
+    mt_res.write_thread = std::this_thread::get_id();
+    mt_res.write_status = status;
+    mt_res.writes++;
+}
+
+static void mt_close_cb(ziti_connection) {
+    mt_res.close_thread = std::this_thread::get_id();
+    mt_res.closes++;
+}
+
+TEST_CASE("ziti_write_mt/ziti_close_mt run on the loop thread", "[ztx]") {
+    uv_loop_t *loop = uv_loop_new();
+    mt_res = mt_result{};
+    mt_res.loop_thread = std::this_thread::get_id();
+
+    auto ztx = new_test_ztx(loop);
+    ziti_connection conn;
+    ziti_conn_init(ztx, &conn, nullptr);
+    conn->disposer = test_disposer;
+    // closed by the app, but not released yet
+    conn->close = true;
+
+    static uint8_t data[] = "hello";
+    std::thread t([conn] {
+        CHECK(ziti_write_mt(conn, data, sizeof(data), mt_write_cb, nullptr) == ZITI_OK);
+        CHECK(ziti_close_mt(conn, mt_close_cb) == ZITI_OK);
+    });
+    t.join();
+
+    // nothing runs until the loop picks up the requests
+    CHECK(mt_res.writes == 0);
+    CHECK(mt_res.closes == 0);
+
+    uv_run(loop, UV_RUN_NOWAIT);
+
+    CHECK(mt_res.writes == 1);
+    CHECK(mt_res.write_status == ZITI_INVALID_STATE);
+    CHECK(mt_res.write_thread == mt_res.loop_thread);
+
+    // close of already closed connection completes right away
+    CHECK(mt_res.closes == 1);
+    CHECK(mt_res.close_thread == mt_res.loop_thread);
+
+    conn->close = false;
+    ziti_close(conn, nullptr);
+    ziti_shutdown(ztx);
+    uv_run(loop, UV_RUN_DEFAULT);
+    uv_loop_close(loop);
+    free(loop);
+}
+
+TEST_CASE("ziti_write_mt/ziti_close_mt pending at shutdown are completed", "[ztx]") {
+    uv_loop_t *loop = uv_loop_new();
+    mt_res = mt_result{};
+
+    auto ztx = new_test_ztx(loop);
+    // connection handle held by the app thread, not known to the context anymore
+    auto conn = (ziti_connection) calloc(1, sizeof(struct ziti_conn));
+    conn->ziti_ctx = ztx;
+
+    ziti_shutdown(ztx);
+    // context stops processing requests after it was shut down,
+    // this runs after shutdown on the last loop wakeup
+    ziti_queue_work(ztx, [](ziti_context ztx, void *ctx) {
+        auto conn = (ziti_connection) ctx;
+        static uint8_t data[] = "hello";
+        ziti_write_mt(conn, data, sizeof(data), mt_write_cb, nullptr);
+        ziti_close_mt(conn, mt_close_cb);
+    }, conn);
+
+    uv_run(loop, UV_RUN_DEFAULT);
+
+    CHECK(mt_res.writes == 1);
+    CHECK(mt_res.write_status == ZITI_DISABLED);
+    CHECK(mt_res.closes == 1);
+
+    free(conn);
+    uv_loop_close(loop);
+    free(loop);
+}
@@ -0,0 +1,245 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2_includes.hpp"
+
+#include <crypto_pool.h>
+#include <ztrace.h>
+#include <ziti/errors.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define ABYTES crypto_secretstream_xchacha20poly1305_ABYTES
+
+struct stream_test {
+    crypto_pool_t *pool;
+    crypto_secretstream_xchacha20poly1305_state push_state;
+    crypto_secretstream_xchacha20poly1305_state pull_state;
+
+    std::vector<std::string> plain;
+    std::vector<std::vector<uint8_t>> cipher;
+    std::vector<std::string> received;
+
+    size_t next = 0;
+    int batches = 0;
+};
+
+static void submit_next(stream_test *t);
+
+static void on_decrypted(crypto_batch_t *b) {
+    auto t = (stream_test *) b->ctx;
+    for (size_t i = 0; i < b->count; i++) {
+        crypto_op_t *op = &b->ops[i];
+        CHECK(op->rc == 0);
+        t->received.emplace_back((char *) op->out, op->out_len);
+        free(op->out);
+    }
+    free(b);
+
+    submit_next(t);
+}
+
+static void on_encrypted(crypto_batch_t *b) {
+    auto t = (stream_test *) b->ctx;
+    t->batches++;
+
+    // one batch per stream state in flight
+    crypto_batch_t *d = crypto_batch_new(b->count, on_decrypted, t);
+    for (size_t i = 0; i < b->count; i++) {
+        crypto_op_t *op = &b->ops[i];
+        REQUIRE(op->rc == 0);
+        auto &c = *(std::vector<uint8_t> *) op->ctx;
+        CHECK(op->out_len == c.size());
+
+        crypto_op_t *dop = crypto_batch_add(d);
+        dop->decrypt = true;
+        dop->state = &t->pull_state;
+        dop->in = c.data();
+        dop->in_len = c.size();
+        dop->out = (uint8_t *) malloc(c.size() - ABYTES);
+    }
+    crypto_pool_submit(t->pool, d);
+    free(b);
+}
+
+static void submit_next(stream_test *t) {
+    if (t->next == t->plain.size()) return;
+
+    crypto_batch_t *b = crypto_batch_new(5, on_encrypted, t);
+    crypto_op_t *op;
+    while (t->next < t->plain.size() && (op = crypto_batch_add(b)) != nullptr) {
+        auto &p = t->plain[t->next];
+        auto &c = t->cipher[t->next];
+        t->next++;
+
+        // encrypt in place, the way connections do
+        c.resize(p.size() + ABYTES);
+        memcpy(c.data() + 1, p.data(), p.size());
+        op->state = &t->push_state;
+        op->in = c.data() + 1;
+        op->in_len = p.size();
+        op->out = c.data();
+        op->ctx = &c;
+    }
+    crypto_pool_submit(t->pool, b);
+}
+
+TEST_CASE("crypto pool disabled", "[util]") {
+    uv_loop_t *loop = uv_loop_new();
+    CHECK(crypto_pool_new(loop, 0) == nullptr);
+    crypto_pool_free(nullptr);
+    uv_loop_delete(loop);
+}
+
+TEST_CASE("crypto pool preserves stream order", "[util]") {
+    REQUIRE(sodium_init() >= 0);
+    uv_loop_t *loop = uv_loop_new();
+
+    const int streams = 4;
+    crypto_pool_t *pool = crypto_pool_new(loop, 3);
+    REQUIRE(pool != nullptr);
+
+    std::vector<stream_test> tests(streams);
+    for (int s = 0; s < streams; s++) {
+        auto &t = tests[s];
+        t.pool = pool;
+
+        uint8_t key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
+        uint8_t header[crypto_secretstream_xchacha20poly1305_HEADERBYTES];
+        randombytes_buf(key, sizeof(key));
+        crypto_secretstream_xchacha20poly1305_init_push(&t.push_state, header, key);
+        crypto_secretstream_xchacha20poly1305_init_pull(&t.pull_state, header, key);
+
+        for (int i = 0; i < 47; i++) {
+            t.plain.push_back(std::to_string(s) + ":" + std::to_string(i) + std::string(i * 100, 'a' + s));
+        }
+        t.cipher.resize(t.plain.size());
+        submit_next(&t);
+    }
+
+    // pool handle does not keep the loop alive
+    uv_timer_t check;
+    uv_timer_init(loop, &check);
+    check.data = &tests;
+    uv_timer_start(&check, [](uv_timer_t *t) {
+        auto tests = (std::vector<stream_test> *) t->data;
+        for (auto &st: *tests) {
+            if (st.received.size() < st.plain.size()) return;
+        }
+        uv_close((uv_handle_t *) t, nullptr);
+    }, 1, 1);
+    uv_run(loop, UV_RUN_DEFAULT);
+
+    crypto_pool_free(pool);
+    uv_run(loop, UV_RUN_DEFAULT);
+    CHECK(uv_loop_close(loop) == 0);
+    free(loop);
+
+    for (auto &t: tests) {
+        CHECK(t.batches == 10);
+        CHECK(t.received == t.plain);
+    }
+}
+
+TEST_CASE("crypto pool completes work on free", "[util]") {
+    REQUIRE(sodium_init() >= 0);
+    uv_loop_t *loop = uv_loop_new();
+    crypto_pool_t *pool = crypto_pool_new(loop, 2);
+
+    stream_test t;
+    t.pool = pool;
+    uint8_t key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
+    uint8_t header[crypto_secretstream_xchacha20poly1305_HEADERBYTES];
+    randombytes_buf(key, sizeof(key));
+    crypto_secretstream_xchacha20poly1305_init_push(&t.push_state, header, key);
+
+    std::vector<uint8_t> c(1000 + ABYTES);
+    int called = 0;
+    crypto_batch_t *b = crypto_batch_new(1, [](crypto_batch_t *b) {
+        (*(int *) b->ctx)++;
+        CHECK(b->ops[0].rc == 0);
+        CHECK(b->ops[0].out_len == 1000 + ABYTES);
+        free(b);
+    }, &called);
+    crypto_op_t *op = crypto_batch_add(b);
+    op->state = &t.push_state;
+    op->in = c.data() + 1;
+    op->in_len = 1000;
+    op->out = c.data();
+    crypto_pool_submit(pool, b);
+
+    crypto_pool_free(pool);
+    CHECK(called == 1);
+
+    uv_run(loop, UV_RUN_DEFAULT);
+    CHECK(uv_loop_close(loop) == 0);
+    free(loop);
+}
+
+TEST_CASE("crypto pool traces batch id", "[util]") {
+    REQUIRE(sodium_init() >= 0);
+    const char *path = "crypto_trace_test.bin";
+    uv_loop_t *loop = uv_loop_new();
+    crypto_pool_t *pool = crypto_pool_new(loop, 1);
+    REQUIRE(pool != nullptr);
+
+    crypto_secretstream_xchacha20poly1305_state state;
+    uint8_t key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
+    uint8_t header[crypto_secretstream_xchacha20poly1305_HEADERBYTES];
+    randombytes_buf(key, sizeof(key));
+    crypto_secretstream_xchacha20poly1305_init_push(&state, header, key);
+
+    REQUIRE(ziti_trace_start(64) == ZITI_OK);
+    std::vector<uint8_t> c(100 + ABYTES);
+    crypto_batch_t *b = crypto_batch_new(1, [](crypto_batch_t *b) { free(b); }, nullptr);
+    b->id = 4242;
+    crypto_op_t *op = crypto_batch_add(b);
+    op->state = &state;
+    op->in = c.data() + 1;
+    op->in_len = 100;
+    op->out = c.data();
+    crypto_pool_submit(pool, b);
+    crypto_pool_free(pool);
+    ziti_trace_stop();
+
+    REQUIRE(ziti_trace_dump(path) == ZITI_OK);
+    FILE *f = fopen(path, "rb");
+    REQUIRE(f != nullptr);
+    ziti_trace_header hdr{};
+    REQUIRE(fread(&hdr, sizeof(hdr), 1, f) == 1);
+    std::vector<ziti_trace_record> recs;
+    for (uint32_t t = 0; t < hdr.threads; t++) {
+        ziti_trace_thread th{};
+        REQUIRE(fread(&th, sizeof(th), 1, f) == 1);
+        for (uint32_t i = 0; i < th.count; i++) {
+            ziti_trace_record r{};
+            REQUIRE(fread(&r, sizeof(r), 1, f) == 1);
+            if (r.id == 4242) recs.push_back(r);
+        }
+    }
+    fclose(f);
+    remove(path);
+
+    REQUIRE(recs.size() == 2);
+    CHECK(recs[0].event == ZITI_TRACE_ENCRYPT_BEGIN);
+    CHECK(recs[0].a == 100);
+    CHECK(recs[1].event == ZITI_TRACE_ENCRYPT_END);
+
+    uv_run(loop, UV_RUN_DEFAULT);
+    CHECK(uv_loop_close(loop) == 0);
+    free(loop);
+}
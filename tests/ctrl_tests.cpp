@@ -0,0 +1,546 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2_includes.hpp"
+
+#include "http_fixture.hpp"
+
+#include <ziti/errors.h>
+#include <ziti_ctrl.h>
+#include <uv.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+static std::string services_page(const std::string &path, int total) {
+    int limit = 25, offset = 0;
+    auto q = path.find("limit=");
+    if (q != std::string::npos) limit = atoi(path.c_str() + q + 6);
+    q = path.find("offset=");
+    if (q != std::string::npos) offset = atoi(path.c_str() + q + 7);
+
+    std::string json = R"({"meta": {"pagination": {"limit": )" + std::to_string(limit) +
+                       R"(, "offset": )" + std::to_string(offset) +
+                       R"(, "totalCount": )" + std::to_string(total) + R"(}}, "data": [)";
+    for (int i = offset; i < std::min(offset + limit, total); i++) {
+        char svc[1024];
+        snprintf(svc, sizeof(svc), R"(%s{"id": "svc-id-%d", "name": "service-%d", "permissions": ["Dial"],
+            "encryptionRequired": true, "config": {"intercept.v1": {"protocols": ["tcp"],
+            "addresses": ["service-%d.ziti"], "portRanges": [{"low": 80, "high": 80}]}}})",
+                 i > offset ? "," : "", i, i, i);
+        json += svc;
+    }
+    return json + "]}";
+}
+
+TEST_CASE("controller compressed responses", "[ctrl]") {
+    const int total = 60;
+    uv_loop_t *loop = uv_loop_new();
+
+    http_fixture srv(loop, [](const std::string &path) -> std::string {
+        if (path.find("/version") != std::string::npos) {
+            return R"({"data": {"version": "v1.0.0", "revision": "abc", "buildDate": "now",
+                "apiVersions": {"edge": {"v1": {"path": "/edge/client/v1"}}}}, "meta": {}})";
+        }
+        if (path.find("/services") != std::string::npos) {
+            return services_page(path, total);
+        }
+        return R"({"error": {"code": "NOT_FOUND", "message": "not found"}})";
+    });
+
+    struct result_t {
+        ziti_controller ctrl;
+        bool done = false;
+        int err = 0;
+        std::vector<std::string> names;
+    } result;
+
+    auto url = srv.url();
+    model_list urls{};
+    model_list_append(&urls, url.c_str());
+    REQUIRE(ziti_ctrl_init(loop, &result.ctrl, &urls, nullptr) == ZITI_OK);
+    model_list_clear(&urls, nullptr);
+
+    ziti_ctrl_get_version(&result.ctrl, [](const ziti_version *v, const ziti_error *e, void *ctx) {
+        auto r = (result_t *) ctx;
+        if (e) {
+            r->err = e->err;
+            r->done = true;
+            return;
+        }
+        ziti_ctrl_set_token(&r->ctrl, "test-token");
+        ziti_ctrl_get_services(&r->ctrl, [](ziti_service_array arr, const ziti_error *e, void *ctx) {
+            auto r = (result_t *) ctx;
+            r->err = e ? e->err : 0;
+            for (int i = 0; arr && arr[i]; i++) {
+                r->names.emplace_back(arr[i]->name);
+            }
+            free_ziti_service_array(&arr);
+            r->done = true;
+        }, r);
+    }, &result);
+
+    uv_timer_t timeout;
+    uv_timer_init(loop, &timeout);
+    timeout.data = &result;
+    uv_timer_start(&timeout, [](uv_timer_t *t) { ((result_t *) t->data)->done = true; }, 10000, 0);
+    while (!result.done) {
+        uv_run(loop, UV_RUN_ONCE);
+    }
+
+    CHECK(result.err == 0);
+    REQUIRE(result.names.size() == total);
+    for (int i = 0; i < total; i++) {
+        CHECK(result.names[i] == "service-" + std::to_string(i));
+    }
+
+    // version + 3 pages
+    CHECK(srv.requests.size() == 4);
+    // encodings are advertised by tlsuv, controller client does not set the header itself
+    for (auto &req: srv.requests) {
+        auto ae = http_fixture::header(req, "Accept-Encoding");
+        CHECK(model_map_get(&result.ctrl.headers, "Accept-Encoding") == nullptr);
+        CHECK_THAT(ae, Catch::Matchers::ContainsSubstring("gzip", Catch::CaseSensitive::No));
+    }
+    CHECK(srv.sent_bytes * 3 < srv.plain_bytes);
+
+    ziti_ctrl_close(&result.ctrl);
+    srv.close();
+    uv_close((uv_handle_t *) &timeout, nullptr);
+    uv_run(loop, UV_RUN_DEFAULT);
+    uv_loop_close(loop);
+    free(loop);
+}
+
+TEST_CASE("controller switches to faster HA endpoint", "[ctrl]") {
+    uv_loop_t *loop = uv_loop_new();
+
+    std::string slow_url, fast_url;
+    auto handler = [&](const std::string &path) -> std::string {
+        if (path.find("/version") != std::string::npos) {
+            return R"({"data": {"version": "v1.0.0", "revision": "abc", "buildDate": "now",
+                "capabilities": ["HA_CONTROLLER"],
+                "apiVersions": {"edge": {"v1": {"path": "/edge/client/v1"}}}}, "meta": {}})";
+        }
+        if (path.find("/controllers") != std::string::npos) {
+            return R"({"meta": {"pagination": {"limit": 25, "offset": 0, "totalCount": 2}}, "data": [
+                {"id": "slow", "name": "slow", "isOnline": true,
+                 "apiAddresses": {"edge-client": [{"url": ")" + slow_url + R"(", "version": "v1"}]}},
+                {"id": "fast", "name": "fast", "isOnline": true,
+                 "apiAddresses": {"edge-client": [{"url": ")" + fast_url + R"(", "version": "v1"}]}}]})";
+        }
+        return R"({"error": {"code": "NOT_FOUND", "message": "not found"}})";
+    };
+    http_fixture slow(loop, handler);
+    http_fixture fast(loop, handler);
+    slow.delay = 100;
+    slow_url = slow.url() + "/edge/client/v1";
+    fast_url = fast.url() + "/edge/client/v1";
+
+    struct result_t {
+        ziti_controller ctrl;
+        bool done = false;
+        int changes = 0;
+        struct ep_info {
+            std::string id;
+            bool online;
+            bool active;
+            int latency;
+        };
+        std::unordered_map<std::string, ep_info> details;
+    } result;
+
+    model_list urls{};
+    auto url = slow.url();
+    model_list_append(&urls, url.c_str());
+    REQUIRE(ziti_ctrl_init(loop, &result.ctrl, &urls, nullptr) == ZITI_OK);
+    model_list_clear(&urls, nullptr);
+
+    ziti_ctrl_set_callbacks(&result.ctrl, &result, nullptr, [](void *ctx, const model_map *eps) {
+        auto r = (result_t *) ctx;
+        r->changes++;
+        const char *url;
+        ziti_controller_detail *d;
+        MODEL_MAP_FOREACH(url, d, eps) {
+            r->details[url] = {d->id ? d->id : "", d->is_online, ziti_ctrl_is_current(&r->ctrl, url),
+                               d->rtt > 0 ? (int) (d->rtt / 1000) : -1};
+            if (strcmp(d->id, "fast") == 0 && ziti_ctrl_is_current(&r->ctrl, url)) {
+                r->done = true;
+            }
+        }
+    });
+
+    ziti_ctrl_get_version(&result.ctrl, [](const ziti_version *v, const ziti_error *e, void *ctx) {
+        auto r = (result_t *) ctx;
+        REQUIRE(e == nullptr);
+        CHECK(r->ctrl.is_ha);
+        // triggers controller list and endpoint probes
+        ziti_ctrl_set_token(&r->ctrl, "test-token");
+    }, &result);
+
+    uv_timer_t timeout;
+    uv_timer_init(loop, &timeout);
+    timeout.data = &result;
+    uv_timer_start(&timeout, [](uv_timer_t *t) { ((result_t *) t->data)->done = true; }, 10000, 0);
+    while (!result.done) {
+        uv_run(loop, UV_RUN_ONCE);
+    }
+
+    CHECK(result.changes > 0);
+    CHECK_THAT(result.ctrl.url, Catch::Matchers::Equals(fast_url));
+    CHECK(result.details[fast_url].active);
+    CHECK_FALSE(result.details[slow_url].active);
+    CHECK(result.details[slow_url].latency >= 100);
+    CHECK(result.details[fast_url].latency >= 0);
+    CHECK(result.details[fast_url].latency < result.details[slow_url].latency);
+
+    ziti_ctrl_close(&result.ctrl);
+    slow.close();
+    fast.close();
+    uv_close((uv_handle_t *) &timeout, nullptr);
+    uv_run(loop, UV_RUN_DEFAULT);
+    uv_loop_close(loop);
+    free(loop);
+}
+
+TEST_CASE("controller keeps probe connections between rounds", "[ctrl]") {
+    uv_loop_t *loop = uv_loop_new();
+
+    std::string first_url, second_url;
+    auto handler = [&](const std::string &path) -> std::string {
+        if (path.find("/version") != std::string::npos) {
+            return R"({"data": {"version": "v1.0.0", "revision": "abc", "buildDate": "now",
+                "capabilities": ["HA_CONTROLLER"],
+                "apiVersions": {"edge": {"v1": {"path": "/edge/client/v1"}}}}, "meta": {}})";
+        }
+        if (path.find("/controllers") != std::string::npos) {
+            return R"({"meta": {"pagination": {"limit": 25, "offset": 0, "totalCount": 2}}, "data": [
+                {"id": "first", "name": "first", "isOnline": true,
+                 "apiAddresses": {"edge-client": [{"url": ")" + first_url + R"(", "version": "v1"}]}},
+                {"id": "second", "name": "second", "isOnline": true,
+                 "apiAddresses": {"edge-client": [{"url": ")" + second_url + R"(", "version": "v1"}]}}]})";
+        }
+        return R"({"error": {"code": "NOT_FOUND", "message": "not found"}})";
+    };
+    http_fixture first(loop, handler);
+    http_fixture second(loop, handler);
+    first_url = first.url() + "/edge/client/v1";
+    second_url = second.url() + "/edge/client/v1";
+
+    struct result_t {
+        ziti_controller ctrl;
+        bool done = false;
+    } result;
+
+    model_list urls{};
+    auto url = first.url();
+    model_list_append(&urls, url.c_str());
+    REQUIRE(ziti_ctrl_init(loop, &result.ctrl, &urls, nullptr) == ZITI_OK);
+    model_list_clear(&urls, nullptr);
+    result.ctrl.probe_interval = 50;
+
+    ziti_ctrl_get_version(&result.ctrl, [](const ziti_version *v, const ziti_error *e, void *ctx) {
+        auto r = (result_t *) ctx;
+        REQUIRE(e == nullptr);
+        ziti_ctrl_set_token(&r->ctrl, "test-token");
+    }, &result);
+
+    uv_timer_t timeout;
+    uv_timer_init(loop, &timeout);
+    timeout.data = &result;
+    uv_timer_start(&timeout, [](uv_timer_t *t) { ((result_t *) t->data)->done = true; }, 1000, 0);
+    while (!result.done) {
+        uv_run(loop, UV_RUN_ONCE);
+    }
+
+    // endpoints are equally fast, controller requests stay on the first one
+    CHECK(result.ctrl.switch_time == 0);
+    // several rounds of two requests each, all on one probe connection
+    CHECK(second.requests.size() >= 6);
+    CHECK(second.conn_ids == 1);
+
+    ziti_ctrl_close(&result.ctrl);
+    first.close();
+    second.close();
+    uv_close((uv_handle_t *) &timeout, nullptr);
+    uv_run(loop, UV_RUN_DEFAULT);
+    uv_loop_close(loop);
+    free(loop);
+}
+
+TEST_CASE("controller fetches list pages in parallel on idle connections", "[ctrl]") {
+    const int total = 200;
+    uv_loop_t *loop = uv_loop_new();
+
+    http_fixture srv(loop, [](const std::string &path) -> std::string {
+        if (path.find("/version") != std::string::npos) {
+            return R"({"data": {"version": "v1.0.0", "revision": "abc", "buildDate": "now",
+                "apiVersions": {"edge": {"v1": {"path": "/edge/client/v1"}}}}, "meta": {}})";
+        }
+        return services_page(path, total);
+    });
+    srv.delay = 50;
+
+    struct result_t {
+        ziti_controller ctrl;
+        bool done = false;
+        int err = 0;
+        std::vector<std::string> names;
+    } result;
+
+    auto url = srv.url();
+    model_list urls{};
+    model_list_append(&urls, url.c_str());
+    REQUIRE(ziti_ctrl_init(loop, &result.ctrl, &urls, nullptr) == ZITI_OK);
+    model_list_clear(&urls, nullptr);
+    // one connection is reserved for other requests, three are left for pages
+    ziti_ctrl_set_conn_pool(&result.ctrl, 4, 0);
+    ziti_ctrl_set_page_concurrency(&result.ctrl, 3);
+
+    ziti_ctrl_get_version(&result.ctrl, [](const ziti_version *v, const ziti_error *e, void *ctx) {
+        auto r = (result_t *) ctx;
+        if (e) {
+            r->err = e->err;
+            r->done = true;
+            return;
+        }
+        ziti_ctrl_set_token(&r->ctrl, "test-token");
+        ziti_ctrl_get_services(&r->ctrl, [](ziti_service_array arr, const ziti_error *e, void *ctx) {
+            auto r = (result_t *) ctx;
+            r->err = e ? e->err : 0;
+            for (int i = 0; arr && arr[i]; i++) {
+                r->names.emplace_back(arr[i]->name);
+            }
+            free_ziti_service_array(&arr);
+            r->done = true;
+        }, r);
+    }, &result);
+
+    uv_timer_t timeout;
+    uv_timer_init(loop, &timeout);
+    timeout.data = &result;
+    uv_timer_start(&timeout, [](uv_timer_t *t) { ((result_t *) t->data)->done = true; }, 10000, 0);
+    while (!result.done) {
+        uv_run(loop, UV_RUN_ONCE);
+    }
+
+    CHECK(result.err == 0);
+    REQUIRE(result.names.size() == total);
+    for (int i = 0; i < total; i++) {
+        CHECK(result.names[i] == "service-" + std::to_string(i));
+    }
+
+    // version + 8 pages
+    CHECK(srv.requests.size() == 9);
+    CHECK(srv.max_busy_conns == 3);
+    // pages were not queued behind each other while another connection was idle
+    CHECK(srv.max_conn_pending == 1);
+
+    ziti_ctrl_close(&result.ctrl);
+    srv.close();
+    uv_close((uv_handle_t *) &timeout, nullptr);
+    uv_run(loop, UV_RUN_DEFAULT);
+    uv_loop_close(loop);
+    free(loop);
+}
+
+static std::string ctrl_test_handler(const std::string &path, int total) {
+    if (path.find("/version") != std::string::npos) {
+        return R"({"data": {"version": "v1.0.0", "revision": "abc", "buildDate": "now",
+            "apiVersions": {"edge": {"v1": {"path": "/edge/client/v1"}}}}, "meta": {}})";
+    }
+    if (path.find("/current-identity") != std::string::npos) {
+        return R"({"data": {"id": "identity-id", "name": "identity"}, "meta": {}})";
+    }
+    return services_page(path, total);
+}
+
+static std::vector<int> request_conns(const http_fixture &srv, const std::string &path) {
+    std::vector<int> ids;
+    for (size_t i = 0; i < srv.requests.size(); i++) {
+        if (srv.requests[i].find(path) != std::string::npos) {
+            ids.push_back(srv.request_conns[i]);
+        }
+    }
+    return ids;
+}
+
+TEST_CASE("controller keeps a connection for dial path requests", "[ctrl]") {
+    const int total = 200;
+    uv_loop_t *loop = uv_loop_new();
+
+    http_fixture srv(loop, [](const std::string &path) { return ctrl_test_handler(path, total); });
+    srv.delay = 50;
+
+    struct result_t {
+        ziti_controller ctrl;
+        bool done = false;
+        bool identity_first = false;
+        int err = 0;
+        size_t count = 0;
+    } result;
+
+    auto url = srv.url();
+    model_list urls{};
+    model_list_append(&urls, url.c_str());
+    REQUIRE(ziti_ctrl_init(loop, &result.ctrl, &urls, nullptr) == ZITI_OK);
+    model_list_clear(&urls, nullptr);
+    ziti_ctrl_set_conn_pool(&result.ctrl, 2, 0);
+    ziti_ctrl_set_page_concurrency(&result.ctrl, 3);
+
+    ziti_ctrl_get_version(&result.ctrl, [](const ziti_version *v, const ziti_error *e, void *ctx) {
+        auto r = (result_t *) ctx;
+        if (e) {
+            r->err = e->err;
+            r->done = true;
+            return;
+        }
+        ziti_ctrl_set_token(&r->ctrl, "test-token");
+        ziti_ctrl_get_services(&r->ctrl, [](ziti_service_array arr, const ziti_error *e, void *ctx) {
+            auto r = (result_t *) ctx;
+            r->err = e ? e->err : r->err;
+            for (int i = 0; arr && arr[i]; i++) {
+                r->count++;
+            }
+            free_ziti_service_array(&arr);
+            r->done = true;
+        }, r);
+        // issued while the service list is loading
+        ziti_ctrl_current_identity(&r->ctrl, [](ziti_identity_data *id, const ziti_error *e, void *ctx) {
+            auto r = (result_t *) ctx;
+            r->err = e ? e->err : r->err;
+            r->identity_first = !r->done;
+            free_ziti_identity_data_ptr(id);
+        }, r);
+    }, &result);
+
+    uv_timer_t timeout;
+    uv_timer_init(loop, &timeout);
+    timeout.data = &result;
+    uv_timer_start(&timeout, [](uv_timer_t *t) { ((result_t *) t->data)->done = true; }, 10000, 0);
+    while (!result.done) {
+        uv_run(loop, UV_RUN_ONCE);
+    }
+
+    CHECK(result.err == 0);
+    CHECK(result.count == total);
+    // identity request did not wait behind list pages
+    CHECK(result.identity_first);
+
+    auto versions = request_conns(srv, "/version");
+    auto identity = request_conns(srv, "/current-identity");
+    auto pages = request_conns(srv, "/services");
+    REQUIRE(versions.size() == 1);
+    REQUIRE(identity.size() == 1);
+    REQUIRE(pages.size() == 8);
+    CHECK(identity[0] == versions[0]);
+    for (auto id: pages) {
+        CHECK(id != versions[0]);
+    }
+    CHECK(srv.conn_ids == 2);
+
+    ziti_ctrl_close(&result.ctrl);
+    srv.close();
+    uv_close((uv_handle_t *) &timeout, nullptr);
+    uv_run(loop, UV_RUN_DEFAULT);
+    uv_loop_close(loop);
+    free(loop);
+}
+
+TEST_CASE("controller drains connections when pool shrinks", "[ctrl]") {
+    const int total = 200;
+    uv_loop_t *loop = uv_loop_new();
+
+    http_fixture srv(loop, [](const std::string &path) { return ctrl_test_handler(path, total); });
+    srv.delay = 50;
+
+    struct result_t {
+        ziti_controller ctrl;
+        bool done = false;
+        int err = 0;
+        size_t count = 0;
+        unsigned int slots_after_shrink = 0;
+    } result;
+
+    auto url = srv.url();
+    model_list urls{};
+    model_list_append(&urls, url.c_str());
+    REQUIRE(ziti_ctrl_init(loop, &result.ctrl, &urls, nullptr) == ZITI_OK);
+    model_list_clear(&urls, nullptr);
+    ziti_ctrl_set_conn_pool(&result.ctrl, 4, 0);
+    ziti_ctrl_set_page_concurrency(&result.ctrl, 3);
+
+    ziti_ctrl_get_version(&result.ctrl, [](const ziti_version *v, const ziti_error *e, void *ctx) {
+        auto r = (result_t *) ctx;
+        if (e) {
+            r->err = e->err;
+            r->done = true;
+            return;
+        }
+        ziti_ctrl_set_token(&r->ctrl, "test-token");
+        ziti_ctrl_get_services(&r->ctrl, [](ziti_service_array arr, const ziti_error *e, void *ctx) {
+            auto r = (result_t *) ctx;
+            r->err = e ? e->err : 0;
+            for (int i = 0; arr && arr[i]; i++) {
+                r->count++;
+            }
+            free_ziti_service_array(&arr);
+            r->done = true;
+        }, r);
+
+        // first page is in flight on the second connection
+        ziti_ctrl_set_conn_pool(&r->ctrl, 1, 0);
+        r->slots_after_shrink = r->ctrl.conn_slots;
+    }, &result);
+
+    uv_timer_t timeout;
+    uv_timer_init(loop, &timeout);
+    timeout.data = &result;
+    uv_timer_start(&timeout, [](uv_timer_t *t) { ((result_t *) t->data)->done = true; }, 10000, 0);
+    while (!result.done) {
+        uv_run(loop, UV_RUN_ONCE);
+    }
+
+    // in-flight request was not cancelled
+    CHECK(result.err == 0);
+    CHECK(result.count == total);
+    CHECK(result.slots_after_shrink == 2);
+    CHECK(result.ctrl.conn_count == 1);
+    CHECK(result.ctrl.conn_slots == 1);
+    CHECK(result.ctrl.conns[0].client != nullptr);
+
+    auto pages = request_conns(srv, "/services");
+    REQUIRE(pages.size() == 8);
+    CHECK(pages[0] == 1);
+    for (size_t i = 1; i < pages.size(); i++) {
+        CHECK(pages[i] == 0);
+    }
+
+    // growing again opens new connections on demand
+    ziti_ctrl_set_conn_pool(&result.ctrl, 3, 0);
+    CHECK(result.ctrl.conn_count == 3);
+    CHECK(result.ctrl.conn_slots == 3);
+    CHECK(result.ctrl.conns[1].client == nullptr);
+
+    ziti_ctrl_close(&result.ctrl);
+    srv.close();
+    uv_close((uv_handle_t *) &timeout, nullptr);
+    uv_run(loop, UV_RUN_DEFAULT);
+    uv_loop_close(loop);
+    free(loop);
+}
@@ -0,0 +1,162 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2_includes.hpp"
+
+#include <deadline.h>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <vector>
+
+static void noop(void *) {}
+
+static void arm(deadline_heap_t *h, deadline_t *d, uint64_t exp) {
+    d->expire_cb = noop;
+    deadline_heap_set(h, d, exp);
+}
+
+TEST_CASE("deadline heap order", "[util]") {
+    deadline_heap_t h{};
+    std::vector<deadline_t> d(100);
+
+    CHECK(deadline_heap_next(&h) == UINT64_MAX);
+    for (size_t i = 0; i < d.size(); i++) {
+        arm(&h, &d[i], (i * 37) % 100 + 1);
+    }
+    CHECK(deadline_heap_next(&h) == 1);
+
+    // remove every third
+    for (size_t i = 0; i < d.size(); i += 3) {
+        clear_deadline(&d[i]);
+        CHECK(d[i].heap == nullptr);
+    }
+
+    uint64_t last = 0;
+    int count = 0;
+    deadline_t *e;
+    CHECK(deadline_heap_pop(&h, 0) == nullptr);
+    while ((e = deadline_heap_pop(&h, 1000)) != nullptr) {
+        CHECK(e->expiration >= last);
+        CHECK(e->expire_cb != nullptr);
+        CHECK(e->heap == nullptr);
+        last = e->expiration;
+        count++;
+    }
+    CHECK(count == 66);
+    CHECK(h.size == 0);
+    deadline_heap_free(&h);
+}
+
+TEST_CASE("deadline lazy re-arm", "[util]") {
+    deadline_heap_t h{};
+    deadline_t a{}, b{};
+
+    arm(&h, &a, 10);
+    arm(&h, &b, 20);
+
+    // extending does not move deadline in the heap
+    arm(&h, &a, 30);
+    CHECK(a.expiration == 30);
+    CHECK(deadline_heap_next(&h) == 10);
+
+    // old due time: nothing expires, [a] is re-positioned
+    CHECK(deadline_heap_pop(&h, 15) == nullptr);
+    CHECK(deadline_heap_next(&h) == 20);
+
+    CHECK(deadline_heap_pop(&h, 25) == &b);
+    CHECK(deadline_heap_pop(&h, 25) == nullptr);
+
+    // moving earlier takes effect immediately
+    arm(&h, &a, 5);
+    CHECK(deadline_heap_next(&h) == 5);
+
+    // expiration must be in the past
+    CHECK(deadline_heap_pop(&h, 5) == nullptr);
+    CHECK(deadline_heap_pop(&h, 6) == &a);
+    CHECK(h.size == 0);
+    deadline_heap_free(&h);
+}
+
+TEST_CASE("deadline random operations", "[util]") {
+    deadline_heap_t h{};
+    std::vector<deadline_t> d(500);
+    std::multiset<std::pair<uint64_t, deadline_t *>> ref;
+    std::vector<uint64_t> exp(d.size(), 0);
+
+    std::mt19937 rnd(42);
+    uint64_t now = 0;
+    for (int op = 0; op < 20000; op++) {
+        size_t i = rnd() % d.size();
+        switch (rnd() % 4) {
+            case 0:
+            case 1: { // (re)arm
+                if (d[i].expire_cb) ref.erase({exp[i], &d[i]});
+                exp[i] = now + 1 + rnd() % 1000;
+                arm(&h, &d[i], exp[i]);
+                ref.insert({exp[i], &d[i]});
+                break;
+            }
+            case 2: // clear
+                if (d[i].expire_cb) ref.erase({exp[i], &d[i]});
+                clear_deadline(&d[i]);
+                break;
+            case 3: { // advance clock and expire
+                now += rnd() % 100;
+                deadline_t *e;
+                while ((e = deadline_heap_pop(&h, now)) != nullptr) {
+                    REQUIRE(!ref.empty());
+                    CHECK(e->expiration < now);
+                    CHECK(ref.erase({e->expiration, e}) == 1);
+                    e->expire_cb = nullptr;
+                }
+                CHECK((ref.empty() || ref.begin()->first >= now));
+                break;
+            }
+        }
+        REQUIRE(h.size >= ref.size());
+    }
+    deadline_heap_free(&h);
+}
+
+// run with `all_tests "[bench]"`
+TEST_CASE("deadline re-arm", "[.][bench]") {
+    const size_t count = 50000;
+    const int rounds = 20;
+    deadline_heap_t h{};
+    std::vector<deadline_t> d(count);
+
+    for (size_t i = 0; i < count; i++) {
+        arm(&h, &d[i], 1000 + i % 1000);
+    }
+
+    // idle timer pattern: every deadline is pushed out on each round
+    std::mt19937 rnd(1);
+    auto start = std::chrono::steady_clock::now();
+    uint64_t now = 0;
+    for (int r = 0; r < rounds; r++) {
+        now += 10;
+        for (size_t n = 0; n < count; n++) {
+            arm(&h, &d[rnd() % count], now + 1000);
+        }
+        while (deadline_heap_pop(&h, now) != nullptr) {}
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    printf("%zu deadlines, %zu re-arms: %.1f ms\n", count, count * rounds,
+           std::chrono::duration<double, std::milli>(elapsed).count());
+    deadline_heap_free(&h);
+}
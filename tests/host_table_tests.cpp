@@ -0,0 +1,131 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2_includes.hpp"
+
+#include <epoch_gc.h>
+#include <host_table.h>
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+static std::atomic<int> freed;
+
+static void count_free(void *p) {
+    freed++;
+    free(p);
+}
+
+TEST_CASE("epoch gc waits for active readers", "[util]") {
+    freed = 0;
+    epoch_gc_t *gc = epoch_gc_new();
+
+    unsigned t = epoch_gc_enter(gc);
+    epoch_gc_retire(gc, malloc(16), count_free);
+    CHECK(epoch_gc_reclaim(gc) == 1);
+    CHECK(epoch_gc_reclaim(gc) == 1);
+    CHECK(freed == 0);
+
+    // reader that arrives after retire does not hold it up
+    epoch_gc_leave(gc, t);
+    t = epoch_gc_enter(gc);
+    CHECK(epoch_gc_reclaim(gc) == 0);
+    CHECK(freed == 1);
+
+    epoch_gc_retire(gc, malloc(16), count_free);
+    epoch_gc_leave(gc, t);
+    epoch_gc_free(gc);
+    CHECK(freed == 2);
+}
+
+TEST_CASE("epoch gc reclaims in order", "[util]") {
+    freed = 0;
+    epoch_gc_t *gc = epoch_gc_new();
+
+    // no readers: freed right away
+    epoch_gc_retire(gc, malloc(16), count_free);
+    CHECK(epoch_gc_reclaim(gc) == 0);
+    CHECK(freed == 1);
+
+    unsigned t = epoch_gc_enter(gc);
+
+    epoch_gc_retire(gc, malloc(16), count_free);
+    epoch_gc_retire(gc, malloc(16), count_free);
+    CHECK(epoch_gc_reclaim(gc) == 2);
+    epoch_gc_leave(gc, t);
+    CHECK(epoch_gc_reclaim(gc) == 0);
+    CHECK(freed == 3);
+    epoch_gc_free(gc);
+}
+
+TEST_CASE("host table lookup", "[util]") {
+    epoch_gc_t *gc = epoch_gc_new();
+    host_table_t *t = host_table_new(gc);
+
+    char name[32];
+    for (uint32_t i = 1; i <= 10000; i++) {
+        snprintf(name, sizeof(name), "host%u.ziti", i);
+        host_table_add(t, name, i);
+        epoch_gc_reclaim(gc);
+    }
+    CHECK(host_table_size(t) == 10000);
+
+    unsigned e = epoch_gc_enter(gc);
+    for (uint32_t i = 1; i <= 10000; i++) {
+        snprintf(name, sizeof(name), "host%u.ziti", i);
+        REQUIRE(host_table_get(t, name) == i);
+    }
+    CHECK(host_table_get(t, "host0.ziti") == 0);
+    CHECK(host_table_get(t, "host10001.ziti") == 0);
+    epoch_gc_leave(gc, e);
+
+    host_table_free(t);
+    epoch_gc_free(gc);
+}
+
+TEST_CASE("host table concurrent readers", "[util]") {
+    epoch_gc_t *gc = epoch_gc_new();
+    host_table_t *t = host_table_new(gc);
+    const uint32_t count = 20000;
+
+    std::atomic<uint32_t> added(0);
+    std::atomic<bool> failed(false);
+    std::thread reader([&] {
+        char n[32];
+        uint32_t seen;
+        while ((seen = added.load()) < count) {
+            unsigned e = epoch_gc_enter(gc);
+            for (uint32_t i = seen; i > 0 && i + 64 > seen; i--) {
+                snprintf(n, sizeof(n), "host%u.ziti", i);
+                if (host_table_get(t, n) != i) failed = true;
+            }
+            epoch_gc_leave(gc, e);
+        }
+    });
+
+    char name[32];
+    for (uint32_t i = 1; i <= count; i++) {
+        snprintf(name, sizeof(name), "host%u.ziti", i);
+        host_table_add(t, name, i);
+        added = i;
+        epoch_gc_reclaim(gc);
+    }
+    reader.join();
+    CHECK_FALSE(failed);
+    CHECK(epoch_gc_reclaim(gc) == 0);
+
+    host_table_free(t);
+    epoch_gc_free(gc);
+}
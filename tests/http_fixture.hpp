@@ -0,0 +1,209 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ZITI_SDK_HTTP_FIXTURE_HPP
+#define ZITI_SDK_HTTP_FIXTURE_HPP
+
+#include "catch2_includes.hpp"
+
+#include <uv.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+static std::string gzip(const std::string &in) {
+    z_stream zs{};
+    deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    std::string out(deflateBound(&zs, in.size()), '\0');
+    zs.next_in = (Bytef *) in.data();
+    zs.avail_in = (uInt) in.size();
+    zs.next_out = (Bytef *) &out[0];
+    zs.avail_out = (uInt) out.size();
+    deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return out;
+}
+
+// minimal HTTP/1.1 server: keep-alive, GET only, gzip encoded JSON responses if client accepts it
+struct http_fixture {
+    using handler_t = std::function<std::string(const std::string &path)>;
+
+    struct conn {
+        uv_tcp_t tcp;
+        http_fixture *srv;
+        std::string in;
+        int id = 0; // order of accepted connections
+        int pending = 0; // requests received but not answered yet
+    };
+
+    uv_loop_t *loop;
+    uv_tcp_t server{};
+    int port = 0;
+    handler_t handler;
+    std::vector<std::string> requests;
+    std::vector<int> request_conns; // connection id of each request
+    std::vector<conn *> conns;
+    int conn_ids = 0;
+    size_t plain_bytes = 0;
+    size_t sent_bytes = 0;
+    uint64_t delay = 0; // ms, simulated network latency
+    int max_conn_pending = 0; // most requests waiting on one connection
+    int max_busy_conns = 0; // most connections with requests waiting at the same time
+
+    http_fixture(uv_loop_t *l, handler_t h) : loop(l), handler(std::move(h)) {
+        sockaddr_in addr{};
+        uv_ip4_addr("127.0.0.1", 0, &addr);
+        uv_tcp_init(loop, &server);
+        server.data = this;
+        REQUIRE(uv_tcp_bind(&server, (const sockaddr *) &addr, 0) == 0);
+        REQUIRE(uv_listen((uv_stream_t *) &server, 16, on_connect) == 0);
+
+        sockaddr_storage name{};
+        int len = sizeof(name);
+        uv_tcp_getsockname(&server, (sockaddr *) &name, &len);
+        port = ntohs(((sockaddr_in *) &name)->sin_port);
+    }
+
+    // value of request header, empty if it was not sent
+    static std::string header(const std::string &head, const std::string &name) {
+        std::string lower = head;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        auto key = "\r\n" + name + ":";
+        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+        auto pos = lower.find(key);
+        if (pos == std::string::npos) return "";
+        pos += key.size();
+        auto end = head.find("\r\n", pos);
+        auto value = head.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        value.erase(0, value.find_first_not_of(' '));
+        return value;
+    }
+
+    std::string url() const {
+        return "http://127.0.0.1:" + std::to_string(port);
+    }
+
+    void close() {
+        for (auto c: conns) {
+            uv_close((uv_handle_t *) &c->tcp, [](uv_handle_t *h) { delete (conn *) h->data; });
+        }
+        conns.clear();
+        uv_close((uv_handle_t *) &server, nullptr);
+    }
+
+    static void on_connect(uv_stream_t *s, int status) {
+        auto srv = (http_fixture *) s->data;
+        if (status != 0) return;
+
+        auto c = new conn;
+        c->srv = srv;
+        c->id = srv->conn_ids++;
+        c->tcp.data = c;
+        uv_tcp_init(srv->loop, &c->tcp);
+        uv_accept(s, (uv_stream_t *) &c->tcp);
+        srv->conns.push_back(c);
+        uv_read_start((uv_stream_t *) &c->tcp,
+                      [](uv_handle_t *, size_t size, uv_buf_t *b) { *b = uv_buf_init((char *) malloc(size), size); },
+                      on_read);
+    }
+
+    static void on_read(uv_stream_t *s, ssize_t len, const uv_buf_t *b) {
+        auto c = (conn *) s->data;
+        if (len > 0) {
+            c->in.append(b->base, len);
+        }
+        free(b->base);
+        if (len < 0) {
+            auto &conns = c->srv->conns;
+            conns.erase(std::remove(conns.begin(), conns.end(), c), conns.end());
+            uv_close((uv_handle_t *) s, [](uv_handle_t *h) { delete (conn *) h->data; });
+            return;
+        }
+
+        size_t end;
+        while ((end = c->in.find("\r\n\r\n")) != std::string::npos) {
+            std::string head = c->in.substr(0, end);
+            c->in.erase(0, end + 4);
+            c->srv->respond(c, head);
+        }
+    }
+
+    void respond(conn *c, const std::string &head) {
+        requests.push_back(head);
+        request_conns.push_back(c->id);
+        c->pending++;
+        max_conn_pending = std::max(max_conn_pending, c->pending);
+        int busy = (int) std::count_if(conns.begin(), conns.end(), [](conn *cn) { return cn->pending > 0; });
+        max_busy_conns = std::max(max_busy_conns, busy);
+
+        auto path_start = head.find(' ') + 1;
+        auto path = head.substr(path_start, head.find(' ', path_start) - path_start);
+        auto body = handler(path);
+        plain_bytes += body.size();
+
+        std::string encoding;
+        auto ae = header(head, "accept-encoding");
+        std::transform(ae.begin(), ae.end(), ae.begin(), ::tolower);
+        if (ae.find("gzip") != std::string::npos) {
+            body = gzip(body);
+            encoding = "Content-Encoding: gzip\r\n";
+        }
+        sent_bytes += body.size();
+
+        auto resp = new std::string("HTTP/1.1 200 OK\r\n"
+                                    "Content-Type: application/json\r\n" + encoding +
+                                    "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body);
+        if (delay == 0) {
+            send(c, resp);
+            return;
+        }
+
+        struct delayed {
+            uv_timer_t timer;
+            http_fixture *srv;
+            conn *c;
+            std::string *resp;
+        };
+        auto d = new delayed{{}, this, c, resp};
+        d->timer.data = d;
+        uv_timer_init(loop, &d->timer);
+        uv_timer_start(&d->timer, [](uv_timer_t *t) {
+            auto d = (delayed *) t->data;
+            auto &conns = d->srv->conns;
+            if (std::find(conns.begin(), conns.end(), d->c) != conns.end()) {
+                d->srv->send(d->c, d->resp);
+            } else {
+                delete d->resp;
+            }
+            uv_close((uv_handle_t *) t, [](uv_handle_t *h) { delete (delayed *) h->data; });
+        }, delay, 0);
+    }
+
+    void send(conn *c, std::string *resp) {
+        c->pending--;
+        auto wr = new uv_write_t;
+        wr->data = resp;
+        uv_buf_t buf = uv_buf_init(&(*resp)[0], resp->size());
+        uv_write(wr, (uv_stream_t *) &c->tcp, &buf, 1, [](uv_write_t *w, int) {
+            delete (std::string *) w->data;
+            delete w;
+        });
+    }
+};
+
+#endif //ZITI_SDK_HTTP_FIXTURE_HPP
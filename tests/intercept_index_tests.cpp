@@ -0,0 +1,265 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2_includes.hpp"
+
+#include <intercept_index.h>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+struct svc_intercept {
+    std::string name;
+    ziti_intercept_cfg_v1 *cfg;
+};
+
+static void add_service(std::vector<svc_intercept> &services, intercept_index_t *idx,
+                        const std::string &name, const std::string &json) {
+    svc_intercept s{name, alloc_ziti_intercept_cfg_v1()};
+    REQUIRE(parse_ziti_intercept_cfg_v1(s.cfg, json.c_str(), json.size()) > 0);
+    intercept_index_add(idx, name.c_str(), s.cfg);
+    services.push_back(s);
+}
+
+static void free_services(std::vector<svc_intercept> &services) {
+    for (auto &s: services) {
+        free_ziti_intercept_cfg_v1_ptr(s.cfg);
+    }
+    services.clear();
+}
+
+// reference implementation: scan all intercepts, later services win ties (model_map iteration order)
+static const char *scan(const std::vector<svc_intercept> &services, ziti_protocol proto,
+                        const ziti_address *addr, int port, int *score) {
+    const char *best = nullptr;
+    int best_score = -1;
+    for (auto it = services.rbegin(); it != services.rend(); it++) {
+        int match = ziti_intercept_match2(it->cfg, proto, addr, port);
+        if (match == -1) continue;
+        if (best_score == -1 || match < best_score) {
+            best = it->name.c_str();
+            best_score = match;
+        }
+    }
+    *score = best_score;
+    return best;
+}
+
+static const char *lookup(intercept_index_t *idx, ziti_protocol proto, const char *addr_str, int port) {
+    ziti_address addr;
+    REQUIRE(parse_ziti_address_str(&addr, addr_str) == 0);
+    return intercept_index_lookup(idx, proto, &addr, port, nullptr);
+}
+
+TEST_CASE("intercept index lookup", "[model]") {
+    std::vector<svc_intercept> services;
+    intercept_index_t *idx = intercept_index_new();
+
+    add_service(services, idx, "exact", R"({
+        "protocols": ["tcp"], "addresses": ["foo.ziti", "1.2.3.4"], "portRanges": [{"low": 80, "high": 80}]
+    })");
+    add_service(services, idx, "wildcard", R"({
+        "protocols": ["tcp", "udp"], "addresses": ["*.ziti"], "portRanges": [{"low": 1, "high": 1000}]
+    })");
+    add_service(services, idx, "sub-wildcard", R"({
+        "protocols": ["tcp"], "addresses": ["*.bar.ziti"], "portRanges": [{"low": 1, "high": 65535}]
+    })");
+    add_service(services, idx, "net", R"({
+        "protocols": ["tcp", "udp"], "addresses": ["100.64.0.0/10", "1.2.0.0/16", "ff::1/64"],
+        "portRanges": [{"low": 80, "high": 80}, {"low": 0, "high": 65535}]
+    })");
+
+    auto tcp = ziti_protocols.tcp;
+    auto udp = ziti_protocols.udp;
+
+    CHECK_THAT(lookup(idx, tcp, "foo.ziti", 80), Catch::Matchers::Equals("exact"));
+    CHECK_THAT(lookup(idx, tcp, "FOO.Ziti", 80), Catch::Matchers::Equals("exact"));
+    // protocol or port do not match exact address
+    CHECK_THAT(lookup(idx, udp, "foo.ziti", 80), Catch::Matchers::Equals("wildcard"));
+    CHECK_THAT(lookup(idx, tcp, "foo.ziti", 81), Catch::Matchers::Equals("wildcard"));
+    CHECK(lookup(idx, tcp, "foo.ziti", 1001) == nullptr);
+
+    // longer domain wins
+    CHECK_THAT(lookup(idx, tcp, "a.bar.ziti", 80), Catch::Matchers::Equals("sub-wildcard"));
+    CHECK_THAT(lookup(idx, udp, "a.bar.ziti", 80), Catch::Matchers::Equals("wildcard"));
+    // wildcard matches the domain itself
+    CHECK_THAT(lookup(idx, tcp, "ziti", 80), Catch::Matchers::Equals("wildcard"));
+    CHECK(lookup(idx, tcp, "ziti.com", 80) == nullptr);
+
+    CHECK_THAT(lookup(idx, tcp, "1.2.3.4", 80), Catch::Matchers::Equals("exact"));
+    CHECK_THAT(lookup(idx, tcp, "1.2.3.5", 80), Catch::Matchers::Equals("net"));
+    CHECK_THAT(lookup(idx, udp, "100.127.1.1", 443), Catch::Matchers::Equals("net"));
+    CHECK(lookup(idx, udp, "100.128.1.1", 443) == nullptr);
+    CHECK_THAT(lookup(idx, tcp, "ff::abcd:1", 22), Catch::Matchers::Equals("net"));
+    CHECK(lookup(idx, tcp, "ff:abcd::1", 22) == nullptr);
+    CHECK(lookup(idx, tcp, "ff:0:0:1::1", 22) == nullptr);
+
+    ziti_address addr;
+    parse_ziti_address_str(&addr, "100.127.1.1");
+    int score;
+    intercept_index_lookup(idx, tcp, &addr, 80, &score);
+    CHECK(score == (22 << 16));
+
+    intercept_index_remove(idx, "exact");
+    CHECK_THAT(lookup(idx, tcp, "1.2.3.4", 80), Catch::Matchers::Equals("net"));
+    CHECK_THAT(lookup(idx, tcp, "foo.ziti", 80), Catch::Matchers::Equals("wildcard"));
+
+    intercept_index_remove(idx, "wildcard");
+    CHECK(lookup(idx, tcp, "foo.ziti", 80) == nullptr);
+    CHECK(intercept_index_size(idx) == 2);
+
+    intercept_index_free(idx);
+    free_services(services);
+}
+
+static std::string random_intercept(std::mt19937 &rnd, int domains) {
+    std::string addrs;
+    int n = 1 + rnd() % 3;
+    for (int i = 0; i < n; i++) {
+        char buf[128];
+        switch (rnd() % 4) {
+            case 0:
+                snprintf(buf, sizeof(buf), "\"host%u.d%u.ziti\"", (unsigned) (rnd() % 50), (unsigned) (rnd() % domains));
+                break;
+            case 1:
+                snprintf(buf, sizeof(buf), "\"*.d%u.ziti\"", (unsigned) (rnd() % domains));
+                break;
+            case 2:
+                snprintf(buf, sizeof(buf), "\"10.%u.%u.0/%u\"", (unsigned) (rnd() % 4), (unsigned) (rnd() % 256),
+                         (unsigned) (8 + rnd() % 25));
+                break;
+            default:
+                snprintf(buf, sizeof(buf), "\"fd00:%x::/%u\"", (unsigned) (rnd() % 4), (unsigned) (16 + rnd() % 100));
+        }
+        addrs += (i ? "," : "") + std::string(buf);
+    }
+
+    unsigned low = rnd() % 1000;
+    unsigned high = low + rnd() % 100;
+    char json[1024];
+    snprintf(json, sizeof(json),
+             R"({"protocols": [%s], "addresses": [%s], "portRanges": [{"low": %u, "high": %u}, {"low": %u, "high": %u}]})",
+             rnd() % 2 ? R"("tcp")" : R"("tcp","udp")", addrs.c_str(), low, high, low / 2, low / 2 + 10);
+    return json;
+}
+
+static std::vector<std::string> random_queries(std::mt19937 &rnd, int count, int domains) {
+    std::vector<std::string> queries;
+    for (int i = 0; i < count; i++) {
+        char buf[128];
+        switch (rnd() % 3) {
+            case 0:
+                snprintf(buf, sizeof(buf), "host%u.d%u.ziti", (unsigned) (rnd() % 50), (unsigned) (rnd() % domains));
+                break;
+            case 1:
+                snprintf(buf, sizeof(buf), "10.%u.%u.%u", (unsigned) (rnd() % 4), (unsigned) (rnd() % 256),
+                         (unsigned) (rnd() % 256));
+                break;
+            default:
+                snprintf(buf, sizeof(buf), "fd00:%x::%x", (unsigned) (rnd() % 4), (unsigned) (rnd() % 0xffff));
+        }
+        queries.emplace_back(buf);
+    }
+    return queries;
+}
+
+TEST_CASE("intercept index matches scan", "[model]") {
+    std::mt19937 rnd(42);
+    std::vector<svc_intercept> services;
+    intercept_index_t *idx = intercept_index_new();
+
+    const int domains = 20;
+    for (int i = 0; i < 500; i++) {
+        add_service(services, idx, "svc" + std::to_string(i), random_intercept(rnd, domains));
+    }
+
+    // replace some services, position is kept
+    for (int i = 0; i < 50; i++) {
+        auto &s = services[rnd() % services.size()];
+        free_ziti_intercept_cfg_v1(s.cfg);
+        auto json = random_intercept(rnd, domains);
+        REQUIRE(parse_ziti_intercept_cfg_v1(s.cfg, json.c_str(), json.size()) > 0);
+        intercept_index_add(idx, s.name.c_str(), s.cfg);
+    }
+
+    int mismatches = 0;
+    for (auto &q: random_queries(rnd, 5000, domains)) {
+        ziti_address addr;
+        REQUIRE(parse_ziti_address_str(&addr, q.c_str()) == 0);
+        ziti_protocol proto = rnd() % 2 ? ziti_protocols.tcp : ziti_protocols.udp;
+        int port = (int) (rnd() % 1100);
+
+        int expected_score, score;
+        const char *expected = scan(services, proto, &addr, port, &expected_score);
+        const char *actual = intercept_index_lookup(idx, proto, &addr, port, &score);
+        if (score != expected_score ||
+            (expected == nullptr) != (actual == nullptr) ||
+            (expected && strcmp(expected, actual) != 0)) {
+            mismatches++;
+            UNSCOPED_INFO(q << ":" << port << " expected " << (expected ? expected : "none") << "(" << expected_score
+                            << ") got " << (actual ? actual : "none") << "(" << score << ")");
+        }
+    }
+    CHECK(mismatches == 0);
+
+    intercept_index_free(idx);
+    free_services(services);
+}
+
+// run with `all_tests "[bench]"`
+TEST_CASE("intercept index lookup vs scan", "[.][bench]") {
+    std::mt19937 rnd(1);
+    std::vector<svc_intercept> services;
+    intercept_index_t *idx = intercept_index_new();
+
+    const int domains = 500;
+    for (int i = 0; i < 5000; i++) {
+        add_service(services, idx, "svc" + std::to_string(i), random_intercept(rnd, domains));
+    }
+
+    std::vector<ziti_address> queries;
+    for (auto &q: random_queries(rnd, 2000, domains)) {
+        ziti_address addr;
+        parse_ziti_address_str(&addr, q.c_str());
+        queries.push_back(addr);
+    }
+
+    int found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto &q: queries) {
+        int score;
+        found += scan(services, ziti_protocols.tcp, &q, 80, &score) != nullptr;
+    }
+    auto scan_time = std::chrono::steady_clock::now() - start;
+
+    int found_idx = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100; i++) {
+        for (auto &q: queries) {
+            found_idx += intercept_index_lookup(idx, ziti_protocols.tcp, &q, 80, nullptr) != nullptr;
+        }
+    }
+    auto idx_time = (std::chrono::steady_clock::now() - start) / 100;
+
+    CHECK(found * 100 == found_idx);
+    printf("%zu services, %zu lookups: scan %.3f ms, index %.3f ms\n", services.size(), queries.size(),
+           std::chrono::duration<double, std::milli>(scan_time).count(),
+           std::chrono::duration<double, std::milli>(idx_time).count());
+
+    intercept_index_free(idx);
+    free_services(services);
+}
@@ -0,0 +1,103 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2_includes.hpp"
+
+#include <log_ring.h>
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+TEST_CASE("log ring full and release", "[util]") {
+    log_ring_t *r = log_ring_new(3);
+    REQUIRE(r != nullptr);
+
+    for (int i = 0; i < 4; i++) {
+        log_record_t *rec = log_ring_claim(r);
+        REQUIRE(rec != nullptr);
+        rec->level = i;
+        log_ring_publish(r, rec);
+    }
+    CHECK(log_ring_claim(r) == nullptr);
+    CHECK(log_ring_dropped(r) == 1);
+
+    log_record_t *recs[8];
+    REQUIRE(log_ring_peek(r, recs, 8) == 4);
+    for (int i = 0; i < 4; i++) {
+        CHECK(recs[i]->level == i);
+    }
+
+    log_ring_release(r, 2);
+    CHECK(log_ring_peek(r, recs, 8) == 2);
+    CHECK(recs[0]->level == 2);
+
+    // claimed but not published record stops the reader
+    log_record_t *pending = log_ring_claim(r);
+    log_record_t *next = log_ring_claim(r);
+    REQUIRE(pending != nullptr);
+    REQUIRE(next != nullptr);
+    next->level = 5;
+    log_ring_publish(r, next);
+    CHECK(log_ring_peek(r, recs, 8) == 2);
+
+    pending->level = 4;
+    log_ring_publish(r, pending);
+    REQUIRE(log_ring_peek(r, recs, 8) == 4);
+    CHECK(recs[2]->level == 4);
+    CHECK(recs[3]->level == 5);
+
+    log_ring_free(r);
+}
+
+TEST_CASE("log ring multiple producers", "[util]") {
+    const int producers = 4;
+    const int count = 20000;
+
+    log_ring_t *r = log_ring_new(64);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([r, p] {
+            for (int i = 0; i < count; i++) {
+                log_record_t *rec;
+                while ((rec = log_ring_claim(r)) == nullptr) {
+                    std::this_thread::yield();
+                }
+                rec->level = p;
+                rec->ts = i;
+                log_ring_publish(r, rec);
+            }
+        });
+    }
+
+    std::vector<uint64_t> next(producers, 0);
+    int total = 0;
+    log_record_t *recs[16];
+    while (total < producers * count) {
+        size_t n = log_ring_peek(r, recs, 16);
+        for (size_t i = 0; i < n; i++) {
+            // records from each producer arrive in order
+            REQUIRE(recs[i]->ts == next[recs[i]->level]);
+            next[recs[i]->level]++;
+        }
+        log_ring_release(r, n);
+        total += (int) n;
+    }
+
+    for (auto &t: threads) {
+        t.join();
+    }
+    CHECK(log_ring_peek(r, recs, 16) == 0);
+    log_ring_free(r);
+}
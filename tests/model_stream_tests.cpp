@@ -0,0 +1,226 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2_includes.hpp"
+
+#include <model_stream.h>
+#include <internal_model.h>
+#include <json-c/json.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+static std::string service_json(int i) {
+    char json[2048];
+    snprintf(json, sizeof(json), R"({
+        "id": "svc-id-%d", "name": "service-%d", "encryptionRequired": %s,
+        "createdAt": "2024-01-01T00:00:00.000Z", "updatedAt": "2024-01-02T00:00:00.000Z",
+        "_links": {"self": {"href": "./services/svc-id-%d"}}, "tags": {}, "roleAttributes": null,
+        "permissions": ["Dial", "Bind"],
+        "config": {
+            "intercept.v1": {"protocols": ["tcp", "udp"], "addresses": ["svc%d.ziti", "10.1.%d.0/24"],
+                             "portRanges": [{"low": 80, "high": 443}], "dialOptions": {"identity": "\u00e9"}},
+            "host.v1": {"protocol": "tcp", "address": "127.0.0.1", "port": 8%03d, "weight": 1.5}
+        },
+        "postureQueries": [{
+            "policyId": "policy-%d", "isPassing": true, "policyType": "Dial",
+            "postureQueries": [
+                {"id": "q1", "isPassing": false, "queryType": "OS", "timeout": -1},
+                {"id": "q2", "isPassing": true, "queryType": "PROCESS", "timeoutRemaining": 42,
+                 "process": {"osType": "Windows", "path": "C:\\bin\\te\"st.exe"}}
+            ]
+        }]
+    })", i, i, i % 2 ? "true" : "false", i, i, i % 256, i % 1000, i);
+    return json;
+}
+
+static std::string services_response(int count, int offset = 0) {
+    std::string json = R"({"meta": {"pagination": {"limit": 500, "offset": 0, "totalCount": )" +
+                       std::to_string(count) + R"(}, "filterableFields": ["id", "name"]}, "data": [)";
+    for (int i = 0; i < count; i++) {
+        json += (i ? "," : "") + service_json(offset + i);
+    }
+    json += "]}";
+    return json;
+}
+
+static int feed_chunks(model_stream *s, const std::string &json, size_t chunk) {
+    int rc = MODEL_PARSE_PARTIAL;
+    for (size_t off = 0; off < json.size() && rc == MODEL_PARSE_PARTIAL; off += chunk) {
+        rc = model_stream_feed(s, json.data() + off, std::min(chunk, json.size() - off));
+    }
+    return rc;
+}
+
+static ziti_service_array dom_parse(const std::string &json) {
+    json_object *j = json_tokener_parse(json.c_str());
+    ziti_service_array arr = nullptr;
+    REQUIRE(ziti_service_array_from_json(&arr, json_object_object_get(j, "data")) == 0);
+    json_object_put(j);
+    return arr;
+}
+
+TEST_CASE("stream decode matches model_from_json", "[model]") {
+    auto json = services_response(5);
+    ziti_service_array expected = dom_parse(json);
+
+    auto chunk = GENERATE(as<size_t>{}, 1, 3, 17, 4096, 1 << 20);
+    CAPTURE(chunk);
+
+    ziti_service_array arr = nullptr;
+    model_stream *s = new_model_stream();
+    REQUIRE(model_stream_bind(s, "data", &arr, get_ziti_service_meta(), array_mod) == 0);
+    CHECK(feed_chunks(s, json, chunk) >= 0);
+    CHECK(model_stream_status(s) == 0);
+    delete_model_stream(s);
+
+    REQUIRE(arr != nullptr);
+    int i;
+    for (i = 0; expected[i] != nullptr; i++) {
+        REQUIRE(arr[i] != nullptr);
+        CHECK(model_cmp(expected[i], arr[i], get_ziti_service_meta()) == 0);
+    }
+    CHECK(arr[i] == nullptr);
+
+    CHECK_THAT(arr[1]->name, Catch::Matchers::Equals("service-1"));
+    CHECK(arr[1]->encryption);
+    CHECK(*arr[1]->permissions[1] == ziti_session_types.Bind);
+    CHECK_THAT(arr[1]->posture_query_set[0]->posture_queries[1]->process->path,
+               Catch::Matchers::Equals("C:\\bin\\te\"st.exe"));
+    CHECK(*arr[1]->posture_query_set[0]->posture_queries[1]->timeoutRemaining == 42);
+    CHECK_THAT((const char *) model_map_get(&arr[1]->config, "intercept.v1"),
+               Catch::Matchers::Equals((const char *) model_map_get(&expected[1]->config, "intercept.v1")));
+
+    free_ziti_service_array(&arr);
+    free_ziti_service_array(&expected);
+}
+
+TEST_CASE("stream decode appends to array", "[model]") {
+    ziti_service_array arr = nullptr;
+    for (int page = 0; page < 3; page++) {
+        model_stream *s = new_model_stream();
+        model_stream_bind(s, "data", &arr, get_ziti_service_meta(), array_mod);
+        CHECK(feed_chunks(s, services_response(10, page * 10), 100) >= 0);
+        delete_model_stream(s);
+    }
+
+    int count = 0;
+    for (; arr[count] != nullptr; count++) {
+        CHECK_THAT(arr[count]->name, Catch::Matchers::Equals("service-" + std::to_string(count)));
+    }
+    CHECK(count == 30);
+    free_ziti_service_array(&arr);
+}
+
+TEST_CASE("stream decode root object", "[model]") {
+    const char *json = R"( {"token": "tok\ud83d\ude00", "id": "s1", "serviceId": null,
+        "edgeRouters": [{"name": "er1", "hostname": "er1.ziti", "supportedProtocols": {"tls": "tls://er1:3022"}}],
+        "refresh": true, "extra": [1, 2.5e3, {"a": [true, false, null]}]} trailing)";
+
+    ziti_session *ns = nullptr;
+    model_stream *s = new_model_stream();
+    model_stream_bind(s, nullptr, &ns, get_ziti_session_meta(), ptr_mod);
+
+    std::string str(json);
+    int rc = model_stream_feed(s, json, str.size());
+    CHECK(rc == (int) str.find(" trailing"));
+    delete_model_stream(s);
+
+    ziti_session expected;
+    parse_ziti_session(&expected, json, str.size());
+
+    REQUIRE(ns != nullptr);
+    CHECK(model_cmp(&expected, ns, get_ziti_session_meta()) == 0);
+    CHECK_THAT(ns->token, Catch::Matchers::Equals("tok\xf0\x9f\x98\x80"));
+    CHECK(ns->service_id == nullptr);
+    CHECK(!ns->refresh); // not mapped to JSON
+    auto er = (ziti_edge_router *) model_list_head(&ns->edge_routers);
+    REQUIRE(er != nullptr);
+    CHECK_THAT(er->protocols.tls, Catch::Matchers::Equals("tls://er1:3022"));
+
+    free_ziti_session_ptr(ns);
+    free_ziti_session(&expected);
+}
+
+TEST_CASE("stream decode errors", "[model]") {
+    ziti_service_array arr = nullptr;
+    model_stream *s = new_model_stream();
+    model_stream_bind(s, "data", &arr, get_ziti_service_meta(), array_mod);
+
+    SECTION("type mismatch") {
+        CHECK(model_stream_feed(s, R"({"data": [{"id": "a"}, {"name": 42}]})", 37) == -1);
+        CHECK(model_stream_status(s) == -1);
+    }
+
+    SECTION("not an array") {
+        CHECK(model_stream_feed(s, R"({"data": {}})", 12) == -1);
+    }
+
+    SECTION("invalid json") {
+        CHECK(model_stream_feed(s, R"({"data": [{"id": "a"}, {"name" 42}]})", 36) == MODEL_PARSE_INVALID);
+        CHECK(model_stream_feed(s, "}", 1) == MODEL_PARSE_INVALID);
+    }
+
+    SECTION("bad number") {
+        CHECK(model_stream_feed(s, R"({"data": [], "x": 1.e5})", 23) == MODEL_PARSE_INVALID);
+    }
+
+    SECTION("incomplete") {
+        CHECK(model_stream_feed(s, R"({"data": [{"id": "a"}, {"name": "b)", 30) == MODEL_PARSE_PARTIAL);
+        CHECK(model_stream_status(s) == MODEL_PARSE_PARTIAL);
+    }
+
+    delete_model_stream(s);
+    free_ziti_service_array(&arr);
+}
+
+// run with `all_tests "[bench]"`
+TEST_CASE("stream decode vs json-c DOM", "[.][bench]") {
+    const int count = 10000;
+    auto json = services_response(count);
+    const size_t chunk = 16 * 1024;
+
+    auto start = std::chrono::steady_clock::now();
+    json_tokener *tok = json_tokener_new();
+    json_object *j = nullptr;
+    for (size_t off = 0; off < json.size() && j == nullptr; off += chunk) {
+        j = json_tokener_parse_ex(tok, json.data() + off, (int) std::min(chunk, json.size() - off));
+    }
+    json_tokener_free(tok);
+    ziti_service_array dom = nullptr;
+    ziti_service_array_from_json(&dom, json_object_object_get(j, "data"));
+    json_object_put(j);
+    auto dom_time = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    ziti_service_array arr = nullptr;
+    model_stream *s = new_model_stream();
+    model_stream_bind(s, "data", &arr, get_ziti_service_meta(), array_mod);
+    CHECK(feed_chunks(s, json, chunk) >= 0);
+    delete_model_stream(s);
+    auto stream_time = std::chrono::steady_clock::now() - start;
+
+    int n = 0;
+    while (arr[n] != nullptr) n++;
+    CHECK(n == count);
+    CHECK(model_cmp(dom[count - 1], arr[count - 1], get_ziti_service_meta()) == 0);
+
+    printf("%d services (%zu bytes): json-c DOM %.1f ms, stream %.1f ms\n", count, json.size(),
+           std::chrono::duration<double, std::milli>(dom_time).count(),
+           std::chrono::duration<double, std::milli>(stream_time).count());
+
+    free_ziti_service_array(&arr);
+    free_ziti_service_array(&dom);
+}
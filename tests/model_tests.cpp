@@ -17,6 +17,7 @@
 #include <catch2/generators/catch_generators.hpp>
 
 #include <ziti/model_support.h>
+#include <chrono>
 #include <iostream>
 #include <tuple>
 
@@ -247,6 +248,76 @@ TEST_CASE("test string escape", "[model]") {
     free_Bar(&bar);
 }
 
+// byte-by-byte escaping
+static std::string escape_ref(const std::string &s) {
+    std::string r = "\"";
+    for (unsigned char c: s) {
+        switch (c) {
+            case '\n': r += "\\n"; break;
+            case '\b': r += "\\b"; break;
+            case '\r': r += "\\r"; break;
+            case '\t': r += "\\t"; break;
+            case '\\': r += "\\\\"; break;
+            case '"': r += "\\\""; break;
+            default:
+                if (c < ' ') {
+                    char u[8];
+                    snprintf(u, sizeof(u), "\\u%04x", c);
+                    r += u;
+                } else {
+                    r += (char)c;
+                }
+        }
+    }
+    return r + "\"";
+}
+
+TEST_CASE("string escape runs", "[model]") {
+    std::string str;
+    for (int i = 0; i < 5000; i++) {
+        // mostly plain text with some UTF-8, escapes at all offsets
+        int c = 1 + (i * 7919) % 255;
+        str += (i % 13 == 0 || c >= ' ') ? (char)c : 'x';
+    }
+    str += "\xc3\xa9\x7f\x80\xff\x1f\"";
+
+    // all string lengths and escape positions around the 16 byte blocks
+    for (size_t len = 0; len < 40; len++) {
+        for (size_t pos = 0; pos < 40; pos++) {
+            std::string s(len, 'a');
+            if (pos < len) s[pos] = (pos % 3 == 0) ? '"' : (pos % 3 == 1 ? '\\' : '\x01');
+            const char *v = s.c_str();
+            char *json = model_to_json(v, get_model_string_meta(), 0, nullptr);
+            REQUIRE_THAT(json, Equals(escape_ref(s)));
+            free(json);
+        }
+    }
+
+    const char *v = str.c_str();
+    char *json = model_to_json(v, get_model_string_meta(), 0, nullptr);
+    CHECK_THAT(json, Equals(escape_ref(str)));
+
+    // parses back
+    Bar bar = {0};
+    bar.msg = strdup(str.c_str());
+    char *bar_json = Bar_to_json(&bar, 0, nullptr);
+    Bar bar2;
+    REQUIRE(parse_Bar(&bar2, bar_json, strlen(bar_json)) > 0);
+    CHECK_THAT(bar2.msg, Equals(str));
+
+    free(json);
+    free(bar_json);
+    free_Bar(&bar);
+    free_Bar(&bar2);
+}
+
+TEST_CASE("number to JSON", "[model]") {
+    model_number n = GENERATE(0, 7, -1, 1234567890, INT64_MAX, INT64_MIN);
+    char *json = model_to_json(&n, get_model_number_meta(), 0, nullptr);
+    CHECK_THAT(json, Equals(std::to_string(n)));
+    free(json);
+}
+
 TEST_CASE("parse array", "[model]") {
     const char *json = R"([{
         "msg":"\thello\n\"world\"!"
@@ -825,3 +896,125 @@ TEST_CASE("parse duration", "[model]") {
         // check it matches the pre-calculated data
     REQUIRE(d.timeout == expected_output);
 }
+
+#define UNMAPPED_MODEL(XX, ...) \
+XX(name, model_string, none, name, __VA_ARGS__) \
+XX(internal, model_string, none, , __VA_ARGS__) \
+XX(count, model_number, none, count, __VA_ARGS__)
+DECLARE_MODEL(Unmapped, UNMAPPED_MODEL)
+IMPL_MODEL(Unmapped, UNMAPPED_MODEL)
+
+// same type without generated functions
+static type_meta reflective_meta(const type_meta *meta) {
+    type_meta m = *meta;
+    m.field_lookup = nullptr;
+    m.fields_writer = nullptr;
+    return m;
+}
+
+TEST_CASE("generated and reflective model functions", "[model]") {
+    const char *json = R"({
+        "bar": )" BAR1 R"(,
+        "barp": {"num": 1, "nump": 2, "msg": "tab\there"},
+        "bara": [)" BAR1 "," BAR1 R"(],
+        "skip": {"num": 3}
+    })";
+
+    auto reflective = reflective_meta(get_Foo_meta());
+    REQUIRE(get_Foo_meta()->field_lookup != nullptr);
+    REQUIRE(get_Foo_meta()->fields_writer != nullptr);
+
+    Foo gen, refl;
+    REQUIRE(model_parse(&gen, json, strlen(json), get_Foo_meta()) == strlen(json));
+    REQUIRE(model_parse(&refl, json, strlen(json), &reflective) == strlen(json));
+    CHECK(model_cmp(&gen, &refl, get_Foo_meta()) == 0);
+    checkBar1(gen.bar);
+    checkBar1(*gen.bar_arr[1]);
+
+    auto flags = GENERATE(0, MODEL_JSON_COMPACT);
+    char *gen_json = model_to_json(&gen, get_Foo_meta(), flags, nullptr);
+    char *refl_json = model_to_json(&gen, &reflective, flags, nullptr);
+    CHECK_THAT(gen_json, Equals(refl_json));
+
+    free(gen_json);
+    free(refl_json);
+    free_Foo(&gen);
+    free_Foo(&refl);
+}
+
+TEST_CASE("generated lookup skips unmapped fields", "[model]") {
+    auto meta = get_Unmapped_meta();
+    CHECK(meta->field_lookup("name", 4) == &meta->fields[0]);
+    CHECK(meta->field_lookup("count", 5) == &meta->fields[2]);
+    CHECK(meta->field_lookup("", 0) == nullptr);
+    CHECK(meta->field_lookup("internal", 8) == nullptr);
+    CHECK(meta->field_lookup("nam", 3) == nullptr);
+
+    const char *json = R"({"": "x", "internal": "y", "name": "n", "count": 7})";
+    Unmapped u;
+    REQUIRE(parse_Unmapped(&u, json, strlen(json)) == strlen(json));
+    CHECK_THAT(u.name, Equals("n"));
+    CHECK(u.internal == nullptr);
+    CHECK(u.count == 7);
+
+    u.internal = strdup("internal");
+    char *out = Unmapped_to_json(&u, MODEL_JSON_COMPACT, nullptr);
+    CHECK_THAT(out, Equals(R"({"name":"n","count":7})"));
+    free(out);
+    free_Unmapped(&u);
+}
+
+#define LONG_PATH_MODEL(XX, ...) \
+XX(value, model_number, none, a_very_long_json_key_that_does_not_fit_into_the_small_key_buffer_of_the_reflective_model_writer_and_must_not_be_truncated_0123456789abcdef, __VA_ARGS__)
+DECLARE_MODEL(LongPath, LONG_PATH_MODEL)
+IMPL_MODEL(LongPath, LONG_PATH_MODEL)
+
+TEST_CASE("reflective writer handles long field paths", "[model]") {
+    auto reflective = reflective_meta(get_LongPath_meta());
+    REQUIRE(strlen(reflective.fields[0].path) > 128);
+
+    LongPath v{42};
+    char *gen_json = LongPath_to_json(&v, MODEL_JSON_COMPACT, nullptr);
+    char *refl_json = model_to_json(&v, &reflective, MODEL_JSON_COMPACT, nullptr);
+    REQUIRE(refl_json != nullptr);
+    CHECK_THAT(refl_json, Equals(gen_json));
+    CHECK_THAT(refl_json, EndsWith("_0123456789abcdef\":42}"));
+    free(gen_json);
+    free(refl_json);
+}
+
+// run with `all_tests "[bench]"`
+TEST_CASE("generated vs reflective model functions", "[.][bench]") {
+    const int count = 20000;
+    std::string json = "[";
+    for (int i = 0; i < count; i++) {
+        json += (i ? "," : "");
+        json += BAR1;
+    }
+    json += "]";
+
+    json_object *j = json_tokener_parse(json.c_str());
+    auto reflective = reflective_meta(get_Bar_meta());
+    for (const type_meta *meta: {(const type_meta *) &reflective, get_Bar_meta()}) {
+        void **arr = nullptr;
+        auto start = std::chrono::steady_clock::now();
+        REQUIRE(model_array_from_json(&arr, j, meta) == 0);
+        auto parse_time = std::chrono::steady_clock::now() - start;
+
+        size_t out_len = 0;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            char *out = model_to_json(arr[i], meta, MODEL_JSON_COMPACT, nullptr);
+            out_len += strlen(out);
+            free(out);
+        }
+        auto write_time = std::chrono::steady_clock::now() - start;
+
+        printf("%s: from_json %d objects %.1f ms, write %zu bytes %.1f ms\n",
+               meta == &reflective ? "reflective" : "generated", count,
+               std::chrono::duration<double, std::milli>(parse_time).count(), out_len,
+               std::chrono::duration<double, std::milli>(write_time).count());
+        model_free_array(&arr, meta);
+    }
+    json_object_put(j);
+}
@@ -0,0 +1,268 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2_includes.hpp"
+
+#include <mpsc_queue.h>
+#include <utils.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct item {
+    int producer;
+    int seq;
+    mpsc_node_t _next;
+};
+
+TEST_CASE("mpsc queue FIFO", "[util]") {
+    mpsc_queue_t q;
+    mpsc_queue_init(&q);
+
+    CHECK(mpsc_queue_pop(&q) == nullptr);
+
+    item items[10];
+    for (int i = 0; i < 10; i++) {
+        items[i].seq = i;
+        bool wakeup = mpsc_queue_push(&q, &items[i]._next);
+        // only first push needs to wake up the consumer
+        CHECK(wakeup == (i == 0));
+    }
+
+    mpsc_queue_rearm(&q);
+    for (int i = 0; i < 10; i++) {
+        mpsc_node_t *n = mpsc_queue_pop(&q);
+        REQUIRE(n != nullptr);
+        CHECK(container_of(n, item, _next)->seq == i);
+    }
+    CHECK(mpsc_queue_pop(&q) == nullptr);
+
+    // drained and rearmed: next push must signal again
+    CHECK(mpsc_queue_push(&q, &items[0]._next));
+    CHECK_FALSE(mpsc_queue_push(&q, &items[1]._next));
+    mpsc_queue_rearm(&q);
+    CHECK(mpsc_queue_pop(&q) == &items[0]._next);
+    CHECK(mpsc_queue_pop(&q) == &items[1]._next);
+    CHECK(mpsc_queue_pop(&q) == nullptr);
+}
+
+TEST_CASE("lf_pool", "[util]") {
+    lf_pool_t *pool = lf_pool_new(sizeof(item), 2);
+
+    auto *i1 = (item *) lf_pool_alloc(pool);
+    auto *i2 = (item *) lf_pool_alloc(pool);
+    auto *i3 = (item *) lf_pool_alloc(pool); // pool is exhausted, comes from the heap
+    REQUIRE(i1 != nullptr);
+    REQUIRE(i2 != nullptr);
+    REQUIRE(i3 != nullptr);
+    CHECK(i1 != i2);
+    CHECK(i2 != i3);
+
+    i1->seq = 42;
+    lf_pool_return(pool, i1);
+    lf_pool_return(pool, i3);
+
+    auto *i4 = (item *) lf_pool_alloc(pool);
+    CHECK(i4 == i1);
+    CHECK(i4->seq == 0);
+
+    lf_pool_return(pool, i2);
+    lf_pool_return(pool, i4);
+    lf_pool_destroy(pool);
+}
+
+// simulates app threads submitting work to the loop thread:
+// each producer allocates from the shared pool, pushes and wakes up consumer when asked to
+TEST_CASE("mpsc queue multi-producer", "[util]") {
+    const int producers = 4;
+    const int count = 100000;
+
+    mpsc_queue_t q;
+    mpsc_queue_init(&q);
+    lf_pool_t *pool = lf_pool_new(sizeof(item), 64);
+
+    std::mutex m;
+    std::condition_variable cv;
+    bool signaled = false;
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&, p] {
+            for (int i = 0; i < count; i++) {
+                auto it = (item *) lf_pool_alloc(pool);
+                it->producer = p;
+                it->seq = i;
+                if (mpsc_queue_push(&q, &it->_next)) {
+                    std::lock_guard<std::mutex> lock(m);
+                    signaled = true;
+                    cv.notify_one();
+                }
+            }
+        });
+    }
+
+    std::vector<int> last(producers, -1);
+    int received = 0;
+    bool ordered = true;
+    while (received < producers * count) {
+        {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [&] { return signaled; });
+            signaled = false;
+        }
+        mpsc_queue_rearm(&q);
+
+        mpsc_node_t *n;
+        while ((n = mpsc_queue_pop(&q)) != nullptr) {
+            auto it = container_of(n, item, _next);
+            ordered = ordered && (it->seq == last[it->producer] + 1);
+            last[it->producer] = it->seq;
+            lf_pool_return(pool, it);
+            received++;
+        }
+    }
+
+    for (auto &t: threads) t.join();
+
+    CHECK(ordered);
+    CHECK(received == producers * count);
+    CHECK(mpsc_queue_pop(&q) == nullptr);
+    lf_pool_destroy(pool);
+}
+
+// producer pushes while consumer is rearming and draining:
+// every item has to be seen either by the drain in progress or after a wakeup
+TEST_CASE("mpsc queue does not lose wakeups", "[util]") {
+    const int count = 20000;
+
+    mpsc_queue_t q;
+    mpsc_queue_init(&q);
+    std::vector<item> items(count);
+
+    std::mutex m;
+    std::condition_variable cv;
+    bool signaled = false;
+    std::atomic<int> received{0};
+
+    std::thread producer([&] {
+        for (int i = 0; i < count; i++) {
+            items[i].seq = i;
+            if (mpsc_queue_push(&q, &items[i]._next)) {
+                std::lock_guard<std::mutex> lock(m);
+                signaled = true;
+                cv.notify_one();
+            }
+            // let consumer catch up so that the queue goes empty between pushes
+            while (received.load() < i) std::this_thread::yield();
+        }
+    });
+
+    bool stalled = false;
+    while (received.load() < count && !stalled) {
+        {
+            std::unique_lock<std::mutex> lock(m);
+            stalled = !cv.wait_for(lock, std::chrono::seconds(5), [&] { return signaled; });
+            signaled = false;
+        }
+        mpsc_queue_rearm(&q);
+        while (mpsc_queue_pop(&q) != nullptr) {
+            received++;
+        }
+    }
+    producer.join();
+
+    CHECK_FALSE(stalled);
+    CHECK(received.load() == count);
+}
+
+template<typename Submit, typename Drain>
+static double submit_throughput(int producers, int count, Submit submit, Drain drain) {
+    std::atomic<bool> done{false};
+    std::thread consumer([&] {
+        while (!done.load()) {
+            drain();
+            std::this_thread::yield();
+        }
+        drain();
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&, p] {
+            for (int i = 0; i < count; i++) submit(p, i);
+        });
+    }
+    for (auto &t: threads) t.join();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    done = true;
+    consumer.join();
+
+    double secs = std::chrono::duration<double>(elapsed).count();
+    return producers * count / secs;
+}
+
+// cross-thread submit throughput: lock-free queue vs. mutex protected list (previous implementation)
+// run with `all_tests "[bench]"`
+TEST_CASE("mpsc queue submit throughput", "[.][bench]") {
+    const int count = 200000;
+
+    for (int producers: {1, 2, 4, 8}) {
+        mpsc_queue_t q;
+        mpsc_queue_init(&q);
+        lf_pool_t *pool = lf_pool_new(sizeof(item), 256);
+        std::atomic<long> wakeups{0};
+
+        double lf = submit_throughput(producers, count, [&](int p, int i) {
+            auto it = (item *) lf_pool_alloc(pool);
+            it->producer = p;
+            it->seq = i;
+            if (mpsc_queue_push(&q, &it->_next)) wakeups++;
+        }, [&] {
+            mpsc_queue_rearm(&q);
+            mpsc_node_t *n;
+            while ((n = mpsc_queue_pop(&q)) != nullptr) {
+                lf_pool_return(pool, container_of(n, item, _next));
+            }
+        });
+        lf_pool_destroy(pool);
+
+        std::mutex m;
+        std::deque<item *> list;
+        double locked = submit_throughput(producers, count, [&](int p, int i) {
+            auto it = (item *) calloc(1, sizeof(item));
+            it->producer = p;
+            it->seq = i;
+            std::lock_guard<std::mutex> lock(m);
+            list.push_front(it);
+        }, [&] {
+            std::deque<item *> work;
+            {
+                std::lock_guard<std::mutex> lock(m);
+                work.swap(list);
+            }
+            for (auto it: work) free(it);
+        });
+
+        printf("producers[%d]: mpsc %.0f ops/s (%ld wakeups), mutex %.0f ops/s\n",
+               producers, lf, wakeups.load(), locked);
+    }
+}
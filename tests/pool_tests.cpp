@@ -84,3 +84,30 @@ TEST_CASE("return after destroy", "[util]") {
     pool_return_obj(f1);
     pool_return_obj(f2);
 }
+
+TEST_CASE("available callback on exhausted pool", "[util]") {
+    pool_t *pool = pool_new(sizeof(foo), 2, clear_foo);
+    int count = 0;
+    pool_set_available_cb(pool, [](void *ctx) { (*(int *) ctx)++; }, &count);
+
+    auto f1 = pool_alloc_obj(pool);
+    pool_return_obj(f1);
+    CHECK(count == 0);
+
+    f1 = pool_alloc_obj(pool);
+    auto f2 = pool_alloc_obj(pool);
+    CHECK(pool_alloc_obj(pool) == nullptr);
+    CHECK_FALSE(pool_has_available(pool));
+
+    pool_return_obj(f1);
+    CHECK(count == 1);
+    // pool was not exhausted on this return
+    pool_return_obj(f2);
+    CHECK(count == 1);
+
+    f1 = pool_alloc_obj(pool);
+    pool_return_obj(f1);
+    CHECK(count == 1);
+
+    pool_destroy(pool);
+}
@@ -0,0 +1,135 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2_includes.hpp"
+#include "http_fixture.hpp"
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+
+#include "zt_internal.h"
+
+TEST_CASE("shard gets services and forwards controller requests", "[ztx]") {
+    uv_loop_t *loop = uv_loop_new();
+    uv_loop_t *shard_loop = uv_loop_new();
+
+    http_fixture srv(loop, [](const std::string &path) -> std::string {
+        if (path.find("/version") != std::string::npos) {
+            return R"({"data": {"version": "v1.0.0", "revision": "abc", "buildDate": "now",
+                "apiVersions": {"edge": {"v1": {"path": "/edge/client/v1"}}}}, "meta": {}})";
+        }
+        return R"({"meta": {"pagination": {"limit": 25, "offset": 0, "totalCount": 1}},
+            "data": [{"id": "svc-id-1", "name": "service-1", "permissions": ["Dial"], "encryptionRequired": true}]})";
+    });
+
+    auto url = srv.url();
+    ziti_config cfg{};
+    cfg.controller_url = (char *) url.c_str();
+    ziti_context ztx;
+    REQUIRE(ziti_context_init(&ztx, &cfg) == ZITI_OK);
+    ziti_options opts{};
+    opts.disabled = true;
+    ziti_context_set_options(ztx, &opts);
+    REQUIRE(ziti_context_run(ztx, loop) == ZITI_OK);
+
+    // authenticated controller, without going through the enrollment/login flow
+    REQUIRE(ziti_ctrl_init(loop, &ztx->ctrl, &ztx->config.controllers, nullptr) == ZITI_OK);
+    bool ready = false;
+    ziti_ctrl_get_version(&ztx->ctrl, [](const ziti_version *v, const ziti_error *e, void *ctx) {
+        *(bool *) ctx = true;
+    }, &ready);
+    while (!ready) {
+        uv_run(loop, UV_RUN_ONCE);
+    }
+    ziti_ctrl_set_token(&ztx->ctrl, "test-token");
+
+    // service known to the primary before the shard is added
+    auto svc = (ziti_service *) calloc(1, sizeof(ziti_service));
+    svc->id = strdup("svc-id-0");
+    svc->name = strdup("service-0");
+    ztx_set_service(ztx, svc);
+
+    ztx->tlsCtx = default_tls_context(nullptr, 0);
+    ztx->tls_gen++;
+
+    ziti_context shard;
+    REQUIRE(ziti_context_add_shard(ztx, shard_loop, &shard) == ZITI_OK);
+
+    struct result_t {
+        tls_context *primary_tls;
+        tls_context *shard_tls = nullptr;
+        bool has_copy = false;
+        std::thread::id cb_thread;
+        std::string service_id;
+        int err = -1;
+        std::atomic<bool> done{false};
+    } result;
+    result.primary_tls = ztx->tlsCtx;
+
+    // queued after shard state and services
+    ziti_queue_work(shard, [](ziti_context s, void *ctx) {
+        auto r = (result_t *) ctx;
+        r->shard_tls = s->tlsCtx;
+        r->has_copy = model_map_get(&s->services, "service-0") != nullptr;
+        ztx_get_service(s, "service-1", [](ziti_service *svc, const ziti_error *e, void *ctx) {
+            auto r = (result_t *) ctx;
+            r->cb_thread = std::this_thread::get_id();
+            r->err = e ? (int) e->err : ZITI_OK;
+            if (svc) {
+                r->service_id = svc->id;
+                free_ziti_service_ptr(svc);
+            }
+            r->done = true;
+        }, r);
+    }, &result);
+
+    std::thread shard_thread([shard_loop] { uv_run(shard_loop, UV_RUN_DEFAULT); });
+
+    uv_timer_t timeout;
+    uv_timer_init(loop, &timeout);
+    timeout.data = &result;
+    uv_timer_start(&timeout, [](uv_timer_t *t) { ((result_t *) t->data)->done = true; }, 5000, 0);
+    while (!result.done) {
+        uv_run(loop, UV_RUN_ONCE);
+    }
+
+    CHECK(result.has_copy);
+    // shard has its own TLS context
+    CHECK(result.shard_tls != nullptr);
+    CHECK(result.shard_tls != result.primary_tls);
+
+    CHECK(result.err == ZITI_OK);
+    CHECK(result.service_id == "svc-id-1");
+    // callback is delivered on the shard loop
+    CHECK(result.cb_thread == shard_thread.get_id());
+
+    int service_reqs = 0;
+    for (auto &r: srv.requests) {
+        if (r.find("/services") != std::string::npos) service_reqs++;
+    }
+    CHECK(service_reqs == 1);
+
+    ziti_shutdown(ztx);
+    srv.close();
+    uv_close((uv_handle_t *) &timeout, nullptr);
+    uv_run(loop, UV_RUN_DEFAULT);
+    shard_thread.join();
+
+    uv_loop_close(shard_loop);
+    free(shard_loop);
+    uv_loop_close(loop);
+    free(loop);
+}
@@ -0,0 +1,118 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2_includes.hpp"
+
+#include <spsc_ring.h>
+
+#include <cstring>
+#include <thread>
+
+TEST_CASE("spsc ring wraparound", "[util]") {
+    spsc_ring_t r;
+    REQUIRE(spsc_ring_init(&r, 10) == 0);
+    CHECK(r.cap == 16);
+
+    uint8_t data[16];
+    for (int i = 0; i < 16; i++) data[i] = (uint8_t) i;
+
+    CHECK(spsc_ring_write(&r, data, 12) == 12);
+    CHECK(spsc_ring_write(&r, data, 12) == 4); // full
+    CHECK(spsc_ring_size(&r) == 16);
+
+    uint8_t out[16];
+    CHECK(spsc_ring_read(&r, out, 10) == 10);
+    CHECK(memcmp(out, data, 10) == 0);
+
+    // write across the end of the buffer
+    CHECK(spsc_ring_write(&r, data, 10) == 10);
+    CHECK(spsc_ring_size(&r) == 16);
+
+    CHECK(spsc_ring_read(&r, out, sizeof(out)) == 16);
+    CHECK(memcmp(out, data + 10, 2) == 0);
+    CHECK(memcmp(out + 2, data, 4) == 0);
+    CHECK(memcmp(out + 6, data, 10) == 0);
+    CHECK(spsc_ring_size(&r) == 0);
+
+    spsc_ring_free(&r);
+}
+
+TEST_CASE("spsc ring peek/consume", "[util]") {
+    spsc_ring_t r;
+    REQUIRE(spsc_ring_init(&r, 8) == 0);
+
+    const uint8_t *p;
+    CHECK(spsc_ring_peek(&r, &p) == 0);
+
+    spsc_ring_write(&r, "abcdef", 6);
+    spsc_ring_consume(&r, 4);
+    spsc_ring_write(&r, "ghijk", 5);
+
+    // readable data wraps: peek only returns contiguous region
+    size_t n = spsc_ring_peek(&r, &p);
+    CHECK(n == 4);
+    CHECK(memcmp(p, "efgh", 4) == 0);
+    spsc_ring_consume(&r, n);
+
+    n = spsc_ring_peek(&r, &p);
+    CHECK(n == 3);
+    CHECK(memcmp(p, "ijk", 3) == 0);
+    spsc_ring_consume(&r, n);
+    CHECK(spsc_ring_size(&r) == 0);
+
+    spsc_ring_free(&r);
+}
+
+TEST_CASE("spsc ring producer/consumer", "[util]") {
+    spsc_ring_t r;
+    REQUIRE(spsc_ring_init(&r, 1024) == 0);
+
+    const size_t total = 4 * 1024 * 1024;
+    std::thread producer([&] {
+        uint8_t chunk[333];
+        size_t sent = 0;
+        while (sent < total) {
+            size_t len = std::min(sizeof(chunk), total - sent);
+            for (size_t i = 0; i < len; i++) chunk[i] = (uint8_t) (sent + i);
+
+            size_t off = 0;
+            while (off < len) {
+                size_t n = spsc_ring_write(&r, chunk + off, len - off);
+                if (n == 0) std::this_thread::yield();
+                off += n;
+            }
+            sent += len;
+        }
+    });
+
+    size_t received = 0;
+    bool valid = true;
+    uint8_t buf[500];
+    while (received < total) {
+        size_t n = spsc_ring_read(&r, buf, sizeof(buf));
+        if (n == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        for (size_t i = 0; i < n; i++) {
+            valid = valid && buf[i] == (uint8_t) (received + i);
+        }
+        received += n;
+    }
+    producer.join();
+
+    CHECK(valid);
+    CHECK(received == total);
+    spsc_ring_free(&r);
+}
@@ -0,0 +1,203 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ZITI_SDK_TLS_FIXTURE_HPP
+#define ZITI_SDK_TLS_FIXTURE_HPP
+
+#include "catch2_includes.hpp"
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include <uv.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// minimal TLS server with self-signed certificate for 127.0.0.1:
+// records plain text sent by clients, never sends any application data back
+struct tls_fixture {
+    struct conn {
+        uv_tcp_t tcp;
+        tls_fixture *srv;
+        SSL *ssl;
+        BIO *net_in;  // received from client, read by SSL
+        BIO *net_out; // written by SSL, sent to client
+    };
+
+    uv_loop_t *loop;
+    uv_tcp_t server{};
+    int port = 0;
+    std::string ca_pem; // server certificate, clients trust it as CA
+    std::string received;
+    std::vector<conn *> conns;
+
+    EVP_PKEY *key = nullptr;
+    X509 *cert = nullptr;
+    SSL_CTX *ctx = nullptr;
+
+    explicit tls_fixture(uv_loop_t *l) : loop(l) {
+        key = new_key();
+        cert = self_signed(key);
+        REQUIRE(cert != nullptr);
+
+        ctx = SSL_CTX_new(TLS_server_method());
+        REQUIRE(SSL_CTX_use_certificate(ctx, cert) == 1);
+        REQUIRE(SSL_CTX_use_PrivateKey(ctx, key) == 1);
+
+        BIO *pem = BIO_new(BIO_s_mem());
+        PEM_write_bio_X509(pem, cert);
+        char *p;
+        long len = BIO_get_mem_data(pem, &p);
+        ca_pem.assign(p, len);
+        BIO_free(pem);
+
+        sockaddr_in addr{};
+        uv_ip4_addr("127.0.0.1", 0, &addr);
+        uv_tcp_init(loop, &server);
+        server.data = this;
+        REQUIRE(uv_tcp_bind(&server, (const sockaddr *) &addr, 0) == 0);
+        REQUIRE(uv_listen((uv_stream_t *) &server, 16, on_connect) == 0);
+
+        sockaddr_storage name{};
+        int namelen = sizeof(name);
+        uv_tcp_getsockname(&server, (sockaddr *) &name, &namelen);
+        port = ntohs(((sockaddr_in *) &name)->sin_port);
+    }
+
+    ~tls_fixture() {
+        SSL_CTX_free(ctx);
+        X509_free(cert);
+        EVP_PKEY_free(key);
+    }
+
+    static EVP_PKEY *new_key() {
+        EVP_PKEY *pkey = nullptr;
+        EVP_PKEY_CTX *kctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+        EVP_PKEY_keygen_init(kctx);
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(kctx, NID_X9_62_prime256v1);
+        EVP_PKEY_keygen(kctx, &pkey);
+        EVP_PKEY_CTX_free(kctx);
+        return pkey;
+    }
+
+    static bool add_ext(X509 *x, int nid, const char *value) {
+        X509V3_CTX v3;
+        X509V3_set_ctx_nodb(&v3);
+        X509V3_set_ctx(&v3, x, x, nullptr, nullptr, 0);
+        X509_EXTENSION *ext = X509V3_EXT_conf_nid(nullptr, &v3, nid, value);
+        if (ext == nullptr) return false;
+        X509_add_ext(x, ext, -1);
+        X509_EXTENSION_free(ext);
+        return true;
+    }
+
+    static X509 *self_signed(EVP_PKEY *pkey) {
+        X509 *x = X509_new();
+        X509_set_version(x, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(x), 1);
+        X509_gmtime_adj(X509_getm_notBefore(x), -60);
+        X509_gmtime_adj(X509_getm_notAfter(x), 3600);
+        X509_set_pubkey(x, pkey);
+
+        X509_NAME *name = X509_get_subject_name(x);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *) "127.0.0.1", -1, -1, 0);
+        X509_set_issuer_name(x, name);
+
+        if (!add_ext(x, NID_basic_constraints, "critical,CA:TRUE") ||
+            !add_ext(x, NID_subject_key_identifier, "hash") ||
+            !add_ext(x, NID_subject_alt_name, "DNS:localhost,DNS:127.0.0.1,IP:127.0.0.1") ||
+            X509_sign(x, pkey, EVP_sha256()) == 0) {
+            X509_free(x);
+            return nullptr;
+        }
+        return x;
+    }
+
+    void close() {
+        for (auto c: conns) {
+            uv_close((uv_handle_t *) &c->tcp, free_conn);
+        }
+        conns.clear();
+        uv_close((uv_handle_t *) &server, nullptr);
+    }
+
+    static void free_conn(uv_handle_t *h) {
+        auto c = (conn *) h->data;
+        SSL_free(c->ssl); // releases BIOs
+        delete c;
+    }
+
+    static void on_connect(uv_stream_t *s, int status) {
+        auto srv = (tls_fixture *) s->data;
+        if (status != 0) return;
+
+        auto c = new conn;
+        c->srv = srv;
+        c->tcp.data = c;
+        c->ssl = SSL_new(srv->ctx);
+        c->net_in = BIO_new(BIO_s_mem());
+        c->net_out = BIO_new(BIO_s_mem());
+        SSL_set_bio(c->ssl, c->net_in, c->net_out);
+        SSL_set_accept_state(c->ssl);
+
+        uv_tcp_init(srv->loop, &c->tcp);
+        uv_accept(s, (uv_stream_t *) &c->tcp);
+        srv->conns.push_back(c);
+        uv_read_start((uv_stream_t *) &c->tcp,
+                      [](uv_handle_t *, size_t size, uv_buf_t *b) { *b = uv_buf_init((char *) malloc(size), size); },
+                      on_read);
+    }
+
+    static void on_read(uv_stream_t *s, ssize_t len, const uv_buf_t *b) {
+        auto c = (conn *) s->data;
+        if (len > 0) {
+            BIO_write(c->net_in, b->base, (int) len);
+        }
+        free(b->base);
+        if (len < 0) {
+            auto &conns = c->srv->conns;
+            conns.erase(std::remove(conns.begin(), conns.end(), c), conns.end());
+            uv_close((uv_handle_t *) s, free_conn);
+            return;
+        }
+
+        // drives the handshake until it is done
+        char buf[16 * 1024];
+        int n;
+        while ((n = SSL_read(c->ssl, buf, sizeof(buf))) > 0) {
+            c->srv->received.append(buf, n);
+        }
+        c->srv->send_pending(c);
+    }
+
+    void send_pending(conn *c) {
+        size_t pending = BIO_ctrl_pending(c->net_out);
+        if (pending == 0) return;
+
+        auto out = new std::string(pending, '\0');
+        BIO_read(c->net_out, &(*out)[0], (int) pending);
+        auto wr = new uv_write_t;
+        wr->data = out;
+        uv_buf_t buf = uv_buf_init(&(*out)[0], out->size());
+        uv_write(wr, (uv_stream_t *) &c->tcp, &buf, 1, [](uv_write_t *w, int) {
+            delete (std::string *) w->data;
+            delete w;
+        });
+    }
+};
+
+#endif //ZITI_SDK_TLS_FIXTURE_HPP
@@ -17,6 +17,11 @@
 #include "utils.h"
 #include "internal_model.h"
 #include "zt_internal.h"
+#include "util/future.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
 
 #if _WIN32
 #include <io.h>
@@ -92,4 +97,154 @@ TEST_CASE("check hostname/domainname") {
 
     printf("hostname = %s\n", info->hostname);
     printf("domain = %s\n", info->domain);
-}
\ No newline at end of file
+}
+TEST_CASE("future complete across threads", "[util]") {
+    for (int i = 0; i < 1000; i++) {
+        future_t *f = new_future();
+        std::thread t([f, i] { complete_future(f, (void *) (uintptr_t) i); });
+
+        void *result = nullptr;
+        CHECK(await_future(f, &result) == 0);
+        CHECK((uintptr_t) result == (uintptr_t) i);
+        // second completion is rejected
+        CHECK(fail_future(f, UV_ECANCELED) == UV_EINVAL);
+        t.join();
+        destroy_future(f);
+    }
+
+    future_t *f = new_future();
+    std::thread t([f] { fail_future(f, UV_ECONNREFUSED); });
+    void *result = nullptr;
+    CHECK(await_future(f, &result) == UV_ECONNREFUSED);
+    CHECK(result == nullptr);
+    t.join();
+    destroy_future(f);
+}
+
+TEST_CASE("future with callback", "[util]") {
+    struct res {
+        void *result;
+        int err;
+        int calls;
+    } r = {};
+
+    auto cb = [](void *result, int err, void *data) {
+        auto r = (res *) data;
+        r->result = result;
+        r->err = err;
+        r->calls++;
+    };
+
+    future_t *f = new_future_cb(cb, &r);
+    CHECK(complete_future(f, &r) == 0);
+    CHECK(r.calls == 1);
+    CHECK(r.result == &r);
+    CHECK(r.err == 0);
+
+    f = new_future_cb(cb, &r);
+    CHECK(fail_future(f, UV_EINVAL) == 0);
+    CHECK(r.calls == 2);
+    CHECK(r.result == nullptr);
+    CHECK(r.err == UV_EINVAL);
+}
+
+static std::atomic<int> log_count;
+
+static void count_log(int level, const char *loc, const char *msg, size_t msglen) {
+    log_count++;
+}
+
+static void log_debug() {
+    ZITI_LOG(DEBUG, "debug message");
+}
+
+TEST_CASE("log level changes reach cached call sites", "[util]") {
+    ziti_log_init(uv_default_loop(), WARN, count_log);
+
+    log_count = 0;
+    log_debug();
+    CHECK(log_count == 0);
+
+    ziti_log_set_level(DEBUG, nullptr);
+    log_count = 0;
+    log_debug();
+    log_debug();
+    CHECK(log_count == 2);
+
+    // per-file level overrides root level
+    ziti_log_set_level(WARN, "util_tests.cpp");
+    log_count = 0;
+    log_debug();
+    CHECK(log_count == 0);
+
+    ziti_log_set_level(ZITI_LOG_DEFAULT_LEVEL, "util_tests.cpp");
+    log_count = 0;
+    log_debug();
+    CHECK(log_count == 1);
+
+    ziti_log_set_level(ERROR, nullptr);
+    ziti_log_set_logger(nullptr);
+}
+
+TEST_CASE("async log writer", "[util]") {
+    ziti_log_init(uv_default_loop(), INFO, count_log);
+    log_count = 0;
+
+    REQUIRE(ziti_log_async_start(4096) == ZITI_OK);
+    CHECK(ziti_log_async_start(16) == ZITI_INVALID_STATE);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([] {
+            for (int i = 0; i < 500; i++) {
+                ZITI_LOG(INFO, "message %d", i);
+            }
+        });
+    }
+    for (auto &t: threads) {
+        t.join();
+    }
+
+    CHECK(ziti_log_async_dropped() == 0);
+    ziti_log_async_stop();
+    CHECK(log_count == 2000);
+
+    // back to synchronous
+    ZITI_LOG(INFO, "sync message");
+    CHECK(log_count == 2001);
+
+    ziti_log_set_level(ERROR, nullptr);
+    ziti_log_set_logger(nullptr);
+}
+
+TEST_CASE("async log writer stops while threads are logging", "[util]") {
+    ziti_log_init(uv_default_loop(), INFO, count_log);
+    log_count = 0;
+
+    REQUIRE(ziti_log_async_start(1 << 16) == ZITI_OK);
+
+    std::atomic<int> started{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&started] {
+            started++;
+            for (int i = 0; i < 5000; i++) {
+                ZITI_LOG(INFO, "message %d", i);
+            }
+        });
+    }
+    while (started < 4) {
+        std::this_thread::yield();
+    }
+
+    // records claimed by producers are written before the ring is released,
+    // later messages are logged synchronously
+    ziti_log_async_stop();
+    for (auto &t: threads) {
+        t.join();
+    }
+    CHECK(log_count == 20000);
+
+    ziti_log_set_level(ERROR, nullptr);
+    ziti_log_set_logger(nullptr);
+}
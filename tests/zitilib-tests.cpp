@@ -20,10 +20,20 @@
 #include "catch2/matchers/catch_matchers.hpp"
 #include "catch2/matchers/catch_matchers_string.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
 #if _WIN32
 #else
 #include <unistd.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 #endif
 
 class testRunListener : public Catch::EventListenerBase {
@@ -54,6 +64,238 @@ ziti_context testRunListener::_ztx;
 CATCH_REGISTER_LISTENER(testRunListener)
 using namespace Catch::Matchers;
 
+static bool wait_fd(ziti_socket_t fd, short events, int timeout_ms) {
+#if _WIN32
+    WSAPOLLFD pfd = { .fd = fd, .events = events, };
+    return WSAPoll(&pfd, 1, timeout_ms) > 0;
+#else
+    struct pollfd pfd = { .fd = fd, .events = events, };
+    return poll(&pfd, 1, timeout_ms) > 0;
+#endif
+}
+
+static std::vector<ziti_completion> wait_completions(size_t count) {
+    std::vector<ziti_completion> done;
+    while (done.size() < count && wait_fd(Ziti_completion_fd(), POLLIN, 5000)) {
+        ziti_completion c[8];
+        int n = Ziti_poll_completions(c, 8);
+        done.insert(done.end(), c, c + n);
+    }
+    return done;
+}
+
+TEST_CASE("resolve async", "[zitilib]") {
+    int numeric, unknown;
+
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE(Ziti_resolve_async("127.0.0.1", "80", nullptr, &numeric) == 0);
+    REQUIRE(Ziti_resolve_async("no-such-host.ziti", "80", nullptr, &unknown) == 0);
+    // submitting never waits for services to load
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+
+    auto done = wait_completions(2);
+    REQUIRE(done.size() == 2);
+    for (auto &c: done) {
+        if (c.ctx == &numeric) {
+            CHECK(c.status == 0);
+            REQUIRE(c.addrinfo != nullptr);
+            auto addr = (struct sockaddr_in *) c.addrinfo->ai_addr;
+            CHECK(addr->sin_addr.s_addr == htonl(INADDR_LOOPBACK));
+            CHECK(addr->sin_port == htons(80));
+            Ziti_freeaddrinfo(c.addrinfo);
+        } else {
+            CHECK(c.ctx == &unknown);
+            CHECK(c.status == EAI_NONAME);
+            CHECK(c.addrinfo == nullptr);
+        }
+    }
+}
+
+// not in the public header, zitify resolves through it
+extern "C" int Ziti_resolve(const char *host, const char *port, const struct addrinfo *hints,
+                            struct addrinfo **addrlist);
+
+TEST_CASE("resolve numeric address after shutdown", "[zitilib]") {
+    Ziti_lib_shutdown();
+
+    struct addrinfo *res = nullptr;
+    REQUIRE(Ziti_resolve("127.0.0.1", "80", nullptr, &res) == 0);
+    REQUIRE(res != nullptr);
+    auto addr = (struct sockaddr_in *) res->ai_addr;
+    CHECK(addr->sin_addr.s_addr == htonl(INADDR_LOOPBACK));
+    CHECK(addr->sin_port == htons(80));
+    Ziti_freeaddrinfo(res);
+
+    // restore for the rest of the run
+    Ziti_lib_init();
+}
+
+static void close_socket(ziti_socket_t s) {
+#if _WIN32
+    closesocket(s);
+#else
+    close(s);
+#endif
+}
+
+TEST_CASE("connect async to unknown address", "[zitilib]") {
+    int ctx;
+    ziti_socket_t sock = Ziti_socket(SOCK_STREAM);
+    REQUIRE(sock != (ziti_socket_t) -1);
+
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE(Ziti_connect_addr_async(sock, "no-such-host.ziti", 80, &ctx) == 0);
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+
+    auto done = wait_completions(1);
+    REQUIRE(done.size() == 1);
+    CHECK(done[0].ctx == &ctx);
+    CHECK(done[0].fd == sock);
+    CHECK(done[0].status == ECONNREFUSED);
+
+#if !_WIN32
+    // socket is hung up
+    char b;
+    REQUIRE(wait_fd(sock, POLLIN, 5000));
+    CHECK(read(sock, &b, 1) <= 0);
+#endif
+    close_socket(sock);
+}
+
+TEST_CASE("connect async", "[zitilib]") {
+    if (testRunListener::ztx() == nullptr) {
+        SKIP("ZITI_TEST_IDENTITY is not set");
+    }
+
+    int ctx;
+    ziti_socket_t sock = Ziti_socket(SOCK_STREAM);
+    REQUIRE(Ziti_connect_addr_async(sock, "httpbin.ziti", 80, &ctx) == 0);
+
+    auto done = wait_completions(1);
+    REQUIRE(done.size() == 1);
+    CHECK(done[0].ctx == &ctx);
+    REQUIRE(done[0].status == 0);
+    CHECK(wait_fd(sock, POLLOUT, 5000));
+
+    auto req = "GET /json HTTP/1.1\r\n"
+               "Host: httpbin.org\r\n"
+               "Connection: close\r\n"
+               "\r\n";
+    CHECK(send(sock, req, (int) strlen(req), 0) == (int) strlen(req));
+
+    char resp[1024];
+    REQUIRE(wait_fd(sock, POLLIN, 5000));
+    int r = (int) recv(sock, resp, sizeof(resp) - 1, 0);
+    REQUIRE(r > 0);
+    resp[r] = '\0';
+    CHECK_THAT(resp, StartsWith("HTTP/1.1 200 OK"));
+    close_socket(sock);
+}
+
+#if !_WIN32
+TEST_CASE("direct socket polls writable when out ring drains", "[zitilib]") {
+    if (testRunListener::ztx() == nullptr) {
+        SKIP("ZITI_TEST_IDENTITY is not set");
+    }
+
+    const size_t total = 4 * 1024 * 1024;
+    ziti_socket_t sock = Ziti_socket(SOCK_STREAM | ZITI_SOCK_DIRECT);
+    REQUIRE(Ziti_connect_addr(sock, "httpbin.ziti", 80) == 0);
+
+    char hdr[256];
+    snprintf(hdr, sizeof(hdr), "POST /anything HTTP/1.1\r\n"
+                               "Host: httpbin.org\r\n"
+                               "Content-Length: %zu\r\n"
+                               "Connection: close\r\n"
+                               "\r\n", total);
+    REQUIRE(Ziti_write(sock, hdr, strlen(hdr)) == (ssize_t) strlen(hdr));
+    REQUIRE(fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK) == 0);
+
+    std::vector<char> chunk(16 * 1024, 'x');
+    size_t sent = 0;
+    int would_block = 0;
+    int spurious = 0;
+    bool woke = false;
+    while (sent < total) {
+        ssize_t n = Ziti_write(sock, chunk.data(), std::min(chunk.size(), total - sent));
+        if (n > 0) {
+            sent += n;
+            woke = false;
+            continue;
+        }
+        REQUIRE(errno == EWOULDBLOCK);
+        if (woke) spurious++;
+        would_block++;
+        // out ring is full: socket must stay quiet until loop makes room
+        REQUIRE(wait_fd(sock, POLLOUT, 5000));
+        woke = true;
+    }
+
+    CHECK(would_block > 0);
+    CHECK(spurious == 0);
+    close_socket(sock);
+}
+#endif
+
+TEST_CASE("accept async on non-listening socket", "[zitilib]") {
+    ziti_socket_t sock = Ziti_socket(SOCK_STREAM);
+    char caller[128];
+    CHECK(Ziti_accept_async(sock, caller, sizeof(caller), nullptr) == (ziti_socket_t) -1);
+    CHECK(Ziti_last_error() == EINVAL);
+    close_socket(sock);
+}
+
+// needs a service that test identity can both bind and dial
+TEST_CASE("accept async", "[zitilib]") {
+    const char *service = getenv("ZITI_TEST_BIND_SERVICE");
+    if (testRunListener::ztx() == nullptr || service == nullptr) {
+        SKIP("ZITI_TEST_IDENTITY or ZITI_TEST_BIND_SERVICE is not set");
+    }
+    ziti_context ztx = testRunListener::ztx();
+
+    ziti_socket_t srv = Ziti_socket(SOCK_STREAM);
+    REQUIRE(Ziti_bind(srv, ztx, service, nullptr) == 0);
+    REQUIRE(Ziti_listen(srv, 10) == 0);
+
+    char caller[128] = "";
+    auto start = std::chrono::steady_clock::now();
+    CHECK(Ziti_accept_async(srv, caller, sizeof(caller), nullptr) == (ziti_socket_t) -1);
+    CHECK(Ziti_last_error() == EWOULDBLOCK);
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+
+    int clt_ctx, srv_ctx;
+    ziti_socket_t clt = Ziti_socket(SOCK_STREAM);
+    REQUIRE(Ziti_connect_async(clt, ztx, service, nullptr, &clt_ctx) == 0);
+
+    REQUIRE(wait_fd(srv, POLLIN, 10000));
+    ziti_socket_t accepted = Ziti_accept_async(srv, caller, sizeof(caller), &srv_ctx);
+    REQUIRE(accepted != (ziti_socket_t) -1);
+    CHECK(strlen(caller) > 0);
+
+    auto done = wait_completions(2);
+    REQUIRE(done.size() == 2);
+    for (auto &c: done) {
+        CHECK(c.status == 0);
+        if (c.ctx == &srv_ctx) {
+            CHECK(c.fd == accepted);
+        } else {
+            CHECK(c.ctx == &clt_ctx);
+            CHECK(c.fd == clt);
+        }
+    }
+
+    REQUIRE(wait_fd(clt, POLLOUT, 5000));
+    CHECK(send(clt, "ping", 4, 0) == 4);
+    char buf[8] = {};
+    REQUIRE(wait_fd(accepted, POLLIN, 5000));
+    CHECK(recv(accepted, buf, sizeof(buf), 0) == 4);
+    CHECK_THAT(buf, Equals("ping"));
+
+    close_socket(clt);
+    close_socket(accepted);
+    close_socket(srv);
+}
+
 TEST_CASE("httpbin.ziti", "[zitilib]") {
     ziti_socket_t sock = Ziti_socket(SOCK_STREAM);
     REQUIRE(Ziti_connect_addr(sock, "httpbin.ziti", 80) == 0);
@@ -0,0 +1,122 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2_includes.hpp"
+
+#include <ztrace.h>
+#include <ziti/errors.h>
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <thread>
+#include <vector>
+
+TEST_CASE("trace dump keeps latest records per thread", "[util]") {
+    const char *path = "ztrace_test.bin";
+
+    // not recorded
+    std::thread([] { ZTRACE(CH_READ, 1, 0, 0); }).join();
+
+    REQUIRE(ziti_trace_start(8) == ZITI_OK);
+    std::thread([] {
+        for (uint32_t i = 0; i < 20; i++) {
+            ZTRACE(CH_WRITE, 1, i, 0);
+        }
+    }).join();
+    std::thread([] {
+        for (uint32_t i = 0; i < 3; i++) {
+            ZTRACE(MSG_DISPATCH, 2, i, 0);
+        }
+    }).join();
+    ziti_trace_stop();
+
+    std::thread([] { ZTRACE(CH_READ, 3, 0, 0); }).join();
+
+    REQUIRE(ziti_trace_dump(path) == ZITI_OK);
+
+    FILE *f = fopen(path, "rb");
+    REQUIRE(f != nullptr);
+    ziti_trace_header hdr{};
+    REQUIRE(fread(&hdr, sizeof(hdr), 1, f) == 1);
+    CHECK(memcmp(hdr.magic, ZITI_TRACE_MAGIC, sizeof(hdr.magic)) == 0);
+    CHECK(hdr.record_size == sizeof(ziti_trace_record));
+
+    std::map<uint32_t, std::vector<ziti_trace_record>> by_id;
+    for (uint32_t t = 0; t < hdr.threads; t++) {
+        ziti_trace_thread th{};
+        REQUIRE(fread(&th, sizeof(th), 1, f) == 1);
+        for (uint32_t i = 0; i < th.count; i++) {
+            ziti_trace_record r{};
+            REQUIRE(fread(&r, sizeof(r), 1, f) == 1);
+            by_id[r.id].push_back(r);
+        }
+    }
+    fclose(f);
+    remove(path);
+
+    CHECK(by_id.count(3) == 0);
+
+    // ring wrapped: only last 8 writes, oldest first
+    auto &writes = by_id[1];
+    REQUIRE(writes.size() == 8);
+    for (uint32_t i = 0; i < 8; i++) {
+        CHECK(writes[i].event == ZITI_TRACE_CH_WRITE);
+        CHECK(writes[i].a == 12 + i);
+        if (i > 0) CHECK(writes[i].ts >= writes[i - 1].ts);
+    }
+
+    auto &dispatched = by_id[2];
+    REQUIRE(dispatched.size() == 3);
+    CHECK(dispatched[0].event == ZITI_TRACE_MSG_DISPATCH);
+    CHECK(dispatched[2].a == 2);
+}
+
+TEST_CASE("trace rings of exited threads are reused", "[util]") {
+    const char *path = "ztrace_test.bin";
+    const uint32_t threads = 2 * ZTRACE_EXITED_RINGS;
+
+    REQUIRE(ziti_trace_start(8) == ZITI_OK);
+    for (uint32_t t = 0; t < threads; t++) {
+        std::thread([t] { ZTRACE(CH_WRITE, 100 + t, 0, 0); }).join();
+    }
+    ziti_trace_stop();
+
+    REQUIRE(ziti_trace_dump(path) == ZITI_OK);
+
+    FILE *f = fopen(path, "rb");
+    REQUIRE(f != nullptr);
+    ziti_trace_header hdr{};
+    REQUIRE(fread(&hdr, sizeof(hdr), 1, f) == 1);
+    // this thread never traced, only rings kept for exited threads
+    CHECK(hdr.threads == ZTRACE_EXITED_RINGS);
+
+    std::map<uint32_t, int> ids;
+    for (uint32_t t = 0; t < hdr.threads; t++) {
+        ziti_trace_thread th{};
+        REQUIRE(fread(&th, sizeof(th), 1, f) == 1);
+        for (uint32_t i = 0; i < th.count; i++) {
+            ziti_trace_record r{};
+            REQUIRE(fread(&r, sizeof(r), 1, f) == 1);
+            ids[r.id]++;
+        }
+    }
+    fclose(f);
+    remove(path);
+
+    // latest exited threads are in the dump
+    for (uint32_t t = 0; t < threads; t++) {
+        CHECK(ids.count(100 + t) == (t >= threads - ZTRACE_EXITED_RINGS ? 1 : 0));
+    }
+}
@@ -0,0 +1,145 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2_includes.hpp"
+
+#include <map>
+
+#include "zt_internal.h"
+#include "message.h"
+
+// context with just enough state for ztx_prepare()
+static ziti_context new_test_ztx(uv_loop_t *loop) {
+    auto ztx = (ziti_context) calloc(1, sizeof(struct ziti_ctx));
+    ztx->loop = loop;
+    ztx->enabled = true;
+    uv_timer_init(loop, &ztx->deadline_timer);
+    uv_prepare_init(loop, &ztx->prepper);
+    ztx->prepper.data = ztx;
+    return ztx;
+}
+
+static void free_test_ztx(ziti_context ztx) {
+    uv_loop_t *loop = ztx->loop;
+    uv_close((uv_handle_t *) &ztx->deadline_timer, nullptr);
+    uv_close((uv_handle_t *) &ztx->prepper, nullptr);
+    uv_run(loop, UV_RUN_DEFAULT);
+    model_map_clear(&ztx->connections, nullptr);
+    free(ztx);
+}
+
+static std::map<uint32_t, int> dispose_calls;
+
+// releases connection on second call
+static int test_disposer(ziti_connection conn) {
+    if (++dispose_calls[conn->conn_id] < 2) {
+        return 0;
+    }
+    free(conn);
+    return 1;
+}
+
+static ziti_connection new_test_conn(ziti_context ztx, uint32_t id) {
+    auto conn = (ziti_connection) calloc(1, sizeof(struct ziti_conn));
+    conn->ziti_ctx = ztx;
+    conn->conn_id = id;
+    conn->disposer = test_disposer;
+    model_map_setl(&ztx->connections, (long) id, conn);
+    return conn;
+}
+
+TEST_CASE("prepare only disposes connections on reap list", "[ztx]") {
+    uv_loop_t *loop = uv_loop_new();
+    auto ztx = new_test_ztx(loop);
+    dispose_calls.clear();
+
+    auto open = new_test_conn(ztx, 1);
+    auto closed = new_test_conn(ztx, 2);
+
+    // what ziti_close() does
+    closed->close = true;
+    LIST_INSERT_HEAD(&ztx->reap_list, closed, _reap);
+
+    ztx_prepare(&ztx->prepper);
+    CHECK(dispose_calls[1] == 0);
+    CHECK(dispose_calls[2] == 1);
+    // not released by disposer yet, stays on the list
+    CHECK(LIST_FIRST(&ztx->reap_list) == closed);
+    CHECK(model_map_getl(&ztx->connections, 2) == closed);
+
+    ztx_prepare(&ztx->prepper);
+    CHECK(dispose_calls[1] == 0);
+    CHECK(dispose_calls[2] == 2);
+    CHECK(LIST_EMPTY(&ztx->reap_list));
+    CHECK(model_map_getl(&ztx->connections, 2) == nullptr);
+    CHECK(model_map_getl(&ztx->connections, 1) == open);
+
+    ztx_prepare(&ztx->prepper);
+    CHECK(dispose_calls[1] == 0);
+
+    free(open);
+    free_test_ztx(ztx);
+    uv_loop_close(loop);
+    free(loop);
+}
+
+static ziti_channel_t *new_test_channel(ziti_context ztx) {
+    auto ch = (ziti_channel_t *) calloc(1, sizeof(ziti_channel_t));
+    ch->ztx = ztx;
+    ch->loop = ztx->loop;
+    ch->incoming = new_buffer();
+    ch->in_msg_pool = pool_new(32 * 1024, 1, (void (*)(void *)) message_free);
+
+    // message header is buffered, body has not arrived yet
+    header_t h;
+    header_init(&h, 1);
+    h.body_len = 16;
+    uint8_t buf[HEADER_SIZE];
+    header_to_buffer(&h, buf);
+    buffer_append_copy(ch->incoming, buf, sizeof(buf));
+    return ch;
+}
+
+static void free_test_channel(ziti_channel_t *ch) {
+    pool_return_obj(ch->in_next);
+    pool_destroy(ch->in_msg_pool);
+    free_buffer(ch->incoming);
+    free(ch);
+}
+
+TEST_CASE("prepare only processes dirty channels", "[ztx]") {
+    uv_loop_t *loop = uv_loop_new();
+    auto ztx = new_test_ztx(loop);
+
+    auto idle = new_test_channel(ztx);
+    auto dirty = new_test_channel(ztx);
+
+    // what message pool available callback does
+    dirty->dirty = true;
+    LIST_INSERT_HEAD(&ztx->dirty_channels, dirty, _dirty);
+
+    ztx_prepare(&ztx->prepper);
+    CHECK(LIST_EMPTY(&ztx->dirty_channels));
+    CHECK_FALSE(dirty->dirty);
+    // inbound data was processed: message is started
+    CHECK(dirty->in_next != nullptr);
+    CHECK(idle->in_next == nullptr);
+    CHECK(buffer_available(idle->incoming) == HEADER_SIZE);
+
+    free_test_channel(idle);
+    free_test_channel(dirty);
+    free_test_ztx(ztx);
+    uv_loop_close(loop);
+    free(loop);
+}
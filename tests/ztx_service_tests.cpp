@@ -0,0 +1,180 @@
+// Copyright (c) 2024. NetFoundry Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2_includes.hpp"
+
+#include "zt_internal.h"
+#include "intercept_index.h"
+
+#include <cstring>
+#include <string>
+
+static ziti_service *service_from_json(const char *json) {
+    ziti_service *s = alloc_ziti_service();
+    REQUIRE(parse_ziti_service(s, json, strlen(json)) > 0);
+    return s;
+}
+
+static const char *lookup(ziti_context ztx, const char *host, int port) {
+    ziti_address addr;
+    REQUIRE(parse_ziti_address_str(&addr, host) == 0);
+    return ztx->intercepts ? intercept_index_lookup(ztx->intercepts, ziti_protocols.tcp, &addr, port, nullptr) : nullptr;
+}
+
+static void free_test_ztx(ziti_context ztx) {
+    while (model_map_size(&ztx->services) > 0) {
+        ztx_drop_service(ztx, (const char *) model_map_it_key(model_map_iterator(&ztx->services)));
+    }
+    intercept_index_free(ztx->intercepts);
+    model_map_clear(&ztx->service_hashes, free);
+    model_map_clear(&ztx->service_forced_updates, nullptr);
+    free(ztx);
+}
+
+TEST_CASE("service configs are parsed once and cached", "[ztx]") {
+    auto ztx = (ziti_context) calloc(1, sizeof(struct ziti_ctx));
+
+    ztx_set_service(ztx, service_from_json(R"({
+        "id": "svc1-id", "name": "svc1", "permissions": ["Dial"],
+        "config": {
+            "intercept.v1": {
+                "protocols": ["tcp"], "addresses": ["svc1.ziti"], "portRanges": [{"low": 80, "high": 80}],
+                "dialOptions": {"identity": "$dst_hostname"}
+            }
+        }
+    })"));
+
+    auto intercept = (const ziti_intercept_cfg_v1 *) ztx_service_config(ztx, "svc1", ZITI_INTERCEPT_CFG_V1);
+    REQUIRE(intercept != nullptr);
+    CHECK(ztx_service_config(ztx, "svc1", ZITI_INTERCEPT_CFG_V1) == intercept);
+    CHECK(model_list_size(&intercept->addresses) == 1);
+    CHECK(ztx_service_config(ztx, "svc1", ZITI_CLIENT_CFG_V1) == nullptr);
+    CHECK(ztx_service_config(ztx, "svc1", "host.v1") == nullptr);
+    CHECK(ztx_service_config(ztx, "no-such-service", ZITI_INTERCEPT_CFG_V1) == nullptr);
+    CHECK_THAT(lookup(ztx, "svc1.ziti", 80), Catch::Matchers::Equals("svc1"));
+
+    SECTION("changed service replaces cached config") {
+        ztx_set_service(ztx, service_from_json(R"({
+            "id": "svc1-id", "name": "svc1", "permissions": ["Dial"],
+            "config": {
+                "intercept.v1": {
+                    "protocols": ["tcp"], "addresses": ["svc1-new.ziti"], "portRanges": [{"low": 80, "high": 80}]
+                }
+            }
+        })"));
+        CHECK(lookup(ztx, "svc1.ziti", 80) == nullptr);
+        CHECK_THAT(lookup(ztx, "svc1-new.ziti", 80), Catch::Matchers::Equals("svc1"));
+    }
+
+    SECTION("service without configs drops cached ones") {
+        ztx_set_service(ztx, service_from_json(R"({
+            "id": "svc1-id", "name": "svc1", "permissions": ["Dial"], "config": {}
+        })"));
+        CHECK(ztx_service_config(ztx, "svc1", ZITI_INTERCEPT_CFG_V1) == nullptr);
+        CHECK(lookup(ztx, "svc1.ziti", 80) == nullptr);
+    }
+
+    SECTION("dropped service") {
+        ztx_drop_service(ztx, "svc1");
+        CHECK(ztx_service_config(ztx, "svc1", ZITI_INTERCEPT_CFG_V1) == nullptr);
+        CHECK(lookup(ztx, "svc1.ziti", 80) == nullptr);
+    }
+
+    free_test_ztx(ztx);
+}
+
+TEST_CASE("intercept config is derived from client config", "[ztx]") {
+    auto ztx = (ziti_context) calloc(1, sizeof(struct ziti_ctx));
+
+    ztx_set_service(ztx, service_from_json(R"({
+        "id": "svc2-id", "name": "svc2", "permissions": ["Dial"],
+        "config": {
+            "ziti-tunneler-client.v1": {"hostname": "svc2.ziti", "port": 8080}
+        }
+    })"));
+
+    CHECK(ztx_service_config(ztx, "svc2", ZITI_CLIENT_CFG_V1) != nullptr);
+    auto intercept = (const ziti_intercept_cfg_v1 *) ztx_service_config(ztx, "svc2", ZITI_INTERCEPT_CFG_V1);
+    REQUIRE(intercept != nullptr);
+    CHECK(model_list_size(&intercept->port_ranges) == 1);
+    CHECK_THAT(lookup(ztx, "svc2.ziti", 8080), Catch::Matchers::Equals("svc2"));
+    CHECK(lookup(ztx, "svc2.ziti", 80) == nullptr);
+
+    free_test_ztx(ztx);
+}
+
+static std::string service_json(const char *name, const char *configs, bool passing) {
+    return std::string(R"({"id": "svc3-id", "name": ")") + name + R"(", "permissions": ["Dial"],
+        "updatedAt": "2024-01-01T00:00:00.000Z",
+        "config": )" + configs + R"(,
+        "posturePolicies": {"policy1": {"policyId": "policy1", "isPassing": )" + (passing ? "true" : "false") + R"(,
+            "postureQueries": [{"id": "query1", "isPassing": true, "queryType": "OS", "timeout": 60,
+                "updatedAt": "2024-01-01T00:00:00.000Z"}]}}})";
+}
+
+TEST_CASE("unchanged services are detected before processing", "[ztx]") {
+    auto ztx = (ziti_context) calloc(1, sizeof(struct ziti_ctx));
+    const char *configs = R"({"intercept.v1": {"protocols": ["tcp"], "addresses": ["svc3.ziti"],
+        "portRanges": [{"low": 80, "high": 80}]}, "ziti-tunneler-client.v1": {"hostname": "svc3.ziti", "port": 80}})";
+
+    auto unchanged = [&](const std::string &json) {
+        auto s = service_from_json(json.c_str());
+        bool result = ztx_service_unchanged(ztx, s);
+        free_ziti_service_ptr(s);
+        return result;
+    };
+
+    // first time it is seen
+    auto s = service_from_json(service_json("svc3", configs, true).c_str());
+    CHECK_FALSE(ztx_service_unchanged(ztx, s));
+    ztx_set_service(ztx, s);
+
+    CHECK(unchanged(service_json("svc3", configs, true)));
+
+    SECTION("order of configs does not matter") {
+        CHECK(unchanged(service_json("svc3", R"({"ziti-tunneler-client.v1": {"hostname": "svc3.ziti", "port": 80},
+            "intercept.v1": {"protocols": ["tcp"], "addresses": ["svc3.ziti"],
+            "portRanges": [{"low": 80, "high": 80}]}})", true)));
+    }
+
+    SECTION("changed config") {
+        auto changed = service_json("svc3", R"({"ziti-tunneler-client.v1": {"hostname": "svc3.ziti", "port": 443}})",
+                                    true);
+        CHECK_FALSE(unchanged(changed));
+        // digest is recorded, service is processed and stored by refresh
+        ztx_set_service(ztx, service_from_json(changed.c_str()));
+        CHECK(unchanged(changed));
+    }
+
+    SECTION("changed posture policy") {
+        CHECK_FALSE(unchanged(service_json("svc3", configs, false)));
+    }
+
+    SECTION("renamed service") {
+        CHECK_FALSE(unchanged(service_json("svc3-renamed", configs, true)));
+    }
+
+    SECTION("forced update") {
+        ziti_force_service_update(ztx, "svc3-id");
+        CHECK_FALSE(unchanged(service_json("svc3", configs, true)));
+    }
+
+    SECTION("dropped service") {
+        ztx_drop_service(ztx, "svc3");
+        CHECK(model_map_get(&ztx->service_hashes, "svc3-id") == nullptr);
+        CHECK_FALSE(unchanged(service_json("svc3", configs, true)));
+    }
+
+    free_test_ztx(ztx);
+}